@@ -32,8 +32,9 @@
    STDLIB WRAPPER SETTINGS
  *=========================*/
 
-/*Enable and configure the built-in memory manager*/
-#define LV_USE_BUILTIN_MALLOC 1
+/*Enable and configure the built-in memory manager.
+ *It is disabled because LVGL allocates from the pools and heap in src/MemoryArena.cpp, through LV_MALLOC, LV_REALLOC and LV_FREE below*/
+#define LV_USE_BUILTIN_MALLOC 0
 #if LV_USE_BUILTIN_MALLOC
     /*Size of the memory available for `lv_malloc()` in bytes (>= 2kB)*/
     #define LV_MEM_SIZE (64U * 1024U)          /*[bytes]*/
@@ -62,9 +63,9 @@
 #define LV_STDLIB_INCLUDE <stdint.h>
 #define LV_STDIO_INCLUDE  <stdint.h>
 #define LV_STRING_INCLUDE <stdint.h>
-#define LV_MALLOC       lv_malloc_builtin
-#define LV_REALLOC      lv_realloc_builtin
-#define LV_FREE         lv_free_builtin
+#define LV_MALLOC       arena_malloc
+#define LV_REALLOC      arena_realloc
+#define LV_FREE         arena_free
 #define LV_MEMSET       lv_memset_builtin
 #define LV_MEMCPY       lv_memcpy_builtin
 #define LV_SNPRINTF     lv_snprintf_builtin
@@ -72,6 +73,14 @@
 #define LV_STRLEN       lv_strlen_builtin
 #define LV_STRNCPY      lv_strncpy_builtin
 
+/*The allocator functions, defined in src/MemoryArena.cpp*/
+#if !defined(__ASSEMBLY__) && !defined(__cplusplus)
+    #include <stddef.h>
+    void * arena_malloc(size_t size);
+    void * arena_realloc(void * p, size_t new_size);
+    void arena_free(void * p);
+#endif
+
 /*====================
    HAL SETTINGS
  *====================*/
@@ -355,28 +364,29 @@
  *===================*/
 
 /*Montserrat fonts with ASCII range and some symbols using bpp = 4
- *https://fonts.google.com/specimen/Montserrat*/
-#define LV_FONT_MONTSERRAT_8  1
-#define LV_FONT_MONTSERRAT_10 1
-#define LV_FONT_MONTSERRAT_12 1
-#define LV_FONT_MONTSERRAT_14 1
-#define LV_FONT_MONTSERRAT_16 1
+ *https://fonts.google.com/specimen/Montserrat
+ *The UI only uses size 18, which is also the source font for the subset below*/
+#define LV_FONT_MONTSERRAT_8  0
+#define LV_FONT_MONTSERRAT_10 0
+#define LV_FONT_MONTSERRAT_12 0
+#define LV_FONT_MONTSERRAT_14 0
+#define LV_FONT_MONTSERRAT_16 0
 #define LV_FONT_MONTSERRAT_18 1
-#define LV_FONT_MONTSERRAT_20 1
-#define LV_FONT_MONTSERRAT_22 1
-#define LV_FONT_MONTSERRAT_24 1
-#define LV_FONT_MONTSERRAT_26 1
-#define LV_FONT_MONTSERRAT_28 1
-#define LV_FONT_MONTSERRAT_30 1
-#define LV_FONT_MONTSERRAT_32 1
-#define LV_FONT_MONTSERRAT_34 1
-#define LV_FONT_MONTSERRAT_36 1
-#define LV_FONT_MONTSERRAT_38 1
-#define LV_FONT_MONTSERRAT_40 1
-#define LV_FONT_MONTSERRAT_42 1
-#define LV_FONT_MONTSERRAT_44 1
-#define LV_FONT_MONTSERRAT_46 1
-#define LV_FONT_MONTSERRAT_48 1
+#define LV_FONT_MONTSERRAT_20 0
+#define LV_FONT_MONTSERRAT_22 0
+#define LV_FONT_MONTSERRAT_24 0
+#define LV_FONT_MONTSERRAT_26 0
+#define LV_FONT_MONTSERRAT_28 0
+#define LV_FONT_MONTSERRAT_30 0
+#define LV_FONT_MONTSERRAT_32 0
+#define LV_FONT_MONTSERRAT_34 0
+#define LV_FONT_MONTSERRAT_36 0
+#define LV_FONT_MONTSERRAT_38 0
+#define LV_FONT_MONTSERRAT_40 0
+#define LV_FONT_MONTSERRAT_42 0
+#define LV_FONT_MONTSERRAT_44 0
+#define LV_FONT_MONTSERRAT_46 0
+#define LV_FONT_MONTSERRAT_48 0
 
 /*Demonstrate special features*/
 #define LV_FONT_MONTSERRAT_12_SUBPX      0
@@ -391,10 +401,23 @@
 /*Optionally declare custom fonts here.
  *You can use these fonts as default font too and they will be available globally.
  *E.g. #define LV_FONT_CUSTOM_DECLARE   LV_FONT_DECLARE(my_font_1) LV_FONT_DECLARE(my_font_2)*/
-#define LV_FONT_CUSTOM_DECLARE
+/*ems_font_18 is the subset of Montserrat 18 holding only the characters the UI displays, which font-subset writes to src/UI/EmsFont18.c (see README.md).
+ *Define EMS_FONT_SUBSET as 1 on the command line of the LVGL, firmware and simulator builds to use it, after generating that file.*/
+#ifndef EMS_FONT_SUBSET
+    #define EMS_FONT_SUBSET 0
+#endif
+#if EMS_FONT_SUBSET
+    #define LV_FONT_CUSTOM_DECLARE LV_FONT_DECLARE(ems_font_18)
+#else
+    #define LV_FONT_CUSTOM_DECLARE
+#endif
 
 /*Always set a default font*/
-#define LV_FONT_DEFAULT &lv_font_montserrat_18
+#if EMS_FONT_SUBSET
+    #define LV_FONT_DEFAULT &ems_font_18
+#else
+    #define LV_FONT_DEFAULT &lv_font_montserrat_18
+#endif
 
 /*Enable handling large font and/or fonts with a lot of characters.
  *The limit depends on the font size, font face and bpp.
@@ -9,6 +9,9 @@
 #include <RP2040/Devices.h>
 #include <TaskPriorities.h>
 #include <Display.h>
+#include <SettingsStore.h>
+#include <MemoryArena.h>
+#include <Telemetry/Telemetry.h>
 #include <Drivers/LedDriver.h>
 #include <Drivers/Buzzer.h>
 #include <hardware/timer.h>
@@ -31,8 +34,10 @@ constexpr unsigned int IdleTaskStackWords = 200;				// currently we don't use th
 static Task<IdleTaskStackWords> idleTask;
 
 // Make malloc/free thread safe. We must use a recursive mutex for it.
+// Nothing should use the newlib heap once startup is complete, so we count any calls made after that.
 extern "C" void __malloc_lock (struct _reent *_r) noexcept
 {
+	MemoryArena::NoteHeapCall();
 	if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)		// don't take mutex if scheduler not started or suspended
 	{
 		mallocMutex.Take();
@@ -72,18 +77,21 @@ extern "C" void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuf
 extern "C" [[noreturn]] void MainTask(void*) noexcept
 {
 	serialUSB.Start(NoPin);
-	Display::Init();
+	SettingsStore::Init();
+	Display::Init();						// the panel is initialised and cleared while we do the rest
 	Buzzer::Init();
+	uint8_t volume;
+	if (SettingsStore::Read(SettingsStore::Key::buzzerVolume, volume))
+	{
+		Buzzer::SetVolume(volume);
+	}
 	LedDriver::Init();
-	LedDriver::SetColour(255, 0, 0);		// red
-	delay(500);
-	LedDriver::SetColour(0, 255, 0);		// green
-	delay(500);
 	LedDriver::SetColour(0, 0, 255);		// blue
 
+	Display::Start();						// build the screen and show the first frame
 	Buzzer::Beep(2000, 500);
-
-	Display::Start();
+	Telemetry::Start();
+	MemoryArena::EndStartup();
 	for (;;)
 	{
 		Display::Spin();
@@ -108,7 +116,7 @@ extern "C" [[noreturn]] void MainTask(void*) noexcept
 #endif
 
 	// Create the startup task and memory allocation mutex
-	mainTask.Create(MainTask, "MAIN", nullptr, TaskPriority::SpinPriority);
+	mainTask.Create(MainTask, "MAIN", nullptr, TaskPriority::DisplayPriority);
 	mallocMutex.Create("Malloc");
 
 	// Initialise watchdog clock
@@ -124,7 +132,6 @@ extern "C" void vApplicationTickHook(void) noexcept
 {
 	CoreSysTick();
 	watchdog_update();
-	Display::Tick();
 	Buzzer::Tick();
 }
 
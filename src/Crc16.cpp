@@ -0,0 +1,41 @@
+/*
+ * Crc16.cpp
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ */
+
+#include "Crc16.h"
+
+// Table of the CRC of each possible top byte, built at compile time so that it lives in flash
+struct Crc16Table
+{
+	uint16_t entries[256];
+
+	constexpr Crc16Table() noexcept : entries()
+	{
+		for (unsigned int i = 0; i < 256; ++i)
+		{
+			uint16_t crc = (uint16_t)(i << 8);
+			for (unsigned int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+			}
+			entries[i] = crc;
+		}
+	}
+};
+
+static constexpr Crc16Table table;
+
+uint16_t Crc16(const uint8_t *data, size_t length, uint16_t crc) noexcept
+{
+	while (length != 0)
+	{
+		crc = (uint16_t)(crc << 8) ^ table.entries[(crc >> 8) ^ *data++];
+		--length;
+	}
+	return crc;
+}
+
+// End
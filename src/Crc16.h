@@ -0,0 +1,21 @@
+/*
+ * Crc16.h
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ *
+ *  CRC-16-CCITT (polynomial 0x1021, initial value 0xFFFF, no reflection), as used by the settings store and the telemetry frames
+ */
+
+#ifndef SRC_CRC16_H_
+#define SRC_CRC16_H_
+
+#include <cstdint>
+#include <cstddef>
+
+constexpr uint16_t Crc16InitialValue = 0xFFFF;
+
+// Calculate the CRC of a block of data. To calculate the CRC of data in several blocks, pass the result for one block as 'crc' for the next.
+uint16_t Crc16(const uint8_t *data, size_t length, uint16_t crc = Crc16InitialValue) noexcept;
+
+#endif /* SRC_CRC16_H_ */
@@ -7,10 +7,24 @@
 
 #include <Core.h>
 #include "Display.h"
+#include "DisplayWake.h"
+#include "PowerManager.h"
 #include <Drivers/SSD1963.h>
+#include <Drivers/FrameScheduler.h>
 #include <Drivers/Buzzer.h>
 #include <Drivers/TouchPanel.h>
+#include <Drivers/TouchAcquisition.h>
 #include "Pins.h"
+#include "Profiler.h"
+#include "SettingsStore.h"
+#include <Telemetry/Telemetry.h>
+#include <UI/DataModel.h>
+#include <UI/StripChart.h>
+#include <UI/GlyphCache.h>
+#include <UI/DeferredFill.h>
+#include <Interrupts.h>
+#include <hardware/timer.h>
+#include <cstring>
 
 #include <lvgl.h>
 #include <src/hal/lv_hal_disp.h>
@@ -18,29 +32,166 @@
 constexpr unsigned int DISP_HOR_RES = SSD1963_HOR_RES;
 constexpr unsigned int DISP_VER_RES = SSD1963_VER_RES;
 
+// Draw buffer configuration. Each buffer holds a band of DisplayBufferLines full-width lines; bigger bands mean fewer flushes but use more RAM.
+// With two buffers, LVGL renders the next band into one buffer while the other one is still being sent to the display by DMA.
+#ifndef DISPLAY_DOUBLE_BUFFERED
+# define DISPLAY_DOUBLE_BUFFERED	1
+#endif
+
+// Large opaque fills are sent to the display as runs instead of being drawn into the draw buffer (see UI/DeferredFill.h)
+#ifndef DISPLAY_DEFERRED_FILL
+# define DISPLAY_DEFERRED_FILL		1
+#endif
+
+#ifndef DISPLAY_BUFFER_LINES
+# if DISPLAY_DOUBLE_BUFFERED
+#  define DISPLAY_BUFFER_LINES		(SSD1963_VER_RES/20)		// two buffers of 1/20 screen size each, so the same RAM as a single 1/10 screen buffer
+# else
+#  define DISPLAY_BUFFER_LINES		(SSD1963_VER_RES/10)		// one buffer of 1/10 screen size
+# endif
+#endif
+
+constexpr unsigned int DisplayBufferLines = DISPLAY_BUFFER_LINES;
+constexpr unsigned int DisplayBufferPixels = DISP_HOR_RES * DisplayBufferLines;
+static_assert(DisplayBufferLines >= 1 && DisplayBufferLines <= DISP_VER_RES);
+
+constexpr uint32_t MaxWaitMillis = 1000;					// longest we let the display task sleep, so that the history is recorded each second
+constexpr uint32_t MaxFlushWaitMillis = 5;					// how long we block waiting for a flush before checking it again, in case a wake was missed
+
 static lv_disp_draw_buf_t draw_buf;
-static lv_color_t buf1[DISP_HOR_RES * DISP_VER_RES / 10];	// Declare a buffer for 1/10 screen size
+alignas(4) static lv_color_t buf1[DisplayBufferPixels];		// word aligned so that the flush function can compare two pixels at a time
+#if DISPLAY_DOUBLE_BUFFERED
+alignas(4) static lv_color_t buf2[DisplayBufferPixels];
+#endif
 static lv_disp_drv_t disp_drv;								// Descriptor of a display driver
+static lv_disp_t *disp = nullptr;
+static bool flushedThisHandler = false;						// lv_timer_handler has sent something to the display
+static bool framePending = false;							// a frame is being flushed and hasn't been passed to the frame scheduler yet
+static uint32_t frameStartTime;								// value of time_us_32() when lv_timer_handler started rendering the pending frame
+static uint32_t refreshPeriod = 0;							// LVGL refresh period in milliseconds
+static uint32_t lvglTime = 0;								// value of time_us_32() up to which we have advanced the LVGL tick
+static uint32_t nextTimerDelay = 0;							// milliseconds until the next LVGL timer is due, as returned by lv_timer_handler
+static bool touchReleaseSeen = true;						// the last touch panel read was released, so the next released read can stop the polling
+static uint32_t ignoredTouchNumber = 0;						// number of the touch that woke the display, which LVGL doesn't see
+static uint8_t backlightLevel = DefaultBacklight;
 
 static lv_indev_drv_t indev_drv;							// Descriptor of an input device
 static lv_indev_t * my_indev = nullptr;
 
-static lv_obj_t * label;
+// Fields shown on the tiles
+static constexpr NumberFormat PowerFormat = { 10, 2, 5, " kW" };				// watts shown as kW to 10W resolution
+static constexpr NumberFormat ChargeFormat = { 10, 0, 5, " %" };				// tenths of a percent shown as whole percent
+static NumberField gridPower(PowerFormat), solarPower(PowerFormat), batteryPower(PowerFormat), homePower(PowerFormat);
+static NumberField batteryCharge(ChargeFormat);
+
+static constexpr const char *MotionStates[] = { "Idle", "Detected motion" };
+static StateField motionState(MotionStates, ARRAY_SIZE(MotionStates));
+
+// Where the telemetry fields get their values from
+struct EmsFieldSource
+{
+	NumberField& field;
+	Ems::Source source;
+	Ems::Quantity quantity;
+};
+
+static const EmsFieldSource emsFieldSources[] =
+{
+	{ gridPower, Ems::Source::grid, Ems::Quantity::power },
+	{ solarPower, Ems::Source::solar, Ems::Quantity::power },
+	{ batteryPower, Ems::Source::battery, Ems::Quantity::power },
+	{ batteryCharge, Ems::Source::battery, Ems::Quantity::stateOfCharge },
+	{ homePower, Ems::Meter(0), Ems::Quantity::power },
+};
+
+// The tiles, in grid order
+struct Tile
+{
+	const char *title;
+	const ModelField& field;
+};
+
+static const Tile tiles[] =
+{
+	{ "Grid", gridPower },
+	{ "Solar", solarPower },
+	{ "Home", homePower },
+	{ "Battery", batteryPower },
+	{ "Charge", batteryCharge },
+	{ "Motion", motionState },
+};
+
+// Called by LVGL when it needs a draw buffer that is still being flushed. We do the waiting here so that the profiler can separate rendering time from waiting time.
+// The task blocks until the display driver's completion interrupt wakes it, so the other tasks on this core run in the meantime.
+static void WaitForFlush(lv_disp_drv_t *drv) noexcept
+{
+	const uint32_t startTime = time_us_32();
+	SSD1963::WaitForFlush(drv);
+	Profiler::AddWaitTime(time_us_32() - startTime);
+}
+
+// Called by the display driver in an interrupt when a flush or fill that we are waiting for has completed
+static void WakeFromFlush() noexcept
+{
+	DisplayWake::NotifyFromIsr(DisplayWake::Event::flush);
+}
+
+// Called by the display driver while we wait for a flush or fill
+static void BlockForFlush() noexcept
+{
+	DisplayWake::WaitForFlush(MaxFlushWaitMillis);
+}
+
+// Called by the display driver for the delays in the panel initialisation when it is done on this core. We are in the main task, so the scheduler is running.
+static void SleepForPanel(uint32_t millis) noexcept
+{
+	delay(millis + 1);						// the delay can end up to a tick early
+}
 
+// LVGL input device callback. The touch panel is read by the acquisition task, so all we need to do here is collect the latest sample.
 static void ReadTouchPanel(lv_indev_drv_t *drv, lv_indev_data_t*data) noexcept
 {
-	uint16_t x, y;
-	static bool repeat = false;
-	if (TouchPanel::Read(x, y, repeat))
+	static TouchSample sample = {};
+	static uint32_t lastTouchNumber = 0;
+	(void)TouchAcquisition::GetLatest(sample);				// if a new sample is being published then we use the previous one
+	if (sample.pressed && sample.touchNumber != ignoredTouchNumber)
 	{
-		data->point.x = x;
-		data->point.y = y;
+		data->point.x = sample.x;
+		data->point.y = sample.y;
 		data->state = LV_INDEV_STATE_PRESSED;
+		if (sample.touchNumber != lastTouchNumber)
+		{
+			lastTouchNumber = sample.touchNumber;
+			Profiler::AddTouchLatency(time_us_32() - sample.touchTime);
+		}
 	}
 	else
 	{
 		data->state = LV_INDEV_STATE_RELEASED;
+		if (touchReleaseSeen && !sample.pressed)
+		{
+			lv_timer_pause(drv->read_timer);				// LVGL has seen the release, so stop polling until the acquisition task sees a touch
+		}
 	}
+	touchReleaseSeen = !sample.pressed;
+}
+
+// Initialise the software draw context with the glyph cache and the deferred fills
+static void InitDrawContext(lv_disp_drv_t *drv, lv_draw_ctx_t *drawCtx) noexcept
+{
+	GlyphCache::Install(drv, drawCtx);
+#if DISPLAY_DEFERRED_FILL
+	DeferredFill::Install(drawCtx);
+#endif
+}
+
+// Send a draw buffer to the display along with the fills that were left out of it
+static void Flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *colours) noexcept
+{
+	size_t numSolidAreas;
+	const SSD1963::SolidArea * const solidAreas = DeferredFill::TakeSolidAreas(colours, numSolidAreas);
+	flushedThisHandler = true;
+	SSD1963::FlushWithSolidAreas(drv, area, colours, solidAreas, numSolidAreas);
 }
 
 static void TouchPanelFeedback(lv_indev_drv_t *drv, uint8_t inEvent) noexcept
@@ -51,69 +202,266 @@ static void TouchPanelFeedback(lv_indev_drv_t *drv, uint8_t inEvent) noexcept
 	}
 }
 
+// Motion sensor interrupt, on both edges
+static void MotionInterrupt(CallbackParameter) noexcept
+{
+	DisplayWake::NotifyFromIsr(DisplayWake::Event::motion);
+}
+
 // Initialise the display
 void Display::Init() noexcept
 {
-	SSD1963::Init();
+	DisplayWake::Init();
+
+	(void)SettingsStore::Read(SettingsStore::Key::backlightLevel, backlightLevel);
+	SSD1963::SetWaitFunctions(WakeFromFlush, BlockForFlush, SleepForPanel);
+	SSD1963::Init(backlightLevel);
 	lv_init();
-	lv_disp_draw_buf_init(&draw_buf, buf1, nullptr, DISP_HOR_RES * DISP_VER_RES / 10);  /*Initialize the display buffer.*/
+	lvglTime = time_us_32();
+#if DISPLAY_DOUBLE_BUFFERED
+	lv_disp_draw_buf_init(&draw_buf, buf1, buf2, DisplayBufferPixels);		/*Initialize the display buffers.*/
+#else
+	lv_disp_draw_buf_init(&draw_buf, buf1, nullptr, DisplayBufferPixels);	/*Initialize the display buffer.*/
+#endif
 	lv_disp_drv_init(&disp_drv);			/*Basic initialization*/
-	disp_drv.flush_cb = SSD1963::Flush;		/*Set your driver function*/
+	disp_drv.flush_cb = Flush;			/*Set your driver function*/
 	disp_drv.draw_buf = &draw_buf;			/*Assign the buffer to the display*/
+	disp_drv.wait_cb = WaitForFlush;
+	disp_drv.render_start_cb = SSD1963::JoinAreas;
+	disp_drv.draw_ctx_init = InitDrawContext;
 	disp_drv.hor_res = DISP_HOR_RES;		/*Set the horizontal resolution of the display*/
 	disp_drv.ver_res = DISP_VER_RES;		/*Set the vertical resolution of the display*/
-	lv_disp_drv_register(&disp_drv);		/*Finally register the driver*/
+	disp = lv_disp_drv_register(&disp_drv);	/*Finally register the driver*/
+	refreshPeriod = FrameScheduler::GetRefreshPeriod();
+	lv_timer_set_period(_lv_disp_get_refr_timer(disp), refreshPeriod);
 
-	TouchPanel::Init(SSD1963_HOR_RES, SSD1963_VER_RES, DisplayOrientation::SwapXY | DisplayOrientation::ReverseY);
+	DisplayOrientation orientation = DisplayOrientation::SwapXY | DisplayOrientation::ReverseY;
+	(void)SettingsStore::Read(SettingsStore::Key::displayOrientation, orientation);
+	TouchPanel::Init(SSD1963_HOR_RES, SSD1963_VER_RES, orientation);
+	SettingsStore::TouchCalibration cal;
+	if (SettingsStore::Read(SettingsStore::Key::touchCalibration, cal))
+	{
+		TouchPanel::Calibrate(cal.xLow, cal.xHigh, cal.yLow, cal.yHigh, cal.margin);
+	}
+	TouchAcquisition::Start();
 	lv_indev_drv_init(&indev_drv);      	/*Basic initialization*/
 	indev_drv.type = LV_INDEV_TYPE_POINTER;	/*Device type*/
 	indev_drv.read_cb = ReadTouchPanel;		/*See below.*/
 	indev_drv.feedback_cb = TouchPanelFeedback;
 	my_indev = lv_indev_drv_register(&indev_drv);	/*Register the driver in LVGL and save the created input device object*/
+
+	pinMode(MotionSensorPin, INPUT);
+	attachInterrupt(MotionSensorPin, MotionInterrupt, InterruptMode::change, CallbackParameter(nullptr));
 }
 
-void Display::Tick() noexcept
+// Advance the LVGL tick to the current time. LVGL has no tick interrupt, so this must be called before lv_timer_handler.
+static void UpdateLvglTime() noexcept
 {
-	lv_tick_inc(1);
+	const uint32_t elapsedMillis = (time_us_32() - lvglTime)/1000;
+	if (elapsedMillis != 0)
+	{
+		lvglTime += elapsedMillis * 1000;
+		lv_tick_inc(elapsedMillis);
+	}
 }
 
-void Display::Spin() noexcept
+// Power chart below the tiles
+constexpr uint32_t ChartSecondsPerColumn = 2;
+constexpr int32_t ChartRangeStep = 5000;							// the chart range is a multiple of this many watts
+static constexpr Ems::Source ChartSources[] = { Ems::Source::grid, Ems::Source::solar, Ems::Source::battery };
+static StripChart powerChart;
+static uint32_t chartTime = 0;										// history time up to which the chart has been drawn
+static int32_t chartMin = -ChartRangeStep, chartMax = ChartRangeStep;
+
+// Get the summary of each charted source over one column's worth of history
+static void GetChartColumn(uint32_t start, TimeSeries::Summary *values) noexcept
+{
+	for (size_t i = 0; i < ARRAY_SIZE(ChartSources); ++i)
+	{
+		const TimeSeries * const history = Telemetry::GetHistory(ChartSources[i]);
+		(void)history->Query(start, start + ChartSecondsPerColumn, values[i]);
+	}
+}
+
+// Widen the chart range if a column doesn't fit, returning true if we did. We never narrow it, because that would redraw the whole chart.
+static bool WidenChartRange(const TimeSeries::Summary *values, int32_t& minValue, int32_t& maxValue) noexcept
+{
+	bool widened = false;
+	for (size_t i = 0; i < ARRAY_SIZE(ChartSources); ++i)
+	{
+		if (values[i].count != 0)
+		{
+			while (values[i].max > maxValue)
+			{
+				maxValue += ChartRangeStep;
+				widened = true;
+			}
+			while (values[i].min < minValue)
+			{
+				minValue -= ChartRangeStep;
+				widened = true;
+			}
+		}
+	}
+	return widened;
+}
+
+// Add columns to the chart for any history recorded since we last did. Normally this adds one column and costs one column of pixels,
+// but if the range has to be widened then we redraw the columns the chart can hold from the history.
+static void UpdateChart() noexcept
+{
+	TimeSeries::Summary values[ARRAY_SIZE(ChartSources)];
+	while (Telemetry::GetHistoryTime() - chartTime >= ChartSecondsPerColumn)
+	{
+		GetChartColumn(chartTime, values);
+		chartTime += ChartSecondsPerColumn;
+		if (WidenChartRange(values, chartMin, chartMax))
+		{
+			powerChart.SetRange(chartMin, chartMax);
+			const size_t numColumns = powerChart.GetNumColumns();
+			const uint32_t span = (numColumns > StripChart::GapColumns) ? (numColumns - StripChart::GapColumns) * ChartSecondsPerColumn : 0;
+			for (uint32_t t = (chartTime > span) ? chartTime - span : 0; t < chartTime; t += ChartSecondsPerColumn)
+			{
+				GetChartColumn(t, values);
+				powerChart.AddColumn(values);
+			}
+		}
+		else
+		{
+			powerChart.AddColumn(values);
+		}
+	}
+}
+
+// Copy the latest telemetry readings to the fields. Readings that haven't changed enough to show are dropped here.
+static void UpdateEmsFields() noexcept
+{
+	const Ems::Data& data = Telemetry::GetData();
+	for (const EmsFieldSource& f : emsFieldSources)
+	{
+		if (data.IsValid(f.source, f.quantity))
+		{
+			(void)f.field.Set(data.Get(f.source, f.quantity));
+		}
+	}
+}
+
+// Tell the frame scheduler how long the last frame took once its final flush has completed, and use the refresh period it chooses
+static void CheckFrameCompleted() noexcept
 {
-	static bool detectedMotion = false;
-	if (digitalRead(MotionSensorPin))
+	if (framePending && !draw_buf.flushing)
 	{
-		if (!detectedMotion)
+		framePending = false;
+		FrameScheduler::FrameCompleted(frameStartTime, SSD1963::GetLastFlushTime());
+		const uint32_t period = FrameScheduler::GetRefreshPeriod();
+		if (period != refreshPeriod)
 		{
-			Buzzer::Beep(2000, 200);
-			lv_label_set_text(label, "Detected motion");
-			detectedMotion = true;
+			refreshPeriod = period;
+			lv_timer_set_period(_lv_disp_get_refr_timer(disp), period);
 		}
 	}
-	else if (detectedMotion)
+}
+
+// Store and apply the settings received over USB. A new setting counts as activity, so that the user can see the effect of it.
+static void ApplySettings() noexcept
+{
+	SettingsStore::Update update;
+	while (Telemetry::StoreNextSetting(update))
 	{
-		lv_label_set_text(label, "Idle");
-		detectedMotion = false;
+		switch (update.key)
+		{
+		case SettingsStore::Key::touchCalibration:
+			{
+				SettingsStore::TouchCalibration cal;
+				memcpy(&cal, update.value, sizeof(cal));
+				TouchPanel::Calibrate(cal.xLow, cal.xHigh, cal.yLow, cal.yHigh, cal.margin);
+			}
+			break;
+
+		case SettingsStore::Key::displayOrientation:
+			TouchPanel::AdjustOrientation((DisplayOrientation)(TouchPanel::GetOrientation() ^ update.value[0]));
+			break;
+
+		case SettingsStore::Key::backlightLevel:
+			backlightLevel = update.value[0];
+			PowerManager::SetActiveLevel(backlightLevel);
+			break;
+
+		case SettingsStore::Key::buzzerVolume:
+			Buzzer::SetVolume(update.value[0]);
+			break;
+		}
+		PowerManager::NoteActivity();
 	}
-	lv_timer_handler();
 }
 
-static void event_cb(lv_event_t * e)
+// Wait for the next LVGL timer or for something else to do, then do it
+void Display::Spin() noexcept
 {
-    LV_LOG_USER("Clicked");
+	const uint32_t events = DisplayWake::WaitForEvent(nextTimerDelay);
+	if (events & (uint32_t)DisplayWake::Event::touch)
+	{
+		if (PowerManager::IsDark())
+		{
+			// A touch on a dark screen just wakes it, so don't pass it to LVGL
+			TouchSample sample;
+			if (TouchAcquisition::GetLatest(sample) && sample.pressed)
+			{
+				ignoredTouchNumber = sample.touchNumber;
+			}
+		}
+		PowerManager::NoteActivity();
+		lv_timer_resume(indev_drv.read_timer);				// read the touch panel in this call of lv_timer_handler
+		lv_timer_ready(indev_drv.read_timer);
+	}
 
-    static uint32_t cnt = 1;
-    lv_obj_t * btn = lv_event_get_target(e);
-    lv_obj_t * label = lv_obj_get_child(btn, 0);
-    lv_label_set_text_fmt(label, "%" LV_PRIu32, cnt);
-    cnt++;
+	const bool motion = digitalRead(MotionSensorPin);
+	if (motionState.Set((motion) ? 1 : 0) && motionState.Get() != 0)
+	{
+		Buzzer::Beep(2000, 200);
+	}
+	if (motion)
+	{
+		PowerManager::NoteActivity();
+	}
+	ApplySettings();
+	const uint32_t powerDelay = PowerManager::Spin();
+	const bool moreUpdates = Telemetry::ApplyUpdates();
+	if (PowerManager::IsDark())
+	{
+		// Nothing can be seen, so don't render or flush. The fields and chart catch up with the telemetry when the backlight comes back on.
+		nextTimerDelay = (moreUpdates) ? 0 : min<uint32_t>(powerDelay, MaxWaitMillis);
+		Profiler::Spin();
+		return;
+	}
+
+	UpdateEmsFields();
+	DataModel::Refresh();
+	UpdateChart();
+	CheckFrameCompleted();
+	const uint32_t handlerStartTime = time_us_32();
+	flushedThisHandler = false;
+	UpdateLvglTime();
+	Profiler::HandlerStarting();
+	const uint32_t timerDelay = lv_timer_handler();
+	Profiler::HandlerFinished();
+	nextTimerDelay = (moreUpdates) ? 0 : min<uint32_t>(min<uint32_t>(timerDelay, powerDelay), MaxWaitMillis);
+	if (flushedThisHandler)
+	{
+		framePending = true;
+		frameStartTime = handlerStartTime;
+	}
+	CheckFrameCompleted();
+	Profiler::Spin();
 }
 
 void Display::Start() noexcept
 {
 	constexpr lv_coord_t tileWidth = DISP_HOR_RES/3 - 21;
-	constexpr lv_coord_t tileHeight = DISP_VER_RES/2 - 28;
+	constexpr lv_coord_t tileHeight = DISP_VER_RES/4 - 14;
+	constexpr lv_coord_t chartHeight = DISP_VER_RES/2 - 38;
     static constexpr lv_coord_t col_dsc[] = {tileWidth, tileWidth, tileWidth, LV_GRID_TEMPLATE_LAST};
-    static constexpr lv_coord_t row_dsc[] = {tileHeight, tileHeight, LV_GRID_TEMPLATE_LAST};
+    static constexpr lv_coord_t row_dsc[] = {tileHeight, tileHeight, chartHeight, LV_GRID_TEMPLATE_LAST};
 
     // Create a grid that fills the screen
     lv_obj_t * cont = lv_obj_create(lv_scr_act());
@@ -125,7 +473,7 @@ void Display::Start() noexcept
     lv_obj_center(cont);
     lv_obj_set_layout(cont, LV_LAYOUT_GRID);
 
-    for (uint32_t i = 0; i < 6; i++)
+    for (uint32_t i = 0; i < ARRAY_SIZE(tiles); i++)
     {
         const uint8_t col = i % 3;
         const uint8_t row = i / 3;
@@ -133,16 +481,38 @@ void Display::Start() noexcept
         lv_obj_t * const btn = lv_btn_create(cont);
         lv_obj_add_flag(btn, LV_OBJ_FLAG_CLICKABLE);
         lv_obj_add_flag(btn, LV_OBJ_FLAG_CLICK_FOCUSABLE);
-        lv_obj_add_event_cb(btn, event_cb, LV_EVENT_PRESSED, nullptr);
 
         // Stretch the cell horizontally and vertically
         // Set span to 1 to make the cell 1 column/row sized
         lv_obj_set_grid_cell(btn, LV_GRID_ALIGN_STRETCH, col, 1, LV_GRID_ALIGN_STRETCH, row, 1);
 
-        label = lv_label_create(btn);
-        lv_label_set_text_fmt(label, "c%u, r%u", col, row);
-        lv_obj_center(label);
+        lv_obj_t * const title = lv_label_create(btn);
+        lv_label_set_text_static(title, tiles[i].title);
+        lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 0);
+
+        lv_obj_t * const value = lv_label_create(btn);
+        lv_obj_center(value);
+        (void)DataModel::Bind(tiles[i].field, value);
+        (void)GlyphCache::AddFont(lv_obj_get_style_text_font(value, LV_PART_MAIN));
     }
+
+    // The power chart goes across the bottom row
+    powerChart.Create(cont);
+    lv_obj_set_grid_cell(powerChart.GetObject(), LV_GRID_ALIGN_STRETCH, 0, 3, LV_GRID_ALIGN_STRETCH, 2, 1);
+    powerChart.AddSeries(lv_palette_main(LV_PALETTE_RED));
+    powerChart.AddSeries(lv_palette_main(LV_PALETTE_AMBER));
+    powerChart.AddSeries(lv_palette_main(LV_PALETTE_GREEN));
+    powerChart.SetRange(chartMin, chartMax);
+    chartTime = Telemetry::GetHistoryTime();
+    DataModel::Refresh();
+
+    // Draw the first frame and turn the backlight on when it has been sent. The flushes wait for the panel initialisation to finish if necessary.
+    const uint32_t screenBuiltTime = time_us_32();
+    lv_refr_now(nullptr);
+    SSD1963::WaitForFlush(&disp_drv);
+    SSD1963::EnableBacklight();
+    PowerManager::Start(backlightLevel);
+    Profiler::SetBootTimes(SSD1963::GetReadyTime(), SSD1963::GetClearedTime(), screenBuiltTime, time_us_32());
 }
 
 // End
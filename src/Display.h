@@ -10,7 +10,6 @@
 
 namespace Display {
 	void Init() noexcept;
-	void Tick() noexcept;
 	void Spin() noexcept;
 	void Start() noexcept;
 }
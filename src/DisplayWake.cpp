@@ -0,0 +1,108 @@
+/*
+ * DisplayWake.cpp
+ *
+ *  Created on: 24 Feb 2023
+ *      Author: David
+ *
+ *  The events are set as bits in the notification value of the display task, so several can arrive while it is busy and all of them
+ *  are seen when it next waits. Only our bits are cleared when it wakes. Events that arrive while the task is waiting for a flush are kept
+ *  and returned by the next call to WaitForEvent, because the notification that carried them has been taken by then.
+ */
+
+#include "DisplayWake.h"
+#include <hardware/timer.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+using namespace DisplayWake;
+
+static TaskHandle_t displayTask = nullptr;
+static uint32_t lastWakeTime;
+static uint32_t flushWaitSinceWake = 0;					// microseconds spent in WaitForFlush since WaitForEvent last returned
+static uint32_t pendingEvents = 0;						// events taken by WaitForFlush, for WaitForEvent to return
+static Stats stats = {};
+
+// Record the calling task as the display task. Call this from the display task before any of the event sources are started.
+void DisplayWake::Init() noexcept
+{
+	displayTask = xTaskGetCurrentTaskHandle();
+	lastWakeTime = time_us_32();
+}
+
+// Wake the display task from another task
+void DisplayWake::Notify(Event e) noexcept
+{
+	if (displayTask != nullptr)
+	{
+		(void)xTaskNotify(displayTask, (uint32_t)e, eSetBits);
+	}
+}
+
+// Wake the display task from an interrupt
+void DisplayWake::NotifyFromIsr(Event e) noexcept
+{
+	if (displayTask != nullptr)
+	{
+		BaseType_t higherPriorityTaskWoken = pdFALSE;
+		(void)xTaskNotifyFromISR(displayTask, (uint32_t)e, eSetBits, &higherPriorityTaskWoken);
+		portYIELD_FROM_ISR(higherPriorityTaskWoken);
+	}
+}
+
+// Block the display task until an event arrives or maxMillis has passed, returning the events that arrived.
+// Events that arrived while the task was busy are returned at once. A flush completing just after WaitForFlush stopped waiting for it can make this
+// return early with no events, which costs no more than a spare pass of the display loop.
+uint32_t DisplayWake::WaitForEvent(uint32_t maxMillis) noexcept
+{
+	const uint32_t startTime = time_us_32();
+	stats.awakeTime += startTime - lastWakeTime - flushWaitSinceWake;
+	flushWaitSinceWake = 0;
+	uint32_t events = 0;
+	(void)xTaskNotifyWait(0, AllEvents | (uint32_t)Event::flush, &events,
+							(maxMillis == 0 || pendingEvents != 0) ? 0 : pdMS_TO_TICKS(maxMillis) + 1);	// +1 so that we don't wake just before the deadline
+	lastWakeTime = time_us_32();
+	stats.blockedTime += lastWakeTime - startTime;
+
+	events = (events | pendingEvents) & AllEvents;
+	pendingEvents = 0;
+	++stats.wakeups;
+	if (events == 0)
+	{
+		++stats.timerWakeups;
+	}
+	if (events & (uint32_t)Event::data)
+	{
+		++stats.dataWakeups;
+	}
+	if (events & (uint32_t)Event::touch)
+	{
+		++stats.touchWakeups;
+	}
+	if (events & (uint32_t)Event::motion)
+	{
+		++stats.motionWakeups;
+	}
+	return events;
+}
+
+// Block the display task until the display driver signals that a flush or fill has completed, or maxMillis has passed.
+// The caller must check whether the flush it is waiting for is the one that completed.
+void DisplayWake::WaitForFlush(uint32_t maxMillis) noexcept
+{
+	const uint32_t startTime = time_us_32();
+	uint32_t events = 0;
+	(void)xTaskNotifyWait(0, AllEvents | (uint32_t)Event::flush, &events, pdMS_TO_TICKS(maxMillis) + 1);
+	pendingEvents |= events & AllEvents;
+	const uint32_t waitTime = time_us_32() - startTime;
+	flushWaitSinceWake += waitTime;
+	stats.blockedTime += waitTime;
+	stats.flushWaitTime += waitTime;
+}
+
+const Stats& DisplayWake::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
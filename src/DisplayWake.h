@@ -0,0 +1,51 @@
+/*
+ * DisplayWake.h
+ *
+ *  Created on: 24 Feb 2023
+ *      Author: David
+ *
+ *  Lets the display task sleep between LVGL timer deadlines. The task blocks on a FreeRTOS notification, and the sources of work that
+ *  don't come from LVGL timers (decoded telemetry, touch samples and the motion sensor) notify it when they have something for it.
+ *  The task also blocks here while it waits for a flush to complete, woken by the display driver's completion interrupt.
+ *  The time the task spends blocked is counted so that the profiler can report how idle the display loop is.
+ */
+
+#ifndef SRC_DISPLAYWAKE_H_
+#define SRC_DISPLAYWAKE_H_
+
+#include <cstdint>
+
+namespace DisplayWake
+{
+	// Reasons for waking the display task, as bits of the notification value
+	enum class Event : uint32_t
+	{
+		data = 1u << 0,
+		touch = 1u << 1,
+		motion = 1u << 2,
+		flush = 1u << 3,					// a flush or fill that the task is waiting for has completed; not one of AllEvents
+	};
+
+	constexpr uint32_t AllEvents = (uint32_t)Event::data | (uint32_t)Event::touch | (uint32_t)Event::motion;
+
+	struct Stats
+	{
+		uint32_t wakeups;						// times the task returned from waiting
+		uint32_t timerWakeups;					// of those, the times it was woken by the LVGL timer deadline
+		uint32_t dataWakeups;					// times it was woken by each event, counted separately if several arrived together
+		uint32_t touchWakeups;
+		uint32_t motionWakeups;
+		uint64_t blockedTime;					// total microseconds spent waiting, including waiting for flushes
+		uint64_t flushWaitTime;					// of that, the microseconds spent waiting for flushes
+		uint64_t awakeTime;						// total microseconds spent between waits
+	};
+
+	void Init() noexcept;
+	void Notify(Event e) noexcept;
+	void NotifyFromIsr(Event e) noexcept;
+	uint32_t WaitForEvent(uint32_t maxMillis) noexcept;
+	void WaitForFlush(uint32_t maxMillis) noexcept;
+	const Stats& GetStats() noexcept;
+}
+
+#endif /* SRC_DISPLAYWAKE_H_ */
@@ -14,6 +14,7 @@
 // When the buzzer is on we drive it in differential mode.
 
 static uint32_t ticksUntilOff = 0;
+static uint8_t volume = Buzzer::MaxVolume;
 
 static void TurnOff() noexcept
 {
@@ -27,9 +28,10 @@ void Buzzer::Init() noexcept
 	TurnOff();
 }
 
-void Buzzer::SetVolume(uint8_t volume) noexcept
+// Set the volume, where MaxVolume gives a 50% duty cycle on each pin and lower volumes give proportionally shorter pulses
+void Buzzer::SetVolume(uint8_t newVolume) noexcept
 {
-	//TODO
+	volume = newVolume;
 }
 
 void Buzzer::Beep(uint32_t frequency, uint32_t milliseconds) noexcept
@@ -61,7 +63,8 @@ void Buzzer::Beep(uint32_t frequency, uint32_t milliseconds) noexcept
 	pwm_config_set_phase_correct(&config, true);
 	pwm_config_set_wrap(&config, top);
 	pwm_init(PwmNumber, &config, false);
-	pwm_set_both_levels(PwmNumber, top/2, top/2);
+	const uint16_t level = (uint16_t)(((uint32_t)(top/2) * volume)/MaxVolume);
+	pwm_set_both_levels(PwmNumber, level, level);
 	pwm_set_output_polarity(PwmNumber, false, true);
 	pwm_set_enabled(PwmNumber, true);
 	SetPinFunction(BuzzerLowPin, GpioPinFunction::Pwm);
@@ -11,6 +11,8 @@
 #include <cstdint>
 
 namespace Buzzer {
+	constexpr uint8_t MaxVolume = 255;
+
 	void Init() noexcept;
 	void SetVolume(uint8_t volume) noexcept;
 	void Beep(uint32_t frequency, uint32_t milliseconds) noexcept;
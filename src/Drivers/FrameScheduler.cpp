@@ -0,0 +1,234 @@
+/*
+ * FrameScheduler.cpp
+ *
+ *  Created on: 23 Feb 2023
+ *      Author: David
+ *
+ *  Times within a frame are in nanoseconds from the last tearing effect edge. Row r is scanned at pass * framePeriod + r * lineTime,
+ *  where pass 0 is the scan that started at that edge. A write of rows y1 to y2 is assumed to go at an even rate, one row every W nanoseconds.
+ *  It doesn't tear if every pass of the scan sees either none of it or all of it: that is, each pass reaches every row either before the row
+ *  starts to be written or after it has been written. The times involved are linear in the row number, so it is enough to check the first and last rows.
+ *  A pass that sees none of the write constrains the start time from below, and that is the only kind of lower bound, so the earliest start time
+ *  that doesn't tear is either now or just after one of the passes has gone by the area with the write following it. The scan repeats every frame,
+ *  so if there is a start time that doesn't tear there is one within a frame period of now, and we never look further ahead than that.
+ *
+ *  The edge time and the frame period are written by the tearing effect interrupt on core 0 and read by the flush worker, which may be on core 1,
+ *  so they are published together through a mailbox and the reader always sees a pair from the same edge.
+ *  Edges can be missed, for example while the panel scan is stopped or when the interrupt is held off, so an interval close to a whole number of
+ *  frame periods is still used to measure the period. Intervals that don't fit stop the pacing until the edges match again, and if several in a row
+ *  agree with each other but not with the period we have then the period is measured again from scratch.
+ */
+
+#include "FrameScheduler.h"
+#include <Mailbox.h>
+
+using namespace FrameScheduler;
+
+constexpr unsigned int PassesToTry = 3;				// the start times we look at are within this many frames of the last edge
+constexpr uint32_t MaxFramesBetweenEdges = 8;		// the most frames an interval between edges can cover and still be used to measure the period
+constexpr uint32_t IntervalsBeforeResync = 3;		// consecutive intervals that must agree with each other but not with the period before we measure it again
+
+// The timing of the last edge, as published by TearEdge
+struct EdgeTiming
+{
+	uint32_t edgeTime;								// value of time_us_32() at the last edge
+	uint32_t framePeriod;							// nanoseconds, measured from the tearing effect edges
+	uint32_t matchedEdges;							// consecutive edges that have matched the frame period, 0 if we are not synchronised
+};
+
+static uint32_t totalLines = 1;
+static uint32_t nominalFramePeriod = 1;				// nanoseconds
+static Mailbox<EdgeTiming> edgeTiming;
+
+// State used only by TearEdge
+static uint32_t lastEdgeTime = 0;
+static uint32_t framePeriod = 1;					// nanoseconds
+static uint32_t matchedEdges = 0;
+static uint32_t lastUnmatchedInterval = 0;			// microseconds
+static uint32_t unmatchedIntervals = 0;				// consecutive intervals that agreed with each other but not with the frame period
+
+static uint32_t framesPerRefresh = 1;
+static uint32_t framesFitting = 0;					// consecutive frames that would have fitted in one panel frame fewer
+static Stats stats = {};
+
+// Return true if no pass of the scan would see part of a write that starts at t0, writes one row every rowTime and ends at tEnd
+static bool IsClean(int32_t t0, int32_t tEnd, int32_t rowTime, uint16_t firstRow, uint16_t lastRow, int32_t period, int32_t lineTime, int32_t margin) noexcept
+{
+	for (int32_t pass = 0; ; ++pass)
+	{
+		const int32_t scanFirst = pass * period + firstRow * lineTime;
+		const int32_t scanLast = pass * period + lastRow * lineTime;
+		if (scanFirst > tEnd + margin)
+		{
+			return true;													// this pass and the later ones only see the new data
+		}
+		const bool seesNone = scanFirst < t0 - margin && scanLast < t0 + (lastRow - firstRow) * rowTime - margin;
+		const bool seesAll = scanFirst > t0 + rowTime + margin && scanLast > tEnd + margin;
+		if (!seesNone && !seesAll)
+		{
+			return false;
+		}
+	}
+}
+
+// Set the nominal panel timing. The frame period is then measured from the tearing effect edges.
+void FrameScheduler::Init(uint32_t lineNanoseconds, uint16_t p_totalLines) noexcept
+{
+	totalLines = p_totalLines;
+	nominalFramePeriod = framePeriod = lineNanoseconds * p_totalLines;
+	matchedEdges = unmatchedIntervals = 0;
+	edgeTiming.Publish(EdgeTiming{ lastEdgeTime, framePeriod, 0 });
+	stats.framePeriod = framePeriod;
+	framesPerRefresh = 1;
+	stats.refreshPeriod = (framePeriod + 500000)/1000000;
+}
+
+// Return the timing of the last edge. The interrupt takes about a microsecond to publish it, so if we catch it part way through we don't wait long.
+static EdgeTiming GetEdgeTiming() noexcept
+{
+	EdgeTiming timing;
+	while (!edgeTiming.Read(timing)) { }
+	return timing;
+}
+
+// Called from the tearing effect interrupt on its falling edge, when the panel starts to scan row 0
+void FrameScheduler::TearEdge(uint32_t now) noexcept
+{
+	const uint32_t interval = now - lastEdgeTime;									// microseconds
+	lastEdgeTime = now;
+	if (stats.tearEdges++ != 0)
+	{
+		const uint32_t periodMicroseconds = framePeriod/1000;
+		const uint32_t frames = (interval + periodMicroseconds/2)/periodMicroseconds;
+		const int32_t error = (int32_t)(interval - frames * periodMicroseconds);
+		if (frames != 0 && frames <= MaxFramesBetweenEdges && error < (int32_t)periodMicroseconds/4 && error > -(int32_t)periodMicroseconds/4)
+		{
+			// The interval covers a whole number of frames, possibly with some edges missed in between
+			stats.missedEdges += frames - 1;
+			framePeriod = framePeriod + ((int32_t)((interval * 1000)/frames - framePeriod))/8;		// smooth out the interrupt latency
+			++matchedEdges;
+			unmatchedIntervals = 0;
+		}
+		else
+		{
+			// Stop pacing until the edges match the period again. If the last few intervals agree with each other then the panel timing has changed, so start again from them.
+			matchedEdges = 0;
+			const uint32_t difference = (interval > lastUnmatchedInterval) ? interval - lastUnmatchedInterval : lastUnmatchedInterval - interval;
+			unmatchedIntervals = (unmatchedIntervals != 0 && difference < lastUnmatchedInterval/16) ? unmatchedIntervals + 1 : 1;
+			lastUnmatchedInterval = interval;
+			if (unmatchedIntervals >= IntervalsBeforeResync && interval > nominalFramePeriod/4000 && interval < (4 * nominalFramePeriod)/1000)
+			{
+				framePeriod = interval * 1000;
+				matchedEdges = 1;
+				unmatchedIntervals = 0;
+				++stats.resyncs;
+			}
+		}
+		stats.framePeriod = framePeriod;
+	}
+	edgeTiming.Publish(EdgeTiming{ now, framePeriod, matchedEdges });
+}
+
+// Return the time at which to start writing screen rows firstRow to lastRow so that the scan doesn't show part of the write, given how long the write takes.
+// The time is a value of time_us_32() and is 'now' if the write can start at once. It is never more than one frame period after 'now'.
+uint32_t FrameScheduler::GetStartTime(uint32_t now, uint16_t firstRow, uint16_t lastRow, uint32_t writeNanoseconds) noexcept
+{
+	const EdgeTiming timing = GetEdgeTiming();
+	const uint32_t edgeTime = timing.edgeTime;
+	const int32_t period = timing.framePeriod;
+	if (timing.matchedEdges == 0 || now - edgeTime > (MaxFramesBetweenEdges * (uint32_t)period)/1000)
+	{
+		++stats.unsyncedFlushes;
+		return now;
+	}
+
+	const int32_t lineTime = period/totalLines;
+	const int32_t margin = MarginLines * lineTime;
+	const int32_t rowTime = writeNanoseconds/(lastRow - firstRow + 1);
+	const int32_t writeTime = rowTime * (lastRow - firstRow + 1);
+	// If edges have been missed since the last one, measure from where the last one should have been
+	const int32_t framesSinceEdge = ((now - edgeTime) * 1000)/period;
+	const int32_t edgeOffset = framesSinceEdge * period;
+	const int32_t timeNow = (now - edgeTime) * 1000 - edgeOffset;
+
+	int32_t best = (IsClean(timeNow, timeNow + writeTime, rowTime, firstRow, lastRow, period, lineTime, margin)) ? timeNow : -1;
+	for (unsigned int pass = 0; pass < PassesToTry && best != timeNow; ++pass)
+	{
+		// Start just after this pass has gone by every row before the write reaches it
+		const int32_t scanFirst = pass * period + firstRow * lineTime;
+		const int32_t scanLast = pass * period + lastRow * lineTime;
+		const int32_t passed = scanLast - (lastRow - firstRow) * rowTime;
+		const int32_t t0 = ((passed > scanFirst) ? passed : scanFirst) + margin + 1;
+		if (t0 > timeNow && t0 <= timeNow + period && (best < 0 || t0 < best) && IsClean(t0, t0 + writeTime, rowTime, firstRow, lastRow, period, lineTime, margin))
+		{
+			best = t0;
+		}
+	}
+
+	if (best < 0)
+	{
+		++stats.unsafeFlushes;
+		return now;
+	}
+	if (best == timeNow)
+	{
+		return now;
+	}
+	++stats.pacedFlushes;
+	stats.paceWaitTime += (best - timeNow)/1000;
+	return edgeTime + (edgeOffset + best + 999)/1000;
+}
+
+// Record how long a frame took from the start of rendering to the last flush completing, and adjust the refresh period to suit.
+// The period goes up as soon as a frame doesn't fit, and down one panel frame at a time when the frames have fitted in less for a while.
+void FrameScheduler::FrameCompleted(uint32_t startTime, uint32_t endTime) noexcept
+{
+	const uint32_t framePeriod = GetEdgeTiming().framePeriod;
+	const uint32_t duration = endTime - startTime;
+	const uint32_t refreshPeriod = (framesPerRefresh * framePeriod)/1000;			// microseconds
+	++stats.frames;
+	if (duration > refreshPeriod)
+	{
+		++stats.lateFrames;
+		stats.droppedFrames += (duration - 1)/refreshPeriod;
+	}
+
+	const uint32_t frameMicroseconds = framePeriod/1000;
+	uint32_t framesNeeded = (duration + frameMicroseconds - 1)/frameMicroseconds;
+	if (framesNeeded == 0)
+	{
+		framesNeeded = 1;
+	}
+	else if (framesNeeded > MaxFramesPerRefresh)
+	{
+		framesNeeded = MaxFramesPerRefresh;
+	}
+	if (framesNeeded > framesPerRefresh)
+	{
+		framesPerRefresh = framesNeeded;
+		framesFitting = 0;
+	}
+	else if (framesNeeded < framesPerRefresh && ++framesFitting >= FramesBeforeSpeedUp)
+	{
+		--framesPerRefresh;
+		framesFitting = 0;
+	}
+	else if (framesNeeded == framesPerRefresh)
+	{
+		framesFitting = 0;
+	}
+	stats.refreshPeriod = (framesPerRefresh * framePeriod + 500000)/1000000;
+}
+
+// Return the LVGL refresh period in milliseconds
+uint32_t FrameScheduler::GetRefreshPeriod() noexcept
+{
+	return stats.refreshPeriod;
+}
+
+const Stats& FrameScheduler::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
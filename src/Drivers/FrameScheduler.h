@@ -0,0 +1,51 @@
+/*
+ * FrameScheduler.h
+ *
+ *  Created on: 23 Feb 2023
+ *      Author: David
+ *
+ *  Paces flushes to the panel scan so that the scan never shows an area part way through being written, and sets the LVGL refresh period
+ *  to a whole number of panel frames that the rendering and the bus can keep up with.
+ *  The SSD1963 tearing effect output is high during the vertical non-display period, so its falling edge is when the panel starts to scan row 0.
+ *  From that and the line time we know where the scan is, and a flush is started either just behind it or early enough to finish before the scan
+ *  reaches it. If no tearing effect edges arrive (for example the pin isn't connected) flushes are started at once, as before.
+ *  The scheduler doesn't touch the hardware and takes the time as a parameter, so the scanline simulation can check it on a host.
+ */
+
+#ifndef SRC_DRIVERS_FRAMESCHEDULER_H_
+#define SRC_DRIVERS_FRAMESCHEDULER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace FrameScheduler
+{
+	constexpr uint32_t MarginLines = 2;					// how close to the scan we let a write get, to allow for interrupt latency and uneven write speed
+	constexpr uint32_t MaxFramesPerRefresh = 6;			// the longest refresh period, in panel frames
+	constexpr uint32_t FramesBeforeSpeedUp = 16;		// consecutive frames that must fit in a shorter refresh period before we use it
+
+	struct Stats
+	{
+		uint32_t tearEdges;								// tearing effect falling edges seen
+		uint32_t framePeriod;							// measured panel frame period in nanoseconds
+		uint32_t missedEdges;							// edges that didn't arrive, judging by the intervals between the ones that did
+		uint32_t resyncs;								// times the frame period was measured again because the edges stopped matching it
+		uint32_t pacedFlushes;							// flushes that were held back to avoid the scan
+		uint32_t paceWaitTime;							// total microseconds that flushes were held back
+		uint32_t unsyncedFlushes;						// flushes started at once because there were no recent tearing effect edges
+		uint32_t unsafeFlushes;							// flushes started at once because no start time within a frame would avoid the scan
+		uint32_t frames;								// LVGL refreshes that drew something
+		uint32_t lateFrames;							// frames that took longer than the refresh period to render and send
+		uint32_t droppedFrames;							// refresh periods missed because the frame before was late
+		uint32_t refreshPeriod;							// the LVGL refresh period in milliseconds
+	};
+
+	void Init(uint32_t lineNanoseconds, uint16_t totalLines) noexcept;
+	void TearEdge(uint32_t now) noexcept;
+	uint32_t GetStartTime(uint32_t now, uint16_t firstRow, uint16_t lastRow, uint32_t writeNanoseconds) noexcept;
+	void FrameCompleted(uint32_t startTime, uint32_t endTime) noexcept;
+	uint32_t GetRefreshPeriod() noexcept;
+	const Stats& GetStats() noexcept;
+}
+
+#endif /* SRC_DRIVERS_FRAMESCHEDULER_H_ */
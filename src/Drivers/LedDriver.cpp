@@ -7,18 +7,27 @@
 
 #include "LedDriver.h"
 #include <Pins.h>
+#include <MemoryArena.h>
 #include <WS2812.h>
+#include <new>
 
 static WS2812 *driver = nullptr;
 
 void LedDriver::Init() noexcept
 {
-	driver = new WS2812(WS2812Pin, false, DmacChanWS2812);
+	void *const mem = MemoryArena::AllocateStartup(sizeof(WS2812), alignof(WS2812));
+	if (mem != nullptr)
+	{
+		driver = new (mem) WS2812(WS2812Pin, false, DmacChanWS2812);
+	}
 }
 
 void LedDriver::SetColour(uint8_t red, uint8_t green, uint8_t blue) noexcept
 {
-	driver->SetColour(((uint32_t)red << 24) | ((uint32_t)green << 16) | ((uint32_t)blue << 8), NumLeds);
+	if (driver != nullptr)
+	{
+		driver->SetColour(((uint32_t)red << 24) | ((uint32_t)green << 16) | ((uint32_t)blue << 8), NumLeds);
+	}
 }
 
 // End
@@ -0,0 +1,219 @@
+/*
+ * PioBus.cpp
+ *
+ *  Created on: 10 Jan 2023
+ *      Author: David
+ *
+ *  The SSD1963 is connected via an 8-bit data bus. To send a 16-bit pixel we put the low byte on the bus, latch it into the 74AHC573,
+ *  then put the high byte on the bus and pulse ~WR. This file implements that sequence in a PIO state machine fed by DMA,
+ *  so that the CPU is free while a block of pixels is being sent.
+ */
+
+#include "PioBus.h"
+#include "PioPrograms.h"
+#include <Core.h>
+#include <Pins.h>
+#include <hardware/gpio.h>
+#include <hardware/pio.h>
+#include <hardware/dma.h>
+#include <hardware/irq.h>
+#include <hardware/timer.h>
+
+using namespace PioBus;
+using namespace PioPrograms;
+
+// Model of the bus waveform generated by the programs, checked against the timing requirements listed in SSD1963.cpp. All times are in picoseconds.
+// This catches a change to the PIO clock or the instruction delays at compile time; the bus timing check in the simulator steps the instruction words themselves.
+namespace BusTiming
+{
+	using namespace Requirements;
+
+	constexpr uint64_t PioClockPeriod = (1000000000000ull * PioClockDivider)/SystemCoreClockFreq;
+
+	// The latch goes high at the same time as the low byte is output, and goes low at the end of the first output instruction
+	constexpr uint64_t LatchHighTime = LatchOpenClocks * PioClockPeriod;
+
+	// The low byte is removed from the data pins at the end of the instruction after that
+	constexpr uint64_t LowByteHoldAfterLatch = LatchHoldClocks * PioClockPeriod;
+
+	// The high byte is output at the same time as ~WR goes low, so its setup time to the rising edge of ~WR is the ~WR low time
+	constexpr uint64_t HighByteSetupToWrite = WriteLowClocks * PioClockPeriod;
+
+	// The low byte appears at the latch outputs one propagation delay after the latch goes high
+	constexpr uint64_t LowByteSetupToWrite = (LatchOpenClocks + LatchHoldClocks + WriteLowClocks) * PioClockPeriod - LatchPropagationDelay;
+
+	// The data pins don't change until the next pixel is output, and the latch doesn't reopen until then either
+	constexpr uint64_t DataHoldAfterWrite = WriteHighClocks * PioClockPeriod;
+
+	static_assert(LatchHighTime >= LatchPulseWidth, "latch pulse too short");
+	static_assert(LatchHighTime >= LatchSetupTime, "data setup time to latch too short");
+	static_assert(LowByteHoldAfterLatch >= LatchHoldTime, "data hold time from latch too short");
+	static_assert(HighByteSetupToWrite >= WriteLowTime, "~WR low time too short");
+	static_assert(HighByteSetupToWrite >= WriteSetupTime, "high byte setup time to ~WR too short");
+	static_assert(LowByteSetupToWrite >= WriteSetupTime, "low byte setup time to ~WR too short");
+	static_assert(DataHoldAfterWrite >= WriteHoldTime, "data hold time from ~WR too short");
+
+	// When repeating a pixel the data and latch outputs don't change, so only the ~WR low time matters
+	static_assert(RepeatLowClocks * PioClockPeriod >= WriteLowTime, "~WR low time too short when repeating");
+}
+
+static const pio_program pixelProgram =
+{
+	.instructions = PixelProgram,
+	.length = PixelProgramLength,
+	.origin = -1,
+};
+
+static const pio_program runProgram =
+{
+	.instructions = RunProgram,
+	.length = RunProgramLength,
+	.origin = -1,
+};
+
+enum class BusMode : uint8_t { none, pixels, runs };
+
+static PIO const pio = (DisplayPioNumber == 0) ? pio0 : pio1;
+constexpr gpio_function PioPinFunction = (DisplayPioNumber == 0) ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1;
+constexpr unsigned int PioIrq = (DisplayPioNumber == 0) ? PIO0_IRQ_0 : PIO1_IRQ_0;
+constexpr IRQn_Type PioIrqNumber = (DisplayPioNumber == 0) ? PIO0_IRQ_0_IRQn : PIO1_IRQ_0_IRQn;
+
+static unsigned int sm;
+static unsigned int pixelProgramOffset, runProgramOffset;
+static BusMode currentMode = BusMode::none;
+static dma_channel_config dmaConfig;
+static PioBus::CompletionCallback completionCallback = nullptr;
+static volatile bool busy = false;
+static PioBus::InterruptStats interruptStats;
+
+// Switch the data, latch, ~RD and ~WR pins between the SIO (used when sending commands) and the PIO
+static void SetPinFunctions(gpio_function func) noexcept
+{
+	for (unsigned int i = 0; i < 8; ++i)
+	{
+		gpio_set_function(DisplayLowestDataPin + i, func);
+	}
+	gpio_set_function(DisplayLatchLowDataPin, func);
+	gpio_set_function(DisplayReadPin, func);
+	gpio_set_function(DisplayWritePin, func);
+}
+
+// Called when the program raises its interrupt at the end of a transfer
+static void PioIrqHandler() noexcept
+{
+	if (pio_interrupt_get(pio, sm))
+	{
+		const uint32_t startTime = time_us_32();
+		pio_interrupt_clear(pio, sm);
+		SetPinFunctions(GPIO_FUNC_SIO);
+		busy = false;
+		completionCallback();
+		const uint32_t isrTime = time_us_32() - startTime;
+		++interruptStats.interrupts;
+		interruptStats.totalTime += isrTime;
+		if (isrTime > interruptStats.maxTime)
+		{
+			interruptStats.maxTime = isrTime;
+		}
+	}
+}
+
+// Configure the state machine and the DMA channel for the type of data we are about to send. Only called when the bus is idle.
+static void SetMode(BusMode mode) noexcept
+{
+	if (mode != currentMode)
+	{
+		pio_sm_set_enabled(pio, sm, false);
+
+		pio_sm_config c = pio_get_default_sm_config();
+		sm_config_set_out_pins(&c, DisplayLowestDataPin, 8);
+		sm_config_set_sideset_pins(&c, DisplayLatchLowDataPin);
+		sm_config_set_sideset(&c, SideSetBits, false, false);
+		sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+		sm_config_set_clkdiv_int_frac(&c, PioClockDivider, 0);
+
+		unsigned int offset;
+		if (mode == BusMode::pixels)
+		{
+			offset = pixelProgramOffset;
+			sm_config_set_wrap(&c, offset, offset + PixelProgramWrapTop);
+			sm_config_set_out_shift(&c, true, true, PixelPullThreshold);
+			channel_config_set_transfer_data_size(&dmaConfig, DMA_SIZE_16);		// the PIO discards the duplicated upper half of each word
+		}
+		else
+		{
+			offset = runProgramOffset;
+			sm_config_set_wrap(&c, offset, offset + RunProgramWrapTop);
+			sm_config_set_out_shift(&c, true, true, RunPullThreshold);
+			channel_config_set_transfer_data_size(&dmaConfig, DMA_SIZE_32);
+		}
+
+		pio_sm_init(pio, sm, offset, &c);
+		pio_sm_set_enabled(pio, sm, true);
+		dma_channel_set_config(DmacChanDisplay, &dmaConfig, false);
+		currentMode = mode;
+	}
+}
+
+void PioBus::Init(CompletionCallback cb) noexcept
+{
+	completionCallback = cb;
+
+	// Set up the state machine
+	sm = pio_claim_unused_sm(pio, true);
+	pixelProgramOffset = pio_add_program(pio, &pixelProgram);
+	runProgramOffset = pio_add_program(pio, &runProgram);
+	pio_sm_set_consecutive_pindirs(pio, sm, DisplayLowestDataPin, 8, true);
+	pio_sm_set_consecutive_pindirs(pio, sm, DisplayLatchLowDataPin, SideSetBits, true);
+
+	// Set up the DMA channel
+	dma_channel_claim(DmacChanDisplay);
+	dmaConfig = dma_channel_get_default_config(DmacChanDisplay);
+	channel_config_set_read_increment(&dmaConfig, true);
+	channel_config_set_write_increment(&dmaConfig, false);
+	channel_config_set_dreq(&dmaConfig, pio_get_dreq(pio, sm, true));
+	channel_config_set_high_priority(&dmaConfig, DmacPrioDisplay != 0);
+	dma_channel_set_write_addr(DmacChanDisplay, &pio->txf[sm], false);
+	SetMode(BusMode::pixels);
+
+	// The end of each transfer is signalled by the state machine, not the DMA, which finishes while the FIFO still holds data
+	pio_set_irq0_source_enabled(pio, (pio_interrupt_source)(pis_interrupt0 + sm), true);
+	irq_add_shared_handler(PioIrq, PioIrqHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+	NVIC_SetPriority(PioIrqNumber, NvicPriorityDisplayPio);
+	irq_set_enabled(PioIrq, true);
+}
+
+// Start sending pixel data. The caller must already have selected the chip, set up the window, sent the 0x2C command and set Data/~CMD high.
+// The completion callback is called from the PIO interrupt when the last pixel has been written. There must be at least one pixel.
+void PioBus::StartTransfer(const uint16_t *data, size_t numPixels) noexcept
+{
+	busy = true;
+	SetMode(BusMode::pixels);
+	SetPinFunctions(PioPinFunction);
+	pio_sm_put(pio, sm, numPixels - 1);				// the state machine is waiting for this, so the FIFO is empty
+	dma_channel_transfer_from_buffer_now(DmacChanDisplay, data, numPixels);
+}
+
+// Start sending run-length encoded pixel data, built using MakeRun. The buffer must remain valid until the completion callback has been called.
+// There must be at least one run.
+void PioBus::StartRunTransfer(const uint32_t *runs, size_t numRuns) noexcept
+{
+	busy = true;
+	SetMode(BusMode::runs);
+	SetPinFunctions(PioPinFunction);
+	pio_sm_put(pio, sm, numRuns - 1);
+	dma_channel_transfer_from_buffer_now(DmacChanDisplay, runs, numRuns);
+}
+
+bool PioBus::IsBusy() noexcept
+{
+	return busy;
+}
+
+// Get the interrupt statistics. Call only from core 0, which handles the interrupt.
+void PioBus::GetInterruptStats(InterruptStats& stats) noexcept
+{
+	stats = interruptStats;
+}
+
+// End
@@ -0,0 +1,57 @@
+/*
+ * PioBus.h
+ *
+ *  Created on: 10 Jan 2023
+ *      Author: David
+ *
+ *  PIO state machine and DMA channel that drive the 16-bit pixel data path to the SSD1963 through the 74AHC573 latch.
+ *  Commands and parameters are still sent by the CPU; the PIO engine is used only for blocks of pixel data.
+ */
+
+#ifndef SRC_DRIVERS_PIOBUS_H_
+#define SRC_DRIVERS_PIOBUS_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace PioBus
+{
+	// Number of PIO clocks taken by each instruction of the programs (1 + delay)
+	constexpr uint32_t LatchOpenClocks = 3;			// low byte on the data pins, latch transparent
+	constexpr uint32_t LatchHoldClocks = 1;			// latch closed, low byte still on the data pins
+	constexpr uint32_t WriteLowClocks = 2;			// high byte on the data pins, ~WR low
+	constexpr uint32_t WriteHighClocks = 1;			// ~WR high, the SSD1963 samples both bytes on this edge
+	constexpr uint32_t RepeatLowClocks = 2;			// ~WR low when repeating the previous pixel
+	constexpr uint32_t RepeatHighClocks = 2;		// ~WR high when repeating the previous pixel
+
+	// Cost of sending pixel data in PIO clocks, used to decide whether run-length encoding is worthwhile
+	constexpr uint32_t ClocksPerPixel = LatchOpenClocks + LatchHoldClocks + WriteLowClocks + WriteHighClocks;
+	constexpr uint32_t ClocksPerRun = ClocksPerPixel + 2;				// for each run, plus ClocksPerRepeat for each repeat
+	constexpr uint32_t ClocksPerRepeat = RepeatLowClocks + RepeatHighClocks;
+
+	// A run is a 32-bit word holding the pixel value in the low half and the number of repeats in the high half
+	constexpr uint32_t MaxRunLength = 65536;
+
+	inline constexpr uint32_t MakeRun(uint16_t pixel, uint32_t length) noexcept
+	{
+		return ((length - 1) << 16) | pixel;
+	}
+
+	typedef void (*CompletionCallback)() noexcept;
+
+	// Time spent handling the interrupt at the end of each transfer, including the completion callback, in microseconds
+	struct InterruptStats
+	{
+		uint32_t interrupts;
+		uint32_t totalTime;
+		uint32_t maxTime;
+	};
+
+	void Init(CompletionCallback cb) noexcept;
+	void StartTransfer(const uint16_t *data, size_t numPixels) noexcept;
+	void StartRunTransfer(const uint32_t *runs, size_t numRuns) noexcept;
+	bool IsBusy() noexcept;
+	void GetInterruptStats(InterruptStats& stats) noexcept;
+}
+
+#endif /* SRC_DRIVERS_PIOBUS_H_ */
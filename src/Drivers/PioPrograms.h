@@ -0,0 +1,112 @@
+/*
+ * PioPrograms.h
+ *
+ *  Created on: 20 Mar 2023
+ *      Author: David
+ *
+ *  The PIO programs that send pixel data to the SSD1963 through the 74AHC573 latch, and the bus timing they must meet. They are kept apart from
+ *  PioBus.cpp, which loads them into the PIO, so that the host simulator and the bus timing check can run the same instruction words.
+ */
+
+#ifndef SRC_DRIVERS_PIOPROGRAMS_H_
+#define SRC_DRIVERS_PIOPROGRAMS_H_
+
+#include "PioBus.h"
+#include <Pins.h>
+
+namespace PioPrograms
+{
+	// The latch, ~RD and ~WR pins are driven using side-set, so they must be consecutive
+	static_assert(DisplayReadPin == DisplayLatchLowDataPin + 1 && DisplayWritePin == DisplayLatchLowDataPin + 2);
+
+	// Side-set bit assignments
+	constexpr uint16_t SideLatch = 1u << 0;
+	constexpr uint16_t SideNotRead = 1u << 1;
+	constexpr uint16_t SideNotWrite = 1u << 2;
+	constexpr unsigned int SideSetBits = 3;
+
+	// PIO clock divider. The timing is checked against this at compile time in PioBus.cpp, and by stepping the programs in the bus timing check.
+	constexpr uint32_t PioClockDivider = 1;
+
+	// Output shift register settings. Both programs shift right. The pixel program is fed 16-bit DMA transfers, which the bus duplicates
+	// into both halves of the FIFO word, so it pulls a new word after 16 bits; the run program uses all 32 bits of each word.
+	constexpr unsigned int PixelPullThreshold = 16;
+	constexpr unsigned int RunPullThreshold = 32;
+
+	// PIO instruction encoding
+	constexpr uint16_t PioOutPins8 = 0x6008;			// out pins, 8
+	constexpr uint16_t PioOutX16 = 0x6030;				// out x, 16
+	constexpr uint16_t PioOutY32 = 0x6040;				// out y, 32
+	constexpr uint16_t PioNop = 0xA042;					// mov y, y
+	constexpr uint16_t PioJmp = 0x0000;					// jmp <address>
+	constexpr uint16_t PioJmpXDec = 0x0040;				// jmp x--, <address>
+	constexpr uint16_t PioJmpYDec = 0x0080;				// jmp y--, <address>
+	constexpr uint16_t PioIrqSetRel0 = 0xC010;			// irq set 0 rel, which sets the flag numbered the same as the state machine
+
+	constexpr uint16_t PioInstr(uint16_t instr, uint16_t sideSet, uint32_t clocks) noexcept
+	{
+		return instr | (sideSet << (13 - SideSetBits)) | ((clocks - 1) << 8);
+	}
+
+	static_assert(PioBus::LatchOpenClocks <= 4 && PioBus::LatchHoldClocks <= 4 && PioBus::WriteLowClocks <= 4 && PioBus::WriteHighClocks <= 4 && PioBus::RepeatLowClocks <= 4 && PioBus::RepeatHighClocks <= 4,
+					"only 2 delay bits available");
+
+	// Both programs start each transfer by reading the number of items in it less one into Y, which StartTransfer and StartRunTransfer write to the FIFO
+	// ahead of the DMA. When the last item has been sent they raise a PIO interrupt, and then wait in instruction 0 for the next transfer with the latch closed and ~WR high.
+	// So the completion interrupt comes when the bus has finished, however much data the DMA left in the FIFO.
+
+	// Program to send one pixel for each 16 bits of data. The low byte comes out first.
+	inline constexpr uint16_t PixelProgram[] =
+	{
+		PioInstr(PioOutY32,			SideNotRead | SideNotWrite,				1),
+		PioInstr(PioOutPins8,		SideLatch | SideNotRead | SideNotWrite,	PioBus::LatchOpenClocks),
+		PioInstr(PioNop,			SideNotRead | SideNotWrite,				PioBus::LatchHoldClocks),
+		PioInstr(PioOutPins8,		SideNotRead,							PioBus::WriteLowClocks),
+		PioInstr(PioJmpYDec | 1,	SideNotRead | SideNotWrite,				PioBus::WriteHighClocks),	// if there are more pixels then decrement the count and send the next
+		PioInstr(PioIrqSetRel0,		SideNotRead | SideNotWrite,				1),
+	};
+
+	constexpr unsigned int PixelProgramLength = sizeof(PixelProgram)/sizeof(PixelProgram[0]);
+	constexpr unsigned int PixelProgramWrapTop = PixelProgramLength - 1;
+
+	// Program to send runs of identical pixels. Each 32-bit word holds the pixel value in the low half and the number of repeats in the high half.
+	// The pixel is sent once in full, then the repeats are just ~WR pulses. The wrap is after the interrupt at instruction 7, which the repeat loop reaches
+	// through instruction 11. Jump addresses are relocated by pio_add_program.
+	inline constexpr uint16_t RunProgram[] =
+	{
+		PioInstr(PioOutY32,			SideNotRead | SideNotWrite,				1),
+		PioInstr(PioOutPins8,		SideLatch | SideNotRead | SideNotWrite,	PioBus::LatchOpenClocks),
+		PioInstr(PioNop,			SideNotRead | SideNotWrite,				PioBus::LatchHoldClocks),
+		PioInstr(PioOutPins8,		SideNotRead,							PioBus::WriteLowClocks),
+		PioInstr(PioOutX16,			SideNotRead | SideNotWrite,				PioBus::WriteHighClocks),
+		PioInstr(PioJmpXDec | 8,	SideNotRead | SideNotWrite,				1),					// if there are repeats then decrement the count and go to the loop
+		PioInstr(PioJmpYDec | 1,	SideNotRead | SideNotWrite,				1),					// if there are more runs then decrement the count and send the next
+		PioInstr(PioIrqSetRel0,		SideNotRead | SideNotWrite,				1),
+		PioInstr(PioNop,			SideNotRead,							PioBus::RepeatLowClocks),
+		PioInstr(PioJmpXDec | 8,	SideNotRead | SideNotWrite,				PioBus::RepeatHighClocks),
+		PioInstr(PioJmpYDec | 1,	SideNotRead | SideNotWrite,				1),
+		PioInstr(PioJmp | 7,		SideNotRead | SideNotWrite,				1),
+	};
+
+	constexpr unsigned int RunProgramLength = sizeof(RunProgram)/sizeof(RunProgram[0]);
+	constexpr unsigned int RunProgramWrapTop = 7;
+
+	static_assert(PioBus::ClocksPerRun == PioBus::LatchOpenClocks + PioBus::LatchHoldClocks + PioBus::WriteLowClocks + PioBus::WriteHighClocks + 2);
+
+	// Timing requirements listed in SSD1963.cpp, in picoseconds
+	namespace Requirements
+	{
+		// 74AHC573
+		constexpr uint64_t LatchPulseWidth = 15000;
+		constexpr uint64_t LatchSetupTime = 3500;
+		constexpr uint64_t LatchHoldTime = 1500;
+		constexpr uint64_t LatchPropagationDelay = 15000;
+
+		// SSD1963
+		constexpr uint64_t WriteLowTime = 12000;
+		constexpr uint64_t WriteSetupTime = 4000;
+		constexpr uint64_t WriteHoldTime = 1000;
+	}
+}
+
+#endif /* SRC_DRIVERS_PIOPROGRAMS_H_ */
@@ -6,12 +6,45 @@
  */
 
 #include "SSD1963.h"
+#include "PioBus.h"
+#include "FrameScheduler.h"
 #include <Pins.h>
 #include <CoreIO.h>
+#include <Interrupts.h>
+#include <SpscQueue.h>
+#include <Mailbox.h>
+#include <TimeCritical.h>
 #include <hardware/gpio.h>
+#include <hardware/timer.h>
+#include <hardware/irq.h>
+#include <hardware/sync.h>
+#include <pico/multicore.h>
+#include <cstring>
+#include <atomic>
+
+// If this is nonzero then the flush work (setting up the window, encoding the pixel data and starting the transfer) is done by core 1
+#ifndef DISPLAY_FLUSH_ON_CORE1
+# define DISPLAY_FLUSH_ON_CORE1		1
+#endif
 
 constexpr bool Is24bit = true;
 
+// PLL and pixel clock settings sent by InitPanel. The PLL runs at the crystal frequency * (M + 1)/(N + 1) (command 0xE2), of which only the
+// bottom 4 bits of N are used, and the pixel clock is the PLL clock * (LCDC_FPR + 1)/2^20 (command 0xE6).
+constexpr uint32_t CrystalFreq = 10000000;
+constexpr uint8_t PllMultiplier = 0x1D;			// M
+constexpr uint8_t PllDivider = 0x22;			// N
+constexpr uint32_t PixelClockFraction = 0x03FFFF;	// LCDC_FPR
+constexpr uint32_t PllClockFreq = (CrystalFreq * (PllMultiplier + 1))/((PllDivider & 0x0F) + 1);
+constexpr uint32_t PixelClockFreq = (uint32_t)(((uint64_t)PllClockFreq * (PixelClockFraction + 1)) >> 20);
+static_assert(CrystalFreq * (PllMultiplier + 1) >= 250000000 && CrystalFreq * (PllMultiplier + 1) <= 800000000, "PLL VCO frequency out of range");
+static_assert(PllClockFreq <= 110000000, "PLL clock too fast");
+
+// Panel scan timing as set by InitPanel: a line is HT + 1 pixel clocks (command 0xB4) and a frame is VT + 1 lines (command 0xB6)
+constexpr uint32_t PixelClocksPerLine = 0x03A0 + 1;
+constexpr uint16_t LinesPerFrame = 0x020D + 1;
+constexpr uint32_t LineNanoseconds = (uint32_t)(((uint64_t)PixelClocksPerLine * 1000000000)/PixelClockFreq);
+
 // SSD1963 timing requirements:
 //  CS falling to WR falling >= 2ns
 //  CS minimum low time  >= 1.5 PLL clock periods (max PLL clock 110MHz)
@@ -103,66 +136,393 @@ inline void LCD_Write_COM_DATA8(uint8_t com1, uint8_t dat1)
 	LCD_Write_DATA8(dat1);
 }
 
+// Buffer for run-length encoded pixel data. Only one flush is in progress at a time, so one buffer is enough.
+constexpr size_t RunBufferSize = 2048;
+static uint32_t runBuffer[RunBufferSize];
+
+// State shared between the cores. The flush statistics are written only by whichever core or interrupt is carrying out the current flush,
+// and LVGL only starts a flush when the previous one has completed, so they have one writer at a time. Core 0 reads the copy published
+// when each flush completes. The statistics that core 0 counts itself are kept separately.
+static SSD1963::FlushStats flushStats;
+static Mailbox<SSD1963::FlushStats> publishedStats;
+static uint32_t areasJoined = 0;							// counted by core 0
+static uint32_t scrolls = 0;								// counted by core 0
+static uint32_t flushQueueFullWaits = 0;					// counted by core 0
+static lv_disp_drv_t *flushingDriver = nullptr;
+static uint32_t flushStartTime;
+static std::atomic<uint32_t> flushesRequested(0);			// incremented by core 0 when LVGL asks for a flush
+static std::atomic<uint32_t> flushesCompleted(0);			// incremented by whichever core or interrupt finishes it
+static std::atomic<bool> panelReady(false);					// set when the initialisation sequence has been sent
+static std::atomic<bool> filling(false);					// true while the PIO is clearing the display memory for InitPanel
+static uint32_t readyTime = 0;								// written before panelReady is set
+static uint32_t clearedTime = 0;							// written before filling is cleared
+static std::atomic<uint32_t> lastFlushTime(0);				// value of time_us_32() when the last flush completed
+static uint8_t initialBacklight;
+static SSD1963::WakeFunction wakeFunction = nullptr;
+static SSD1963::BlockFunction blockFunction = nullptr;
+static SSD1963::SleepFunction sleepFunction = nullptr;
+static std::atomic<bool> waitingForFlush(false);			// the task that runs LVGL is blocked until a flush or fill completes
+
+#if DISPLAY_FLUSH_ON_CORE1
+
+// Core 1 stack, in the SCRATCH_X bank so that it doesn't compete with core 0 for the main RAM banks
+constexpr size_t Core1StackWords = 256;
+static uint32_t core1Stack[Core1StackWords] __attribute__((section(".stack1.core1")));
+
+static bool core1Started = false;
+
+[[noreturn]] static void Core1FlushTask() noexcept;
+static void Core0FifoInterrupt() noexcept;
+static void CheckForPauseRequest() noexcept;
+static void RequestNextSegment() noexcept;
+
+#endif
+
+// Cost of sending an area to the display, in system clocks (the PIO runs at the system clock).
+// Each area costs a window setup (0x2A and 0x2B with 4 parameters each, then 0x2C) sent by the CPU, plus the fixed cost of starting the transfer,
+// handling the completion interrupt and LVGL preparing the area. Both are measured on the display: InitPanel times a burst of NOP commands to get the
+// cost of a bus byte, and each flush updates a running average of the time it took that isn't accounted for by the bus or by waiting for the panel scan.
+// The profiler reports both. Until they have been measured, the costs counted from the code are used: the simulator counts 5 GPIO writes for each byte
+// in LCD_Write_Bus8, which with the GPIO read in gpio_put_masked, its arithmetic, the 6 NOPs and the call to PulseWritePin is about 20 clocks a byte on the M0+.
+constexpr uint32_t DefaultClocksPerBusByte = 20;
+constexpr uint32_t MinClocksPerBusByte = 10, MaxClocksPerBusByte = 80;		// a measurement outside this range is wrong, for example because the host is too fast
+constexpr uint32_t BusCalibrationBytes = 256;
+constexpr uint32_t WindowSetupBytes = 11;
+constexpr uint32_t DefaultClocksPerFlushOverhead = 800;
+constexpr uint32_t MaxClocksPerFlushOverhead = 10000;		// longer measurements are taken to be interruptions
+constexpr uint32_t FlushOverheadAveraging = 16;				// weight of the running average, in flushes
+
+static std::atomic<uint32_t> clocksPerBusByte(DefaultClocksPerBusByte);				// written by InitPanel
+static std::atomic<uint32_t> clocksPerFlushOverhead(DefaultClocksPerFlushOverhead);	// written by whichever core or interrupt finishes a flush
+static uint32_t flushPaceWaitTime;							// microseconds the current flush has spent waiting for the panel scan
+static uint32_t flushBusClocksAtStart;						// flushStats.busClocks when the current flush started
+
+inline uint32_t WindowSetupClocks() noexcept
+{
+	return WindowSetupBytes * clocksPerBusByte.load(std::memory_order_relaxed);
+}
+
+// Wake the task that runs LVGL if it is waiting for a flush or fill. Call only from an interrupt on core 0.
+static void WakeWaitingTask() noexcept
+{
+	if (waitingForFlush && wakeFunction != nullptr)
+	{
+		wakeFunction();
+	}
+}
+
+// Record the completion of a flush. The caller must then tell LVGL, which it may do only on core 0.
+static void FlushDone() noexcept
+{
+	const uint32_t now = time_us_32();
+	flushStats.busyTime += now - flushStartTime;
+
+	// Update the running average of the flush overhead
+	const uint32_t unpacedClocks = (now - flushStartTime - flushPaceWaitTime) * (SystemCoreClockFreq/1000000);
+	const uint32_t busClocks = flushStats.busClocks - flushBusClocksAtStart;
+	const uint32_t overhead = min<uint32_t>((unpacedClocks > busClocks) ? unpacedClocks - busClocks : 0, MaxClocksPerFlushOverhead);
+	const uint32_t average = clocksPerFlushOverhead.load(std::memory_order_relaxed);
+	clocksPerFlushOverhead.store(average + (uint32_t)((int32_t)(overhead - average)/(int32_t)FlushOverheadAveraging), std::memory_order_relaxed);
+
+	publishedStats.Publish(flushStats);
+	lastFlushTime.store(now, std::memory_order_relaxed);
+	flushesCompleted.store(flushesCompleted.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Wait until 'done' returns true, blocking the calling task if we have been given a block function. Call only from the task that runs LVGL.
+template<class F> static void WaitUntil(F done) noexcept
+{
+	if (blockFunction == nullptr)
+	{
+		while (!done()) { }
+		return;
+	}
+	waitingForFlush = true;
+	while (!done())
+	{
+		blockFunction();
+	}
+	waitingForFlush = false;
+}
+
+// Wait until the panel has been initialised and cleared and all the flushes that LVGL has requested have been sent, so that we can send other commands.
+// Call only from the task that runs LVGL.
+static void WaitForFlushes() noexcept
+{
+	WaitUntil([]() noexcept { return panelReady && !filling && flushesCompleted == flushesRequested; });
+}
+
+// Column and page addresses last written to the SSD1963. The controller keeps them until they are changed or it is reset, so we only need to send the ones that differ.
+static uint16_t windowXLow, windowXHigh, windowYLow, windowYHigh;
+static bool windowValid = false;
+
 inline void SetXY(uint16_t xLow, uint16_t xHigh, uint16_t yLow, uint16_t yHigh) noexcept
 {
-	LCD_Write_COM_DATA8(0x2A, xLow >> 8);
-	LCD_Write_Bus8(0x00FF & xLow);
-	LCD_Write_Bus8(xHigh >> 8);
-	LCD_Write_Bus8(0x00FF & xHigh);
+	++flushStats.setXYCalls;
+	if (windowValid && xLow == windowXLow && xHigh == windowXHigh)
+	{
+		++flushStats.windowWritesSkipped;
+	}
+	else
+	{
+		LCD_Write_COM_DATA8(0x2A, xLow >> 8);
+		LCD_Write_Bus8(0x00FF & xLow);
+		LCD_Write_Bus8(xHigh >> 8);
+		LCD_Write_Bus8(0x00FF & xHigh);
+		windowXLow = xLow;
+		windowXHigh = xHigh;
+	}
 
-	LCD_Write_COM_DATA8(0x002B, yLow >> 8);
-	LCD_Write_Bus8(0x00FF & yLow);
-	LCD_Write_Bus8(yHigh >> 8);
-	LCD_Write_Bus8(0x00FF & yHigh);
+	if (windowValid && yLow == windowYLow && yHigh == windowYHigh)
+	{
+		++flushStats.windowWritesSkipped;
+	}
+	else
+	{
+		LCD_Write_COM_DATA8(0x002B, yLow >> 8);
+		LCD_Write_Bus8(0x00FF & yLow);
+		LCD_Write_Bus8(yHigh >> 8);
+		LCD_Write_Bus8(0x00FF & yHigh);
+		windowYLow = yLow;
+		windowYHigh = yHigh;
+	}
+	windowValid = true;
 }
 
-void SSD1963::Init() noexcept
+// Hardware scrolling. Screen rows scrollTop to scrollTop + scrollHeight - 1 are the scroll area, in which the SSD1963 shows memory row
+// scrollTop + (row - scrollTop + scrollOffset) % scrollHeight in screen row 'row'. The rows outside it are shown unchanged.
+// LVGL draws in screen coordinates, so the flush maps the rows of each area to memory rows, splitting the area where they aren't contiguous.
+static uint16_t scrollTop = 0, scrollHeight = SSD1963_VER_RES, scrollOffset = 0;
+
+// A run of screen rows that are contiguous in the SSD1963 memory
+struct RowSegment
 {
-	// Set up the output pins
-	pinMode(DisplayNotResetPin, OUTPUT_HIGH);
-	pinMode(DisplayCsPin, OUTPUT_HIGH);
-	pinMode(DisplayDataNotCommandPin, OUTPUT_HIGH);
-	pinMode(DisplayReadPin, OUTPUT_HIGH);
-	pinMode(DisplayWritePin, OUTPUT_HIGH);
-	SetDriveStrength(DisplayWritePin, 2);
-	pinMode(DisplayLatchLowDataPin, OUTPUT_LOW);
-	SetDriveStrength(DisplayLatchLowDataPin, 2);
-	pinMode(DisplayBacklightPin, OUTPUT_LOW);
-	for (unsigned int i = 0; i < 8; ++i)
+	uint16_t firstRow;
+	uint16_t numRows;
+	uint16_t memoryRow;
+};
+
+// An area can be split into the fixed rows above the scroll area, two parts of the scroll area either side of the wrap, and the fixed rows below
+constexpr size_t MaxRowSegments = 4;
+
+// Map screen rows firstRow to lastRow to memory, returning the number of segments
+static size_t MapRows(uint16_t firstRow, uint16_t lastRow, RowSegment *segments) noexcept
+{
+	const uint16_t scrollEnd = scrollTop + scrollHeight;								// first row below the scroll area
+	const uint16_t wrapRow = (scrollOffset == 0) ? scrollEnd : scrollEnd - scrollOffset;	// first screen row showing memory row scrollTop
+	size_t numSegments = 0;
+	uint16_t row = firstRow;
+	while (row <= lastRow)
 	{
-		pinMode(DisplayLowestDataPin + i, OUTPUT_LOW);
+		uint16_t memoryRow, endRow;														// endRow is the last row of this segment
+		if (row < scrollTop)
+		{
+			memoryRow = row;
+			endRow = scrollTop - 1;
+		}
+		else if (row < wrapRow)
+		{
+			memoryRow = row + scrollOffset;
+			endRow = wrapRow - 1;
+		}
+		else if (row < scrollEnd)
+		{
+			memoryRow = row + scrollOffset - scrollHeight;
+			endRow = scrollEnd - 1;
+		}
+		else
+		{
+			memoryRow = row;
+			endRow = lastRow;
+		}
+		if (endRow > lastRow)
+		{
+			endRow = lastRow;
+		}
+
+		if (numSegments != 0 && segments[numSegments - 1].memoryRow + segments[numSegments - 1].numRows == memoryRow)
+		{
+			segments[numSegments - 1].numRows += endRow - row + 1;
+		}
+		else
+		{
+			segments[numSegments++] = RowSegment{ row, (uint16_t)(endRow - row + 1), memoryRow };
+		}
+		row = endRow + 1;
 	}
+	return numSegments;
+}
+
+// State of a flush that is being sent one segment at a time
+static RowSegment flushSegments[MaxRowSegments];
+static size_t numFlushSegments = 0, nextFlushSegment = 0;
+static const uint16_t *flushSegmentData;
+static uint16_t flushX1, flushX2, flushFirstRow;
+
+// Start sending the next segment of a split flush. The previous segment must have been completed. Call only on the core that does the flushes.
+static void StartNextSegment() noexcept
+{
+	const RowSegment& seg = flushSegments[nextFlushSegment++];
+	const size_t width = flushX2 - flushX1 + 1;
+	SetXY(flushX1, flushX2, seg.memoryRow, seg.memoryRow + seg.numRows - 1);
+	LCD_Write_COM(0x2c);
+	fastDigitalWriteHigh(DisplayDataNotCommandPin);
+	PioBus::StartTransfer(flushSegmentData + (seg.firstRow - flushFirstRow) * width, seg.numRows * width);
+}
+
+// Called from the PIO interrupt when the PIO has finished sending the pixel data. The interrupt is taken on core 0, so if core 1 does the flushes
+// then it is asked to send the next segment of a split flush, because it owns the bus and the window state.
+static void FlushComplete() noexcept
+{
+	if (nextFlushSegment < numFlushSegments)
+	{
+#if DISPLAY_FLUSH_ON_CORE1
+		RequestNextSegment();
+#else
+		StartNextSegment();
+#endif
+		return;
+	}
+	fastDigitalWriteHigh(DisplayCsPin);
+	if (filling)
+	{
+		clearedTime = time_us_32();
+		filling = false;						// this was the transfer started by StartFill, not a flush
+	}
+	else
+	{
+		FlushDone();
+		lv_disp_flush_ready(flushingDriver);
+	}
+	WakeWaitingTask();
+}
+
+// Hardware alarm that ends the wait for a scan slot. It is claimed by InitPanel so that its interrupt is taken on the core that does the flushes.
+static int scanAlarm = -1;
+constexpr uint32_t ScanSpinMicroseconds = 10;			// the last part of the wait is spun, to cover the time taken to wake from the alarm
+
+static void ScanAlarmCallback(unsigned int) noexcept
+{
+#if DISPLAY_FLUSH_ON_CORE1
+	__sev();									// core 1 may have checked the time just before the alarm, so make sure that its next WFE returns
+#else
+	WakeWaitingTask();
+#endif
+}
+
+static void InitScanAlarm() noexcept
+{
+	scanAlarm = hardware_alarm_claim_unused(true);
+	hardware_alarm_set_callback((unsigned int)scanAlarm, ScanAlarmCallback);
+}
+
+// Measure how long the CPU takes to write a byte to the display by timing a burst of NOP commands, with interrupts disabled so that they aren't counted
+static void CalibrateBus() noexcept
+{
+	const uint32_t flags = save_and_disable_interrupts();
+	const uint32_t start = time_us_32();
+	for (uint32_t i = 0; i < BusCalibrationBytes; ++i)
+	{
+		LCD_Write_COM(0x00);
+	}
+	const uint32_t elapsed = time_us_32() - start;
+	restore_interrupts(flags);
+	const uint32_t measured = (elapsed * (SystemCoreClockFreq/1000000) + BusCalibrationBytes/2)/BusCalibrationBytes;
+	if (measured >= MinClocksPerBusByte && measured <= MaxClocksPerBusByte)
+	{
+		clocksPerBusByte.store(measured, std::memory_order_relaxed);
+	}
+}
+
+// Wait during the panel initialisation. On core 0 we sleep if we have been given a function to do it, so that the other tasks can run;
+// the sleep is rounded up to whole milliseconds, which the panel doesn't mind. Otherwise we use the hardware timer, which works on core 1 and before the scheduler is running.
+static void WaitMicroseconds(uint32_t microseconds) noexcept
+{
+#if !DISPLAY_FLUSH_ON_CORE1
+	if (sleepFunction != nullptr)
+	{
+		sleepFunction((microseconds + 999)/1000);
+		return;
+	}
+#endif
+	const uint32_t start = time_us_32();
+	while (time_us_32() - start < microseconds) { }
+}
+
+// Runs for StartFill, enough for the whole display memory
+static uint32_t fillRuns[(SSD1963_HOR_RES * SSD1963_VER_RES + PioBus::MaxRunLength - 1)/PioBus::MaxRunLength];
+
+// Start the PIO filling a window of the display memory with one colour: the colour is sent once followed by a write strobe for each of the other pixels,
+// as a few runs of up to PioBus::MaxRunLength pixels. The CPU is free while it runs. The chip stays selected until FlushComplete clears 'filling'.
+static void StartFill(uint16_t xLow, uint16_t xHigh, uint16_t yLow, uint16_t yHigh, uint16_t colour) noexcept
+{
+	const size_t numPixels = (size_t)(xHigh - xLow + 1) * (yHigh - yLow + 1);
+	size_t numRuns = 0;
+	for (size_t done = 0; done < numPixels; done += PioBus::MaxRunLength)
+	{
+		fillRuns[numRuns++] = PioBus::MakeRun(colour, min<size_t>(numPixels - done, PioBus::MaxRunLength));
+	}
+	fastDigitalWriteLow(DisplayCsPin);
+	SetXY(xLow, xHigh, yLow, yHigh);
+	LCD_Write_COM(0x2C);
+	fastDigitalWriteHigh(DisplayDataNotCommandPin);
+	filling = true;
+	PioBus::StartRunTransfer(fillRuns, numRuns);
+}
+
+// Send the backlight PWM configuration with the given duty cycle. Chip select must be low.
+static void SendBacklightPwm(uint8_t level) noexcept
+{
+	LCD_Write_COM(0xBE);		// set PWM for B/L
+	LCD_Write_DATA8(0x06);		// PWM frequency = PLL clock / (256 * (6 + 1) /256
+	LCD_Write_Bus8(level);		// PWm duty cycle
+	LCD_Write_Bus8(0x01);		// PWM enabled and controlled by host
+	LCD_Write_Bus8(0xf0);		// Manual brightness value
+	LCD_Write_Bus8(0x00);		// Minimum brightness
+	LCD_Write_Bus8(0x00);		// Brightness prescaler for transition effects
+}
+
+// Reset and configure the controller, then start clearing its memory. When the flush worker runs on core 1 this is done there,
+// so the waits the controller needs overlap with LVGL building the screen on core 0. The waits after the PLL and software reset commands
+// are the datasheet minimums with a margin.
+static void InitPanel() noexcept
+{
+	InitScanAlarm();
 
 	// Hardware reset the display
-	delay(15);
+	WaitMicroseconds(15000);
 	fastDigitalWriteLow(DisplayNotResetPin);
-	delay(15);
+	WaitMicroseconds(15000);
 	fastDigitalWriteHigh(DisplayNotResetPin);
-	delay(15);
+	WaitMicroseconds(15000);
 
 	// Initialise the display
 	fastDigitalWriteLow(DisplayCsPin);
 
-	LCD_Write_COM(0xE2);		// PLL multiplier, set PLL clock to 100M (M=35 N=2 for 10MHz crystal)
-	LCD_Write_DATA8(0x1D);	    // N=0x36 for 6.5M, 0x23 for 10M crystal (ER 5": 0x23)
-	LCD_Write_DATA8(0x22);
+	LCD_Write_COM(0xE2);		// PLL multiplier, set PLL clock to 100M (M=29 N=2 for 10MHz crystal)
+	LCD_Write_DATA8(PllMultiplier);	// N=0x36 for 6.5M, 0x23 for 10M crystal (ER 5": 0x23)
+	LCD_Write_DATA8(PllDivider);
 	LCD_Write_DATA8(0x04);
 
 	LCD_Write_COM(0xE0);		// PLL enable
 	LCD_Write_DATA8(0x01);
-	delay(10);					// need 100us here according to datasheet
+	WaitMicroseconds(1000);		// need 100us here according to datasheet
 
 	LCD_Write_COM(0xE0);		// use PLL as system clock
 	LCD_Write_DATA8(0x03);
-	delay(10);
+	WaitMicroseconds(1000);
 
 	LCD_Write_COM(0x01);		// software reset
-	delay(100);
+	windowValid = false;
+	scrollTop = 0;
+	scrollHeight = SSD1963_VER_RES;
+	scrollOffset = 0;
+	WaitMicroseconds(10000);	// the datasheet says to wait 5ms before sending another command
 
 	LCD_Write_COM(0xE6);		//PLL setting for PCLK, depends on resolution
-	LCD_Write_DATA8(0x03);
-	LCD_Write_Bus8(0xFF);		// ER 5": 0x33
-	LCD_Write_Bus8(0xFF);		// ER 5": 0x33
+	LCD_Write_DATA8((PixelClockFraction >> 16) & 0xFF);
+	LCD_Write_Bus8((PixelClockFraction >> 8) & 0xFF);		// ER 5": 0x33
+	LCD_Write_Bus8(PixelClockFraction & 0xFF);				// ER 5": 0x33
 
 	LCD_Write_COM(0xB0);		//LCD SPECIFICATION
 	LCD_Write_DATA8((Is24bit) ? 0x20		// other 5" displays are 24-bit, data latched on falling edge I assume (setting 0x24 for rising edge works too)
@@ -203,40 +563,376 @@ void SSD1963::Init() noexcept
 	LCD_Write_COM(0xF0);		//pixel data interface
 	LCD_Write_DATA8(0x03);		//0x03: 16-bit (565 format), 0x02: 16-bit packed
 
-	delay(1);
+	LCD_Write_COM(0x29);		// display on
 
-	// Clear the display
-	SetXY(0, SSD1963_HOR_RES - 1, 0, SSD1963_VER_RES - 1);
-	LCD_Write_COM(0x2C);
-	LCD_Write_DATA16(0);		// write first pixel
-	for (unsigned int i = 0; i < SSD1963_HOR_RES * SSD1963_VER_RES - 1; ++i)
+	LCD_Write_COM(0x35);		// tearing effect output on
+	LCD_Write_DATA8(0x00);		// V-blank only, so it is high during the vertical non-display period
+
+	SendBacklightPwm(initialBacklight);
+
+	LCD_Write_COM(0xd0);		// Dynamic brightness configuration
+	LCD_Write_DATA8(0x0d);		// DNC enable, aggressive mode
+
+	CalibrateBus();
+	StartFill(0, SSD1963_HOR_RES - 1, 0, SSD1963_VER_RES - 1, 0);		// clear the display memory
+	readyTime = time_us_32();
+	panelReady = true;								// sequentially consistent, so readyTime is visible to core 0 once this is
+}
+
+// Tearing effect interrupt, on the falling edge when the panel starts to scan row 0
+static void TearInterrupt(CallbackParameter) noexcept
+{
+	FrameScheduler::TearEdge(time_us_32());
+}
+
+// Set up the pins and start initialising the panel. The backlight stays off until EnableBacklight is called, normally once the first frame has been sent.
+void SSD1963::Init(uint8_t backlight) noexcept
+{
+	// Set up the output pins
+	pinMode(DisplayNotResetPin, OUTPUT_HIGH);
+	pinMode(DisplayCsPin, OUTPUT_HIGH);
+	pinMode(DisplayDataNotCommandPin, OUTPUT_HIGH);
+	pinMode(DisplayReadPin, OUTPUT_HIGH);
+	pinMode(DisplayWritePin, OUTPUT_HIGH);
+	SetDriveStrength(DisplayWritePin, 2);
+	pinMode(DisplayLatchLowDataPin, OUTPUT_LOW);
+	SetDriveStrength(DisplayLatchLowDataPin, 2);
+	pinMode(DisplayBacklightPin, OUTPUT_LOW);
+	for (unsigned int i = 0; i < 8; ++i)
 	{
-		asm volatile("nop");
-		asm volatile("nop");
-		PulseWritePin();		// write remaining pixels
+		pinMode(DisplayLowestDataPin + i, OUTPUT_LOW);
 	}
+	initialBacklight = backlight;
+	publishedStats.Publish(flushStats);
 
-	LCD_Write_COM(0x29);		// display on
+	// The tearing effect output tells the frame scheduler when the panel starts each frame
+	FrameScheduler::Init(LineNanoseconds, LinesPerFrame);
+	pinMode(DisplayTearPin, INPUT_PULLDOWN);
+	attachInterrupt(DisplayTearPin, TearInterrupt, InterruptMode::falling, CallbackParameter(nullptr));
 
-	LCD_Write_COM(0xBE);		// set PWM for B/L
-	LCD_Write_DATA8(0x06);		// PWM frequency = PLL clock / (256 * (6 + 1) /256
-	LCD_Write_Bus8(0xf0);		// PWm duty cycle
-	LCD_Write_Bus8(0x01);		// PWM enabled and controlled by host
-	LCD_Write_Bus8(0xf0);		// Manual brightness value
-	LCD_Write_Bus8(0x00);		// Minimum brightness
-	LCD_Write_Bus8(0x00);		// Brightness prescaler for transition effects
+	PioBus::Init(FlushComplete);					// this must be done by core 0 so that the PIO interrupt is handled by core 0
+#if DISPLAY_FLUSH_ON_CORE1
+	multicore_launch_core1_with_stack(Core1FlushTask, core1Stack, sizeof(core1Stack));		// core 1 initialises the panel before it starts flushing
+	core1Started = true;
 
-	LCD_Write_COM(0xd0);		// Dynamic brightness configuration
-	LCD_Write_DATA8(0x0d);		// DNC enable, aggressive mode
+	// Core 1 tells us through our inter-core FIFO when it has finished the initialisation or some flushes. The launch uses the FIFO, so this must come after it.
+	irq_set_exclusive_handler(SIO_IRQ_PROC0, Core0FifoInterrupt);
+	NVIC_SetPriority(SIO_IRQ_PROC0_IRQn, NvicPriorityCore1Fifo);
+	irq_set_enabled(SIO_IRQ_PROC0, true);
+#else
+	InitPanel();
+#endif
+}
 
-	fastDigitalWriteHigh(DisplayCsPin);
+// Give the driver the functions it uses to block the task that runs LVGL while it waits for flushes or for the panel. Without them it spins.
+void SSD1963::SetWaitFunctions(WakeFunction wake, BlockFunction block, SleepFunction sleep) noexcept
+{
+	wakeFunction = wake;
+	blockFunction = block;
+	sleepFunction = sleep;
+}
+
+// Wait until LVGL's draw buffer is no longer being flushed. Call only from the task that runs LVGL.
+void SSD1963::WaitForFlush(lv_disp_drv_t *disp_drv) noexcept
+{
+	WaitUntil([disp_drv]() noexcept { return disp_drv->draw_buf->flushing == 0; });
+}
+
+// Return true if the initialisation sequence has been sent. The memory may still be being cleared, but flushes wait for that.
+bool SSD1963::IsReady() noexcept
+{
+	return panelReady;
+}
+
+// Return the value of time_us_32() when the last flush completed
+uint32_t SSD1963::GetLastFlushTime() noexcept
+{
+	return lastFlushTime.load(std::memory_order_relaxed);
+}
+
+// Return the value of time_us_32() when the panel became ready, or zero if it isn't ready yet
+uint32_t SSD1963::GetReadyTime() noexcept
+{
+	return readyTime;
+}
 
-	delay(1000);
+// Return the value of time_us_32() when the PIO finished clearing the display memory, or zero if it hasn't finished yet
+uint32_t SSD1963::GetClearedTime() noexcept
+{
+	return (filling || !panelReady) ? 0 : clearedTime;
+}
+
+void SSD1963::EnableBacklight() noexcept
+{
 	fastDigitalWriteHigh(DisplayBacklightPin);
 }
 
-void SSD1963::Flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p) noexcept
+// Set the backlight PWM duty cycle. Zero turns the backlight supply off as well. Call only from the task that runs LVGL, between calls to lv_timer_handler.
+void SSD1963::SetBacklight(uint8_t level) noexcept
+{
+	WaitForFlushes();
+	fastDigitalWriteLow(DisplayCsPin);
+	SendBacklightPwm(level);
+	fastDigitalWriteHigh(DisplayCsPin);
+	if (level == 0)
+	{
+		fastDigitalWriteLow(DisplayBacklightPin);
+	}
+	else
+	{
+		fastDigitalWriteHigh(DisplayBacklightPin);
+	}
+}
+
+// Run-length encoder for pixel data. A run can continue from one call to the next, so an area can be encoded in pieces.
+class RunEncoder
+{
+public:
+	RunEncoder(uint32_t *p_runs, size_t p_maxRuns) noexcept : runs(p_runs), maxRuns(p_maxRuns) { }
+
+	void AddPixels(const uint16_t *p, size_t numPixels) noexcept;
+	void AddRepeated(uint16_t pixel, size_t count) noexcept;
+	size_t Finish() noexcept;
+	bool IsFull() const noexcept { return full; }
+
+private:
+	void EndRun() noexcept;
+
+	uint32_t *runs;
+	size_t maxRuns;
+	size_t numRuns = 0;
+	size_t runLength = 0;						// length of the run in progress
+	uint16_t runPixel = 0;
+	bool full = false;							// set if there would be more than maxRuns runs
+};
+
+// Write the run in progress to the buffer, split into runs of at most PioBus::MaxRunLength
+TIME_CRITICAL(RunEncoder_EndRun) inline void RunEncoder::EndRun() noexcept
+{
+	while (runLength != 0)
+	{
+		if (numRuns == maxRuns)
+		{
+			full = true;
+			runLength = 0;
+			return;
+		}
+		const size_t chunk = min<size_t>(runLength, PioBus::MaxRunLength);
+		runs[numRuns++] = PioBus::MakeRun(runPixel, chunk);
+		runLength -= chunk;
+	}
+}
+
+TIME_CRITICAL(RunEncoder_AddRepeated) inline void RunEncoder::AddRepeated(uint16_t pixel, size_t count) noexcept
 {
+	if (count != 0)
+	{
+		if (runLength != 0 && pixel != runPixel)
+		{
+			EndRun();
+		}
+		runPixel = pixel;
+		runLength += count;
+	}
+}
+
+// Add a block of pixels, comparing two pixels at a time where possible. It is kept out of line so that the loop stays in RAM when it is called from DoFlush.
+TIME_CRITICAL(RunEncoder_AddPixels) __attribute__((noinline)) void RunEncoder::AddPixels(const uint16_t *p, size_t numPixels) noexcept
+{
+	const uint16_t * const end = p + numPixels;
+	while (p < end && !full)
+	{
+		const uint16_t * const start = p;
+		const uint16_t pixel = *p++;
+
+		// Extend the run one pixel at a time until we reach a word boundary, then a word at a time, then finish off with the odd pixel if there is one
+		if (p < end && *p == pixel && (reinterpret_cast<uintptr_t>(p) & 3) != 0)
+		{
+			++p;
+		}
+		// The pair is loaded with memcpy to avoid aliasing the pixel buffer as uint32_t. It is word aligned here, so this is a single load on the M0+.
+		if ((reinterpret_cast<uintptr_t>(p) & 3) == 0)
+		{
+			const uint32_t pixelPair = ((uint32_t)pixel << 16) | pixel;
+			while (p + 1 < end)
+			{
+				uint32_t pair;
+				memcpy(&pair, __builtin_assume_aligned(p, 4), sizeof(pair));
+				if (pair != pixelPair)
+				{
+					break;
+				}
+				p += 2;
+			}
+		}
+		if (p < end && *p == pixel)
+		{
+			++p;
+		}
+		AddRepeated(pixel, p - start);
+	}
+}
+
+// Return the number of runs, or zero if there would be more than maxRuns of them
+size_t RunEncoder::Finish() noexcept
+{
+	EndRun();
+	return (full) ? 0 : numRuns;
+}
+
+// Encode the pixels of an area, taking the pixels of the solid areas from their colour instead of the draw buffer, and return the number of pixels taken from them.
+// The solid areas must not extend beyond the sides of the area or overlap each other; rows of them outside the area are ignored.
+static size_t EncodeWithSolidAreas(RunEncoder& encoder, const uint16_t *pixels, const lv_area_t& area,
+									const SSD1963::SolidArea *solidAreas, size_t numSolidAreas) noexcept
+{
+	// Sort the solid areas by their left edges so that we can encode each row from left to right
+	const SSD1963::SolidArea *sorted[SSD1963::MaxSolidAreas];
+	for (size_t i = 0; i < numSolidAreas; ++i)
+	{
+		size_t j = i;
+		while (j != 0 && sorted[j - 1]->area.x1 > solidAreas[i].area.x1)
+		{
+			sorted[j] = sorted[j - 1];
+			--j;
+		}
+		sorted[j] = &solidAreas[i];
+	}
+
+	const size_t width = area.x2 - area.x1 + 1;
+	size_t solidPixels = 0;
+	for (lv_coord_t y = area.y1; y <= area.y2 && !encoder.IsFull(); ++y)
+	{
+		lv_coord_t x = area.x1;
+		for (size_t i = 0; i < numSolidAreas; ++i)
+		{
+			const SSD1963::SolidArea& s = *sorted[i];
+			if (y >= s.area.y1 && y <= s.area.y2)
+			{
+				encoder.AddPixels(pixels + (x - area.x1), s.area.x1 - x);
+				encoder.AddRepeated(s.colour.full, s.area.x2 - s.area.x1 + 1);
+				solidPixels += s.area.x2 - s.area.x1 + 1;
+				x = s.area.x2 + 1;
+			}
+		}
+		encoder.AddPixels(pixels + (x - area.x1), area.x2 + 1 - x);
+		pixels += width;
+	}
+	return solidPixels;
+}
+
+// Write the solid areas to the draw buffer, for when the flush can't send them as runs
+static void DrawSolidAreas(lv_color_t *buf, const lv_area_t& area, const SSD1963::SolidArea *solidAreas, size_t numSolidAreas) noexcept
+{
+	const size_t width = area.x2 - area.x1 + 1;
+	for (size_t i = 0; i < numSolidAreas; ++i)
+	{
+		const SSD1963::SolidArea& s = solidAreas[i];
+		lv_color_t *row = buf + (s.area.y1 - area.y1) * width + (s.area.x1 - area.x1);
+		for (lv_coord_t y = s.area.y1; y <= s.area.y2; ++y)
+		{
+			lv_color_fill(row, s.colour, s.area.x2 - s.area.x1 + 1);
+			row += width;
+		}
+	}
+}
+
+// Render cost of each extra pixel in a joined area. LVGL draws the background and any objects in the gap between the two areas, which costs
+// about as much per pixel as the rest of the area. The profiler's render_us divided by the pixels written gives an upper bound, because it
+// includes the fixed cost of each part.
+constexpr uint32_t RenderClocksPerPixel = 20;
+
+// Decide whether it is cheaper to render and send two areas as the smallest rectangle that contains them both rather than separately.
+// Overlapping pixels are counted twice when the areas are sent separately, so overlapping areas are nearly always joined.
+static bool WorthJoining(const lv_area_t& a, const lv_area_t& b, lv_area_t& joined) noexcept
+{
+	_lv_area_join(&joined, &a, &b);
+	const uint32_t separatePixels = lv_area_get_size(&a) + lv_area_get_size(&b);
+	const uint32_t joinedPixels = lv_area_get_size(&joined);
+	const uint32_t clocksPerArea = WindowSetupClocks() + clocksPerFlushOverhead.load(std::memory_order_relaxed);
+	return joinedPixels <= separatePixels || (joinedPixels - separatePixels) * (PioBus::ClocksPerPixel + RenderClocksPerPixel) < clocksPerArea;
+}
+
+// JoinAreas edits LVGL's list of invalidated areas (inv_areas, inv_area_joined and inv_p in lv_disp_t), which isn't part of its API.
+// The layout is that of LVGL 8.3, which also added the render_start_cb that calls it; LVGL 9 replaces the list.
+static_assert(LVGL_VERSION_MAJOR == 8 && LVGL_VERSION_MINOR >= 3, "check JoinAreas against this version of LVGL");
+
+// Called by LVGL just before it renders the invalidated areas. LVGL has already joined areas where that reduces the number of pixels;
+// here we also join areas where the saving in per-area overhead outweighs the cost of the extra pixels. A joined area is stored in the slot of the
+// later of the two areas so that LVGL's record of which area is drawn last remains valid.
+void SSD1963::JoinAreas(lv_disp_drv_t *disp_drv) noexcept
+{
+	lv_disp_t * const disp = _lv_refr_get_disp_refreshing();
+	bool joinedAny;
+	do
+	{
+		joinedAny = false;
+		for (uint32_t j = 1; j < disp->inv_p; ++j)
+		{
+			if (disp->inv_area_joined[j] == 0)
+			{
+				for (uint32_t i = 0; i < j; ++i)
+				{
+					lv_area_t joined;
+					if (disp->inv_area_joined[i] == 0 && WorthJoining(disp->inv_areas[i], disp->inv_areas[j], joined))
+					{
+						disp->inv_areas[j] = joined;
+						disp->inv_area_joined[i] = 1;
+						++areasJoined;
+						joinedAny = true;
+					}
+				}
+			}
+		}
+	} while (joinedAny);
+}
+
+// Get the statistics as they were when the last flush completed. Call only from core 0.
+void SSD1963::GetFlushStats(FlushStats& stats) noexcept
+{
+	while (!publishedStats.Read(stats)) { }			// the flush worker on core 1 is part way through publishing them, which takes a microsecond
+	stats.areasJoined = areasJoined;
+	stats.scrolls = scrolls;
+	stats.flushQueueFullWaits = flushQueueFullWaits;
+	stats.busByteClocks = clocksPerBusByte.load(std::memory_order_relaxed);
+	stats.flushOverheadClocks = clocksPerFlushOverhead.load(std::memory_order_relaxed);
+}
+
+// Wait until rows firstRow to lastRow can be written without the panel scan showing part of the write, given the number of bus clocks it will take.
+// The scheduler never asks us to wait more than one panel frame (about 20ms), and usually much less: the average is in the profiler's pace_wait_us/paced_flushes.
+// So we don't spin for that long: on core 0 the task that runs LVGL blocks until the alarm wakes it, so that the other tasks can run, and core 1 sleeps
+// in WFE, waking to act on a pause request if one arrives. Only the last few microseconds are spun.
+static void WaitForScanSlot(uint16_t firstRow, uint16_t lastRow, uint32_t busClocks) noexcept
+{
+	const uint32_t writeNanoseconds = (uint32_t)(((uint64_t)busClocks * 1000)/(SystemCoreClockFreq/1000000));
+	const uint32_t now = time_us_32();
+	const uint32_t startTime = FrameScheduler::GetStartTime(now, firstRow, lastRow, writeNanoseconds);
+	const uint32_t wakeTime = startTime - ScanSpinMicroseconds;
+	const int32_t sleepTime = (int32_t)(wakeTime - time_us_32());
+	if (sleepTime > 0 && !hardware_alarm_set_target((unsigned int)scanAlarm, from_us_since_boot(time_us_64() + (uint32_t)sleepTime)))
+	{
+#if DISPLAY_FLUSH_ON_CORE1
+		while ((int32_t)(time_us_32() - wakeTime) < 0)
+		{
+			CheckForPauseRequest();
+			__wfe();
+		}
+#else
+		WaitUntil([wakeTime]() noexcept { return (int32_t)(time_us_32() - wakeTime) >= 0; });
+#endif
+	}
+	while ((int32_t)(time_us_32() - startTime) < 0) { }
+	flushPaceWaitTime += time_us_32() - now;
+}
+
+// Send an area to the display. The solid areas, if any, are parts of it that LVGL left out of the draw buffer.
+// Returns true if the flush has been completed, in which case the caller must tell LVGL, or false if the PIO interrupt will complete it.
+// The caller must have waited for the clear started by InitPanel to finish.
+static bool DoFlush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p, const SSD1963::SolidArea *solidAreas, size_t numSolidAreas) noexcept
+{
+	flushStartTime = time_us_32();
+	flushPaceWaitTime = 0;
+	flushBusClocksAtStart = flushStats.busClocks;
+
 	// Truncate the area to the screen
 	int32_t act_x1 = max<lv_coord_t>(area->x1, 0);
 	int32_t act_y1 = max<lv_coord_t>(area->y1, 0);
@@ -244,47 +940,371 @@ void SSD1963::Flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t
 	int32_t act_y2 = min<lv_coord_t>(area->y2, SSD1963_VER_RES - 1);
 	if (act_x1 <= act_x2 && act_y1 <= act_y2)
 	{
-		// Set the rectangular area
+		RowSegment segments[MaxRowSegments];
+		const size_t numSegments = MapRows(act_y1, act_y2, segments);
 		fastDigitalWriteLow(DisplayCsPin);
 
-#if 1
-		SetXY(act_x1, act_x2, act_y1, act_y2);
-		LCD_Write_COM(0x2c);
-		fastDigitalWriteHigh(DisplayDataNotCommandPin);
-#endif
-
 		const uint16_t full_w = area->x2 - area->x1 + 1;
 		const uint16_t act_w = act_x2 - act_x1 + 1;
 
-		for (int16_t i = act_y1; i <= act_y2; i++)
+		const size_t numPixels = act_w * (act_y2 - act_y1 + 1);
+		++flushStats.flushes;
+		flushStats.pixelsSent += numPixels;
+		if (numSegments > 1)
 		{
-#if 0
-			SetXY(act_x1, act_x2, i, i);
+			++flushStats.splitFlushes;
+		}
+
+		// Only the run-length encoded transfer can send the solid areas without reading them from the draw buffer, so if we can't use that then draw them
+		const bool wholeArea = act_w == full_w && act_y1 == area->y1;
+		if (numSolidAreas != 0 && (!wholeArea || numSegments > 1))
+		{
+			DrawSolidAreas(color_p, *area, solidAreas, numSolidAreas);
+			++flushStats.solidFallbacks;
+			numSolidAreas = 0;
+		}
+
+		// If the whole area is on the screen then the pixel data is contiguous, so let the PIO send it. It will call lv_disp_flush_ready when it has finished.
+		if (wholeArea)
+		{
+			flushingDriver = disp_drv;
+			if (numSegments > 1)
+			{
+				// The area crosses a scroll boundary, so send the segments one after another as the PIO completes each one
+				for (size_t i = 0; i < numSegments; ++i)
+				{
+					flushSegments[i] = segments[i];
+				}
+				numFlushSegments = numSegments;
+				nextFlushSegment = 0;
+				flushSegmentData = (const uint16_t*)color_p;
+				flushX1 = act_x1;
+				flushX2 = act_x2;
+				flushFirstRow = act_y1;
+				flushStats.busClocks += numPixels * PioBus::ClocksPerPixel + (numSegments - 1) * WindowSetupClocks();
+				WaitForScanSlot(act_y1, act_y2, numPixels * PioBus::ClocksPerPixel + (numSegments - 1) * WindowSetupClocks());
+				StartNextSegment();
+				return false;
+			}
+
+			numFlushSegments = nextFlushSegment = 0;
+			SetXY(act_x1, act_x2, segments[0].memoryRow, segments[0].memoryRow + segments[0].numRows - 1);
 			LCD_Write_COM(0x2c);
 			fastDigitalWriteHigh(DisplayDataNotCommandPin);
-#endif
-			const uint16_t *p = (uint16_t*)color_p;
-			uint16_t lastPixel = *p++;
-			LCD_Write_Bus16(lastPixel);
-			for (uint16_t j = 1; j < act_w; ++j)
+
+			// Sending as runs costs ClocksPerRun for each run and ClocksPerRepeat for each other pixel, so only do it if there are few enough runs
+			const size_t breakEvenRuns = (numPixels * (PioBus::ClocksPerPixel - PioBus::ClocksPerRepeat))/(PioBus::ClocksPerRun - PioBus::ClocksPerRepeat);
+			RunEncoder encoder(runBuffer, min<size_t>(breakEvenRuns, RunBufferSize));
+			size_t solidPixels = 0;
+			if (numSolidAreas == 0)
+			{
+				encoder.AddPixels((const uint16_t*)color_p, numPixels);
+			}
+			else
 			{
-				const uint16_t newPixel = *p++;
-				if (newPixel == lastPixel)
+				const lv_area_t actArea = { (lv_coord_t)act_x1, (lv_coord_t)act_y1, (lv_coord_t)act_x2, (lv_coord_t)act_y2 };
+				solidPixels = EncodeWithSolidAreas(encoder, (const uint16_t*)color_p, actArea, solidAreas, numSolidAreas);
+			}
+			const size_t numRuns = encoder.Finish();
+			if (numRuns != 0)
+			{
+				++flushStats.encodedFlushes;
+				flushStats.solidPixels += solidPixels;
+				flushStats.runsFound += numRuns;
+				const uint32_t busClocks = numRuns * PioBus::ClocksPerRun + (numPixels - numRuns) * PioBus::ClocksPerRepeat;
+				flushStats.busClocksSaved += numPixels * PioBus::ClocksPerPixel - busClocks;
+				flushStats.busClocks += busClocks;
+				WaitForScanSlot(act_y1, act_y2, busClocks);
+				PioBus::StartRunTransfer(runBuffer, numRuns);
+			}
+			else
+			{
+				if (numSolidAreas != 0)
 				{
-					PulseWritePin();
+					DrawSolidAreas(color_p, *area, solidAreas, numSolidAreas);
+					++flushStats.solidFallbacks;
 				}
-				else
+				flushStats.busClocks += numPixels * PioBus::ClocksPerPixel;
+				WaitForScanSlot(act_y1, act_y2, numPixels * PioBus::ClocksPerPixel);
+				PioBus::StartTransfer((const uint16_t*)color_p, numPixels);
+			}
+			return false;
+		}
+
+		flushStats.busClocks += numPixels * 2 * clocksPerBusByte.load(std::memory_order_relaxed);		// the CPU writes each pixel about as fast as two command bytes
+		WaitForScanSlot(act_y1, act_y2, numPixels * 2 * clocksPerBusByte.load(std::memory_order_relaxed));
+		for (size_t seg = 0; seg < numSegments; ++seg)
+		{
+			SetXY(act_x1, act_x2, segments[seg].memoryRow, segments[seg].memoryRow + segments[seg].numRows - 1);
+			LCD_Write_COM(0x2c);
+			fastDigitalWriteHigh(DisplayDataNotCommandPin);
+			for (uint16_t i = 0; i < segments[seg].numRows; i++)
+			{
+				const uint16_t *p = (uint16_t*)color_p;
+				uint16_t lastPixel = *p++;
+				LCD_Write_Bus16(lastPixel);
+				for (uint16_t j = 1; j < act_w; ++j)
 				{
-					lastPixel = newPixel;
-					LCD_Write_Bus16(newPixel);
+					const uint16_t newPixel = *p++;
+					if (newPixel == lastPixel)
+					{
+						PulseWritePin();
+					}
+					else
+					{
+						lastPixel = newPixel;
+						LCD_Write_Bus16(newPixel);
+					}
 				}
+				color_p += full_w;
 			}
-			color_p += full_w;
 		}
 		fastDigitalWriteHigh(DisplayCsPin);
 	}
 
-	lv_disp_flush_ready(disp_drv);
+	FlushDone();
+	return true;
+}
+
+// Send a command with 16-bit parameters. The bus must be idle.
+static void SendCommand(uint8_t cmd, const uint16_t *params, size_t numParams) noexcept
+{
+	fastDigitalWriteLow(DisplayCsPin);
+	LCD_Write_COM(cmd);
+	fastDigitalWriteHigh(DisplayDataNotCommandPin);
+	for (size_t i = 0; i < numParams; ++i)
+	{
+		LCD_Write_Bus8(params[i] >> 8);
+		LCD_Write_Bus8(params[i] & 0x00FF);
+	}
+	fastDigitalWriteHigh(DisplayCsPin);
+}
+
+// Make screen rows top to top + height - 1 a hardware scroll area, and reset the scroll offset to zero. Returns false if the area is invalid.
+// The rows above and below it don't scroll. Call only from the task that runs LVGL, between calls to lv_timer_handler.
+bool SSD1963::SetScrollArea(uint16_t top, uint16_t height) noexcept
+{
+	if (height == 0 || top + height > SSD1963_VER_RES)
+	{
+		return false;
+	}
+	WaitForFlushes();
+	const uint16_t areaParams[3] = { top, height, (uint16_t)(SSD1963_VER_RES - top - height) };
+	SendCommand(0x33, areaParams, 3);
+	SendCommand(0x37, &top, 1);
+	scrollTop = top;
+	scrollHeight = height;
+	scrollOffset = 0;
+	return true;
+}
+
+// Scroll the contents of the scroll area up by 'offset' rows from where they were when the scroll area was set, wrapping around at the end.
+// This changes a single controller register, but the rows that come into view at the bottom still hold what scrolled off the top,
+// so the caller must invalidate them. Call only from the task that runs LVGL, between calls to lv_timer_handler.
+void SSD1963::SetScrollOffset(uint16_t offset) noexcept
+{
+	offset %= scrollHeight;
+	if (offset != scrollOffset)
+	{
+		WaitForFlushes();
+		const uint16_t start = scrollTop + offset;
+		SendCommand(0x37, &start, 1);
+		scrollOffset = offset;
+		++scrolls;
+	}
+}
+
+uint16_t SSD1963::GetScrollOffset() noexcept
+{
+	return scrollOffset;
+}
+
+// Show only screen rows firstRow to lastRow, leaving the rest of the panel dark. Used to save power when only part of the screen is in use.
+void SSD1963::SetPartialArea(uint16_t firstRow, uint16_t lastRow) noexcept
+{
+	WaitForFlushes();
+	const uint16_t params[2] = { firstRow, lastRow };
+	SendCommand(0x30, params, 2);
+	SendCommand(0x12, nullptr, 0);
+}
+
+// Show the whole screen again after SetPartialArea
+void SSD1963::SetNormalMode() noexcept
+{
+	WaitForFlushes();
+	SendCommand(0x13, nullptr, 0);
+}
+
+// Stop or restart the panel scan. The display memory keeps its contents while the scan is stopped, so they are shown again at once when it restarts.
+// Call only from the task that runs LVGL, between calls to lv_timer_handler.
+void SSD1963::SetDisplayOn(bool on) noexcept
+{
+	WaitForFlushes();
+	SendCommand((on) ? 0x29 : 0x28, nullptr, 0);
+}
+
+#if DISPLAY_FLUSH_ON_CORE1
+
+// Flush requests passed from LVGL on core 0 to the worker on core 1. LVGL only has one flush outstanding at a time, so the queue doesn't need to be long.
+// Flushes that core 1 completes itself are passed back to core 0 to tell LVGL, so that LVGL's state is only ever changed on core 0.
+struct FlushRequest
+{
+	lv_disp_drv_t *disp_drv;
+	lv_area_t area;
+	lv_color_t *color_p;
+	const SSD1963::SolidArea *solidAreas;				// owned by the caller until the flush is complete
+	size_t numSolidAreas;
+};
+
+static SpscQueue<FlushRequest, 4> flushQueue;
+static SpscQueue<lv_disp_drv_t*, 4> completedQueue;
+
+// Messages sent to core 1 through the inter-core FIFO
+constexpr uint32_t Core1Doorbell = 0;					// there are flush requests in the queue
+constexpr uint32_t Core1PauseRequest = 1;				// stop executing from flash until resumed
+constexpr uint32_t Core1NextSegment = 2;				// the PIO has finished a segment of a split flush, so send the next
+
+// Message sent to core 0 through the inter-core FIFO
+constexpr uint32_t Core0FlushesDone = 0;				// core 1 has finished initialising the panel or processing the flush queue
+
+// Core 1 pause handshake. Volatile rather than atomic so that no library code in flash is called while core 1 is paused.
+constexpr uint32_t Core1Running = 0, Core1PausePending = 1, Core1IsPaused = 2;
+static volatile uint32_t core1PauseState = Core1Running;
+
+// Wait here while core 0 is writing to flash. This runs from RAM, so it mustn't call anything.
+// A flush may still be in progress, so interrupts are disabled until we resume: the PIO interrupt handler and what it calls run from flash.
+TIME_CRITICAL(Core1Paused) __attribute__((noinline)) static void Core1Paused() noexcept
+{
+	const uint32_t flags = save_and_disable_interrupts();
+	core1PauseState = Core1IsPaused;
+	while (core1PauseState == Core1IsPaused) { }
+	restore_interrupts(flags);
+}
+
+// Act on a pause request that arrives while core 1 is waiting for a scan slot part way through a flush. Any doorbell read here can be dropped,
+// because it was rung after its request was queued and core 1 empties the queue before it waits for another. No segment request can be read here,
+// because the wait comes before the first segment of a split flush is started and LVGL doesn't request another flush until the last one is complete.
+static void CheckForPauseRequest() noexcept
+{
+	while (multicore_fifo_rvalid())
+	{
+		if (multicore_fifo_pop_blocking() == Core1PauseRequest)
+		{
+			Core1Paused();
+		}
+	}
+}
+
+// Core 1 sleeps in the inter-core FIFO pop until core 0 rings the doorbell, then processes everything in the queue
+// When the queue is empty it tells core 0, which may be waiting for a flush that core 1 completed itself rather than leaving to the PIO interrupt.
+[[noreturn]] static void Core1FlushTask() noexcept
+{
+	InitPanel();
+	while (filling) { }							// core 1 has nothing else to do until the display memory has been cleared
+	multicore_fifo_push_blocking(Core0FlushesDone);
+	for (;;)
+	{
+		const uint32_t msg = multicore_fifo_pop_blocking();
+		if (msg == Core1PauseRequest)
+		{
+			Core1Paused();
+			continue;
+		}
+		if (msg == Core1NextSegment)
+		{
+			StartNextSegment();
+			continue;
+		}
+		FlushRequest req;
+		while (flushQueue.Get(req))
+		{
+			if (DoFlush(req.disp_drv, &req.area, req.color_p, req.solidAreas, req.numSolidAreas))
+			{
+				(void)completedQueue.Put(req.disp_drv);		// can't fail, because LVGL waits for each flush to complete before it requests another
+			}
+		}
+		multicore_fifo_push_blocking(Core0FlushesDone);
+	}
+}
+
+// Ask core 1 to send the next segment of a split flush. Called from the PIO interrupt on core 0. The FIFO to core 1 has room, because it holds
+// at most a doorbell, a pause request and this request at a time.
+static void RequestNextSegment() noexcept
+{
+	multicore_fifo_push_blocking(Core1NextSegment);
+}
+
+// Inter-core FIFO interrupt on core 0, raised when core 1 has finished some work that the task running LVGL may be waiting for
+static void Core0FifoInterrupt() noexcept
+{
+	multicore_fifo_drain();
+	multicore_fifo_clear_irq();
+	lv_disp_drv_t *disp_drv;
+	while (completedQueue.Get(disp_drv))
+	{
+		lv_disp_flush_ready(disp_drv);
+	}
+	WakeWaitingTask();
+}
+
+// Send an area of the draw buffer to the display, with the solid areas that LVGL left out of it. The caller must keep the solid areas until the flush is complete.
+void SSD1963::FlushWithSolidAreas(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p, const SolidArea *solidAreas, size_t numSolidAreas) noexcept
+{
+	flushesRequested.store(flushesRequested.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	const FlushRequest req{ disp_drv, *area, color_p, solidAreas, numSolidAreas };
+	if (!flushQueue.Put(req))
+	{
+		// This should never happen, because LVGL waits for each flush to complete before it requests another. Core 0 mustn't do the flush itself
+		// while core 1 owns the bus, so count it and wait for core 1 to make room. Core 1 tells us each time it empties the queue.
+		++flushQueueFullWaits;
+		WaitUntil([&req]() noexcept { return flushQueue.Put(req); });
+	}
+	multicore_fifo_push_blocking(Core1Doorbell);
+}
+
+// Stop core 1 executing code from flash so that core 0 can erase or program it. Core 1 finishes any flushes already queued first,
+// unless it is waiting for a scan slot, in which case it pauses at once and finishes the flush when resumed.
+void SSD1963::PauseFlushWorker() noexcept
+{
+	if (core1Started)
+	{
+		core1PauseState = Core1PausePending;
+		multicore_fifo_push_blocking(Core1PauseRequest);
+		while (core1PauseState != Core1IsPaused) { }
+	}
+}
+
+void SSD1963::ResumeFlushWorker() noexcept
+{
+	core1PauseState = Core1Running;
+}
+
+#else
+
+void SSD1963::PauseFlushWorker() noexcept
+{
+}
+
+void SSD1963::ResumeFlushWorker() noexcept
+{
+}
+
+// Send an area of the draw buffer to the display, with the solid areas that LVGL left out of it. The caller must keep the solid areas until the flush is complete.
+void SSD1963::FlushWithSolidAreas(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p, const SolidArea *solidAreas, size_t numSolidAreas) noexcept
+{
+	flushesRequested.store(flushesRequested.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	WaitUntil([]() noexcept { return !filling; });					// the first frame can be rendered while InitPanel's clear is still running
+	if (DoFlush(disp_drv, area, color_p, solidAreas, numSolidAreas))
+	{
+		lv_disp_flush_ready(disp_drv);
+	}
+}
+
+#endif
+
+void SSD1963::Flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p) noexcept
+{
+	FlushWithSolidAreas(disp_drv, area, color_p, nullptr, 0);
 }
 
 // End
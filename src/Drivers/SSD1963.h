@@ -12,11 +12,69 @@
 
 constexpr unsigned int SSD1963_HOR_RES = 800;
 constexpr unsigned int SSD1963_VER_RES = 480;
+constexpr uint8_t DefaultBacklight = 0xF0;
 
 namespace SSD1963
 {
-	void Init() noexcept;
+	constexpr size_t MaxSolidAreas = 16;
+
+	// A rectangle of one colour that was left out of the draw buffer. The flush sends it as a run of that colour instead of reading the buffer.
+	struct SolidArea
+	{
+		lv_area_t area;
+		lv_color_t colour;
+	};
+
+	struct FlushStats
+	{
+		uint32_t flushes;
+		uint32_t encodedFlushes;			// number of flushes sent as runs of identical pixels
+		uint32_t pixelsSent;
+		uint32_t runsFound;					// total number of runs in the encoded flushes
+		uint32_t busClocksSaved;			// PIO clocks saved by sending runs instead of individual pixels
+		uint32_t setXYCalls;
+		uint32_t windowWritesSkipped;		// column or page address commands not sent because the address was unchanged
+		uint32_t areasJoined;				// invalidated areas merged into another area by JoinAreas
+		uint32_t busyTime;					// total microseconds from starting flushes to them completing
+		uint32_t busClocks;					// total system clocks the bus was expected to take to send the flushes
+		uint32_t splitFlushes;				// flushes sent in more than one window because they crossed a scroll boundary
+		uint32_t scrolls;					// number of times the hardware scroll offset was changed
+		uint32_t solidPixels;				// pixels sent from solid areas without being read from the draw buffer
+		uint32_t solidFallbacks;			// flushes in which the solid areas had to be written to the draw buffer after all
+		uint32_t busByteClocks;				// measured system clocks for the CPU to write a command or parameter byte
+		uint32_t flushOverheadClocks;		// running average of the system clocks a flush takes that aren't spent on the bus or waiting for the panel scan
+		uint32_t flushQueueFullWaits;		// flushes that had to wait for room in the queue to core 1, which should never happen
+	};
+
+	// Functions that let the task that runs LVGL sleep while it waits for a flush or fill. The driver calls the block function repeatedly while it waits,
+	// and calls the wake function from an interrupt on core 0 when a flush or fill completes while it is waiting. The block function must return
+	// once the wake function has been called, and should return after a few milliseconds anyway. If the panel is initialised on core 0, the delays
+	// in the initialisation sequence use the sleep function, which must wait for at least the given number of milliseconds.
+	typedef void (*WakeFunction)() noexcept;
+	typedef void (*BlockFunction)() noexcept;
+	typedef void (*SleepFunction)(uint32_t millis) noexcept;
+
+	void Init(uint8_t backlight = DefaultBacklight) noexcept;
+	void SetWaitFunctions(WakeFunction wake, BlockFunction block, SleepFunction sleep) noexcept;
+	void WaitForFlush(lv_disp_drv_t *disp_drv) noexcept;
+	bool IsReady() noexcept;
+	uint32_t GetReadyTime() noexcept;
+	uint32_t GetClearedTime() noexcept;
+	uint32_t GetLastFlushTime() noexcept;
+	void EnableBacklight() noexcept;
+	void SetBacklight(uint8_t level) noexcept;
+	void SetDisplayOn(bool on) noexcept;
+	void JoinAreas(lv_disp_drv_t *disp_drv) noexcept;
+	void PauseFlushWorker() noexcept;
+	void ResumeFlushWorker() noexcept;
+	bool SetScrollArea(uint16_t top, uint16_t height) noexcept;
+	void SetScrollOffset(uint16_t offset) noexcept;
+	uint16_t GetScrollOffset() noexcept;
+	void SetPartialArea(uint16_t firstRow, uint16_t lastRow) noexcept;
+	void SetNormalMode() noexcept;
+	void GetFlushStats(FlushStats& stats) noexcept;
 	extern "C" void Flush(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p) noexcept;
+	void FlushWithSolidAreas(lv_disp_drv_t * disp_drv, const lv_area_t * area, lv_color_t * color_p, const SolidArea *solidAreas, size_t numSolidAreas) noexcept;
 }
 
 #endif /* SRC_SSD1963_H_ */
@@ -0,0 +1,101 @@
+/*
+ * TouchAcquisition.cpp
+ *
+ *  Created on: 31 Jan 2023
+ *      Author: David
+ */
+
+#include "TouchAcquisition.h"
+#include "TouchPanel.h"
+#include <Mailbox.h>
+#include <DisplayWake.h>
+#include <TaskPriorities.h>
+#include <Pins.h>
+#include <CoreIO.h>
+#include <Interrupts.h>
+#include <RTOSIface/RTOSIface.h>
+#include <hardware/timer.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+constexpr unsigned int TouchTaskStackWords = 150;
+constexpr uint32_t PressedPollMillis = 10;			// how often we sample while the panel is being touched
+constexpr uint32_t IdlePollMillis = 200;			// how often we check for a touch if we miss the pen interrupt
+
+static Task<TouchTaskStackWords> touchTask;
+static Mailbox<TouchSample> mailbox;
+static volatile uint32_t penDownTime = 0;
+
+// Pen interrupt. The XPT2046 pulls ~PENIRQ low when the panel is touched, as long as it isn't in the middle of a conversion.
+static void PenInterrupt(CallbackParameter) noexcept
+{
+	penDownTime = time_us_32();
+	BaseType_t higherPriorityTaskWoken = pdFALSE;
+	vTaskNotifyGiveFromISR(touchTask.GetFreeRTOSHandle(), &higherPriorityTaskWoken);
+	portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
+[[noreturn]] static void TouchTask(void *) noexcept
+{
+	TouchSample sample = {};
+	uint32_t releaseTime = time_us_32();
+	for (;;)
+	{
+		if (sample.pressed)
+		{
+			vTaskDelay(pdMS_TO_TICKS(PressedPollMillis));
+		}
+		else
+		{
+			(void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IdlePollMillis));
+		}
+
+		const uint32_t startTime = time_us_32();
+		uint16_t x, y, rawX, rawY;
+		bool repeat;
+		const bool pressed = TouchPanel::Read(x, y, repeat, &rawX, &rawY);
+		if (pressed)
+		{
+			if (!sample.pressed)
+			{
+				// Time the touch from the pen interrupt if it was for this touch, else from when we found it
+				const uint32_t irqTime = penDownTime;
+				sample.touchTime = ((int32_t)(irqTime - releaseTime) > 0) ? irqTime : startTime;
+				++sample.touchNumber;
+			}
+			sample.x = x;
+			sample.y = y;
+			sample.rawX = rawX;
+			sample.rawY = rawY;
+		}
+		else if (sample.pressed)
+		{
+			releaseTime = startTime;
+		}
+		else
+		{
+			continue;											// nothing has changed, so there is no need to publish anything
+		}
+		sample.pressed = pressed;
+		sample.sampleTime = startTime;
+		mailbox.Publish(sample);
+		DisplayWake::Notify(DisplayWake::Event::touch);
+	}
+}
+
+// Start the acquisition task. TouchPanel::Init must have been called first.
+void TouchAcquisition::Start() noexcept
+{
+	mailbox.Publish(TouchSample{});
+	touchTask.Create(TouchTask, "TOUCH", nullptr, TaskPriority::TouchPriority);
+	attachInterrupt(TouchIrqPin, PenInterrupt, InterruptMode::falling, CallbackParameter(nullptr));
+}
+
+// Get the latest touch sample. Returns false if the acquisition task was part way through publishing one, in which case the caller should use the previous one.
+bool TouchAcquisition::GetLatest(TouchSample& sample) noexcept
+{
+	return mailbox.Read(sample);
+}
+
+// End
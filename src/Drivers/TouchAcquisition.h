@@ -0,0 +1,32 @@
+/*
+ * TouchAcquisition.h
+ *
+ *  Created on: 31 Jan 2023
+ *      Author: David
+ *
+ *  Background acquisition of touch panel readings. A task woken by the touch controller's pen interrupt does the slow bit-banged
+ *  conversions and publishes each result, so the LVGL input device callback only has to collect the latest sample.
+ */
+
+#ifndef SRC_DRIVERS_TOUCHACQUISITION_H_
+#define SRC_DRIVERS_TOUCHACQUISITION_H_
+
+#include <cstdint>
+
+struct TouchSample
+{
+	uint16_t x, y;							// screen coordinates, valid if pressed is true
+	uint16_t rawX, rawY;					// ADC readings after allowing for the orientation
+	uint32_t touchTime;						// value of time_us_32() when the current touch started
+	uint32_t sampleTime;					// value of time_us_32() when this sample was taken
+	uint32_t touchNumber;					// incremented each time the panel is touched
+	bool pressed;
+};
+
+namespace TouchAcquisition
+{
+	void Start() noexcept;
+	bool GetLatest(TouchSample& sample) noexcept;
+}
+
+#endif /* SRC_DRIVERS_TOUCHACQUISITION_H_ */
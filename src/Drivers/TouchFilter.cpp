@@ -0,0 +1,179 @@
+/*
+ * TouchFilter.cpp
+ *
+ *  Created on: 2 Feb 2023
+ *      Author: David
+ */
+
+#include "TouchFilter.h"
+
+static uint16_t diff(uint16_t a, uint16_t b) noexcept { return (a < b) ? b - a : a - b; }
+
+// Insertion sort, fine for the few readings we deal with
+static void Sort(uint16_t *readings, size_t n) noexcept
+{
+	for (size_t i = 1; i < n; ++i)
+	{
+		const uint16_t val = readings[i];
+		size_t j = i;
+		while (j != 0 && readings[j - 1] > val)
+		{
+			readings[j] = readings[j - 1];
+			--j;
+		}
+		readings[j] = val;
+	}
+}
+
+// Averaging filter
+
+void AveragingTouchFilter::Start() noexcept
+{
+	sum = 0;
+	count = 0;
+}
+
+TouchFilterResult AveragingTouchFilter::Add(uint16_t reading) noexcept
+{
+	// Take enough readings to fill the ring buffer, after that replace the oldest one
+	const size_t slot = count % NumReadings;
+	if (count >= NumReadings)
+	{
+		sum -= ring[slot];
+	}
+	ring[slot] = reading;
+	sum += reading;
+	++count;
+	if (count < NumReadings)
+	{
+		return TouchFilterResult::needMore;
+	}
+
+	// Test whether every reading is within 'maxDiff' of the average reading
+	result = (uint16_t)(sum/NumReadings);
+	for (const uint16_t r : ring)
+	{
+		if (diff(result, r) > MaxDiff)
+		{
+			return (count < NumReadings + MaxAttempts) ? TouchFilterResult::needMore : TouchFilterResult::unstable;
+		}
+	}
+	return TouchFilterResult::stable;
+}
+
+// Median filter
+
+void MedianTouchFilter::Start() noexcept
+{
+	count = 0;
+}
+
+TouchFilterResult MedianTouchFilter::Add(uint16_t reading) noexcept
+{
+	readings[count++] = reading;
+	if (count < NumReadings)
+	{
+		return TouchFilterResult::needMore;
+	}
+
+	uint16_t sorted[NumReadings];
+	for (size_t i = 0; i < NumReadings; ++i)
+	{
+		sorted[i] = readings[i];
+	}
+	Sort(sorted, NumReadings);
+	result = sorted[NumReadings/2];
+	return (sorted[(3 * NumReadings)/4] - sorted[NumReadings/4] <= MaxSpread) ? TouchFilterResult::stable : TouchFilterResult::unstable;
+}
+
+// Exponential smoothing filter
+
+void IirTouchFilter::Start() noexcept
+{
+	count = 0;
+	closeReadings = 0;
+}
+
+TouchFilterResult IirTouchFilter::Add(uint16_t reading) noexcept
+{
+	if (count == 0)
+	{
+		smoothed = (uint32_t)reading << Shift;
+	}
+	else
+	{
+		smoothed = smoothed - (smoothed >> Shift) + reading;
+	}
+	++count;
+	result = (uint16_t)(smoothed >> Shift);
+
+	closeReadings = (diff(result, reading) <= MaxDiff) ? closeReadings + 1 : 0;
+	return (closeReadings >= NeededCloseReadings && count > NeededCloseReadings) ? TouchFilterResult::stable
+			: (count < MaxReadings) ? TouchFilterResult::needMore
+				: TouchFilterResult::unstable;
+}
+
+// Adaptive outlier rejection filter
+
+void AdaptiveTouchFilter::Start() noexcept
+{
+	count = 0;
+}
+
+// See whether the last n readings are all within the current threshold of their median. If they are, set the result and update the noise estimate.
+bool AdaptiveTouchFilter::TryAccept(size_t n) noexcept
+{
+	uint16_t latest[WindowSize] = { 0 };
+	for (size_t i = 0; i < n; ++i)
+	{
+		latest[i] = window[(count - n + i) % WindowSize];
+	}
+	Sort(latest, n);
+	const uint16_t median = latest[n/2];
+
+	// Allow four times the typical deviation, within fixed limits
+	const uint32_t threshold = (noise * 4) >> 4;
+	const uint16_t maxDeviation = (threshold < MinThreshold) ? MinThreshold : (threshold > MaxThreshold) ? MaxThreshold : (uint16_t)threshold;
+	uint32_t totalDeviation = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const uint16_t d = diff(latest[i], median);
+		if (d > maxDeviation)
+		{
+			return false;
+		}
+		totalDeviation += d;
+	}
+
+	result = median;
+	noise = (uint32_t)((int32_t)noise + ((int32_t)((totalDeviation << 4)/n) - (int32_t)noise)/8);
+	return true;
+}
+
+TouchFilterResult AdaptiveTouchFilter::Add(uint16_t reading) noexcept
+{
+	window[count % WindowSize] = reading;
+	++count;
+	if (count < MinReadings)
+	{
+		return TouchFilterResult::needMore;
+	}
+	if (TryAccept((count < WindowSize) ? count : WindowSize))
+	{
+		return TouchFilterResult::stable;
+	}
+	if (count < MaxReadings)
+	{
+		return TouchFilterResult::needMore;
+	}
+
+	// The panel is noisier than we expected, so allow more noise next time
+	noise += noise >> 2;
+	if (noise > (uint32_t)MaxThreshold << 4)
+	{
+		noise = (uint32_t)MaxThreshold << 4;
+	}
+	return TouchFilterResult::unstable;
+}
+
+// End
@@ -0,0 +1,124 @@
+/*
+ * TouchFilter.h
+ *
+ *  Created on: 2 Feb 2023
+ *      Author: David
+ *
+ *  Filters that turn a series of noisy touch panel ADC conversions on one axis into a single reading.
+ *  The touch panel driver calls Start, then feeds conversions to Add until the filter says it has a stable reading or has given up.
+ *  The filters don't touch the hardware, so they can be benchmarked on a host against recorded traces.
+ */
+
+#ifndef SRC_DRIVERS_TOUCHFILTER_H_
+#define SRC_DRIVERS_TOUCHFILTER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+enum class TouchFilterResult : uint8_t
+{
+	needMore = 0,				// the filter needs another conversion
+	stable,						// GetResult returns a good reading
+	unstable					// the filter has given up, the readings were too noisy
+};
+
+class TouchFilter
+{
+public:
+	virtual const char *GetName() const noexcept = 0;
+	virtual void Start() noexcept = 0;
+	virtual TouchFilterResult Add(uint16_t reading) noexcept = 0;
+	uint16_t GetResult() const noexcept { return result; }
+
+protected:
+	uint16_t result = 0;
+};
+
+// The original filter: fill a ring of 8 readings, then accept their average if every reading is within MaxDiff of it, taking up to 16 more readings
+class AveragingTouchFilter : public TouchFilter
+{
+public:
+	const char *GetName() const noexcept override { return "average"; }
+	void Start() noexcept override;
+	TouchFilterResult Add(uint16_t reading) noexcept override;
+
+private:
+	static constexpr size_t NumReadings = 8;
+	static constexpr uint16_t MaxDiff = 40;			// needs to be big enough to handle jitter.
+													// 8 was OK for the 4.3 and 5 inch displays but not the 7 inch.
+													// 25 is OK for most 7" displays.
+	static constexpr unsigned int MaxAttempts = 16;
+
+	uint16_t ring[NumReadings];
+	uint32_t sum;
+	size_t count;
+};
+
+// Median of a fixed number of readings, rejected if the middle half of the readings are spread too widely
+class MedianTouchFilter : public TouchFilter
+{
+public:
+	const char *GetName() const noexcept override { return "median5"; }
+	void Start() noexcept override;
+	TouchFilterResult Add(uint16_t reading) noexcept override;
+
+private:
+	static constexpr size_t NumReadings = 5;
+	static constexpr uint16_t MaxSpread = 40;
+
+	uint16_t readings[NumReadings];
+	size_t count;
+};
+
+// Exponential smoothing, stable when several successive readings are close to the smoothed value
+class IirTouchFilter : public TouchFilter
+{
+public:
+	const char *GetName() const noexcept override { return "iir"; }
+	void Start() noexcept override;
+	TouchFilterResult Add(uint16_t reading) noexcept override;
+
+private:
+	static constexpr unsigned int Shift = 2;			// each reading contributes 1/4 of the new value
+	static constexpr uint16_t MaxDiff = 30;
+	static constexpr unsigned int NeededCloseReadings = 3;
+	static constexpr unsigned int MaxReadings = 16;
+
+	uint32_t smoothed;								// scaled by 2^Shift
+	unsigned int count;
+	unsigned int closeReadings;
+};
+
+// Median of three readings, accepted if they all lie within a threshold that tracks the noise seen in previous touches.
+// If they don't, more readings are taken and the median of the last five is tried, up to a limit.
+class AdaptiveTouchFilter : public TouchFilter
+{
+public:
+	const char *GetName() const noexcept override { return "adaptive"; }
+	void Start() noexcept override;
+	TouchFilterResult Add(uint16_t reading) noexcept override;
+
+private:
+	static constexpr size_t WindowSize = 5;
+	static constexpr size_t MinReadings = 3;
+	static constexpr unsigned int MaxReadings = 12;
+	static constexpr uint16_t MinThreshold = 8;
+	static constexpr uint16_t MaxThreshold = 60;
+
+	bool TryAccept(size_t n) noexcept;
+
+	uint16_t window[WindowSize];
+	unsigned int count;
+	uint32_t noise = 16 << 4;						// running average of the deviation from the median, scaled by 16
+};
+
+// Returns every conversion unchanged. Used to record raw traces for benchmarking the other filters.
+class PassThroughTouchFilter : public TouchFilter
+{
+public:
+	const char *GetName() const noexcept override { return "none"; }
+	void Start() noexcept override { }
+	TouchFilterResult Add(uint16_t reading) noexcept override { result = reading; return TouchFilterResult::stable; }
+};
+
+#endif /* SRC_DRIVERS_TOUCHFILTER_H_ */
@@ -10,6 +10,7 @@
 #include "TouchPanel.h"
 #include <CoreIO.h>
 #include <Pins.h>
+#include "TouchFilter.h"
 
 static DisplayOrientation orientAdjust;
 static uint16_t disp_x_size, disp_y_size;
@@ -17,6 +18,10 @@ static uint16_t scaleX, scaleY;
 static int16_t offsetX, offsetY;
 static bool pressed = false;
 
+static AveragingTouchFilter defaultFilter;
+static TouchFilter * volatile filter = &defaultFilter;
+constexpr unsigned int MaxConversionsPerAxis = 32;			// in case a filter never makes up its mind
+
 constexpr uint32_t writeSetupTimeToLeadingEdge = 100;		// nanoseconds
 constexpr uint32_t readSetupTimeFromTrailingEdge = 200;
 constexpr uint32_t clockPulseWidth = 200;
@@ -70,68 +75,28 @@ static uint16_t ReadData(uint8_t command) noexcept
 	return(data);
 }
 
-static uint16_t diff(uint16_t a, uint16_t b) noexcept { return (a < b) ? b - a : a - b; }
-
 // Get data from the touch chip. CS has already been set low.
 // We need to allow the touch chip ADC input to settle. See TI app note http://www.ti.com/lit/pdf/sbaa036.
-static bool getTouchData(bool wantY, uint16_t &rslt) noexcept
+// The filter decides how many conversions to take and whether the result is good.
+static bool getTouchData(bool wantY, TouchFilter& f, uint16_t &rslt) noexcept
 {
 	const uint8_t command = (wantY) ? 0xD3 : 0x93;	// start, channel 5 (y) or 1 (x), 12-bit, differential mode, don't power down between conversions
 	WriteCommand(command);							// send the command
 	ReadData(command);								// discard the first result and send the same command again
 
-	const size_t numReadings = 8;
-	const uint16_t maxDiff = 40;					// needs to be big enough to handle jitter.
-													// 8 was OK for the 4.3 and 5 inch displays but not the 7 inch.
-													// 25 is OK for most 7" displays.
-	const unsigned int maxAttempts = 16;
-
-	uint16_t ring[numReadings];
-	uint32_t sum = 0;
-
-	// Take enough readings to fill the ring buffer
-	for (size_t i = 0; i < numReadings; ++i)
+	f.Start();
+	TouchFilterResult res;
+	unsigned int conversions = 0;
+	do
 	{
-		const uint16_t val = ReadData(command);
-		ring[i] = val;
-		sum += val;
-	}
-
-	// Test whether every reading is within 'maxDiff' of the average reading.
-	// If it is, return the average reading.
-	// If not, take another reading and try again, up to 'maxAttempts' times.
-	uint16_t avg;
-	size_t last = 0;
-	bool ok;
-	for (unsigned int i = 0; i < maxAttempts; ++i)
-	{
-		avg = (uint16_t)(sum/numReadings);
-		ok = true;
-		for (size_t i = 0; ok && i < numReadings; ++i)
-		{
-			if (diff(avg, ring[i]) > maxDiff)
-			{
-				ok = false;
-				break;
-			}
-		}
-		if (ok)
-		{
-			break;
-		}
-
-		// Take another reading
-		sum -= ring[last];
-		const uint16_t val = ReadData(command);
-		ring[last] = val;
-		sum += val;
-		last = (last + 1) % numReadings;
-	}
+		res = f.Add(ReadData(command));
+		++conversions;
+	} while (res == TouchFilterResult::needMore && conversions < MaxConversionsPerAxis);
 
 	ReadData(command & 0xF8);			// tell it to power down between conversions
 	ReadData(0);						// read the final data
-	rslt = avg;
-	return ok;
+	rslt = f.GetResult();
+	return res == TouchFilterResult::stable;
 }
 
 void TouchPanel::AdjustOrientation(DisplayOrientation a) noexcept
@@ -175,13 +140,14 @@ bool TouchPanel::Read(uint16_t &px, uint16_t &py, bool &repeat, uint16_t * null
 
 	if (!digitalRead(TouchIrqPin))			// if screen is touched
 	{
+		TouchFilter& f = *filter;			// in case another task changes the filter while we are using it
 		fastDigitalWriteLow(TouchCsPin);
 		delayMicroseconds(100);				// allow the screen to settle
 		uint16_t tx;
-		if (getTouchData(false, tx))
+		if (getTouchData(false, f, tx))
 		{
 			uint16_t ty;
-			if (getTouchData(true, ty))
+			if (getTouchData(true, f, ty))
 			{
 				if (!digitalRead(TouchIrqPin))
 				{
@@ -234,4 +200,15 @@ void TouchPanel::Calibrate(uint16_t xlow, uint16_t xhigh, uint16_t ylow, uint16_
 	offsetY = (int16_t)(((uint32_t)ylow * (uint32_t)scaleY) >> 16) - (int16_t)margin;
 }
 
+// Choose the filter used to turn the ADC conversions into a reading
+void TouchPanel::SetFilter(TouchFilter& f) noexcept
+{
+	filter = &f;
+}
+
+TouchFilter& TouchPanel::GetFilter() noexcept
+{
+	return *filter;
+}
+
 // End
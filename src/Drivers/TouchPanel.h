@@ -12,6 +12,8 @@
 #include "DisplayOrientation.h"
 #include <ecv_duet3d.h>
 
+class TouchFilter;
+
 namespace TouchPanel
 {
 	void Init(uint16_t xp, uint16_t yp, DisplayOrientation orientationAdjust = DisplayOrientation::Default) noexcept;
@@ -19,6 +21,8 @@ namespace TouchPanel
 	void Calibrate(uint16_t xlow, uint16_t xhigh, uint16_t ylow, uint16_t yhigh, uint16_t margin) noexcept;
 	void AdjustOrientation(DisplayOrientation a) noexcept;
 	DisplayOrientation GetOrientation() noexcept;
+	void SetFilter(TouchFilter& f) noexcept;
+	TouchFilter& GetFilter() noexcept;
 };
 
 #endif /* SRC_DRIVERS_TOUCHPANEL_H_ */
@@ -0,0 +1,73 @@
+/*
+ * Mailbox.h
+ *
+ *  Created on: 31 Jan 2023
+ *      Author: David
+ *
+ *  Lock-free single-item mailbox holding the latest value published by one writer, for one reader.
+ *  The writer never waits. The reader never waits either: if it catches the writer part way through an update then Read returns false,
+ *  so a reader running at a higher priority than the writer can't spin forever. Like SpscQueue it uses only atomic loads and stores; on the
+ *  RP2040 a relaxed atomic load or store of a word is an ordinary load or store, so copying the value in atomic words costs little more than copying it directly.
+ */
+
+#ifndef SRC_MAILBOX_H_
+#define SRC_MAILBOX_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
+
+template<class T> class Mailbox
+{
+public:
+	static_assert(std::is_trivially_copyable<T>::value, "mailbox items are copied word by word");
+
+	Mailbox() noexcept : sequence(0) { }
+
+	// Replace the value in the mailbox. Call only from the writer.
+	void Publish(const T& item) noexcept
+	{
+		uint32_t buffer[NumWords] = {};
+		memcpy(buffer, &item, sizeof(T));
+		const uint32_t seq = sequence.load(std::memory_order_relaxed);
+		sequence.store(seq + 1, std::memory_order_relaxed);			// odd sequence number means an update is in progress
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < NumWords; ++i)
+		{
+			words[i].store(buffer[i], std::memory_order_relaxed);
+		}
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+	// Copy the latest value to 'item' and return true, or return false if nothing has been published yet or the writer is part way through an update
+	bool Read(T& item) const noexcept
+	{
+		const uint32_t seq = sequence.load(std::memory_order_acquire);
+		if (seq == 0 || (seq & 1) != 0)
+		{
+			return false;
+		}
+		uint32_t buffer[NumWords];
+		for (size_t i = 0; i < NumWords; ++i)
+		{
+			buffer[i] = words[i].load(std::memory_order_relaxed);
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) != seq)
+		{
+			return false;
+		}
+		memcpy(&item, buffer, sizeof(T));
+		return true;
+	}
+
+private:
+	static constexpr size_t NumWords = (sizeof(T) + 3)/4;
+
+	std::atomic<uint32_t> words[NumWords];			// the value, copied in words so that a reader that overlaps an update isn't a data race
+	std::atomic<uint32_t> sequence;
+};
+
+#endif /* SRC_MAILBOX_H_ */
@@ -0,0 +1,395 @@
+/*
+ * MemoryArena.cpp
+ *
+ *  Created on: 18 Feb 2023
+ *      Author: David
+ *
+ *  An allocation is taken from the pool with the smallest blocks that are large enough, or from the next larger pool if that one is full,
+ *  or from the heap if all those are full or the block is larger than the largest pool block. Pool allocation and freeing take constant
+ *  time and pool memory cannot fragment. The heap keeps its free blocks in address order and merges neighbouring free blocks when freeing.
+ *  The total is the same 64K bytes that the LVGL builtin allocator used.
+ */
+
+#include "MemoryArena.h"
+#include <cstring>
+
+using namespace MemoryArena;
+
+struct PoolConfig
+{
+	uint16_t blockSize;
+	uint16_t numBlocks;
+};
+
+// Pool sizes, in increasing block size. Use the 'm' profiler command to see how full each one gets.
+constexpr PoolConfig poolConfigs[NumPools] =
+{
+	{ 16, 256 },			// small style values, timers, label text
+	{ 32, 256 },			// styles, event descriptors
+	{ 64, 128 },			// basic objects, style lists
+	{ 128, 64 },			// labels and other widgets
+	{ 256, 16 },
+};
+
+constexpr size_t HeapSize = 32 * 1024;				// for draw layers and anything else too large for the pools
+constexpr size_t StartupArenaSize = 1024;
+constexpr size_t Alignment = 8;
+
+constexpr size_t TotalPoolBytes() noexcept
+{
+	size_t total = 0;
+	for (const PoolConfig& c : poolConfigs)
+	{
+		total += (size_t)c.blockSize * c.numBlocks;
+	}
+	return total;
+}
+
+constexpr bool PoolsAreValid() noexcept
+{
+	for (size_t i = 0; i < NumPools; ++i)
+	{
+		if (poolConfigs[i].blockSize % Alignment != 0 || poolConfigs[i].blockSize < sizeof(void*) || (i != 0 && poolConfigs[i].blockSize <= poolConfigs[i - 1].blockSize))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static_assert(PoolsAreValid(), "pool block sizes must be multiples of the alignment and in increasing order");
+
+struct FreeBlock
+{
+	FreeBlock *next;
+};
+
+struct Pool
+{
+	uint8_t *end;
+	FreeBlock *freeList;
+	PoolStats stats;
+};
+
+// Header of a heap block. The size includes the header. The next pointer is used only while the block is free.
+struct alignas(Alignment) HeapBlock
+{
+	size_t size;
+	HeapBlock *nextFree;
+};
+
+constexpr size_t HeaderSize = sizeof(HeapBlock);
+constexpr size_t MinSplit = HeaderSize + 4 * Alignment;			// don't leave free blocks smaller than this
+
+alignas(Alignment) static uint8_t poolMemory[TotalPoolBytes()];
+alignas(Alignment) static uint8_t heapMemory[HeapSize];
+alignas(Alignment) static uint8_t startupArena[StartupArenaSize];
+
+static Pool pools[NumPools];
+static HeapBlock *heapFreeList = nullptr;
+static HeapStats heapStats = {};
+static bool initialised = false;
+
+static size_t startupUsed = 0;
+static bool startupFinished = false;
+static uint32_t failures = 0;
+static volatile uint32_t heapCallsAfterBoot = 0;
+
+static void Init() noexcept
+{
+	uint8_t *p = poolMemory;
+	for (size_t i = 0; i < NumPools; ++i)
+	{
+		Pool& pool = pools[i];
+		pool.freeList = nullptr;
+		for (size_t j = poolConfigs[i].numBlocks; j != 0; --j)
+		{
+			FreeBlock *const b = reinterpret_cast<FreeBlock*>(p + (j - 1) * poolConfigs[i].blockSize);
+			b->next = pool.freeList;
+			pool.freeList = b;
+		}
+		p += (size_t)poolConfigs[i].blockSize * poolConfigs[i].numBlocks;
+		pool.end = p;
+		pool.stats = PoolStats{ poolConfigs[i].blockSize, poolConfigs[i].numBlocks, 0, 0, 0, 0 };
+	}
+
+	heapFreeList = reinterpret_cast<HeapBlock*>(heapMemory);
+	heapFreeList->size = HeapSize;
+	heapFreeList->nextFree = nullptr;
+	heapStats.size = HeapSize;
+	initialised = true;
+}
+
+static void *PoolAllocate(Pool& pool) noexcept
+{
+	FreeBlock *const b = pool.freeList;
+	if (b != nullptr)
+	{
+		pool.freeList = b->next;
+		++pool.stats.used;
+		++pool.stats.allocations;
+		if (pool.stats.used > pool.stats.highWater)
+		{
+			pool.stats.highWater = pool.stats.used;
+		}
+	}
+	return b;
+}
+
+static void *HeapAllocate(size_t size) noexcept
+{
+	const size_t needed = (size + HeaderSize + Alignment - 1) & ~(Alignment - 1);
+	HeapBlock **prev = &heapFreeList;
+	for (HeapBlock *b = heapFreeList; b != nullptr; b = b->nextFree)
+	{
+		if (b->size >= needed)
+		{
+			if (b->size - needed >= MinSplit)
+			{
+				HeapBlock *const rest = reinterpret_cast<HeapBlock*>(reinterpret_cast<uint8_t*>(b) + needed);
+				rest->size = b->size - needed;
+				rest->nextFree = b->nextFree;
+				*prev = rest;
+				b->size = needed;
+			}
+			else
+			{
+				*prev = b->nextFree;
+			}
+			heapStats.used += b->size;
+			++heapStats.allocations;
+			if (heapStats.used > heapStats.highWater)
+			{
+				heapStats.highWater = heapStats.used;
+			}
+			return reinterpret_cast<uint8_t*>(b) + HeaderSize;
+		}
+		prev = &b->nextFree;
+	}
+	return nullptr;
+}
+
+// Return a heap block to the free list, merging it with the free blocks either side of it
+static void HeapFree(void *p) noexcept
+{
+	HeapBlock *const b = reinterpret_cast<HeapBlock*>(static_cast<uint8_t*>(p) - HeaderSize);
+	heapStats.used -= b->size;
+
+	HeapBlock *before = nullptr;
+	HeapBlock *after = heapFreeList;
+	while (after != nullptr && after < b)
+	{
+		before = after;
+		after = after->nextFree;
+	}
+
+	b->nextFree = after;
+	if (after != nullptr && reinterpret_cast<uint8_t*>(b) + b->size == reinterpret_cast<uint8_t*>(after))
+	{
+		b->size += after->size;
+		b->nextFree = after->nextFree;
+	}
+
+	if (before == nullptr)
+	{
+		heapFreeList = b;
+	}
+	else if (reinterpret_cast<uint8_t*>(before) + before->size == reinterpret_cast<uint8_t*>(b))
+	{
+		before->size += b->size;
+		before->nextFree = b->nextFree;
+	}
+	else
+	{
+		before->nextFree = b;
+	}
+}
+
+// Return the pool that a block was allocated from, or nullptr if it came from the heap
+static Pool *FindPool(const void *p) noexcept
+{
+	const uint8_t *const bp = static_cast<const uint8_t*>(p);
+	if (bp >= poolMemory && bp < poolMemory + sizeof(poolMemory))
+	{
+		for (Pool& pool : pools)
+		{
+			if (bp < pool.end)
+			{
+				return &pool;
+			}
+		}
+	}
+	return nullptr;
+}
+
+static bool IsInHeap(const void *p) noexcept
+{
+	const uint8_t *const bp = static_cast<const uint8_t*>(p);
+	return bp >= heapMemory + HeaderSize && bp < heapMemory + sizeof(heapMemory);
+}
+
+void *MemoryArena::Allocate(size_t size) noexcept
+{
+	if (!initialised)
+	{
+		Init();
+	}
+
+	size_t first = 0;
+	while (first < NumPools && poolConfigs[first].blockSize < size)
+	{
+		++first;
+	}
+
+	for (size_t i = first; i < NumPools; ++i)
+	{
+		void *const p = PoolAllocate(pools[i]);
+		if (p != nullptr)
+		{
+			if (i != first)
+			{
+				++pools[first].stats.overflows;
+			}
+			return p;
+		}
+	}
+
+	void *const p = HeapAllocate(size);
+	if (p == nullptr)
+	{
+		++failures;
+	}
+	else if (first < NumPools)
+	{
+		++pools[first].stats.overflows;
+	}
+	return p;
+}
+
+void *MemoryArena::Reallocate(void *p, size_t newSize) noexcept
+{
+	if (p == nullptr)
+	{
+		return Allocate(newSize);
+	}
+
+	const Pool *const pool = FindPool(p);
+	const size_t capacity = (pool != nullptr) ? pool->stats.blockSize : reinterpret_cast<HeapBlock*>(static_cast<uint8_t*>(p) - HeaderSize)->size - HeaderSize;
+	if (newSize <= capacity)
+	{
+		return p;
+	}
+
+	void *const newP = Allocate(newSize);
+	if (newP != nullptr)
+	{
+		memcpy(newP, p, capacity);
+		Free(p);
+	}
+	return newP;
+}
+
+void MemoryArena::Free(void *p) noexcept
+{
+	Pool *const pool = FindPool(p);
+	if (pool != nullptr)
+	{
+		FreeBlock *const b = static_cast<FreeBlock*>(p);
+		b->next = pool->freeList;
+		pool->freeList = b;
+		--pool->stats.used;
+	}
+	else if (IsInHeap(p))
+	{
+		HeapFree(p);
+	}
+}
+
+// Allocate memory that will never be freed. This may only be called before EndStartup, and returns nullptr if the arena is full.
+void *MemoryArena::AllocateStartup(size_t size, size_t alignment) noexcept
+{
+	const size_t start = (startupUsed + alignment - 1) & ~(alignment - 1);
+	if (startupFinished || start + size > StartupArenaSize)
+	{
+		++failures;
+		return nullptr;
+	}
+	startupUsed = start + size;
+	return startupArena + start;
+}
+
+// Called when startup is complete. From now on any use of the newlib heap is counted, because it means that something allocates
+// memory at run time that should be using the pools.
+void MemoryArena::EndStartup() noexcept
+{
+	startupFinished = true;
+}
+
+// Called from the newlib heap lock
+void MemoryArena::NoteHeapCall() noexcept
+{
+	if (startupFinished)
+	{
+		heapCallsAfterBoot = heapCallsAfterBoot + 1;
+	}
+}
+
+void MemoryArena::GetPoolStats(size_t pool, PoolStats& stats) noexcept
+{
+	if (!initialised)
+	{
+		Init();
+	}
+	stats = pools[pool].stats;
+}
+
+void MemoryArena::GetHeapStats(HeapStats& stats) noexcept
+{
+	if (!initialised)
+	{
+		Init();
+	}
+
+	uint32_t totalFree = 0, largestFree = 0;
+	uint16_t freeBlocks = 0;
+	for (const HeapBlock *b = heapFreeList; b != nullptr; b = b->nextFree)
+	{
+		totalFree += b->size;
+		if (b->size > largestFree)
+		{
+			largestFree = b->size;
+		}
+		++freeBlocks;
+	}
+
+	stats = heapStats;
+	stats.largestFree = largestFree;
+	stats.freeBlocks = freeBlocks;
+	stats.fragmentation = (totalFree == 0) ? 0 : (uint16_t)(100 - (largestFree * 100)/totalFree);
+}
+
+void MemoryArena::GetStats(Stats& stats) noexcept
+{
+	stats.startupUsed = startupUsed;
+	stats.startupSize = StartupArenaSize;
+	stats.failures = failures;
+	stats.heapCallsAfterBoot = heapCallsAfterBoot;
+}
+
+// Functions called by LVGL through the LV_MALLOC, LV_REALLOC and LV_FREE definitions in lv_conf.h
+extern "C" void *arena_malloc(size_t size) noexcept
+{
+	return Allocate(size);
+}
+
+extern "C" void *arena_realloc(void *p, size_t newSize) noexcept
+{
+	return Reallocate(p, newSize);
+}
+
+extern "C" void arena_free(void *p) noexcept
+{
+	Free(p);
+}
+
+// End
@@ -0,0 +1,65 @@
+/*
+ * MemoryArena.h
+ *
+ *  Created on: 18 Feb 2023
+ *      Author: David
+ *
+ *  Static memory for the whole program, so that nothing uses the newlib heap after boot:
+ *  - Fixed-size block pools in a range of size classes, and a first-fit heap for blocks too large for the pools. LVGL allocates from these
+ *    through the LV_MALLOC, LV_REALLOC and LV_FREE hooks in lv_conf.h. Only the display task may use them.
+ *  - A bump arena for objects that are created during startup and never freed.
+ */
+
+#ifndef SRC_MEMORYARENA_H_
+#define SRC_MEMORYARENA_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace MemoryArena
+{
+	struct PoolStats
+	{
+		uint16_t blockSize;
+		uint16_t numBlocks;
+		uint16_t used;
+		uint16_t highWater;
+		uint32_t allocations;
+		uint32_t overflows;					// allocations of this size class that were satisfied from a larger one or from the heap
+	};
+
+	struct HeapStats
+	{
+		uint32_t size;
+		uint32_t used;						// including block headers
+		uint32_t highWater;
+		uint32_t largestFree;
+		uint16_t freeBlocks;
+		uint16_t fragmentation;				// percentage of the free space that is not in the largest free block
+		uint32_t allocations;
+	};
+
+	struct Stats
+	{
+		uint32_t startupUsed;
+		uint32_t startupSize;
+		uint32_t failures;					// allocations that could not be satisfied
+		uint32_t heapCallsAfterBoot;		// uses of the newlib heap after EndStartup was called
+	};
+
+	constexpr size_t NumPools = 5;
+
+	void *Allocate(size_t size) noexcept;
+	void *Reallocate(void *p, size_t newSize) noexcept;
+	void Free(void *p) noexcept;
+
+	void *AllocateStartup(size_t size, size_t alignment) noexcept;
+	void EndStartup() noexcept;
+	void NoteHeapCall() noexcept;
+
+	void GetPoolStats(size_t pool, PoolStats& stats) noexcept;
+	void GetHeapStats(HeapStats& stats) noexcept;
+	void GetStats(Stats& stats) noexcept;
+}
+
+#endif /* SRC_MEMORYARENA_H_ */
@@ -22,6 +22,7 @@ constexpr Pin DisplayReadPin = GpioPin(9);
 constexpr Pin DisplayWritePin = GpioPin(10);
 constexpr Pin DisplayBacklightPin = GpioPin(14);
 constexpr Pin DisplayLowestDataPin = 0;
+constexpr Pin DisplayTearPin = GpioPin(22);				// tearing effect output of the SSD1963, if it is connected
 
 // Motion sensor interface
 constexpr Pin MotionSensorPin = GpioPin(15);
@@ -43,11 +44,18 @@ constexpr Pin TouchIrqPin = GpioPin(17);
 
 constexpr DmaChannel DmacChanWS2812 = 0;
 constexpr DmaChannel DmacChanAdcRx = 1;
+constexpr DmaChannel DmacChanDisplay = 2;
 
 // DMA priorities, higher is better. RP2040 has only 0 and 1.
 constexpr DmaPriority DmacPrioAdcRx = 1;
+constexpr DmaPriority DmacPrioDisplay = 1;
+
+// PIO blocks
+constexpr unsigned int DisplayPioNumber = 1;				// the PIO used to send pixel data to the display
 
 // NVIC priorities
+constexpr NvicPriority NvicPriorityDisplayPio = 2;			// the display bus finishing a transfer
+constexpr NvicPriority NvicPriorityCore1Fifo = 2;			// core 1 telling core 0 that display flushes have completed
 constexpr NvicPriority NvicPriorityUSB = 3;
 
 #endif /* SRC_PINS_H_ */
@@ -0,0 +1,173 @@
+/*
+ * PowerManager.cpp
+ *
+ *  Created on: 25 Feb 2023
+ *      Author: David
+ *
+ *  Spin must be called at least once a second so that the time without activity doesn't wrap. Activity always returns us to the active state
+ *  at the full brightness at once; only dimming and turning off are faded.
+ */
+
+#include "PowerManager.h"
+#include <Drivers/SSD1963.h>
+#include <hardware/timer.h>
+
+using namespace PowerManager;
+
+static State state = State::active;
+static uint8_t activeLevel = DefaultBacklight;
+static uint8_t level = 0;									// the PWM duty cycle we last sent
+static uint8_t fadeStartLevel = 0;
+static uint8_t fadeTargetLevel = 0;
+static uint32_t fadeStartTime = 0;
+static uint32_t lastSpinTime = 0;
+static uint64_t idleTime = 0;								// microseconds since the last activity
+static bool activity = false;								// there has been activity since Spin was last called
+static bool started = false;
+static Stats stats = {};
+
+static void SetLevel(uint8_t newLevel) noexcept
+{
+	if (newLevel != level)
+	{
+		level = newLevel;
+		SSD1963::SetBacklight(level);
+	}
+}
+
+static void StartFade(uint8_t target, uint32_t now) noexcept
+{
+	fadeStartLevel = level;
+	fadeTargetLevel = target;
+	fadeStartTime = now;
+}
+
+static void EnterState(State newState, uint32_t now) noexcept
+{
+	if (state == State::deepIdle)
+	{
+		SSD1963::SetDisplayOn(true);
+	}
+
+	switch (newState)
+	{
+	case State::active:
+		++stats.wakes;
+		fadeTargetLevel = activeLevel;
+		SetLevel(activeLevel);
+		break;
+
+	case State::dimmed:
+		StartFade(activeLevel/DimmedDivisor, now);
+		break;
+
+	case State::backlightOff:
+		StartFade(0, now);
+		break;
+
+	case State::deepIdle:
+		fadeTargetLevel = 0;
+		SetLevel(0);
+		SSD1963::SetDisplayOn(false);
+		break;
+	}
+	state = newState;
+}
+
+// Take over the backlight at the given brightness. Call this once the first frame has been sent and the backlight turned on.
+void PowerManager::Start(uint8_t p_activeLevel) noexcept
+{
+	activeLevel = level = fadeTargetLevel = p_activeLevel;
+	state = State::active;
+	lastSpinTime = time_us_32();
+	idleTime = 0;
+	started = true;
+}
+
+// Change the brightness used in the active state, and the dimmed brightness with it. If we are active then the new brightness is used at once.
+void PowerManager::SetActiveLevel(uint8_t p_activeLevel) noexcept
+{
+	activeLevel = p_activeLevel;
+	if (started && state == State::active)
+	{
+		fadeTargetLevel = activeLevel;
+		SetLevel(activeLevel);
+	}
+}
+
+// Record motion or a touch. The display is woken by the next call to Spin.
+void PowerManager::NoteActivity() noexcept
+{
+	activity = true;
+}
+
+// Change state and fade the backlight as needed. Returns the number of milliseconds until we next need to be called.
+uint32_t PowerManager::Spin() noexcept
+{
+	if (!started)
+	{
+		return FadeStepMillis;
+	}
+
+	const uint32_t now = time_us_32();
+	const uint32_t elapsed = now - lastSpinTime;
+	lastSpinTime = now;
+	stats.timeInState[(size_t)state] += elapsed;
+	if (activity)
+	{
+		activity = false;
+		idleTime = 0;
+	}
+	else
+	{
+		idleTime += elapsed;
+	}
+
+	const uint32_t idleMillis = (idleTime >= (uint64_t)DeepIdleAfterMillis * 1000) ? DeepIdleAfterMillis : (uint32_t)(idleTime/1000);
+	const State newState = (idleMillis < DimAfterMillis) ? State::active
+							: (idleMillis < BacklightOffAfterMillis) ? State::dimmed
+								: (idleMillis < DeepIdleAfterMillis) ? State::backlightOff
+									: State::deepIdle;
+	if (newState != state)
+	{
+		EnterState(newState, now);
+	}
+
+	if (level != fadeTargetLevel)
+	{
+		const uint32_t fadeMillis = (now - fadeStartTime)/1000;
+		if (fadeMillis >= FadeMillis)
+		{
+			SetLevel(fadeTargetLevel);
+		}
+		else
+		{
+			SetLevel((uint8_t)(fadeStartLevel - (int32_t)((fadeStartLevel - fadeTargetLevel) * fadeMillis)/(int32_t)FadeMillis));
+			return FadeStepMillis;
+		}
+	}
+
+	const uint32_t nextChange = (idleMillis < DimAfterMillis) ? DimAfterMillis
+								: (idleMillis < BacklightOffAfterMillis) ? BacklightOffAfterMillis
+									: (idleMillis < DeepIdleAfterMillis) ? DeepIdleAfterMillis
+										: UINT32_MAX;
+	return (nextChange == UINT32_MAX) ? UINT32_MAX : nextChange - idleMillis;
+}
+
+State PowerManager::GetState() noexcept
+{
+	return state;
+}
+
+// Return true if the backlight has been turned off, so there is no point in rendering anything
+bool PowerManager::IsDark() noexcept
+{
+	return (state == State::backlightOff || state == State::deepIdle) && level == 0;
+}
+
+const Stats& PowerManager::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
@@ -0,0 +1,53 @@
+/*
+ * PowerManager.h
+ *
+ *  Created on: 25 Feb 2023
+ *      Author: David
+ *
+ *  Display power states driven by the motion sensor and the touch panel. After a period without activity the backlight fades to a dim level,
+ *  later it fades out, and later still the panel scan is stopped. While the backlight is out nothing is rendered or flushed, but the telemetry is still applied.
+ *  The display memory keeps the last frame, so when there is activity again the backlight comes straight back on showing it, and the screen is then
+ *  brought up to date as usual.
+ */
+
+#ifndef SRC_POWERMANAGER_H_
+#define SRC_POWERMANAGER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace PowerManager
+{
+	enum class State : uint8_t
+	{
+		active = 0,
+		dimmed,
+		backlightOff,
+		deepIdle,
+	};
+
+	constexpr size_t NumStates = 4;
+
+	constexpr uint32_t DimAfterMillis = 60 * 1000;					// time without activity before we dim the backlight
+	constexpr uint32_t BacklightOffAfterMillis = 5 * 60 * 1000;		// ... before we turn it off
+	constexpr uint32_t DeepIdleAfterMillis = 30 * 60 * 1000;		// ... before we stop the panel scan as well
+	constexpr uint32_t FadeMillis = 1000;							// time taken to dim the backlight or to turn it off
+	constexpr uint32_t FadeStepMillis = 20;							// how often we change the PWM duty cycle while fading
+	constexpr uint8_t DimmedDivisor = 4;							// the dimmed PWM duty cycle is this fraction of the normal one
+
+	struct Stats
+	{
+		uint64_t timeInState[NumStates];							// microseconds spent in each state
+		uint32_t wakes;												// times activity brought the display back from a dimmed or dark state
+	};
+
+	void Start(uint8_t activeLevel) noexcept;
+	void SetActiveLevel(uint8_t activeLevel) noexcept;
+	void NoteActivity() noexcept;
+	uint32_t Spin() noexcept;
+	State GetState() noexcept;
+	bool IsDark() noexcept;
+	const Stats& GetStats() noexcept;
+}
+
+#endif /* SRC_POWERMANAGER_H_ */
@@ -0,0 +1,323 @@
+/*
+ * Profiler.cpp
+ *
+ *  Created on: 28 Jan 2023
+ *      Author: David
+ *
+ *  The frame records can be read over the USB CDC port. Commands are single characters sent in a telemetry command frame (see FrameParser.h).
+ *  Send 'c' to get them as CSV text, or 'b' to get them in binary.
+ *  The binary form is a BinaryHeader followed by the FrameRecord structs, oldest first, all little-endian.
+ *  Send 't' to start or stop recording a raw touch trace. While it is recording the touch filter is bypassed and each touch panel
+ *  sample is sent as a "rawX,rawY" line, one ADC conversion per axis, for replaying through the filters with the touch filter benchmark.
+ *  Send 'm' to get the memory pool and heap statistics as CSV text.
+ */
+
+#include "Profiler.h"
+#include <CoreIO.h>
+#include <RP2040/Devices.h>
+#include <Drivers/SSD1963.h>
+#include <Drivers/PioBus.h>
+#include <Drivers/FrameScheduler.h>
+#include <DisplayWake.h>
+#include <PowerManager.h>
+#include <Drivers/TouchPanel.h>
+#include <Drivers/TouchFilter.h>
+#include <Drivers/TouchAcquisition.h>
+#include <Telemetry/Telemetry.h>
+#include <UI/DataModel.h>
+#include <UI/GlyphCache.h>
+#include <UI/DeferredFill.h>
+#include <MemoryArena.h>
+#include <General/SafeVsnprintf.h>
+#include <hardware/timer.h>
+#include <cinttypes>
+
+using namespace Profiler;
+
+struct BinaryHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	uint32_t numRecords;
+};
+
+constexpr uint32_t BinaryMagic = 0x50534D45;			// "EMSP"
+constexpr uint16_t BinaryVersion = 1;
+
+static FrameRecord frames[NumFrameRecords];
+static size_t nextFrame = 0;
+static size_t numFrames = 0;
+
+static uint32_t handlerStartTime;
+static uint32_t waitTime;
+static uint32_t maxHandlerTime = 0;
+static SSD1963::FlushStats statsAtStart;
+
+static PassThroughTouchFilter traceFilter;
+static TouchFilter *filterBeforeTrace = nullptr;			// non-null while we are recording a touch trace
+static uint32_t lastTraceSampleTime = 0;
+
+static uint32_t touchEvents = 0;
+static uint32_t totalTouchLatency = 0;
+static uint32_t maxTouchLatency = 0;
+
+static uint32_t bootPanelReady = 0, bootPanelCleared = 0, bootScreenBuilt = 0, bootFirstFrame = 0;
+static uint32_t bootBusInterruptTime = 0;
+
+void Profiler::HandlerStarting() noexcept
+{
+	SSD1963::GetFlushStats(statsAtStart);
+	waitTime = 0;
+	handlerStartTime = time_us_32();
+}
+
+void Profiler::HandlerFinished() noexcept
+{
+	const uint32_t handlerTime = time_us_32() - handlerStartTime;
+	if (handlerTime > maxHandlerTime)
+	{
+		maxHandlerTime = handlerTime;
+	}
+
+	SSD1963::FlushStats stats;
+	SSD1963::GetFlushStats(stats);
+	if (stats.flushes != statsAtStart.flushes)
+	{
+		FrameRecord& f = frames[nextFrame];
+		f.startTime = handlerStartTime;
+		f.handlerTime = handlerTime;
+		f.renderTime = (handlerTime > waitTime) ? handlerTime - waitTime : 0;
+		f.flushTime = stats.busyTime - statsAtStart.busyTime;
+		f.pixelsWritten = stats.pixelsSent - statsAtStart.pixelsSent;
+		f.flushes = (uint16_t)(stats.flushes - statsAtStart.flushes);
+		f.setXYCalls = (uint16_t)(stats.setXYCalls - statsAtStart.setXYCalls);
+		nextFrame = (nextFrame + 1) % NumFrameRecords;
+		if (numFrames < NumFrameRecords)
+		{
+			++numFrames;
+		}
+	}
+}
+
+// Called when LVGL has had to wait for a flush to complete before it could continue rendering
+void Profiler::AddWaitTime(uint32_t microseconds) noexcept
+{
+	waitTime += microseconds;
+}
+
+// Record the time from the panel being touched to LVGL receiving the press
+void Profiler::AddTouchLatency(uint32_t microseconds) noexcept
+{
+	++touchEvents;
+	totalTouchLatency += microseconds;
+	if (microseconds > maxTouchLatency)
+	{
+		maxTouchLatency = microseconds;
+	}
+}
+
+// Record when the stages of startup finished, as values of time_us_32(), which counts from shortly after reset, and how much of the time
+// until then core 0 spent in the bus completion interrupt
+void Profiler::SetBootTimes(uint32_t panelReady, uint32_t panelCleared, uint32_t screenBuilt, uint32_t firstFrame) noexcept
+{
+	bootPanelReady = panelReady;
+	bootPanelCleared = panelCleared;
+	bootScreenBuilt = screenBuilt;
+	bootFirstFrame = firstFrame;
+	PioBus::InterruptStats bus;
+	PioBus::GetInterruptStats(bus);
+	bootBusInterruptTime = bus.totalTime;
+}
+
+uint32_t Profiler::GetMaxHandlerTime() noexcept
+{
+	return maxHandlerTime;
+}
+
+// Copy the most recent frame records to the buffer, oldest first, returning the number copied
+size_t Profiler::GetFrames(FrameRecord *buffer, size_t maxFrames) noexcept
+{
+	const size_t count = min<size_t>(maxFrames, numFrames);
+	size_t index = (nextFrame + NumFrameRecords - count) % NumFrameRecords;
+	for (size_t i = 0; i < count; ++i)
+	{
+		buffer[i] = frames[index];
+		index = (index + 1) % NumFrameRecords;
+	}
+	return count;
+}
+
+static void ReportCsv() noexcept
+{
+	char line[140];
+	size_t len = SafeSnprintf(line, sizeof(line), "# max_handler_us=%" PRIu32 ",touches=%" PRIu32 ",touch_latency_avg_us=%" PRIu32 ",touch_latency_max_us=%" PRIu32 "\n",
+								maxHandlerTime, touchEvents, (touchEvents == 0) ? 0 : totalTouchLatency/touchEvents, maxTouchLatency);
+	serialUSB.write((const uint8_t*)line, len);
+	const Telemetry::Stats t = Telemetry::GetStats();
+	len = SafeSnprintf(line, sizeof(line), "# telemetry_updates=%" PRIu32 ",overruns=%" PRIu32 ",max_queued=%" PRIu32 ",latency_avg_us=%" PRIu32 ",latency_max_us=%" PRIu32 "\n",
+						t.updatesApplied, t.overruns, t.maxQueued, (t.updatesApplied == 0) ? 0 : t.totalLatency/t.updatesApplied, t.maxLatency);
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "# settings_stored=%" PRIu32 ",settings_rejected=%" PRIu32 "\n", t.settingsStored, t.settingsRejected);
+	serialUSB.write((const uint8_t*)line, len);
+	const DataModel::Stats& ui = DataModel::GetStats();
+	len = SafeSnprintf(line, sizeof(line), "# labels_updated=%" PRIu32 ",unchanged_texts=%" PRIu32 "\n", ui.labelsUpdated, ui.unchangedTexts);
+	serialUSB.write((const uint8_t*)line, len);
+	const GlyphCache::Stats& gc = GlyphCache::GetStats();
+	len = SafeSnprintf(line, sizeof(line), "# glyph_cache_hits=%" PRIu32 ",misses=%" PRIu32 ",evictions=%" PRIu32 ",bypassed=%" PRIu32 "\n", gc.hits, gc.misses, gc.evictions, gc.bypassed);
+	serialUSB.write((const uint8_t*)line, len);
+	const DeferredFill::Stats& df = DeferredFill::GetStats();
+	SSD1963::FlushStats fs;
+	SSD1963::GetFlushStats(fs);
+	len = SafeSnprintf(line, sizeof(line), "# solid_fills=%" PRIu32 ",pixels_deferred=%" PRIu32 ",pixels_written=%" PRIu32 ",solid_pixels_sent=%" PRIu32 ",solid_fallbacks=%" PRIu32 "\n",
+						df.fills, df.pixelsDeferred, df.pixelsWritten, fs.solidPixels, fs.solidFallbacks);
+	serialUSB.write((const uint8_t*)line, len);
+	PioBus::InterruptStats bus;
+	PioBus::GetInterruptStats(bus);
+	len = SafeSnprintf(line, sizeof(line), "# bus_interrupts=%" PRIu32 ",bus_isr_us=%" PRIu32 ",bus_isr_max_us=%" PRIu32 "\n", bus.interrupts, bus.totalTime, bus.maxTime);
+	serialUSB.write((const uint8_t*)line, len);
+	const FrameScheduler::Stats& sched = FrameScheduler::GetStats();
+	const uint64_t unpacedClocks = (uint64_t)(fs.busyTime - sched.paceWaitTime) * (SystemCoreClockFreq/1000000);
+	len = SafeSnprintf(line, sizeof(line), "# flushes=%" PRIu32 ",flush_busy_us=%" PRIu32 ",bus_clocks=%" PRIu32 ",flush_overhead_clocks=%" PRIu32 "\n",
+						fs.flushes, fs.busyTime, fs.busClocks,
+						(fs.flushes == 0 || unpacedClocks < fs.busClocks) ? 0 : (uint32_t)((unpacedClocks - fs.busClocks)/fs.flushes));
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "# bus_byte_clocks=%" PRIu32 ",recent_flush_overhead_clocks=%" PRIu32 ",flush_queue_full_waits=%" PRIu32 "\n",
+						fs.busByteClocks, fs.flushOverheadClocks, fs.flushQueueFullWaits);
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "# te_edges=%" PRIu32 ",missed_edges=%" PRIu32 ",te_resyncs=%" PRIu32 ",panel_frame_us=%" PRIu32 "\n",
+						sched.tearEdges, sched.missedEdges, sched.resyncs, sched.framePeriod/1000);
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "# paced_flushes=%" PRIu32 ",pace_wait_us=%" PRIu32 ",unsynced_flushes=%" PRIu32 ",unsafe_flushes=%" PRIu32 "\n",
+						sched.pacedFlushes, sched.paceWaitTime, sched.unsyncedFlushes, sched.unsafeFlushes);
+	serialUSB.write((const uint8_t*)line, len);
+	const DisplayWake::Stats& wake = DisplayWake::GetStats();
+	len = SafeSnprintf(line, sizeof(line), "# frames=%" PRIu32 ",late_frames=%" PRIu32 ",dropped_frames=%" PRIu32 ",refresh_period_ms=%" PRIu32 ",flush_wait_ms=%" PRIu32 "\n",
+						sched.frames, sched.lateFrames, sched.droppedFrames, sched.refreshPeriod, (uint32_t)(wake.flushWaitTime/1000));
+	serialUSB.write((const uint8_t*)line, len);
+	const uint64_t loopTime = wake.blockedTime + wake.awakeTime;
+	len = SafeSnprintf(line, sizeof(line), "# idle_pct=%" PRIu32 ",wakeups=%" PRIu32 ",timer_wakeups=%" PRIu32 ",data_wakeups=%" PRIu32 ",touch_wakeups=%" PRIu32 ",motion_wakeups=%" PRIu32 "\n",
+						(loopTime == 0) ? 0 : (uint32_t)((wake.blockedTime * 100)/loopTime), wake.wakeups, wake.timerWakeups, wake.dataWakeups, wake.touchWakeups, wake.motionWakeups);
+	serialUSB.write((const uint8_t*)line, len);
+	const PowerManager::Stats& power = PowerManager::GetStats();
+	len = SafeSnprintf(line, sizeof(line), "# power_active_ms=%" PRIu32 ",dimmed_ms=%" PRIu32 ",backlight_off_ms=%" PRIu32 ",deep_idle_ms=%" PRIu32 ",wakes=%" PRIu32 "\n",
+						(uint32_t)(power.timeInState[(size_t)PowerManager::State::active]/1000), (uint32_t)(power.timeInState[(size_t)PowerManager::State::dimmed]/1000),
+						(uint32_t)(power.timeInState[(size_t)PowerManager::State::backlightOff]/1000), (uint32_t)(power.timeInState[(size_t)PowerManager::State::deepIdle]/1000),
+						power.wakes);
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "# boot_panel_ready_us=%" PRIu32 ",panel_cleared_us=%" PRIu32 ",screen_built_us=%" PRIu32 ",first_frame_us=%" PRIu32 ",boot_bus_isr_us=%" PRIu32 "\n",
+						bootPanelReady, bootPanelCleared, bootScreenBuilt, bootFirstFrame, bootBusInterruptTime);
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "start_us,handler_us,render_us,flush_us,pixels,flushes,setxy\n");
+	serialUSB.write((const uint8_t*)line, len);
+
+	size_t index = (nextFrame + NumFrameRecords - numFrames) % NumFrameRecords;
+	for (size_t i = 0; i < numFrames; ++i)
+	{
+		const FrameRecord& f = frames[index];
+		const size_t n = SafeSnprintf(line, sizeof(line), "%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%u,%u\n",
+										f.startTime, f.handlerTime, f.renderTime, f.flushTime, f.pixelsWritten, f.flushes, f.setXYCalls);
+		serialUSB.write((const uint8_t*)line, n);
+		index = (index + 1) % NumFrameRecords;
+	}
+}
+
+static void ReportBinary() noexcept
+{
+	const BinaryHeader header = { BinaryMagic, BinaryVersion, sizeof(FrameRecord), (uint32_t)numFrames };
+	serialUSB.write((const uint8_t*)&header, sizeof(header));
+
+	size_t index = (nextFrame + NumFrameRecords - numFrames) % NumFrameRecords;
+	for (size_t i = 0; i < numFrames; ++i)
+	{
+		serialUSB.write((const uint8_t*)&frames[index], sizeof(FrameRecord));
+		index = (index + 1) % NumFrameRecords;
+	}
+}
+
+static void ReportMemory() noexcept
+{
+	char line[140];
+	MemoryArena::Stats m;
+	MemoryArena::GetStats(m);
+	size_t len = SafeSnprintf(line, sizeof(line), "# startup_used=%" PRIu32 ",startup_size=%" PRIu32 ",failures=%" PRIu32 ",heap_calls_after_boot=%" PRIu32 "\n",
+								m.startupUsed, m.startupSize, m.failures, m.heapCallsAfterBoot);
+	serialUSB.write((const uint8_t*)line, len);
+	MemoryArena::HeapStats h;
+	MemoryArena::GetHeapStats(h);
+	len = SafeSnprintf(line, sizeof(line), "# heap_size=%" PRIu32 ",used=%" PRIu32 ",high_water=%" PRIu32 ",largest_free=%" PRIu32 ",free_blocks=%u,fragmentation_pct=%u,allocations=%" PRIu32 "\n",
+						h.size, h.used, h.highWater, h.largestFree, h.freeBlocks, h.fragmentation, h.allocations);
+	serialUSB.write((const uint8_t*)line, len);
+	len = SafeSnprintf(line, sizeof(line), "block_size,blocks,used,high_water,allocations,overflows\n");
+	serialUSB.write((const uint8_t*)line, len);
+	for (size_t i = 0; i < MemoryArena::NumPools; ++i)
+	{
+		MemoryArena::PoolStats p;
+		MemoryArena::GetPoolStats(i, p);
+		len = SafeSnprintf(line, sizeof(line), "%u,%u,%u,%u,%" PRIu32 ",%" PRIu32 "\n", p.blockSize, p.numBlocks, p.used, p.highWater, p.allocations, p.overflows);
+		serialUSB.write((const uint8_t*)line, len);
+	}
+}
+
+static void StartOrStopTrace() noexcept
+{
+	if (filterBeforeTrace == nullptr)
+	{
+		filterBeforeTrace = &TouchPanel::GetFilter();
+		TouchPanel::SetFilter(traceFilter);
+	}
+	else
+	{
+		TouchPanel::SetFilter(*filterBeforeTrace);
+		filterBeforeTrace = nullptr;
+	}
+}
+
+static void ReportTraceSample() noexcept
+{
+	TouchSample sample;
+	if (TouchAcquisition::GetLatest(sample) && sample.pressed && sample.sampleTime != lastTraceSampleTime)
+	{
+		lastTraceSampleTime = sample.sampleTime;
+		char line[20];
+		const size_t len = SafeSnprintf(line, sizeof(line), "%u,%u\n", sample.rawX, sample.rawY);
+		serialUSB.write((const uint8_t*)line, len);
+	}
+}
+
+// Handle a command character received from the USB port in a telemetry command frame
+void Profiler::Command(uint8_t c) noexcept
+{
+	switch (c)
+	{
+	case 'c':
+		ReportCsv();
+		break;
+
+	case 'b':
+		ReportBinary();
+		break;
+
+	case 't':
+		StartOrStopTrace();
+		break;
+
+	case 'm':
+		ReportMemory();
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Send the next line of the touch trace if we are recording one
+void Profiler::Spin() noexcept
+{
+	if (filterBeforeTrace != nullptr && serialUSB.IsConnected())
+	{
+		ReportTraceSample();
+	}
+}
+
+// End
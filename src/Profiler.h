@@ -0,0 +1,44 @@
+/*
+ * Profiler.h
+ *
+ *  Created on: 28 Jan 2023
+ *      Author: David
+ *
+ *  Per-frame performance counters for the display pipeline, kept in a ring buffer and reported over USB, and touch latency statistics
+ */
+
+#ifndef SRC_PROFILER_H_
+#define SRC_PROFILER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Profiler
+{
+	// Record of one call to lv_timer_handler that caused something to be drawn. Times are in microseconds.
+	struct FrameRecord
+	{
+		uint32_t startTime;					// value of time_us_32() when lv_timer_handler was called
+		uint32_t handlerTime;				// time spent in lv_timer_handler
+		uint32_t renderTime;				// part of handlerTime not spent waiting for flushes to complete
+		uint32_t flushTime;					// time from starting each flush to it completing, summed over the frame
+		uint32_t pixelsWritten;
+		uint16_t flushes;
+		uint16_t setXYCalls;
+	};
+
+	constexpr size_t NumFrameRecords = 128;
+
+	void HandlerStarting() noexcept;
+	void HandlerFinished() noexcept;
+	void AddWaitTime(uint32_t microseconds) noexcept;
+	void AddTouchLatency(uint32_t microseconds) noexcept;
+	void SetBootTimes(uint32_t panelReady, uint32_t panelCleared, uint32_t screenBuilt, uint32_t firstFrame) noexcept;
+	uint32_t GetMaxHandlerTime() noexcept;
+	size_t GetFrames(FrameRecord *buffer, size_t maxFrames) noexcept;
+
+	void Command(uint8_t c) noexcept;
+	void Spin() noexcept;
+}
+
+#endif /* SRC_PROFILER_H_ */
@@ -0,0 +1,69 @@
+/*
+ * SettingsFlash.cpp
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  While the flash is being erased or programmed it can't be read, so nothing may execute from it.
+ *  We pause the display flush worker on core 1 and disable interrupts on this core for the duration.
+ *  A sector erase typically takes 45ms, so the settings store should only write when a setting changes.
+ */
+
+#include <Core.h>
+#include <SettingsFlash.h>
+#include <Drivers/SSD1963.h>
+#include <hardware/flash.h>
+#include <hardware/sync.h>
+#include <hardware/regs/addressmap.h>
+#include <cstring>
+
+using namespace SettingsFlash;
+
+extern "C" uint8_t __settings_start__[];			// defined in the linker script
+
+static_assert(SectorSize == FLASH_SECTOR_SIZE);
+
+static uint32_t FlashOffset(unsigned int sector) noexcept
+{
+	return (uint32_t)(reinterpret_cast<uintptr_t>(__settings_start__) - XIP_BASE) + sector * SectorSize;
+}
+
+const uint8_t *SettingsFlash::GetSector(unsigned int sector) noexcept
+{
+	return __settings_start__ + sector * SectorSize;
+}
+
+void SettingsFlash::EraseSector(unsigned int sector) noexcept
+{
+	SSD1963::PauseFlushWorker();
+	const uint32_t flags = save_and_disable_interrupts();
+	flash_range_erase(FlashOffset(sector), SectorSize);
+	restore_interrupts(flags);
+	SSD1963::ResumeFlushWorker();
+}
+
+// Program some bytes within a sector. The flash can only be programmed in whole pages, so we fill the rest of each page with 0xFF, which leaves those bytes unchanged.
+void SettingsFlash::Program(unsigned int sector, size_t offset, const uint8_t *data, size_t length) noexcept
+{
+	uint8_t page[FLASH_PAGE_SIZE];
+	while (length != 0)
+	{
+		const size_t pageStart = offset & ~(FLASH_PAGE_SIZE - 1);
+		const size_t offsetInPage = offset - pageStart;
+		const size_t chunk = min<size_t>(length, FLASH_PAGE_SIZE - offsetInPage);
+		memset(page, 0xFF, sizeof(page));
+		memcpy(page + offsetInPage, data, chunk);
+
+		SSD1963::PauseFlushWorker();
+		const uint32_t flags = save_and_disable_interrupts();
+		flash_range_program(FlashOffset(sector) + pageStart, page, FLASH_PAGE_SIZE);
+		restore_interrupts(flags);
+		SSD1963::ResumeFlushWorker();
+
+		offset += chunk;
+		data += chunk;
+		length -= chunk;
+	}
+}
+
+// End
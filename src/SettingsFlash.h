@@ -0,0 +1,27 @@
+/*
+ * SettingsFlash.h
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  Access to the flash sectors reserved for the settings store at the end of the 2MB flash (see rp2040_flash.ld).
+ *  Programming behaves like NOR flash: it can only change bits from 1 to 0, and erasing a sector sets every byte to 0xFF.
+ */
+
+#ifndef SRC_SETTINGSFLASH_H_
+#define SRC_SETTINGSFLASH_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace SettingsFlash
+{
+	constexpr size_t SectorSize = 4096;
+	constexpr unsigned int NumSectors = 4;
+
+	const uint8_t *GetSector(unsigned int sector) noexcept;
+	void EraseSector(unsigned int sector) noexcept;
+	void Program(unsigned int sector, size_t offset, const uint8_t *data, size_t length) noexcept;
+}
+
+#endif /* SRC_SETTINGSFLASH_H_ */
@@ -0,0 +1,244 @@
+/*
+ * SettingsStore.cpp
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  Sector layout: a SectorHeader, then records packed one after another, each a RecordHeader followed by the value padded to a multiple of 4 bytes.
+ *  The first record whose key byte is 0xFF marks the end of the log.
+ *
+ *  Power loss:
+ *  - A record interrupted while being programmed fails its CRC check and is skipped. If its length is corrupt we stop reading the sector
+ *    at that point and treat it as full, so the next write moves everything to a new sector.
+ *  - When moving to a new sector the header is programmed last, so a sector whose move was interrupted has no valid header and is ignored.
+ *    Of the sectors with valid headers, the one with the highest sequence number is the active one.
+ */
+
+#include "SettingsStore.h"
+#include "SettingsFlash.h"
+#include "Crc16.h"
+#include <cstring>
+
+using namespace SettingsStore;
+using SettingsFlash::SectorSize;
+using SettingsFlash::NumSectors;
+
+constexpr uint32_t SectorMagic = 0x53534D45;			// "EMSS"
+constexpr uint8_t ErasedKey = 0xFF;
+
+struct SectorHeader
+{
+	uint32_t magic;
+	uint32_t sequence;
+	uint16_t crc;
+	uint16_t reserved;
+};
+
+struct RecordHeader
+{
+	uint8_t key;
+	uint8_t length;
+	uint16_t crc;
+};
+
+static_assert(sizeof(SectorHeader) % 4 == 0 && sizeof(RecordHeader) == 4);
+static_assert(NumKeys * (sizeof(RecordHeader) + MaxValueLength) + sizeof(SectorHeader) <= SectorSize, "all the settings must fit in one sector");
+
+static uint8_t values[NumKeys][MaxValueLength];
+static uint8_t lengths[NumKeys];						// 0 means that there is no value for that key
+static unsigned int activeSector;
+static uint32_t activeSequence;
+static size_t writeOffset;
+
+static uint16_t RecordCrc(uint8_t key, uint8_t length, const uint8_t *data) noexcept
+{
+	const uint8_t header[2] = { key, length };
+	return Crc16(data, length, Crc16(header, sizeof(header)));
+}
+
+static size_t RecordSize(size_t length) noexcept
+{
+	return sizeof(RecordHeader) + ((length + 3) & ~3u);
+}
+
+static bool IsValidHeader(const SectorHeader& hdr) noexcept
+{
+	return hdr.magic == SectorMagic && hdr.crc == Crc16(reinterpret_cast<const uint8_t*>(&hdr), offsetof(SectorHeader, crc));
+}
+
+// Append a record to a sector, returning true if it reads back correctly
+static bool ProgramRecord(unsigned int sector, size_t offset, unsigned int key, const uint8_t *data, size_t length) noexcept
+{
+	uint8_t buffer[sizeof(RecordHeader) + MaxValueLength];
+	const size_t size = RecordSize(length);
+	memset(buffer, 0xFF, size);
+	const RecordHeader hdr = { (uint8_t)key, (uint8_t)length, RecordCrc((uint8_t)key, (uint8_t)length, data) };
+	memcpy(buffer, &hdr, sizeof(hdr));
+	memcpy(buffer + sizeof(hdr), data, length);
+	SettingsFlash::Program(sector, offset, buffer, size);
+	return memcmp(SettingsFlash::GetSector(sector) + offset, buffer, size) == 0;
+}
+
+// Read the records in the active sector into the cache and find where the next record goes
+static void LoadActiveSector() noexcept
+{
+	const uint8_t * const base = SettingsFlash::GetSector(activeSector);
+	size_t offset = sizeof(SectorHeader);
+	while (offset + sizeof(RecordHeader) <= SectorSize)
+	{
+		RecordHeader hdr;
+		memcpy(&hdr, base + offset, sizeof(hdr));
+		if (hdr.key == ErasedKey)
+		{
+			break;
+		}
+		if (hdr.length == 0 || hdr.length > MaxValueLength || offset + RecordSize(hdr.length) > SectorSize)
+		{
+			offset = SectorSize;					// corrupt length, so we can't find the next record
+			break;
+		}
+		const uint8_t * const data = base + offset + sizeof(RecordHeader);
+		if (hdr.key < NumKeys && hdr.crc == RecordCrc(hdr.key, hdr.length, data))
+		{
+			memcpy(values[hdr.key], data, hdr.length);
+			lengths[hdr.key] = hdr.length;
+		}
+		offset += RecordSize(hdr.length);
+	}
+	writeOffset = offset;
+}
+
+// Copy the latest value of every key to the next sector and make that the active one.
+// If a sector is bad then we try the next one, but if they are all bad we give up and stay with the current one.
+static bool MoveToNextSector() noexcept
+{
+	for (unsigned int attempt = 1; attempt < NumSectors; ++attempt)
+	{
+		const unsigned int sector = (activeSector + attempt) % NumSectors;
+		SettingsFlash::EraseSector(sector);
+		size_t offset = sizeof(SectorHeader);
+		bool ok = true;
+		for (unsigned int key = 0; ok && key < NumKeys; ++key)
+		{
+			if (lengths[key] != 0)
+			{
+				ok = ProgramRecord(sector, offset, key, values[key], lengths[key]);
+				offset += RecordSize(lengths[key]);
+			}
+		}
+
+		if (ok)
+		{
+			SectorHeader hdr = { SectorMagic, activeSequence + 1, 0, 0xFFFF };
+			hdr.crc = Crc16(reinterpret_cast<const uint8_t*>(&hdr), offsetof(SectorHeader, crc));
+			SettingsFlash::Program(sector, 0, reinterpret_cast<const uint8_t*>(&hdr), sizeof(hdr));
+			if (memcmp(SettingsFlash::GetSector(sector), &hdr, sizeof(hdr)) == 0)
+			{
+				activeSector = sector;
+				activeSequence = hdr.sequence;
+				writeOffset = offset;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Find the active sector and load the settings from it. If no sector has a valid header then the store is empty.
+void SettingsStore::Init() noexcept
+{
+	memset(lengths, 0, sizeof(lengths));
+	bool found = false;
+	for (unsigned int sector = 0; sector < NumSectors; ++sector)
+	{
+		SectorHeader hdr;
+		memcpy(&hdr, SettingsFlash::GetSector(sector), sizeof(hdr));
+		if (IsValidHeader(hdr) && (!found || (int32_t)(hdr.sequence - activeSequence) > 0))
+		{
+			activeSector = sector;
+			activeSequence = hdr.sequence;
+			found = true;
+		}
+	}
+
+	if (found)
+	{
+		LoadActiveSector();
+	}
+	else
+	{
+		// Set up an empty store. We start with the last sector so that moving to the next one erases sector 0 first.
+		activeSector = NumSectors - 1;
+		activeSequence = 0;
+		(void)MoveToNextSector();
+	}
+}
+
+bool SettingsStore::Read(Key key, void *data, size_t length) noexcept
+{
+	const unsigned int k = (unsigned int)key;
+	if (k >= NumKeys || lengths[k] != length)
+	{
+		return false;
+	}
+	memcpy(data, values[k], length);
+	return true;
+}
+
+// Store a value. Writing the value that is already stored does nothing, so callers don't need to check whether a setting has changed.
+bool SettingsStore::Write(Key key, const void *data, size_t length) noexcept
+{
+	const unsigned int k = (unsigned int)key;
+	if (k >= NumKeys || length == 0 || length > MaxValueLength)
+	{
+		return false;
+	}
+	if (lengths[k] == length && memcmp(values[k], data, length) == 0)
+	{
+		return true;
+	}
+
+	memcpy(values[k], data, length);
+	lengths[k] = (uint8_t)length;
+	if (writeOffset + RecordSize(length) <= SectorSize && ProgramRecord(activeSector, writeOffset, k, values[k], length))
+	{
+		writeOffset += RecordSize(length);
+		return true;
+	}
+	return MoveToNextSector();
+}
+
+// Return the size of the value that the firmware reads for a key, or 0 if the key isn't used
+size_t SettingsStore::GetValueLength(Key key) noexcept
+{
+	switch (key)
+	{
+	case Key::touchCalibration:		return sizeof(TouchCalibration);
+	case Key::displayOrientation:	return sizeof(uint8_t);
+	case Key::backlightLevel:		return sizeof(uint8_t);
+	case Key::buzzerVolume:			return sizeof(uint8_t);
+	default:						return 0;
+	}
+}
+
+// Decode the payload of a settings frame, which is a key byte followed by the value. Returns false if the key isn't one that the firmware uses
+// or the value is the wrong size for it, so that a stray frame can't store a value that would never be read.
+bool SettingsStore::DecodeUpdate(const uint8_t *payload, size_t length, Update& update) noexcept
+{
+	if (length < 2)
+	{
+		return false;
+	}
+	const Key key = (Key)payload[0];
+	const size_t valueLength = length - 1;
+	if (GetValueLength(key) != valueLength)
+	{
+		return false;
+	}
+	update.key = key;
+	update.length = (uint8_t)valueLength;
+	memcpy(update.value, payload + 1, valueLength);
+	return true;
+}
+
+// End
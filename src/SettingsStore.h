@@ -0,0 +1,57 @@
+/*
+ * SettingsStore.h
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  Small log-structured key/value store for settings that must survive a power cycle, kept in the flash sectors provided by SettingsFlash.
+ *  One sector is active at a time. Each write appends a CRC-checked record to it; when it is full the latest value of every key is copied
+ *  to the next sector in turn, so erases are spread over all the sectors. At startup only the sector headers and the active sector are read.
+ *  The values are cached in RAM, so reading a setting doesn't touch the flash.
+ */
+
+#ifndef SRC_SETTINGSSTORE_H_
+#define SRC_SETTINGSSTORE_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace SettingsStore
+{
+	// Keys must be less than NumKeys. Never reuse the number of a key that has been removed.
+	enum class Key : uint8_t
+	{
+		touchCalibration = 1,
+		displayOrientation = 2,
+		backlightLevel = 3,
+		buzzerVolume = 4,
+	};
+
+	constexpr unsigned int NumKeys = 16;
+	constexpr size_t MaxValueLength = 32;
+
+	struct TouchCalibration
+	{
+		uint16_t xLow, xHigh, yLow, yHigh, margin;
+	};
+
+	// A new value for a setting, received in a settings frame over USB (see FrameParser.h) for the display task to store and apply
+	struct Update
+	{
+		Key key;
+		uint8_t length;
+		uint8_t value[MaxValueLength];
+	};
+
+	void Init() noexcept;
+	bool Read(Key key, void *data, size_t length) noexcept;
+	bool Write(Key key, const void *data, size_t length) noexcept;
+	size_t GetValueLength(Key key) noexcept;
+	bool DecodeUpdate(const uint8_t *payload, size_t length, Update& update) noexcept;
+
+	// Read a value, returning false and leaving 'value' unchanged if there is no stored value of the right size
+	template<class T> bool Read(Key key, T& value) noexcept { return Read(key, &value, sizeof(T)); }
+	template<class T> bool Write(Key key, const T& value) noexcept { return Write(key, &value, sizeof(T)); }
+}
+
+#endif /* SRC_SETTINGSSTORE_H_ */
@@ -0,0 +1,293 @@
+/*
+ * BandBench.cpp
+ *
+ *  Created on: 18 Mar 2023
+ *      Author: David
+ *
+ *  Host benchmark that replays a trace of invalidated areas for several draw buffer sizes, to choose DISPLAY_BUFFER_LINES and DISPLAY_DOUBLE_BUFFERED.
+ *  Each area is split into parts as LVGL 8.3 does, with as many rows as fit in the buffer at the width of the area. Each part is flushed through
+ *  the SSD1963 driver to the virtual SSD1963, which counts the PIO clocks and the commands and parameters sent by the CPU. Rendering isn't
+ *  simulated: each part costs a fixed number of clocks, for LVGL to walk the objects and set up the drawing, plus a number of clocks per pixel.
+ *  Measure both with the profiler and pass them in, because they depend on the screen being drawn. The CPU's part of each flush is charged as
+ *  the driver measures it on the display, which the profiler reports as bus_byte_clocks and recent_flush_overhead_clocks; pass those in too if they
+ *  differ from the defaults. With two buffers the next part is rendered while the last one is flushed; with one, rendering waits for the flush.
+ *  Pacing to the panel scan isn't included.
+ *
+ *  The trace has one line per frame: the time in milliseconds followed by the areas as x1,y1,x2,y2 separated by spaces, which is what the
+ *  simulator writes when it is given a trace file. Without a trace file, or given -, ten minutes of the grid screen is made up: the power
+ *  values change each second and the energy values every ten seconds, the chart adds a column every two seconds, a tile is pressed and
+ *  released every thirty seconds and the whole screen is redrawn every two minutes.
+ *
+ *  Usage: band-bench [trace-file|- [render-clocks-per-part [render-clocks-per-pixel [bus-byte-clocks [flush-overhead-clocks]]]]]
+ */
+
+#include <Drivers/SSD1963.h>
+#include "../VirtualSSD1963.h"
+#include <CoreIO.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+constexpr unsigned int Width = SSD1963_HOR_RES;
+constexpr unsigned int Height = SSD1963_VER_RES;
+constexpr unsigned int MaxBufferLines = 96;
+
+
+static const unsigned int bufferLines[] = { 8, 12, 16, 24, 32, 48, 96 };
+
+typedef std::vector<lv_area_t> Frame;
+
+static uint16_t reference[Height][Width];
+static lv_color_t flushBuffer[Width * MaxBufferLines];
+static lv_disp_draw_buf_t drawBuf;
+static lv_disp_drv_t driver;
+static std::mt19937 rng(1);
+static uint32_t renderClocksPerPart = 25000;
+static uint32_t renderClocksPerPixel = 20;
+static uint32_t clocksPerBusByte = 20;					// costs of the CPU's part of a flush, with the defaults used by SSD1963.cpp
+static uint32_t clocksPerFlushOverhead = 800;
+
+// Fill the reference with short runs, like text, between long runs, like backgrounds, so that the driver's run encoding is used as it would be
+static void MakeReference() noexcept
+{
+	for (auto& row : reference)
+	{
+		for (unsigned int x = 0; x < Width; )
+		{
+			const bool text = rng() % 4 == 0;
+			const uint16_t colour = (uint16_t)rng();
+			unsigned int length = (text) ? 1 + rng() % 3 : 1 + rng() % 60;
+			while (length-- != 0 && x < Width)
+			{
+				row[x++] = colour;
+			}
+		}
+	}
+}
+
+static lv_area_t MakeArea(int x1, int y1, int x2, int y2) noexcept
+{
+	const lv_area_t a = { (lv_coord_t)x1, (lv_coord_t)y1, (lv_coord_t)x2, (lv_coord_t)y2 };
+	return a;
+}
+
+// Make up a trace of the grid screen, using the layout in Display.cpp
+static void MakeTrace(std::vector<Frame>& frames) noexcept
+{
+	constexpr int TileWidth = Width/3 - 21, TileHeight = Height/4 - 14, ChartHeight = Height/2 - 38, Gap = 10;
+	constexpr int X0 = (Width - (3 * TileWidth + 2 * Gap))/2, Y0 = (Height - (2 * TileHeight + ChartHeight + 2 * Gap))/2;
+	constexpr int ValueWidth = 96, ValueHeight = 22;			// the value labels at their longest
+	constexpr int ShadowWidth = 3;
+	constexpr int ChartPadding = 15, ChartColumns = 3 * TileWidth + 2 * Gap - 2 * ChartPadding, ChartRows = ChartHeight - 2 * ChartPadding;
+	constexpr int GapColumns = 8;
+	constexpr int ChartX = X0 + ChartPadding, ChartY = Y0 + 2 * (TileHeight + Gap) + ChartPadding;
+
+	int cursor = 0;
+	for (unsigned int second = 0; second < 600; ++second)
+	{
+		Frame f;
+		if (second % 120 == 0)
+		{
+			f.push_back(MakeArea(0, 0, Width - 1, Height - 1));
+			frames.push_back(f);
+			continue;
+		}
+		for (int tile = 0; tile < 6; ++tile)
+		{
+			if (tile < 4 || second % 10 == 0)
+			{
+				const int cx = X0 + (tile % 3) * (TileWidth + Gap) + TileWidth/2, cy = Y0 + (tile / 3) * (TileHeight + Gap) + TileHeight/2;
+				f.push_back(MakeArea(cx - ValueWidth/2, cy - ValueHeight/2, cx + ValueWidth/2 - 1, cy + ValueHeight/2 - 1));
+			}
+		}
+		if (second % 2 == 0)
+		{
+			const int gapEdge = (cursor + GapColumns) % ChartColumns;
+			f.push_back(MakeArea(ChartX + cursor, ChartY, ChartX + cursor, ChartY + ChartRows - 1));
+			f.push_back(MakeArea(ChartX + gapEdge, ChartY, ChartX + gapEdge + ((gapEdge + 1 < ChartColumns) ? 1 : 0), ChartY + ChartRows - 1));
+			cursor = (cursor + 1) % ChartColumns;
+		}
+		frames.push_back(f);
+		if (second % 30 == 15)
+		{
+			// Press a tile and then release it, which redraws the whole tile with its shadow each time
+			const int tile = (second / 30) % 6;
+			const int x1 = X0 + (tile % 3) * (TileWidth + Gap), y1 = Y0 + (tile / 3) * (TileHeight + Gap);
+			const Frame press(1, MakeArea(x1 - ShadowWidth, y1 - ShadowWidth, x1 + TileWidth - 1 + ShadowWidth, y1 + TileHeight - 1 + ShadowWidth + 2));
+			frames.push_back(press);
+			frames.push_back(press);
+		}
+	}
+}
+
+// Read a trace written by the simulator, returning false if the file can't be read or has no frames
+static bool ReadTrace(const char *fileName, std::vector<Frame>& frames) noexcept
+{
+	FILE * const f = fopen(fileName, "r");
+	if (f == nullptr)
+	{
+		return false;
+	}
+	char line[4096];
+	while (fgets(line, sizeof(line), f) != nullptr)
+	{
+		Frame frame;
+		char *p = line;
+		(void)strtoul(p, &p, 10);				// the time
+		int x1, y1, x2, y2, n;
+		while (sscanf(p, " %d,%d,%d,%d%n", &x1, &y1, &x2, &y2, &n) == 4)
+		{
+			p += n;
+			if (x1 <= x2 && y1 <= y2)
+			{
+				frame.push_back(MakeArea(x1, y1, x2, y2));
+			}
+		}
+		if (!frame.empty())
+		{
+			frames.push_back(frame);
+		}
+	}
+	fclose(f);
+	return !frames.empty();
+}
+
+// Flush one part from the reference through the driver and return the clocks it took
+static uint64_t FlushPart(const lv_area_t& area) noexcept
+{
+	const unsigned int w = (unsigned int)lv_area_get_width(&area);
+	for (lv_coord_t row = area.y1; row <= area.y2; ++row)
+	{
+		for (lv_coord_t x = area.x1; x <= area.x2; ++x)
+		{
+			flushBuffer[(unsigned int)(row - area.y1) * w + (unsigned int)(x - area.x1)].full = reference[row][x];
+		}
+	}
+	const VirtualSSD1963::BusCounters before = VirtualSSD1963::GetTotalCounters();
+	drawBuf.flushing = 1;
+	SSD1963::Flush(&driver, &area, flushBuffer);
+	while (drawBuf.flushing) { }
+	const VirtualSSD1963::BusCounters& after = VirtualSSD1963::GetTotalCounters();
+	return (after.pioClocks - before.pioClocks)
+			+ (after.commands - before.commands + after.parameters - before.parameters) * clocksPerBusByte
+			+ clocksPerFlushOverhead;
+}
+
+struct Result
+{
+	uint64_t totalClocks;
+	uint64_t maxFrameClocks;
+	uint64_t parts;
+};
+
+// Replay the frames with the given buffer, returning the total time and the longest frame in clocks
+static Result Replay(const std::vector<Frame>& frames, unsigned int lines, bool doubleBuffered) noexcept
+{
+	const uint32_t bufferPixels = Width * lines;
+	Result r = {};
+	for (const Frame& frame : frames)
+	{
+		// Times are in clocks from the start of the frame. The frame ends when the last flush has completed.
+		uint64_t renderEnd = 0, flushEnd = 0;
+		for (const lv_area_t& area : frame)
+		{
+			const uint32_t w = (uint32_t)lv_area_get_width(&area), h = (uint32_t)lv_area_get_height(&area);
+			const uint32_t maxRows = (bufferPixels/w < h) ? bufferPixels/w : h;
+			for (lv_coord_t y = area.y1; y <= area.y2; y += (lv_coord_t)maxRows)
+			{
+				const lv_area_t part = MakeArea(area.x1, y, area.x2, (y + (int)maxRows - 1 < area.y2) ? y + (int)maxRows - 1 : area.y2);
+				const uint64_t renderStart = (doubleBuffered) ? renderEnd : flushEnd;
+				renderEnd = renderStart + renderClocksPerPart + (uint64_t)lv_area_get_size(&part) * renderClocksPerPixel;
+
+				// With two buffers LVGL waits for the previous flush before starting this one, then renders the next part while it runs
+				const uint64_t flushStart = (renderEnd > flushEnd) ? renderEnd : flushEnd;
+				flushEnd = flushStart + FlushPart(part);
+				if (doubleBuffered)
+				{
+					renderEnd = flushStart;
+				}
+				++r.parts;
+			}
+		}
+		r.totalClocks += flushEnd;
+		if (flushEnd > r.maxFrameClocks)
+		{
+			r.maxFrameClocks = flushEnd;
+		}
+	}
+	return r;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<Frame> frames;
+	if (argc > 1 && strcmp(argv[1], "-") != 0)
+	{
+		if (!ReadTrace(argv[1], frames))
+		{
+			printf("Can't read a trace from %s\n", argv[1]);
+			return 1;
+		}
+	}
+	else
+	{
+		MakeTrace(frames);
+	}
+	if (argc > 2)
+	{
+		renderClocksPerPart = (uint32_t)atoi(argv[2]);
+	}
+	if (argc > 3)
+	{
+		renderClocksPerPixel = (uint32_t)atoi(argv[3]);
+	}
+	if (argc > 4)
+	{
+		clocksPerBusByte = (uint32_t)atoi(argv[4]);
+	}
+	if (argc > 5)
+	{
+		clocksPerFlushOverhead = (uint32_t)atoi(argv[5]);
+	}
+
+	MakeReference();
+	VirtualSSD1963::Reset();
+	SSD1963::Init();
+	driver.draw_buf = &drawBuf;
+
+	const std::vector<Frame> fullScreen(1, Frame(1, MakeArea(0, 0, Width - 1, Height - 1)));
+	(void)Replay(fullScreen, MaxBufferLines, false);			// so that the PIO clocks of the clear started by Init aren't counted
+
+	uint64_t areas = 0, pixels = 0;
+	for (const Frame& frame : frames)
+	{
+		areas += frame.size();
+		for (const lv_area_t& area : frame)
+		{
+			pixels += lv_area_get_size(&area);
+		}
+	}
+	printf("%u frames, %llu areas, %llu pixels, render cost %u clocks per part and %u per pixel, %u clocks per bus byte, %u flush overhead\n",
+			(unsigned int)frames.size(), (unsigned long long)areas, (unsigned long long)pixels, (unsigned int)renderClocksPerPart, (unsigned int)renderClocksPerPixel,
+			(unsigned int)clocksPerBusByte, (unsigned int)clocksPerFlushOverhead);
+
+	constexpr double ClocksPerMillisecond = SystemCoreClockFreq/1000.0;
+	printf("lines,buffers,buffer_bytes,parts_per_frame,avg_frame_ms,max_frame_ms,fps,full_screen_fps\n");
+	for (bool doubleBuffered : { false, true })
+	{
+		for (unsigned int lines : bufferLines)
+		{
+			const Result r = Replay(frames, lines, doubleBuffered);
+			const Result full = Replay(fullScreen, lines, doubleBuffered);
+			const double avgMillis = r.totalClocks/ClocksPerMillisecond/frames.size();
+			printf("%u,%u,%u,%.1f,%.2f,%.2f,%.0f,%.1f\n", lines, (doubleBuffered) ? 2 : 1, Width * lines * 2 * ((doubleBuffered) ? 2 : 1),
+					(double)r.parts/frames.size(), avgMillis, r.maxFrameClocks/ClocksPerMillisecond, 1000.0/avgMillis,
+					SystemCoreClockFreq/(double)full.totalClocks);
+		}
+	}
+	return 0;
+}
+
+// End
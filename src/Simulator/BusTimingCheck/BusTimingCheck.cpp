@@ -0,0 +1,262 @@
+/*
+ * BusTimingCheck.cpp
+ *
+ *  Created on: 20 Mar 2023
+ *      Author: David
+ *
+ *  Host check of the display bus waveform generated by the PIO programs. The instruction words from PioPrograms.h, including their side-set
+ *  and delay bits, are run in the state machine model, and each edge on the data, latch, ~RD and ~WR pins is timed at the system clock
+ *  frequency and PIO clock divider. The timing is checked against the 74AHC573 and SSD1963 requirements, the pixels the SSD1963 would receive
+ *  are compared with the pixels sent, and the PIO clocks taken are compared with the costs in PioBus.h that the driver uses.
+ *  Transfers are sent back to back, which is the tightest case, because in the firmware the CPU always takes a few microseconds to start the next one.
+ *
+ *  Usage: bus-timing-check
+ */
+
+#include <Drivers/PioBus.h>
+#include <Drivers/PioPrograms.h>
+#include "../PioStateMachine.h"
+#include <CoreIO.h>
+#include <Pins.h>
+#include <cstdio>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace PioBus;
+using namespace PioPrograms;
+using namespace PioPrograms::Requirements;
+
+constexpr uint32_t DataMask = 0xFFu << DisplayLowestDataPin;
+constexpr uint32_t LatchBit = 1u << DisplayLatchLowDataPin;
+constexpr uint32_t ReadBit = 1u << DisplayReadPin;
+constexpr uint32_t WriteBit = 1u << DisplayWritePin;
+constexpr uint64_t PioClockPeriod = (1000000000000ull * PioClockDivider)/SystemCoreClockFreq;		// picoseconds
+
+// A timing requirement and the worst case seen
+struct Check
+{
+	const char *name;
+	uint64_t required;
+	uint64_t worst;
+	unsigned int failures;
+};
+
+static Check latchPulse = { "latch pulse width", LatchPulseWidth, UINT64_MAX, 0 };
+static Check latchSetup = { "data setup to latch falling", LatchSetupTime, UINT64_MAX, 0 };
+static Check latchHold = { "data hold from latch falling", LatchHoldTime, UINT64_MAX, 0 };
+static Check writeLow = { "~WR low time", WriteLowTime, UINT64_MAX, 0 };
+static Check highByteSetup = { "high byte setup to ~WR rising", WriteSetupTime, UINT64_MAX, 0 };
+static Check lowByteSetup = { "low byte (latch output) setup to ~WR rising", WriteSetupTime, UINT64_MAX, 0 };
+static Check dataHold = { "data hold from ~WR rising", WriteHoldTime, UINT64_MAX, 0 };
+static Check * const checks[] = { &latchPulse, &latchSetup, &latchHold, &writeLow, &highByteSetup, &lowByteSetup, &dataHold };
+
+static void Measure(Check& c, uint64_t time) noexcept
+{
+	if (time < c.worst)
+	{
+		c.worst = time;
+	}
+	if (time < c.required)
+	{
+		++c.failures;
+	}
+}
+
+constexpr PioStateMachine::Config PixelConfig =
+	{ PixelProgram, PixelProgramLength, PixelProgramWrapTop, DisplayLowestDataPin, 8, DisplayLatchLowDataPin, SideSetBits, PixelPullThreshold };
+constexpr PioStateMachine::Config RunConfig =
+	{ RunProgram, RunProgramLength, RunProgramWrapTop, DisplayLowestDataPin, 8, DisplayLatchLowDataPin, SideSetBits, RunPullThreshold };
+
+static void OnPinWrite(uint32_t mask, uint32_t values) noexcept;
+static PioStateMachine machine(OnPinWrite);
+
+// Waveform analysis. Times are in picoseconds from the start of the check.
+static uint32_t pins = ReadBit | WriteBit;
+static uint64_t dataChangeTime = 0;						// when the data pins last changed
+static uint64_t latchRiseTime = 0;
+static uint64_t latchOutputTime = 0;					// when the latch outputs last changed, allowing for the propagation delay
+static uint64_t writeFallTime = 0;
+static bool latchHoldPending = false, dataHoldPending = false;
+static uint64_t latchFallTime = 0, writeRiseTime = 0;
+static uint8_t latchOutputs = 0;
+static unsigned int readGlitches = 0;
+static std::vector<uint16_t> received;
+
+static void OnPinWrite(uint32_t mask, uint32_t values) noexcept
+{
+	const uint64_t now = machine.GetClocks() * PioClockPeriod;
+	const uint32_t newPins = (pins & ~mask) | (values & mask);
+	const uint32_t changed = pins ^ newPins;
+
+	// Edges of the latch and ~WR are timed against the data as it was before this clock
+	if ((changed & LatchBit) != 0)
+	{
+		if ((newPins & LatchBit) != 0)
+		{
+			latchRiseTime = now;
+			if (dataHoldPending)
+			{
+				Measure(dataHold, now - writeRiseTime);				// the latch outputs may start to change as soon as it opens
+			}
+		}
+		else
+		{
+			Measure(latchPulse, now - latchRiseTime);
+			Measure(latchSetup, now - dataChangeTime);
+			latchFallTime = now;
+			latchHoldPending = true;
+		}
+	}
+	if ((changed & WriteBit) != 0)
+	{
+		if ((newPins & WriteBit) == 0)
+		{
+			writeFallTime = now;
+		}
+		else
+		{
+			Measure(writeLow, now - writeFallTime);
+			Measure(highByteSetup, now - dataChangeTime);
+			Measure(lowByteSetup, (now > latchOutputTime) ? now - latchOutputTime : 0);
+			received.push_back((uint16_t)((((newPins & DataMask) >> DisplayLowestDataPin) << 8) | latchOutputs));
+			writeRiseTime = now;
+			dataHoldPending = true;
+		}
+	}
+	if ((changed & ReadBit) != 0 || (newPins & ReadBit) == 0)
+	{
+		++readGlitches;
+	}
+
+	// Then any change to the data pins at this clock ends the hold times
+	if ((changed & DataMask) != 0)
+	{
+		if (latchHoldPending)
+		{
+			Measure(latchHold, now - latchFallTime);
+			latchHoldPending = false;
+		}
+		if (dataHoldPending)
+		{
+			Measure(dataHold, now - writeRiseTime);
+			dataHoldPending = false;
+		}
+		dataChangeTime = now;
+	}
+
+	// While the latch is open its outputs follow the data pins one propagation delay later
+	if ((newPins & LatchBit) != 0 && ((changed & (DataMask | LatchBit)) != 0))
+	{
+		latchOutputs = (uint8_t)((newPins & DataMask) >> DisplayLowestDataPin);
+		latchOutputTime = now + LatchPropagationDelay;
+	}
+	pins = newPins;
+}
+
+static unsigned int failures = 0;
+
+// Run a transfer that has been put in the FIFO and check the pixels received and the clocks taken
+static void Run(const std::vector<uint16_t>& expected, uint64_t expectedClocks, const char *what) noexcept
+{
+	received.clear();
+	const uint64_t startClocks = machine.GetClocks();
+	if (!machine.Run())
+	{
+		printf("%s: PIO program failed: %s\n", what, machine.GetError());
+		++failures;
+		return;
+	}
+	const uint64_t clocks = machine.GetClocks() - startClocks;
+	if (received != expected)
+	{
+		printf("%s: %u pixels sent, %u received, first difference at %u\n", what, (unsigned int)expected.size(), (unsigned int)received.size(),
+				(unsigned int)(std::mismatch(expected.begin(), expected.end(), received.begin(), received.end()).first - expected.begin()));
+		++failures;
+	}
+	if (clocks != expectedClocks)
+	{
+		printf("%s: took %llu PIO clocks, the driver's cost model says %llu\n", what, (unsigned long long)clocks, (unsigned long long)expectedClocks);
+		++failures;
+	}
+}
+
+static void SendPixels(const std::vector<uint16_t>& pixels) noexcept
+{
+	machine.Init(PixelConfig);									// switching programs doesn't change the pins, so the transfers are still back to back
+	machine.Put(pixels.size() - 1);
+	for (uint16_t p : pixels)
+	{
+		machine.Put(p * 0x00010001u);							// a 16-bit DMA transfer to the FIFO writes the data to both halves of the word
+	}
+	Run(pixels, pixels.size() * ClocksPerPixel + 2, "pixels");
+}
+
+static void SendRuns(const std::vector<uint32_t>& runs) noexcept
+{
+	std::vector<uint16_t> expected;
+	uint64_t expectedClocks = 2;								// reading the count and raising the interrupt
+	machine.Init(RunConfig);
+	machine.Put(runs.size() - 1);
+	for (uint32_t r : runs)
+	{
+		machine.Put(r);
+		expected.insert(expected.end(), (r >> 16) + 1, (uint16_t)r);
+		expectedClocks += ClocksPerRun + (r >> 16) * ClocksPerRepeat;
+	}
+	if ((runs.back() >> 16) != 0)
+	{
+		++expectedClocks;										// the repeat loop takes an extra jump to reach the interrupt
+	}
+	Run(expected, expectedClocks, "runs");
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+
+	// Pixels that exercise every data bit in both directions, then random ones, in transfers of different lengths including a single pixel
+	SendPixels({ 0x0000, 0xFFFF, 0x0000, 0x5AA5, 0xA55A, 0x00FF, 0xFF00, 0x0001, 0x8000 });
+	SendPixels({ 0x1234 });
+	for (unsigned int i = 0; i < 200; ++i)
+	{
+		std::vector<uint16_t> pixels(1 + rng() % 64);
+		for (uint16_t& p : pixels)
+		{
+			p = (uint16_t)rng();
+		}
+		SendPixels(pixels);
+	}
+
+	// Runs with no repeats, one, several and the maximum, interleaved with pixel transfers as the driver does
+	SendRuns({ MakeRun(0xFFFF, 1), MakeRun(0x0000, 2), MakeRun(0xA55A, 5), MakeRun(0x5AA5, 1) });
+	SendRuns({ MakeRun(0x1234, 3) });
+	SendRuns({ MakeRun(0x8001, MaxRunLength) });
+	for (unsigned int i = 0; i < 200; ++i)
+	{
+		std::vector<uint32_t> runs(1 + rng() % 16);
+		for (uint32_t& r : runs)
+		{
+			r = MakeRun((uint16_t)rng(), 1 + ((rng() % 4 == 0) ? rng() % 300 : rng() % 4));
+		}
+		SendRuns(runs);
+		SendPixels({ (uint16_t)rng(), (uint16_t)rng() });
+	}
+
+	printf("PIO clock %.3fns, %llu clocks simulated\n", PioClockPeriod/1000.0, (unsigned long long)machine.GetClocks());
+	printf("requirement,required_ns,worst_ns,failures\n");
+	for (const Check *c : checks)
+	{
+		printf("%s,%.1f,%.1f,%u\n", c->name, c->required/1000.0, c->worst/1000.0, c->failures);
+		failures += c->failures;
+	}
+	if (readGlitches != 0)
+	{
+		printf("~RD went low %u times\n", readGlitches);
+		failures += readGlitches;
+	}
+	printf((failures == 0) ? "Bus timing OK\n" : "Bus timing check failed\n");
+	return (failures == 0) ? 0 : 1;
+}
+
+// End
@@ -0,0 +1,17 @@
+/*
+ * BuzzerSim.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator version of the buzzer driver, which does nothing
+ */
+
+#include <Drivers/Buzzer.h>
+
+void Buzzer::Init() noexcept { }
+void Buzzer::SetVolume(uint8_t volume) noexcept { }
+void Buzzer::Beep(uint32_t frequency, uint32_t milliseconds) noexcept { }
+void Buzzer::Tick() noexcept { }
+
+// End
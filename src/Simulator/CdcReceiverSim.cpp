@@ -0,0 +1,107 @@
+/*
+ * CdcReceiverSim.cpp
+ *
+ *  Created on: 8 Feb 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for CdcReceiver.cpp. There is no RTOS in the simulator, so the port is read when an update is requested.
+ */
+
+#include <Telemetry/CdcReceiver.h>
+#include <SpscQueue.h>
+#include <RP2040/Devices.h>
+#include <hardware/timer.h>
+
+static SpscQueue<TelemetryUpdate, CdcReceiver::UpdateQueueLength> updateQueue;
+static SpscQueue<SettingsStore::Update, CdcReceiver::SettingsQueueLength> settingsQueue;
+static uint32_t chunkReceiveTime = 0;
+static uint32_t overruns = 0;
+static uint32_t maxQueued = 0;
+static uint32_t settingsRejected = 0;
+
+static void QueueUpdate(const TelemetryUpdate& update) noexcept
+{
+	if (updateQueue.Put(update))
+	{
+		maxQueued = max<uint32_t>(maxQueued, updateQueue.Count());
+	}
+	else
+	{
+		++overruns;
+	}
+}
+
+static void HandleFrame(uint8_t type, uint8_t sequence, const uint8_t *payload, size_t length) noexcept
+{
+	if (type == FrameFormat::ReadingsFrame)
+	{
+		for (const uint8_t * const end = payload + length - (length % Ems::ReadingSize); payload < end; payload += Ems::ReadingSize)
+		{
+			QueueUpdate(TelemetryUpdate{ chunkReceiveTime, Ems::DecodeReading(payload), false });
+		}
+	}
+	else if (type == FrameFormat::SettingsFrame)
+	{
+		SettingsStore::Update update;
+		if (!SettingsStore::DecodeUpdate(payload, length, update) || !settingsQueue.Put(update))
+		{
+			++settingsRejected;
+		}
+	}
+	else if (type == FrameFormat::CommandFrame)
+	{
+		// Profiler commands are passed to the display task so that the profiler is only ever used from one task
+		for (size_t i = 0; i < length; ++i)
+		{
+			QueueUpdate(TelemetryUpdate{ chunkReceiveTime, Ems::Reading{ payload[i], 0, 0 }, true });
+		}
+	}
+}
+
+static FrameParser parser(HandleFrame);
+
+void CdcReceiver::Start() noexcept
+{
+}
+
+bool CdcReceiver::GetUpdate(TelemetryUpdate& update) noexcept
+{
+	if (updateQueue.IsEmpty())
+	{
+		uint8_t buffer[64];
+		const size_t numRead = serialUSB.readBytes(reinterpret_cast<char*>(buffer), sizeof(buffer));
+		if (numRead != 0)
+		{
+			chunkReceiveTime = time_us_32();
+			parser.Process(buffer, numRead);
+		}
+	}
+	return updateQueue.Get(update);
+}
+
+bool CdcReceiver::GetSettingsUpdate(SettingsStore::Update& update) noexcept
+{
+	return settingsQueue.Get(update);
+}
+
+uint32_t CdcReceiver::GetSettingsRejected() noexcept
+{
+	return settingsRejected;
+}
+
+uint32_t CdcReceiver::GetOverruns() noexcept
+{
+	return overruns;
+}
+
+uint32_t CdcReceiver::GetMaxQueued() noexcept
+{
+	return maxQueued;
+}
+
+const FrameParser::Stats& CdcReceiver::GetParserStats() noexcept
+{
+	return parser.GetStats();
+}
+
+// End
@@ -0,0 +1,15 @@
+/*
+ * Core.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the CoreN2G Core.h
+ */
+
+#ifndef SRC_SIMULATOR_CORE_H_
+#define SRC_SIMULATOR_CORE_H_
+
+#include "CoreIO.h"
+
+#endif /* SRC_SIMULATOR_CORE_H_ */
@@ -0,0 +1,70 @@
+/*
+ * CoreIO.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the parts of the CoreN2G CoreIO.h that the display, touch panel and buzzer drivers use.
+ *  Pin writes go to the simulated GPIO port instead of the SIO.
+ */
+
+#ifndef SRC_SIMULATOR_COREIO_H_
+#define SRC_SIMULATOR_COREIO_H_
+
+#include <cstdint>
+#include <cstddef>
+#include "SimPins.h"
+
+typedef uint8_t Pin;
+typedef uint8_t DmaChannel;
+typedef uint8_t DmaPriority;
+typedef uint8_t NvicPriority;
+
+constexpr Pin NoPin = 0xFF;
+
+inline constexpr Pin GpioPin(unsigned int n) noexcept { return (Pin)n; }
+
+enum PinMode
+{
+	INPUT = 0,
+	INPUT_PULLUP,
+	INPUT_PULLDOWN,
+	OUTPUT_LOW,
+	OUTPUT_HIGH,
+};
+
+constexpr uint32_t SystemCoreClockFreq = 125000000;
+
+template<class T> inline constexpr T min(T a, T b) noexcept { return (a < b) ? a : b; }
+template<class T> inline constexpr T max(T a, T b) noexcept { return (a > b) ? a : b; }
+
+#ifndef ARRAY_SIZE
+# define ARRAY_SIZE(_x)		(sizeof(_x)/sizeof((_x)[0]))
+#endif
+
+inline void fastDigitalWriteHigh(Pin pin) noexcept { SimPins::WriteMasked(1u << pin, 1u << pin); }
+inline void fastDigitalWriteLow(Pin pin) noexcept { SimPins::WriteMasked(1u << pin, 0); }
+inline void digitalWrite(Pin pin, bool high) noexcept { SimPins::WriteMasked(1u << pin, (high) ? 1u << pin : 0); }
+inline bool digitalRead(Pin pin) noexcept { return SimPins::Read(pin); }
+
+inline void pinMode(Pin pin, PinMode mode) noexcept
+{
+	if (mode == OUTPUT_LOW)
+	{
+		fastDigitalWriteLow(pin);
+	}
+	else if (mode == OUTPUT_HIGH)
+	{
+		fastDigitalWriteHigh(pin);
+	}
+}
+
+inline void SetDriveStrength(Pin pin, unsigned int strength) noexcept { }
+
+// The simulator runs in real time, as time_us_32() reads the host clock (see hardware/timer.h), but these return at once: the waits they make
+// in the firmware are for the panel initialisation and the touch controller timing, which the virtual devices don't need
+inline void delay(uint32_t ms) noexcept { }
+inline void delayMicroseconds(uint32_t us) noexcept { }
+inline void delayNanoseconds(uint32_t ns) noexcept { }
+
+#endif /* SRC_SIMULATOR_COREIO_H_ */
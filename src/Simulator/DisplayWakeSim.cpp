@@ -0,0 +1,59 @@
+/*
+ * DisplayWakeSim.cpp
+ *
+ *  Created on: 24 Feb 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for DisplayWake.cpp. There is no RTOS in the simulator and the event sources are polled when the display
+ *  task asks for them, so waiting sleeps for at most a millisecond and then reports that any of the events may have arrived.
+ *  The simulated display driver doesn't wake the task when a flush completes, so waiting for a flush just yields.
+ */
+
+#include <DisplayWake.h>
+#include <hardware/timer.h>
+#include <chrono>
+#include <thread>
+
+using namespace DisplayWake;
+
+static uint32_t lastWakeTime;
+static Stats stats = {};
+
+void DisplayWake::Init() noexcept
+{
+	lastWakeTime = time_us_32();
+}
+
+void DisplayWake::Notify(Event) noexcept
+{
+}
+
+void DisplayWake::NotifyFromIsr(Event) noexcept
+{
+}
+
+uint32_t DisplayWake::WaitForEvent(uint32_t maxMillis) noexcept
+{
+	const uint32_t startTime = time_us_32();
+	stats.awakeTime += startTime - lastWakeTime;
+	if (maxMillis != 0)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	lastWakeTime = time_us_32();
+	stats.blockedTime += lastWakeTime - startTime;
+	++stats.wakeups;
+	return AllEvents;
+}
+
+void DisplayWake::WaitForFlush(uint32_t) noexcept
+{
+	std::this_thread::yield();
+}
+
+const Stats& DisplayWake::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
@@ -0,0 +1,128 @@
+/*
+ * FontBench.cpp
+ *
+ *  Created on: 19 Feb 2023
+ *      Author: David
+ *
+ *  Host program that compares the full Montserrat 18 font with the subset generated by font-subset, drawing the tile value labels
+ *  as the display does when the EMS readings change.
+ *  - Render time: a label is given a new value and the screen is refreshed, many times over, timing lv_refr_now.
+ *  - Glyph data locality: for the same texts it collects the flash addresses of the glyph bitmaps that are read, and counts the
+ *    8-byte XIP cache lines they fall in and the span of addresses they cover. The host has no XIP cache, so this is
+ *    the part of the difference that the render time on the host cannot show.
+ *
+ *  Usage: font-bench [iterations]
+ */
+
+#include <lvgl.h>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <set>
+
+LV_FONT_DECLARE(ems_font_18)
+
+constexpr lv_coord_t Width = 800;
+constexpr lv_coord_t Height = 480;
+constexpr size_t XipLineSize = 8;					// size of an RP2040 flash cache line
+
+static lv_color_t buffer[Width * 40];
+static lv_disp_draw_buf_t drawBuf;
+static lv_disp_drv_t driver;
+static std::mt19937 rng(1);
+
+static void Flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *colours) noexcept
+{
+	lv_disp_flush_ready(drv);
+}
+
+// Make a value string like the ones the data model shows
+static void MakeValue(char *buf, size_t length) noexcept
+{
+	if (rng() % 4 == 0)
+	{
+		snprintf(buf, length, "%u %%", (unsigned int)(rng() % 101));
+	}
+	else
+	{
+		const int tenWatts = (int)(rng() % 2000) - 1000;
+		snprintf(buf, length, "%s%d.%02d kW", (tenWatts < 0) ? "-" : "", abs(tenWatts)/100, abs(tenWatts) % 100);
+	}
+}
+
+static double TimeLabelUpdates(const lv_font_t *font, unsigned int iterations) noexcept
+{
+	lv_obj_t * const label = lv_label_create(lv_scr_act());
+	lv_obj_set_style_text_font(label, font, 0);
+	lv_obj_center(label);
+	char text[20];
+	rng.seed(1);
+
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		MakeValue(text, sizeof(text));
+		lv_label_set_text(label, text);
+		lv_refr_now(nullptr);
+	}
+	const auto end = std::chrono::steady_clock::now();
+	lv_obj_del(label);
+	return std::chrono::duration<double, std::micro>(end - start).count()/iterations;
+}
+
+static void MeasureLocality(const lv_font_t *font, unsigned int iterations, size_t& lines, size_t& span) noexcept
+{
+	std::set<uintptr_t> touched;
+	char text[20];
+	rng.seed(1);
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		MakeValue(text, sizeof(text));
+		for (const char *p = text; *p != 0; ++p)
+		{
+			lv_font_glyph_dsc_t g;
+			if (!lv_font_get_glyph_dsc(font, &g, (uint8_t)*p, 0))
+			{
+				continue;
+			}
+			const size_t bytes = ((size_t)g.box_w * g.box_h * g.bpp + 7)/8;
+			const uintptr_t b = reinterpret_cast<uintptr_t>(lv_font_get_glyph_bitmap(font, (uint8_t)*p));
+			for (uintptr_t line = b/XipLineSize; bytes != 0 && line <= (b + bytes - 1)/XipLineSize; ++line)
+			{
+				touched.insert(line);
+			}
+		}
+	}
+	lines = touched.size();
+	span = (touched.empty()) ? 0 : (*touched.rbegin() - *touched.begin() + 1) * XipLineSize;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned int iterations = (argc > 1) ? (unsigned int)atoi(argv[1]) : 5000;
+
+	lv_init();
+	lv_disp_draw_buf_init(&drawBuf, buffer, nullptr, sizeof(buffer)/sizeof(buffer[0]));
+	lv_disp_drv_init(&driver);
+	driver.flush_cb = Flush;
+	driver.draw_buf = &drawBuf;
+	driver.hor_res = Width;
+	driver.ver_res = Height;
+	lv_disp_drv_register(&driver);
+	lv_refr_now(nullptr);
+
+	static const lv_font_t * const fonts[] = { &lv_font_montserrat_18, &ems_font_18 };
+	static const char * const names[] = { "montserrat_18", "ems_font_18" };
+	printf("font,label_update_us,xip_lines_touched,bitmap_span_bytes\n");
+	for (size_t i = 0; i < 2; ++i)
+	{
+		const double us = TimeLabelUpdates(fonts[i], iterations);
+		size_t lines, span;
+		MeasureLocality(fonts[i], iterations, lines, span);
+		printf("%s,%.2f,%u,%u\n", names[i], us, (unsigned int)lines, (unsigned int)span);
+	}
+	return 0;
+}
+
+// End
@@ -0,0 +1,340 @@
+/*
+ * FontSubset.cpp
+ *
+ *  Created on: 19 Feb 2023
+ *      Author: David
+ *
+ *  Host program that writes a C source file containing a subset of one of the LVGL builtin Montserrat fonts, holding only the
+ *  characters that the UI displays. Kerning is kept, with the kerning classes renumbered to those the subset uses.
+ *  The bitmaps of the "hot" characters, those in the values that change while the display is running, come first and
+ *  all the font data is put in the .font_hot section, which the linker script places at the start of .rodata. So the glyphs
+ *  needed to redraw a value are in a few consecutive flash cache lines instead of being spread over the whole font.
+ *  It prints the flash used by the full font and by the subset.
+ *
+ *  Usage: font-subset size name characters [hot-characters] > file.c
+ */
+
+#include <lvgl.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+
+struct SourceFont
+{
+	int size;
+	const lv_font_t *font;
+};
+
+static const SourceFont sourceFonts[] =
+{
+#if LV_FONT_MONTSERRAT_14
+	{ 14, &lv_font_montserrat_14 },
+#endif
+#if LV_FONT_MONTSERRAT_18
+	{ 18, &lv_font_montserrat_18 },
+#endif
+#if LV_FONT_MONTSERRAT_24
+	{ 24, &lv_font_montserrat_24 },
+#endif
+#if LV_FONT_MONTSERRAT_28
+	{ 28, &lv_font_montserrat_28 },
+#endif
+#if LV_FONT_MONTSERRAT_32
+	{ 32, &lv_font_montserrat_32 },
+#endif
+#if LV_FONT_MONTSERRAT_48
+	{ 48, &lv_font_montserrat_48 },
+#endif
+};
+
+// Some versions of LVGL have a glyph cache pointer in the font descriptor and some don't. The generated file must match.
+template<class T, class = void> struct HasCache : std::false_type { };
+template<class T> struct HasCache<T, decltype((void)T::cache, void())> : std::true_type { };
+
+struct Glyph
+{
+	uint32_t letter;
+	uint32_t sourceId;
+	bool hot;
+};
+
+// Find the glyph ID of a character in a font, returning 0 if it isn't there
+static uint32_t FindGlyph(const lv_font_fmt_txt_dsc_t *dsc, uint32_t letter) noexcept
+{
+	for (unsigned int i = 0; i < dsc->cmap_num; ++i)
+	{
+		const lv_font_fmt_txt_cmap_t& cmap = dsc->cmaps[i];
+		const uint32_t rcp = letter - cmap.range_start;
+		if (letter < cmap.range_start || rcp >= cmap.range_length)
+		{
+			continue;
+		}
+
+		switch (cmap.type)
+		{
+		case LV_FONT_FMT_TXT_CMAP_FORMAT0_TINY:
+			return cmap.glyph_id_start + rcp;
+
+		case LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL:
+			return cmap.glyph_id_start + static_cast<const uint8_t*>(cmap.glyph_id_ofs_list)[rcp];
+
+		case LV_FONT_FMT_TXT_CMAP_SPARSE_TINY:
+		case LV_FONT_FMT_TXT_CMAP_SPARSE_FULL:
+			for (unsigned int j = 0; j < cmap.list_length; ++j)
+			{
+				if (cmap.unicode_list[j] == rcp)
+				{
+					return (cmap.type == LV_FONT_FMT_TXT_CMAP_SPARSE_TINY) ? cmap.glyph_id_start + j
+							: cmap.glyph_id_start + static_cast<const uint16_t*>(cmap.glyph_id_ofs_list)[j];
+				}
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+	return 0;
+}
+
+static size_t BitmapSize(const lv_font_fmt_txt_dsc_t *dsc, uint32_t id) noexcept
+{
+	const lv_font_fmt_txt_glyph_dsc_t& g = dsc->glyph_dsc[id];
+	return ((size_t)g.box_w * g.box_h * dsc->bpp + 7)/8;
+}
+
+// Work out the flash used by the full font: bitmaps, glyph descriptors, character maps and kerning tables
+static size_t FullFontSize(const lv_font_fmt_txt_dsc_t *dsc) noexcept
+{
+	uint32_t numGlyphs = 0;
+	size_t size = dsc->cmap_num * sizeof(lv_font_fmt_txt_cmap_t);
+	for (unsigned int i = 0; i < dsc->cmap_num; ++i)
+	{
+		const lv_font_fmt_txt_cmap_t& cmap = dsc->cmaps[i];
+		const bool sparse = (cmap.type == LV_FONT_FMT_TXT_CMAP_SPARSE_TINY || cmap.type == LV_FONT_FMT_TXT_CMAP_SPARSE_FULL);
+		const uint32_t count = (sparse) ? cmap.list_length : cmap.range_length;
+		numGlyphs = std::max(numGlyphs, cmap.glyph_id_start + count);
+		size += (sparse) ? cmap.list_length * sizeof(uint16_t) : 0;
+		size += (cmap.type == LV_FONT_FMT_TXT_CMAP_FORMAT0_FULL) ? cmap.range_length
+				: (cmap.type == LV_FONT_FMT_TXT_CMAP_SPARSE_FULL) ? cmap.list_length * sizeof(uint16_t) : 0;
+	}
+
+	size_t bitmapEnd = 0;
+	for (uint32_t id = 1; id < numGlyphs; ++id)
+	{
+		bitmapEnd = std::max(bitmapEnd, dsc->glyph_dsc[id].bitmap_index + BitmapSize(dsc, id));
+	}
+	size += bitmapEnd + numGlyphs * sizeof(lv_font_fmt_txt_glyph_dsc_t);
+
+	if (dsc->kern_dsc != nullptr && dsc->kern_classes != 0)
+	{
+		const lv_font_fmt_txt_kern_classes_t *kern = static_cast<const lv_font_fmt_txt_kern_classes_t*>(dsc->kern_dsc);
+		size += 2 * numGlyphs + (size_t)kern->left_class_cnt * kern->right_class_cnt + sizeof(*kern);
+	}
+	return size;
+}
+
+// Write an array of small integers as C source, 16 to a line
+static void WriteArray(const char *type, const char *name, const std::vector<int>& values) noexcept
+{
+	printf("static FONT_HOT const %s %s[] = {", type, name);
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		printf("%s%d,", (i % 16 == 0) ? "\n    " : " ", values[i]);
+	}
+	printf("\n};\n\n");
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "Usage: font-subset size name characters [hot-characters] > file.c\n");
+		return 1;
+	}
+
+	const int size = atoi(argv[1]);
+	const char * const name = argv[2];
+	const char * const characters = argv[3];
+	const char * const hotCharacters = (argc > 4) ? argv[4] : "";
+
+	const lv_font_t *font = nullptr;
+	for (const SourceFont& s : sourceFonts)
+	{
+		if (s.size == size)
+		{
+			font = s.font;
+		}
+	}
+	if (font == nullptr)
+	{
+		fprintf(stderr, "Montserrat %d is not enabled in lv_conf.h\n", size);
+		return 1;
+	}
+
+	const lv_font_fmt_txt_dsc_t * const dsc = static_cast<const lv_font_fmt_txt_dsc_t*>(font->dsc);
+	if (dsc->bitmap_format != LV_FONT_FMT_TXT_PLAIN)
+	{
+		fprintf(stderr, "Compressed fonts are not supported\n");
+		return 1;
+	}
+
+	// Collect the characters in code point order. They are all ASCII because that's all the UI uses.
+	std::vector<Glyph> glyphs;
+	for (const char *p = characters; *p != 0; ++p)
+	{
+		const uint32_t letter = (uint8_t)*p;
+		if (std::none_of(glyphs.begin(), glyphs.end(), [letter](const Glyph& g) { return g.letter == letter; }))
+		{
+			const uint32_t id = FindGlyph(dsc, letter);
+			if (id == 0)
+			{
+				fprintf(stderr, "Character '%c' is not in the font\n", (char)letter);
+				return 1;
+			}
+			glyphs.push_back(Glyph{ letter, id, strchr(hotCharacters, (int)letter) != nullptr });
+		}
+	}
+	std::sort(glyphs.begin(), glyphs.end(), [](const Glyph& a, const Glyph& b) { return a.letter < b.letter; });
+	if (glyphs.empty())
+	{
+		fprintf(stderr, "No characters given\n");
+		return 1;
+	}
+
+	// Lay out the bitmaps with the hot glyphs first
+	std::vector<int> bitmap;
+	std::vector<size_t> bitmapIndex(glyphs.size());
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (size_t i = 0; i < glyphs.size(); ++i)
+		{
+			if (glyphs[i].hot == (pass == 0))
+			{
+				bitmapIndex[i] = bitmap.size();
+				const uint8_t *const src = dsc->glyph_bitmap + dsc->glyph_dsc[glyphs[i].sourceId].bitmap_index;
+				bitmap.insert(bitmap.end(), src, src + BitmapSize(dsc, glyphs[i].sourceId));
+			}
+		}
+	}
+
+	printf("/*\n * Subset of lv_font_montserrat_%d generated by font-subset (src/Simulator/FontSubset). Do not edit.\n", size);
+	printf(" * Characters: \"%s\"\n * Hot characters: \"%s\"\n */\n\n", characters, hotCharacters);
+	printf("#include \"../../lvgl/lvgl.h\"\n\n");
+	printf("#define FONT_HOT __attribute__((section(\".font_hot\")))\n\n");
+
+	WriteArray("uint8_t", "glyph_bitmap", bitmap);
+
+	printf("static FONT_HOT const lv_font_fmt_txt_glyph_dsc_t glyph_dsc[] = {\n");
+	printf("    {.bitmap_index = 0, .adv_w = 0, .box_w = 0, .box_h = 0, .ofs_x = 0, .ofs_y = 0} /* id = 0 reserved */,\n");
+	for (size_t i = 0; i < glyphs.size(); ++i)
+	{
+		const lv_font_fmt_txt_glyph_dsc_t& g = dsc->glyph_dsc[glyphs[i].sourceId];
+		printf("    {.bitmap_index = %u, .adv_w = %u, .box_w = %u, .box_h = %u, .ofs_x = %d, .ofs_y = %d} /* '%c' */,\n",
+				(unsigned int)bitmapIndex[i], (unsigned int)g.adv_w, (unsigned int)g.box_w, (unsigned int)g.box_h, (int)g.ofs_x, (int)g.ofs_y, (char)glyphs[i].letter);
+	}
+	printf("};\n\n");
+
+	const uint32_t rangeStart = glyphs.front().letter;
+	std::vector<int> unicodeList;
+	for (const Glyph& g : glyphs)
+	{
+		unicodeList.push_back((int)(g.letter - rangeStart));
+	}
+	WriteArray("uint16_t", "unicode_list_0", unicodeList);
+	printf("static FONT_HOT const lv_font_fmt_txt_cmap_t cmaps[] = {\n");
+	printf("    {\n        .range_start = %u, .range_length = %u, .glyph_id_start = 1,\n", (unsigned int)rangeStart, (unsigned int)(glyphs.back().letter - rangeStart + 1));
+	printf("        .unicode_list = unicode_list_0, .glyph_id_ofs_list = NULL, .list_length = %u, .type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY\n    }\n};\n\n", (unsigned int)glyphs.size());
+
+	// Copy the kerning classes that the subset uses, renumbering them from 1
+	const lv_font_fmt_txt_kern_classes_t * const kern = (dsc->kern_classes != 0) ? static_cast<const lv_font_fmt_txt_kern_classes_t*>(dsc->kern_dsc) : nullptr;
+	size_t kernBytes = 0;
+	if (kern != nullptr)
+	{
+		std::vector<int> leftClasses, rightClasses;
+		std::vector<int> leftMapping{ 0 }, rightMapping{ 0 };
+		for (const Glyph& g : glyphs)
+		{
+			for (int side = 0; side < 2; ++side)
+			{
+				const int cls = (side == 0) ? kern->left_class_mapping[g.sourceId] : kern->right_class_mapping[g.sourceId];
+				std::vector<int>& classes = (side == 0) ? leftClasses : rightClasses;
+				std::vector<int>& mapping = (side == 0) ? leftMapping : rightMapping;
+				if (cls == 0)
+				{
+					mapping.push_back(0);
+					continue;
+				}
+				auto it = std::find(classes.begin(), classes.end(), cls);
+				if (it == classes.end())
+				{
+					classes.push_back(cls);
+					it = classes.end() - 1;
+				}
+				mapping.push_back((int)(it - classes.begin()) + 1);
+			}
+		}
+
+		std::vector<int> values;
+		for (int left : leftClasses)
+		{
+			for (int right : rightClasses)
+			{
+				values.push_back(kern->class_pair_values[(left - 1) * kern->right_class_cnt + (right - 1)]);
+			}
+		}
+		if (values.empty())
+		{
+			values.push_back(0);						// C doesn't allow empty arrays
+		}
+
+		kernBytes = leftMapping.size() + rightMapping.size() + values.size() + sizeof(*kern);
+		WriteArray("uint8_t", "kern_left_class_mapping", leftMapping);
+		WriteArray("uint8_t", "kern_right_class_mapping", rightMapping);
+		WriteArray("int8_t", "kern_class_values", values);
+		printf("static FONT_HOT const lv_font_fmt_txt_kern_classes_t kern_classes = {\n");
+		printf("    .class_pair_values = kern_class_values,\n    .left_class_mapping = kern_left_class_mapping,\n    .right_class_mapping = kern_right_class_mapping,\n");
+		printf("    .left_class_cnt = %u,\n    .right_class_cnt = %u,\n};\n\n", (unsigned int)leftClasses.size(), (unsigned int)rightClasses.size());
+	}
+
+	constexpr bool hasCache = HasCache<lv_font_fmt_txt_dsc_t>::value;
+	if (hasCache)
+	{
+		printf("static lv_font_fmt_txt_glyph_cache_t cache;\n\n");
+	}
+	printf("static FONT_HOT const lv_font_fmt_txt_dsc_t font_dsc = {\n");
+	printf("    .glyph_bitmap = glyph_bitmap,\n    .glyph_dsc = glyph_dsc,\n    .cmaps = cmaps,\n");
+	printf("    .kern_dsc = %s,\n    .kern_scale = %u,\n", (kern != nullptr) ? "&kern_classes" : "NULL", (unsigned int)dsc->kern_scale);
+	printf("    .cmap_num = 1,\n    .bpp = %u,\n    .kern_classes = %u,\n    .bitmap_format = 0,\n", (unsigned int)dsc->bpp, (kern != nullptr) ? 1u : 0u);
+	if (hasCache)
+	{
+		printf("    .cache = &cache\n");
+	}
+	printf("};\n\n");
+
+	printf("const lv_font_t %s = {\n", name);
+	printf("    .get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt,\n    .get_glyph_bitmap = lv_font_get_bitmap_fmt_txt,\n");
+	printf("    .line_height = %d,\n    .base_line = %d,\n    .subpx = LV_FONT_SUBPX_NONE,\n", (int)font->line_height, (int)font->base_line);
+	printf("    .underline_position = %d,\n    .underline_thickness = %d,\n", (int)font->underline_position, (int)font->underline_thickness);
+	printf("    .dsc = &font_dsc\n};\n");
+
+	// Report the flash used by each version
+	const size_t subsetSize = bitmap.size() + (glyphs.size() + 1) * sizeof(lv_font_fmt_txt_glyph_dsc_t) + sizeof(lv_font_fmt_txt_cmap_t) + glyphs.size() * sizeof(uint16_t) + kernBytes;
+	size_t hotBytes = 0;
+	for (size_t i = 0; i < glyphs.size(); ++i)
+	{
+		if (glyphs[i].hot)
+		{
+			hotBytes += BitmapSize(dsc, glyphs[i].sourceId);
+		}
+	}
+	const size_t fullSize = FullFontSize(dsc);
+	fprintf(stderr, "Montserrat %d: full font %u bytes, subset of %u glyphs %u bytes (%u%% saved), hot glyph bitmaps %u bytes\n",
+			size, (unsigned int)fullSize, (unsigned int)glyphs.size(), (unsigned int)subsetSize, (unsigned int)(100 - (subsetSize * 100)/fullSize), (unsigned int)hotBytes);
+	return 0;
+}
+
+// End
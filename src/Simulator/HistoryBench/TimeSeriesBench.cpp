@@ -0,0 +1,193 @@
+/*
+ * TimeSeriesBench.cpp
+ *
+ *  Created on: 12 Feb 2023
+ *      Author: David
+ *
+ *  Host program that checks the time-series history store against a plain array of all the samples, then measures its speed.
+ *  - Check: several days of 1 second samples with random gaps are added. Range queries at random places are compared with the minimum,
+ *    maximum and average of the reference samples over the same range, widened to the resolution the store used.
+ *  - Benchmark: a full day of 1 second samples is added and timed, then chart queries of 800 points over the last 15 minutes,
+ *    hour and day are timed, as is a single summary of the whole day.
+ *
+ *  Usage: time-series-bench [check-iterations]
+ */
+
+#include <Telemetry/TimeSeries.h>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+constexpr int32_t UnitsPerCount = 10;				// power in watts, stored to 10W
+constexpr uint32_t SecondsPerDay = 24 * 60 * 60;
+
+static std::mt19937 rng(1);
+
+// A simulated power reading: a slow daily swing, some steps as loads switch, and noise
+static int32_t PowerAt(uint32_t t) noexcept
+{
+	static int32_t step = 0;
+	if (rng() % 600 == 0)
+	{
+		step = (int32_t)(rng() % 6000) - 3000;
+	}
+	const int32_t daily = (int32_t)(4000 * (int32_t)((t % SecondsPerDay) < SecondsPerDay/2 ? (t % SecondsPerDay) : SecondsPerDay - (t % SecondsPerDay)) / (int32_t)(SecondsPerDay/2));
+	return daily + step + (int32_t)(rng() % 200) - 100;
+}
+
+static int32_t Quantise(int32_t value) noexcept
+{
+	const int32_t half = UnitsPerCount/2;
+	return (value >= 0) ? (value + half)/UnitsPerCount : -((half - value)/UnitsPerCount);
+}
+
+// Check range queries against the reference samples, returning the number of mismatches
+static unsigned int Check(unsigned int iterations) noexcept
+{
+	static TimeSeries series(UnitsPerCount);
+	constexpr uint32_t Duration = 5 * SecondsPerDay;
+	std::vector<int32_t> samples(Duration);
+	std::vector<bool> present(Duration, false);
+
+	// Add the samples, leaving occasional gaps of up to a couple of hours
+	for (uint32_t t = 0; t < Duration; ++t)
+	{
+		if (rng() % 20000 == 0)
+		{
+			t += rng() % 7200;
+			if (t >= Duration)
+			{
+				break;
+			}
+		}
+		const int32_t v = PowerAt(t);
+		samples[t] = Quantise(v) * UnitsPerCount;
+		present[t] = true;
+		series.Add(t, v);
+	}
+
+	unsigned int failures = 0;
+	const uint32_t latest = series.GetLatestTime();
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		// Pick a range ending at or before the latest sample, mostly recent but sometimes long
+		const uint32_t length = 1 + rng() % ((i % 4 == 0) ? 4 * SecondsPerDay : 3600);
+		const uint32_t end = latest + 1 - rng() % 1800;
+		const uint32_t start = (end > length) ? end - length : 0;
+		TimeSeries::Summary s;
+		(void)series.Query(start, end, s);
+
+		// Work out the reference results for the range widened to each resolution, and accept the first one that matches.
+		// The average is compared with a tolerance because the downsampled averages are quantised.
+		bool matched = false;
+		for (size_t level = 0; level < TimeSeries::NumLevels && !matched; ++level)
+		{
+			const uint32_t period = TimeSeries::LevelPeriods[level];
+			const uint32_t wideStart = (start/period) * period;
+			const uint32_t wideEnd = std::min<uint32_t>(((end + period - 1)/period) * period, Duration);
+			if (latest - wideStart >= TimeSeries::LevelLengths[level] * period + period)
+			{
+				continue;									// this resolution doesn't go back far enough
+			}
+			int32_t rmin = INT32_MAX, rmax = INT32_MIN;
+			int64_t sum = 0;
+			uint32_t count = 0;
+			for (uint32_t t = wideStart; t < wideEnd; ++t)
+			{
+				if (present[t])
+				{
+					rmin = std::min(rmin, samples[t]);
+					rmax = std::max(rmax, samples[t]);
+					sum += samples[t];
+					++count;
+				}
+			}
+			if (count == s.count && (count == 0 || (rmin == s.min && rmax == s.max && llabs(sum/(int64_t)count - s.avg) <= UnitsPerCount)))
+			{
+				matched = true;
+			}
+		}
+		if (!matched)
+		{
+			if (++failures <= 10)
+			{
+				printf("Mismatch for %u..%u: min %d max %d avg %d count %u\n", (unsigned int)start, (unsigned int)end, (int)s.min, (int)s.max, (int)s.avg, (unsigned int)s.count);
+			}
+		}
+	}
+
+	// Check that chart queries account for every sample exactly once when the raw samples cover the range
+	TimeSeries::Summary points[800];
+	const uint32_t chartStart = latest + 1 - 800;
+	const size_t n = series.QueryBuckets(chartStart, latest + 1, points, 800);
+	uint32_t chartCount = 0, refCount = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		chartCount += points[i].count;
+	}
+	for (uint32_t t = chartStart; t <= latest; ++t)
+	{
+		refCount += present[t];
+	}
+	if (chartCount != refCount)
+	{
+		printf("Chart query counted %u samples instead of %u\n", (unsigned int)chartCount, (unsigned int)refCount);
+		++failures;
+	}
+	return failures;
+}
+
+template<class F> static double TimeNanoseconds(F f, unsigned int repeats) noexcept
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < repeats; ++i)
+	{
+		f();
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count()/repeats;
+}
+
+static void Benchmark() noexcept
+{
+	static TimeSeries series(UnitsPerCount);
+	std::vector<int32_t> values(SecondsPerDay);
+	for (uint32_t t = 0; t < SecondsPerDay; ++t)
+	{
+		values[t] = PowerAt(t);
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+	for (uint32_t t = 0; t < SecondsPerDay; ++t)
+	{
+		series.Add(t, values[t]);
+	}
+	const double insertTime = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count()/SecondsPerDay;
+	printf("Insert: %.1f ns per sample, %u bytes per series\n", insertTime, (unsigned int)sizeof(TimeSeries));
+
+	static TimeSeries::Summary points[800];
+	volatile uint32_t total = 0;
+	const uint32_t end = series.GetLatestTime() + 1;
+	const uint32_t ranges[] = { 15 * 60, 60 * 60, SecondsPerDay };
+	for (const uint32_t range : ranges)
+	{
+		const double t = TimeNanoseconds([&]() { total = total + series.QueryBuckets(end - range, end, points, 800); }, 200);
+		printf("Chart of %u seconds in 800 points: %.1f us\n", (unsigned int)range, t/1000.0);
+	}
+	TimeSeries::Summary s;
+	const double t = TimeNanoseconds([&]() { total = total + series.Query(0, end, s); }, 10000);
+	printf("Summary of the whole day: %.1f us (min %d, max %d, avg %d)\n", t/1000.0, (int)s.min, (int)s.max, (int)s.avg);
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned int iterations = (argc > 1) ? (unsigned int)atoi(argv[1]) : 20000;
+	const unsigned int failures = Check(iterations);
+	printf("Check: %u queries, %u failures\n", iterations, failures);
+	Benchmark();
+	return (failures == 0) ? 0 : 1;
+}
+
+// End
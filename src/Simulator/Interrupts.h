@@ -0,0 +1,41 @@
+/*
+ * Interrupts.h
+ *
+ *  Created on: 23 Feb 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the CoreN2G Interrupts.h. There are no pin interrupts in the simulator, so attaching one does nothing.
+ */
+
+#ifndef SRC_SIMULATOR_INTERRUPTS_H_
+#define SRC_SIMULATOR_INTERRUPTS_H_
+
+#include "CoreIO.h"
+
+union CallbackParameter
+{
+	void *vp;
+	uint32_t u32;
+	int32_t i32;
+
+	CallbackParameter(void *pp) noexcept : vp(pp) { }
+	CallbackParameter(uint32_t pp) noexcept : u32(pp) { }
+	CallbackParameter() noexcept : u32(0) { }
+};
+
+typedef void (*StandardCallbackFunction)(CallbackParameter) noexcept;
+
+enum class InterruptMode : uint8_t
+{
+	none = 0,
+	low,
+	high,
+	change,
+	falling,
+	rising
+};
+
+inline bool attachInterrupt(Pin pin, StandardCallbackFunction callback, InterruptMode mode, CallbackParameter param) noexcept { return true; }
+inline void detachInterrupt(Pin pin) noexcept { }
+
+#endif /* SRC_SIMULATOR_INTERRUPTS_H_ */
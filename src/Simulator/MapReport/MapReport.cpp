@@ -0,0 +1,161 @@
+/*
+ * MapReport.cpp
+ *
+ *  Created on: 21 Feb 2023
+ *      Author: David
+ *
+ *  Host program that reads the linker map file of the firmware and lists the code that runs from RAM, which is everything between the
+ *  __ram_code_start and __ram_code_end symbols defined in rp2040_flash.ld. Each input section is printed with its size and the object
+ *  file it came from, largest first, followed by the total for each object file and the overall total. Functions marked TIME_CRITICAL
+ *  appear as .time_critical.<name>; library code placed in RAM by the linker script appears as .text sections.
+ *
+ *  Usage: map-report <file.map>
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cinttypes>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+struct InputSection
+{
+	std::string name;
+	std::string file;
+	uint32_t address;
+	uint32_t size;
+};
+
+// Parse "0x..." into value, returning false if the token isn't a hex number
+static bool ParseHex(const char *token, uint32_t& value) noexcept
+{
+	if (strncmp(token, "0x", 2) != 0)
+	{
+		return false;
+	}
+	char *end;
+	value = (uint32_t)strtoull(token + 2, &end, 16);
+	return *end == 0;
+}
+
+// Return the part of a path after the last directory separator
+static std::string BaseName(const char *path) noexcept
+{
+	const char *p = path;
+	for (const char *q = path; *q != 0 && *q != '('; ++q)
+	{
+		if (*q == '/' || *q == '\\')
+		{
+			p = q + 1;
+		}
+	}
+	return p;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "Usage: map-report <file.map>\n");
+		return 1;
+	}
+	FILE * const f = fopen(argv[1], "r");
+	if (f == nullptr)
+	{
+		fprintf(stderr, "Can't open %s\n", argv[1]);
+		return 1;
+	}
+
+	// An input section line starts with a space and the section name. The address, size and file follow on the same line,
+	// or on the next line if the name is long. Symbol assignments are an address followed by "name = value".
+	std::vector<InputSection> sections;
+	std::string pendingName;
+	uint32_t start = 0, end = 0;
+	bool haveStart = false, haveEnd = false;
+	char line[1024];
+	while (fgets(line, sizeof(line), f) != nullptr)
+	{
+		line[strcspn(line, "\r\n")] = 0;
+		char *tokens[4];
+		size_t numTokens = 0;
+		const bool startsWithName = line[0] == ' ' && line[1] == '.';
+		for (char *t = strtok(line, " \t"); t != nullptr && numTokens < 4; t = strtok(nullptr, " \t"))
+		{
+			tokens[numTokens++] = t;
+		}
+
+		uint32_t address, size;
+		if (numTokens >= 3 && ParseHex(tokens[0], address) && strcmp(tokens[2], "=") == 0)
+		{
+			if (strcmp(tokens[1], "__ram_code_start") == 0)
+			{
+				start = address;
+				haveStart = true;
+			}
+			else if (strcmp(tokens[1], "__ram_code_end") == 0)
+			{
+				end = address;
+				haveEnd = true;
+			}
+			pendingName.clear();
+		}
+		else if (startsWithName && numTokens == 1)
+		{
+			pendingName = tokens[0];
+		}
+		else if (startsWithName && numTokens == 4 && ParseHex(tokens[1], address) && ParseHex(tokens[2], size))
+		{
+			sections.push_back(InputSection{ tokens[0], BaseName(tokens[3]), address, size });
+			pendingName.clear();
+		}
+		else if (!pendingName.empty() && numTokens == 3 && ParseHex(tokens[0], address) && ParseHex(tokens[1], size))
+		{
+			sections.push_back(InputSection{ pendingName, BaseName(tokens[2]), address, size });
+			pendingName.clear();
+		}
+		else
+		{
+			pendingName.clear();
+		}
+	}
+	fclose(f);
+
+	if (!haveStart || !haveEnd)
+	{
+		fprintf(stderr, "The map file doesn't define __ram_code_start and __ram_code_end\n");
+		return 1;
+	}
+
+	std::vector<InputSection> ramCode;
+	for (const InputSection& s : sections)
+	{
+		if (s.size != 0 && s.address >= start && s.address < end)
+		{
+			ramCode.push_back(s);
+		}
+	}
+	std::sort(ramCode.begin(), ramCode.end(), [](const InputSection& a, const InputSection& b) { return a.size > b.size; });
+
+	printf("%8s  %-40s %s\n", "bytes", "section", "file");
+	std::map<std::string, uint32_t> fileTotals;
+	uint32_t total = 0;
+	for (const InputSection& s : ramCode)
+	{
+		printf("%8" PRIu32 "  %-40s %s\n", s.size, s.name.c_str(), s.file.c_str());
+		fileTotals[s.file] += s.size;
+		total += s.size;
+	}
+
+	printf("\n%8s  %s\n", "bytes", "file");
+	for (const auto& ft : fileTotals)
+	{
+		printf("%8" PRIu32 "  %s\n", ft.second, ft.first.c_str());
+	}
+	printf("\n%8" PRIu32 "  total in sections, %" PRIu32 " bytes from 0x%08" PRIx32 " to 0x%08" PRIx32 " including alignment\n", total, end - start, start, end);
+	return 0;
+}
+
+// End
@@ -0,0 +1,110 @@
+/*
+ * PioBusSim.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator version of PioBus. It runs the PIO programs from PioPrograms.h in a model of a state machine, which drives the pins
+ *  of the virtual SSD1963 and counts the PIO clocks, and completes each transfer before returning.
+ */
+
+#include <Drivers/PioBus.h>
+#include <Drivers/PioPrograms.h>
+#include "PioStateMachine.h"
+#include "SimPins.h"
+#include "VirtualSSD1963.h"
+#include <Pins.h>
+#include <hardware/timer.h>
+#include <pico/multicore.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace PioBus;
+using namespace PioPrograms;
+
+constexpr PioStateMachine::Config PixelConfig =
+	{ PixelProgram, PixelProgramLength, PixelProgramWrapTop, DisplayLowestDataPin, 8, DisplayLatchLowDataPin, SideSetBits, PixelPullThreshold };
+constexpr PioStateMachine::Config RunConfig =
+	{ RunProgram, RunProgramLength, RunProgramWrapTop, DisplayLowestDataPin, 8, DisplayLatchLowDataPin, SideSetBits, RunPullThreshold };
+
+static PioStateMachine machine(SimPins::PioWriteMasked);
+static const PioStateMachine::Config *currentConfig = nullptr;
+static CompletionCallback completionCallback = nullptr;
+static InterruptStats interruptStats;
+
+// Call the completion callback as the interrupt handler would, on core 0 and timing it the same way
+static void Complete() noexcept
+{
+	const uint32_t startTime = time_us_32();
+	SimCallOnCore0(completionCallback);
+	const uint32_t isrTime = time_us_32() - startTime;
+	++interruptStats.interrupts;
+	interruptStats.totalTime += isrTime;
+	if (isrTime > interruptStats.maxTime)
+	{
+		interruptStats.maxTime = isrTime;
+	}
+}
+
+// Load the program for the type of data we are about to send, as PioBus.cpp does when the type changes
+static void SetMode(const PioStateMachine::Config& config) noexcept
+{
+	if (&config != currentConfig)
+	{
+		machine.Init(config);
+		currentConfig = &config;
+	}
+}
+
+// Run a transfer that has been put in the state machine's FIFO, then complete it
+static void Run() noexcept
+{
+	const uint64_t startClocks = machine.GetClocks();
+	machine.SetPins(SimPins::GetOutputs());
+	if (!machine.Run())
+	{
+		fprintf(stderr, "PIO program failed: %s\n", machine.GetError());
+		abort();
+	}
+	VirtualSSD1963::AddPioClocks(machine.GetClocks() - startClocks);
+	Complete();
+}
+
+void PioBus::Init(CompletionCallback cb) noexcept
+{
+	completionCallback = cb;
+}
+
+void PioBus::StartTransfer(const uint16_t *data, size_t numPixels) noexcept
+{
+	SetMode(PixelConfig);
+	machine.Put(numPixels - 1);
+	for (size_t i = 0; i < numPixels; ++i)
+	{
+		machine.Put(data[i] * 0x00010001u);				// a 16-bit DMA transfer to the FIFO writes the data to both halves of the word
+	}
+	Run();
+}
+
+void PioBus::StartRunTransfer(const uint32_t *runs, size_t numRuns) noexcept
+{
+	SetMode(RunConfig);
+	machine.Put(numRuns - 1);
+	for (size_t i = 0; i < numRuns; ++i)
+	{
+		machine.Put(runs[i]);
+	}
+	Run();
+}
+
+bool PioBus::IsBusy() noexcept
+{
+	return false;
+}
+
+void PioBus::GetInterruptStats(InterruptStats& stats) noexcept
+{
+	stats = interruptStats;
+}
+
+// End
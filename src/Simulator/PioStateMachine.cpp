@@ -0,0 +1,157 @@
+/*
+ * PioStateMachine.cpp
+ *
+ *  Created on: 20 Mar 2023
+ *      Author: David
+ *
+ *  The side-set and any pin output of an instruction take effect at the clock on which it starts, and the delay bits add clocks after it.
+ *  An out instruction that finds the OSR empty pulls from the FIFO at no cost, or stalls if the FIFO is empty.
+ */
+
+#include "PioStateMachine.h"
+
+PioStateMachine::PioStateMachine(PinWriter w) noexcept
+	: config(), pinWriter(w), clocks(0), pins(0), osr(0), x(0), y(0), osrCount(32), pc(0), error(nullptr)
+{
+}
+
+void PioStateMachine::Init(const Config& c) noexcept
+{
+	config = c;
+	fifo.clear();
+	osr = 0;
+	osrCount = 32;
+	pc = 0;
+	error = nullptr;
+}
+
+void PioStateMachine::Put(uint32_t word) noexcept
+{
+	fifo.push_back(word);
+}
+
+bool PioStateMachine::Run() noexcept
+{
+	for (;;)
+	{
+		switch (Step())
+		{
+		case Result::ok:
+			break;
+
+		case Result::irq:
+			return true;
+
+		case Result::stalled:
+			error = "stalled waiting for data";
+			return false;
+
+		case Result::error:
+			return false;
+		}
+	}
+}
+
+void PioStateMachine::WritePins(uint32_t mask, uint32_t values) noexcept
+{
+	values &= mask;
+	if ((pins & mask) != values)
+	{
+		pins = (pins & ~mask) | values;
+		pinWriter(mask, values);
+	}
+}
+
+// Execute one instruction
+PioStateMachine::Result PioStateMachine::Step() noexcept
+{
+	const uint16_t instr = config.program[pc];
+	const unsigned int delayBits = 5 - config.sideSetBits;
+	const uint32_t sideSet = (instr >> (8 + delayBits)) & ((1u << config.sideSetBits) - 1);
+	const uint32_t delay = (instr >> 8) & ((1u << delayBits) - 1);
+	const uint32_t sideSetMask = ((1u << config.sideSetBits) - 1) << config.sideSetBase;
+	unsigned int nextPc = (pc == config.wrapTop) ? 0 : pc + 1;
+	Result result = Result::ok;
+
+	switch (instr >> 13)
+	{
+	case 0:			// jmp
+		{
+			bool jump;
+			switch ((instr >> 5) & 7)
+			{
+			case 0:		jump = true; break;
+			case 2:		jump = x != 0; --x; break;
+			case 4:		jump = y != 0; --y; break;
+			default:	error = "unsupported jmp condition"; return Result::error;
+			}
+			if (jump)
+			{
+				nextPc = instr & 0x1F;
+			}
+			WritePins(sideSetMask, sideSet << config.sideSetBase);
+		}
+		break;
+
+	case 3:			// out
+		{
+			if (osrCount >= config.pullThreshold)
+			{
+				if (fifo.empty())
+				{
+					WritePins(sideSetMask, sideSet << config.sideSetBase);		// side-set takes effect even while the instruction stalls
+					return Result::stalled;
+				}
+				osr = fifo.front();
+				fifo.pop_front();
+				osrCount = 0;
+			}
+			const unsigned int bitCount = ((instr & 0x1F) == 0) ? 32 : (instr & 0x1F);
+			const uint32_t data = (bitCount == 32) ? osr : osr & ((1u << bitCount) - 1);
+			osr = (bitCount == 32) ? 0 : osr >> bitCount;
+			osrCount += bitCount;
+			switch ((instr >> 5) & 7)
+			{
+			case 0:
+				{
+					const uint32_t outMask = ((config.outCount == 32) ? 0xFFFFFFFFu : (1u << config.outCount) - 1) << config.outBase;
+					WritePins(sideSetMask | outMask, (sideSet << config.sideSetBase) | (data << config.outBase));
+				}
+				break;
+			case 1:		x = data; WritePins(sideSetMask, sideSet << config.sideSetBase); break;
+			case 2:		y = data; WritePins(sideSetMask, sideSet << config.sideSetBase); break;
+			default:	error = "unsupported out destination"; return Result::error;
+			}
+		}
+		break;
+
+	case 5:			// mov
+		if ((instr & 0xFF) != 0x42)
+		{
+			error = "unsupported mov";
+			return Result::error;
+		}
+		WritePins(sideSetMask, sideSet << config.sideSetBase);
+		break;
+
+	case 6:			// irq
+		if ((instr & 0x60) != 0)
+		{
+			error = "unsupported irq clear or wait";
+			return Result::error;
+		}
+		WritePins(sideSetMask, sideSet << config.sideSetBase);
+		result = Result::irq;
+		break;
+
+	default:
+		error = "unsupported instruction";
+		return Result::error;
+	}
+
+	clocks += 1 + delay;
+	pc = nextPc;
+	return result;
+}
+
+// End
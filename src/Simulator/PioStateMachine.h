@@ -0,0 +1,66 @@
+/*
+ * PioStateMachine.h
+ *
+ *  Created on: 20 Mar 2023
+ *      Author: David
+ *
+ *  Host model of an RP2040 PIO state machine, enough to run the display bus programs in src/Drivers/PioPrograms.h one instruction at a time.
+ *  It decodes the instruction words themselves, including the side-set and delay bits, and counts PIO clocks. Only the instructions and
+ *  settings that the programs use are supported: out to pins, X or Y with autopull and right shift, jmp (always, X-- and Y--), mov y,y
+ *  and irq set. The TX FIFO has no size limit.
+ */
+
+#ifndef SRC_SIMULATOR_PIOSTATEMACHINE_H_
+#define SRC_SIMULATOR_PIOSTATEMACHINE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+
+class PioStateMachine
+{
+public:
+	struct Config
+	{
+		const uint16_t *program;
+		unsigned int length;
+		unsigned int wrapTop;				// the wrap goes back to instruction 0
+		unsigned int outBase;
+		unsigned int outCount;
+		unsigned int sideSetBase;
+		unsigned int sideSetBits;			// not optional
+		unsigned int pullThreshold;
+	};
+
+	// Called with each change the state machine makes to its output pins, with the bits that it drives and their new values
+	typedef void (*PinWriter)(uint32_t mask, uint32_t values) noexcept;
+
+	explicit PioStateMachine(PinWriter w) noexcept;
+
+	void Init(const Config& c) noexcept;	// like pio_sm_init: load the settings and start at instruction 0 with the FIFO and output shift register empty
+	void SetPins(uint32_t p) noexcept { pins = p; }		// tell the state machine the pin levels when it takes the pins over
+	void Put(uint32_t word) noexcept;
+	bool Run() noexcept;					// run until the program raises its interrupt, returning false if it stalls or meets an instruction we don't support first
+	uint64_t GetClocks() const noexcept { return clocks; }
+	uint32_t GetPins() const noexcept { return pins; }
+	const char *GetError() const noexcept { return error; }
+
+private:
+	enum class Result : uint8_t { ok, stalled, irq, error };
+
+	Result Step() noexcept;
+	void WritePins(uint32_t mask, uint32_t values) noexcept;
+
+	Config config;
+	PinWriter pinWriter;
+	std::deque<uint32_t> fifo;
+	uint64_t clocks;
+	uint32_t pins;
+	uint32_t osr;
+	uint32_t x, y;
+	unsigned int osrCount;					// bits shifted out of the OSR since it was filled
+	unsigned int pc;
+	const char *error;
+};
+
+#endif /* SRC_SIMULATOR_PIOSTATEMACHINE_H_ */
@@ -0,0 +1,166 @@
+/*
+ * QueueCheck.cpp
+ *
+ *  Created on: 1 Mar 2023
+ *      Author: David
+ *
+ *  Host stress test for the lock-free structures that pass data between the cores and between tasks, meant to be built with ThreadSanitizer.
+ *  A producer thread puts numbered items into an SpscQueue as fast as it can while a consumer thread takes them out, checking that every item
+ *  arrives once, in order and intact. The queue is kept short so that it is full or empty much of the time, and the threads yield when they
+ *  can't make progress so that the test doesn't depend on having a core for each of them. Then a writer thread publishes items to a Mailbox
+ *  while a reader thread reads it, checking that no item it reads was torn and that the items never go backwards.
+ *  ThreadSanitizer reports any access to shared data that isn't ordered by the atomics.
+ *
+ *  Usage: queue-check [items]
+ */
+
+#include <SpscQueue.h>
+#include <Mailbox.h>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// An item whose words all depend on its number, so that a torn copy can be detected
+struct Item
+{
+	uint32_t number;
+	uint32_t words[7];
+
+	static Item Make(uint32_t n) noexcept
+	{
+		Item item;
+		item.number = n;
+		for (size_t i = 0; i < 7; ++i)
+		{
+			item.words[i] = n * 2654435761u + (uint32_t)i;
+		}
+		return item;
+	}
+
+	bool IsIntact() const noexcept
+	{
+		for (size_t i = 0; i < 7; ++i)
+		{
+			if (words[i] != number * 2654435761u + (uint32_t)i)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+static SpscQueue<Item, 4> queue;
+static Mailbox<Item> mailbox;
+
+static unsigned int CheckQueue(uint32_t numItems) noexcept
+{
+	unsigned int failures = 0;
+	uint32_t fullCount = 0, emptyCount = 0, maxCount = 0;
+	std::thread producer([numItems, &fullCount]() noexcept
+		{
+			for (uint32_t n = 0; n < numItems; )
+			{
+				if (queue.Put(Item::Make(n)))
+				{
+					++n;
+				}
+				else
+				{
+					++fullCount;
+					std::this_thread::yield();
+				}
+			}
+		});
+	std::thread consumer([numItems, &failures, &emptyCount, &maxCount]() noexcept
+		{
+			for (uint32_t expected = 0; expected < numItems; )
+			{
+				const uint32_t count = queue.Count();
+				if (count > maxCount)
+				{
+					maxCount = count;
+				}
+				Item item;
+				if (!queue.Get(item))
+				{
+					++emptyCount;
+					std::this_thread::yield();
+					continue;
+				}
+				if (item.number != expected || !item.IsIntact())
+				{
+					if (failures < 10)
+					{
+						printf("queue: expected item %u, got item %u%s\n", expected, item.number, (item.IsIntact()) ? "" : " torn");
+					}
+					++failures;
+				}
+				expected = item.number + 1;
+			}
+		});
+	producer.join();
+	consumer.join();
+	if (!queue.IsEmpty() || maxCount > 4)
+	{
+		printf("queue: not empty at the end, or held %u items\n", maxCount);
+		++failures;
+	}
+	printf("queue: %u items, found full %u times and empty %u times, %u failures\n", numItems, fullCount, emptyCount, failures);
+	return failures;
+}
+
+static unsigned int CheckMailbox(uint32_t numItems) noexcept
+{
+	unsigned int failures = 0;
+	uint32_t reads = 0, busyReads = 0;
+	std::thread writer([numItems]() noexcept
+		{
+			for (uint32_t n = 1; n <= numItems; ++n)
+			{
+				mailbox.Publish(Item::Make(n));
+				if (n % 16 == 0)
+				{
+					std::this_thread::yield();				// let the reader in between updates as well as during them
+				}
+			}
+		});
+	std::thread reader([numItems, &failures, &reads, &busyReads]() noexcept
+		{
+			uint32_t last = 0;
+			while (last < numItems)
+			{
+				Item item;
+				if (!mailbox.Read(item))
+				{
+					++busyReads;
+					std::this_thread::yield();
+					continue;
+				}
+				++reads;
+				if (item.number < last || !item.IsIntact())
+				{
+					if (failures < 10)
+					{
+						printf("mailbox: read item %u after item %u%s\n", item.number, last, (item.IsIntact()) ? "" : " torn");
+					}
+					++failures;
+				}
+				last = item.number;
+			}
+		});
+	writer.join();
+	reader.join();
+	printf("mailbox: %u items, %u reads, %u reads found it empty or being updated, %u failures\n", numItems, reads, busyReads, failures);
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	const uint32_t numItems = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1000000;
+	unsigned int failures = CheckQueue(numItems);
+	failures += CheckMailbox(numItems);
+	return (failures == 0) ? 0 : 1;
+}
+
+// End
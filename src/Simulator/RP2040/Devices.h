@@ -0,0 +1,28 @@
+/*
+ * Devices.h
+ *
+ *  Created on: 28 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the USB serial device. Nothing is ever received and output goes to stderr.
+ */
+
+#ifndef SRC_SIMULATOR_RP2040_DEVICES_H_
+#define SRC_SIMULATOR_RP2040_DEVICES_H_
+
+#include <Core.h>
+#include <cstdio>
+
+class SimSerial
+{
+public:
+	bool IsConnected() const noexcept { return false; }
+	int available() const noexcept { return 0; }
+	int read() noexcept { return -1; }
+	size_t readBytes(char *buffer, size_t length) noexcept { return 0; }
+	size_t write(const uint8_t *buffer, size_t size) noexcept { return fwrite(buffer, 1, size, stderr); }
+};
+
+inline SimSerial serialUSB;
+
+#endif /* SRC_SIMULATOR_RP2040_DEVICES_H_ */
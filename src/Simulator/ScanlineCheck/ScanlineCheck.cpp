@@ -0,0 +1,257 @@
+/*
+ * ScanlineCheck.cpp
+ *
+ *  Created on: 23 Feb 2023
+ *      Author: David
+ *
+ *  Host program that checks the frame scheduler against a model of the panel scan.
+ *  The panel scans one row per line time, starting at row 0 when the tearing effect output falls, and its real frame period is a little
+ *  different from the nominal one, as it would be with crystal tolerance. The edges reach the scheduler after a random interrupt latency, and
+ *  a few of them don't reach it at all.
+ *  Flushes of random areas arrive at random times, each written at an even rate that depends on its width and on whether it is sent as runs.
+ *  For each one the scheduler chooses the start time, and the model checks row by row that no pass of the scan sees part of the old contents
+ *  and part of the new, which is what shows as a tear. The same flushes started at once are checked too, for comparison.
+ *  Then it checks that the scheduler measures the frame period again when the panel timing changes and keeps it when only every other edge arrives,
+ *  and feeds the scheduler frames of different lengths and checks the refresh periods it chooses and the late and dropped frames it counts.
+ *
+ *  Usage: scanline-check [flushes]
+ */
+
+#include <Drivers/FrameScheduler.h>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+constexpr uint32_t LineNanoseconds = 37160;				// 929 pixel clocks at 25MHz
+constexpr uint16_t TotalLines = 526;
+constexpr uint16_t VisibleLines = 480;
+constexpr double RealLineNanoseconds = LineNanoseconds * 1.003;
+constexpr uint64_t StartTime = 4290000000ull * 1000;		// nanoseconds, so that time_us_32() wraps during the run
+constexpr unsigned int WarmUpEdges = 100;				// let the scheduler measure the frame period before we count tears
+constexpr unsigned int MissedEdgeOneIn = 20;			// the proportion of edges that the scheduler doesn't see
+
+static std::mt19937 rng(1);
+static uint64_t nextEdge = StartTime;					// time of the next falling edge in nanoseconds
+static uint64_t edgeNumber = 0;
+
+static uint64_t EdgeTime(uint64_t n) noexcept
+{
+	return StartTime + (uint64_t)(n * RealLineNanoseconds * TotalLines);
+}
+
+// Give the scheduler the edges up to a time, each after a random interrupt latency of up to 20us, leaving some of them out
+static void DeliverEdges(uint64_t now) noexcept
+{
+	while (nextEdge + 20000 <= now)
+	{
+		if (edgeNumber < WarmUpEdges/2 || rng() % MissedEdgeOneIn != 0)
+		{
+			FrameScheduler::TearEdge((uint32_t)((nextEdge + rng() % 20000)/1000));
+		}
+		nextEdge = EdgeTime(++edgeNumber);
+	}
+}
+
+// Return true if some pass of the scan sees part of a write of rows y1 to y2 that starts at 'start' and writes one row every rowTime nanoseconds
+static bool Tears(uint64_t start, double rowTime, unsigned int y1, unsigned int y2) noexcept
+{
+	const uint64_t end = start + (uint64_t)((y2 - y1 + 1) * rowTime);
+	const uint64_t firstPass = (start > StartTime + (uint64_t)(RealLineNanoseconds * TotalLines)) ? (uint64_t)((start - StartTime)/(RealLineNanoseconds * TotalLines)) - 1 : 0;
+	for (uint64_t pass = firstPass; EdgeTime(pass) <= end; ++pass)
+	{
+		bool seenOld = false, seenNew = false;
+		for (unsigned int r = y1; r <= y2; ++r)
+		{
+			const double scan = EdgeTime(pass) + r * RealLineNanoseconds;
+			const double writeStart = start + (r - y1) * rowTime;
+			if (scan < writeStart)
+			{
+				seenOld = true;
+			}
+			else if (scan > writeStart + rowTime)
+			{
+				seenNew = true;
+			}
+			else
+			{
+				return true;
+			}
+		}
+		if (seenOld && seenNew)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static unsigned int CheckFlushes(unsigned int numFlushes) noexcept
+{
+	unsigned int pacedTears = 0, unpacedTears = 0, counted = 0, tooLate = 0;
+	uint64_t now = StartTime, busyUntil = StartTime;
+	for (unsigned int i = 0; i < numFlushes; ++i)
+	{
+		// Mostly full width bands as LVGL sends them when a large area changes, the rest labels and chart columns
+		unsigned int y1, y2;
+		double rowTime;
+		switch (rng() % 4)
+		{
+		case 0:
+		case 1:
+			y1 = rng() % VisibleLines;
+			y2 = y1 + rng() % 24;
+			rowTime = (rng() & 1) ? 800 * 7 * 8.0 : 800 * 7 * 8.0 * (0.1 + 0.8 * (rng() % 100)/100.0);
+			break;
+
+		case 2:
+			y1 = rng() % VisibleLines;
+			y2 = y1 + rng() % 30;
+			rowTime = (20 + rng() % 200) * 7 * 8.0;
+			break;
+
+		default:
+			y1 = rng() % 100;
+			y2 = y1 + rng() % (VisibleLines - y1);
+			rowTime = (1 + rng() % 5) * 7 * 8.0;
+			break;
+		}
+		if (y2 >= VisibleLines)
+		{
+			y2 = VisibleLines - 1;
+		}
+
+		now = ((now > busyUntil) ? now : busyUntil) + rng() % 25000000;
+		DeliverEdges(now);
+		const uint32_t nowMicros = (uint32_t)(now/1000);
+		const uint32_t writeNanoseconds = (uint32_t)((y2 - y1 + 1) * rowTime);
+		const uint32_t startMicros = FrameScheduler::GetStartTime(nowMicros, y1, y2, writeNanoseconds);
+		const uint64_t start = now - (now % 1000) + (uint64_t)(uint32_t)(startMicros - nowMicros) * 1000;
+		if (start > now + 1000 + (uint64_t)(RealLineNanoseconds * TotalLines))
+		{
+			++tooLate;
+		}
+		busyUntil = start + writeNanoseconds;
+		if (edgeNumber >= WarmUpEdges)
+		{
+			++counted;
+			if (Tears(start, rowTime, y1, y2))
+			{
+				++pacedTears;
+			}
+			if (Tears(now, rowTime, y1, y2))
+			{
+				++unpacedTears;
+			}
+		}
+	}
+
+	const FrameScheduler::Stats& s = FrameScheduler::GetStats();
+	printf("%u flushes checked: %u tore when paced, %u would have torn if started at once, %u started more than a frame late\n", counted, pacedTears, unpacedTears, tooLate);
+	printf("Measured frame period %uns (real %.0fns), %u edges missed, %u flushes paced, average wait %uus, %u unsynchronised, %u with no tear-free start\n",
+			(unsigned int)s.framePeriod, RealLineNanoseconds * TotalLines, (unsigned int)s.missedEdges, (unsigned int)s.pacedFlushes,
+			(s.pacedFlushes == 0) ? 0 : (unsigned int)(s.paceWaitTime/s.pacedFlushes), (unsigned int)s.unsyncedFlushes, (unsigned int)s.unsafeFlushes);
+	return pacedTears + tooLate + s.unsafeFlushes;
+}
+
+// Give the scheduler edges at a new frame period, then only every other edge, and check that it measures the new period and keeps pacing
+static unsigned int CheckEdgeRecovery() noexcept
+{
+	unsigned int failures = 0;
+	const FrameScheduler::Stats& s = FrameScheduler::GetStats();
+	const uint32_t newPeriod = (LineNanoseconds * TotalLines * 13)/10;			// as if the panel timing had been changed by 30%
+	const uint32_t resyncsBefore = s.resyncs, missedBefore = s.missedEdges;
+	uint64_t t = EdgeTime(edgeNumber) + 100 * (uint64_t)newPeriod;
+	for (unsigned int i = 0; i < 50; ++i)
+	{
+		t += newPeriod;
+		FrameScheduler::TearEdge((uint32_t)((t + rng() % 20000)/1000));
+	}
+	printf("New frame period %uns: measured %uns after %u resyncs\n", (unsigned int)newPeriod, (unsigned int)s.framePeriod, (unsigned int)(s.resyncs - resyncsBefore));
+	if (s.resyncs - resyncsBefore != 1 || s.framePeriod > newPeriod + newPeriod/200 || s.framePeriod < newPeriod - newPeriod/200)
+	{
+		++failures;
+	}
+
+	const uint32_t unsyncedBefore = s.unsyncedFlushes;
+	for (unsigned int i = 0; i < 50; ++i)
+	{
+		t += 2 * (uint64_t)newPeriod;
+		FrameScheduler::TearEdge((uint32_t)((t + rng() % 20000)/1000));
+		(void)FrameScheduler::GetStartTime((uint32_t)((t + 30000)/1000), 100, 120, 1000000);
+	}
+	printf("Every other edge missed: measured %uns, %u edges missed, %u unsynchronised flushes\n",
+			(unsigned int)s.framePeriod, (unsigned int)(s.missedEdges - missedBefore), (unsigned int)(s.unsyncedFlushes - unsyncedBefore));
+	if (s.missedEdges - missedBefore != 50 || s.unsyncedFlushes != unsyncedBefore || s.framePeriod > newPeriod + newPeriod/200 || s.framePeriod < newPeriod - newPeriod/200)
+	{
+		++failures;
+	}
+
+	// Go back to the original panel timing. This is close enough to the new one that the scheduler may follow it without measuring it from scratch.
+	const uint32_t realPeriod = (uint32_t)(RealLineNanoseconds * TotalLines);
+	for (unsigned int i = 0; i < 50; ++i)
+	{
+		t += realPeriod;
+		FrameScheduler::TearEdge((uint32_t)((t + rng() % 20000)/1000));
+	}
+	printf("Back to frame period %uns: measured %uns after %u resyncs\n", (unsigned int)realPeriod, (unsigned int)s.framePeriod, (unsigned int)(s.resyncs - resyncsBefore));
+	if (s.framePeriod > realPeriod + realPeriod/200 || s.framePeriod < realPeriod - realPeriod/200)
+	{
+		++failures;
+	}
+	return failures;
+}
+
+// Feed the scheduler a number of frames of one length, returning the refresh period it ends up with
+static uint32_t RunFrames(unsigned int numFrames, uint32_t frameMicroseconds) noexcept
+{
+	static uint32_t t = 0;
+	for (unsigned int i = 0; i < numFrames; ++i)
+	{
+		FrameScheduler::FrameCompleted(t, t + frameMicroseconds);
+		t += 50000;
+	}
+	return FrameScheduler::GetRefreshPeriod();
+}
+
+static unsigned int CheckRefreshPeriod() noexcept
+{
+	unsigned int failures = 0;
+	const FrameScheduler::Stats& s = FrameScheduler::GetStats();
+	struct Step { unsigned int frames; uint32_t frameMicroseconds; uint32_t expectedPeriod; uint32_t expectedLate; };
+	static const Step steps[] =
+	{
+		{ 50, 12000, 20, 0 },						// fits in one panel frame
+		{ 1, 30000, 39, 1 },						// late, so the period goes up to two panel frames at once
+		{ 10, 30000, 39, 0 },
+		{ 1, 100000, 118, 1 },						// very late, and the period goes up to the six frames it needs
+		{ FrameScheduler::FramesBeforeSpeedUp - 1, 12000, 118, 0 },	// short frames don't bring it down straight away
+		{ 1, 12000, 98, 0 },						// but then it comes down one frame at a time
+		{ 4 * FrameScheduler::FramesBeforeSpeedUp, 12000, 20, 0 },
+	};
+	for (const Step& step : steps)
+	{
+		const uint32_t lateBefore = s.lateFrames;
+		const uint32_t period = RunFrames(step.frames, step.frameMicroseconds);
+		const uint32_t late = s.lateFrames - lateBefore;
+		printf("%u frames of %uus: refresh period %ums, %u late, %u dropped so far\n",
+				step.frames, (unsigned int)step.frameMicroseconds, (unsigned int)period, (unsigned int)late, (unsigned int)s.droppedFrames);
+		if (period != step.expectedPeriod || late != step.expectedLate)
+		{
+			printf("  expected %ums and %u late\n", (unsigned int)step.expectedPeriod, (unsigned int)step.expectedLate);
+			++failures;
+		}
+	}
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned int numFlushes = (argc > 1) ? (unsigned int)atoi(argv[1]) : 100000;
+	FrameScheduler::Init(LineNanoseconds, TotalLines);
+	const unsigned int flushFailures = CheckFlushes(numFlushes);
+	const unsigned int edgeFailures = CheckEdgeRecovery();
+	const unsigned int periodFailures = CheckRefreshPeriod();
+	return (flushFailures == 0 && edgeFailures == 0 && periodFailures == 0) ? 0 : 1;
+}
+
+// End
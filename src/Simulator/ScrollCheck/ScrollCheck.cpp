@@ -0,0 +1,194 @@
+/*
+ * ScrollCheck.cpp
+ *
+ *  Created on: 16 Feb 2023
+ *      Author: David
+ *
+ *  Host program that checks the SSD1963 hardware scrolling against a software-scrolled reference screen.
+ *  The reference holds what the screen should show. Each step either scrolls the scroll area by a random number of rows, shifting the
+ *  reference rows in software and flushing only the rows that come into view, or redraws a random area that may cross the scroll
+ *  boundaries, or moves the scroll area and redraws the screen. After each step the panel image of the virtual SSD1963, which applies
+ *  the scroll registers as the real controller does, must match the reference exactly.
+ *
+ *  Usage: scroll-check [steps]
+ */
+
+#include <Drivers/SSD1963.h>
+#include "../VirtualSSD1963.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+constexpr unsigned int Width = SSD1963_HOR_RES;
+constexpr unsigned int Height = SSD1963_VER_RES;
+
+static uint16_t reference[Height][Width];
+static lv_color_t flushBuffer[Width * 48];
+static lv_disp_draw_buf_t drawBuf;
+static lv_disp_drv_t driver;
+static std::mt19937 rng(1);
+static uint16_t scrollTop = 0, scrollHeight = Height, scrollOffset = 0;
+static uint64_t scrollPixelsSent = 0, softwareScrollPixels = 0;
+
+// Fill a row of the reference with runs of random colours, so that some flushes are sent as runs and some aren't
+static void NewRow(uint16_t *row) noexcept
+{
+	const bool longRuns = (rng() & 1) != 0;
+	for (unsigned int x = 0; x < Width; )
+	{
+		const uint16_t colour = (uint16_t)rng();
+		unsigned int length = (longRuns) ? 1 + rng() % 100 : 1 + rng() % 3;
+		while (length-- != 0 && x < Width)
+		{
+			row[x++] = colour;
+		}
+	}
+}
+
+// Send part of the reference to the display as LVGL would, in bands no taller than the flush buffer
+static void FlushArea(unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2) noexcept
+{
+	const unsigned int w = x2 - x1 + 1;
+	const unsigned int bandRows = sizeof(flushBuffer)/sizeof(flushBuffer[0])/w;
+	for (unsigned int y = y1; y <= y2; y += bandRows)
+	{
+		const unsigned int lastRow = (y + bandRows - 1 < y2) ? y + bandRows - 1 : y2;
+		for (unsigned int row = y; row <= lastRow; ++row)
+		{
+			for (unsigned int x = x1; x <= x2; ++x)
+			{
+				flushBuffer[(row - y) * w + (x - x1)].full = reference[row][x];
+			}
+		}
+		const lv_area_t area = { (lv_coord_t)x1, (lv_coord_t)y, (lv_coord_t)x2, (lv_coord_t)lastRow };
+		drawBuf.flushing = 1;
+		SSD1963::Flush(&driver, &area, flushBuffer);
+		while (drawBuf.flushing) { }
+	}
+}
+
+// Scroll the reference up by 'rows' rows, or down if it is negative, and flush the new rows in a few pieces
+static void Scroll(int rows) noexcept
+{
+	static uint16_t saved[Height][Width];
+	const unsigned int n = (unsigned int)abs(rows);
+	for (unsigned int i = 0; i < scrollHeight; ++i)
+	{
+		for (unsigned int x = 0; x < Width; ++x)
+		{
+			saved[i][x] = reference[scrollTop + i][x];
+		}
+	}
+	for (unsigned int i = 0; i < scrollHeight; ++i)
+	{
+		const unsigned int from = (rows > 0) ? i + n : i - n;			// unsigned wrap makes values out of range when i < n
+		if (from < scrollHeight)
+		{
+			for (unsigned int x = 0; x < Width; ++x)
+			{
+				reference[scrollTop + i][x] = saved[from][x];
+			}
+		}
+		else
+		{
+			NewRow(reference[scrollTop + i]);
+		}
+	}
+
+	scrollOffset = (uint16_t)((scrollOffset + rows + (int)scrollHeight) % scrollHeight);
+	SSD1963::SetScrollOffset(scrollOffset);
+
+	const uint64_t pixelsBefore = VirtualSSD1963::GetTotalCounters().pixels;
+	const unsigned int firstNew = (rows > 0) ? scrollTop + scrollHeight - n : scrollTop;
+	const unsigned int split = firstNew + rng() % n;
+	FlushArea(0, firstNew, Width - 1, split);
+	if (split + 1 < firstNew + n)
+	{
+		FlushArea(0, split + 1, Width - 1, firstNew + n - 1);
+	}
+	scrollPixelsSent += VirtualSSD1963::GetTotalCounters().pixels - pixelsBefore;
+	softwareScrollPixels += (uint64_t)scrollHeight * Width;
+}
+
+static unsigned int CompareWithReference() noexcept
+{
+	unsigned int mismatches = 0;
+	for (unsigned int y = 0; y < Height; ++y)
+	{
+		for (unsigned int x = 0; x < Width; ++x)
+		{
+			if (VirtualSSD1963::GetVisiblePixel(x, y) != reference[y][x])
+			{
+				++mismatches;
+			}
+		}
+	}
+	return mismatches;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned int steps = (argc > 1) ? (unsigned int)atoi(argv[1]) : 2000;
+
+	VirtualSSD1963::Reset();
+	SSD1963::Init();
+	driver.draw_buf = &drawBuf;
+	for (auto& row : reference)
+	{
+		NewRow(row);
+	}
+	FlushArea(0, 0, Width - 1, Height - 1);
+
+	unsigned int failedSteps = 0;
+	for (unsigned int step = 0; step < steps; ++step)
+	{
+		const unsigned int action = rng() % 16;
+		if (action == 0)
+		{
+			// Move the scroll area. The offset goes back to zero, so LVGL would redraw the whole screen.
+			scrollTop = (uint16_t)(rng() % (Height/2));
+			scrollHeight = (uint16_t)(1 + rng() % (Height - scrollTop));
+			scrollOffset = 0;
+			if (!SSD1963::SetScrollArea(scrollTop, scrollHeight))
+			{
+				printf("SetScrollArea(%u, %u) failed\n", scrollTop, scrollHeight);
+			}
+			FlushArea(0, 0, Width - 1, Height - 1);
+		}
+		else if (action < 6)
+		{
+			// Redraw a random area, which may cross the edges of the scroll area and the wrap point
+			const unsigned int x1 = rng() % Width, y1 = rng() % Height;
+			const unsigned int x2 = x1 + rng() % (Width - x1), y2 = y1 + rng() % (Height - y1);
+			for (unsigned int y = y1; y <= y2; ++y)
+			{
+				const uint16_t colour = (uint16_t)rng();
+				for (unsigned int x = x1; x <= x2; ++x)
+				{
+					reference[y][x] = colour ^ (uint16_t)(x & 7);
+				}
+			}
+			FlushArea(x1, y1, x2, y2);
+		}
+		else
+		{
+			const unsigned int maxRows = (scrollHeight > 40) ? 40 : scrollHeight;
+			const int rows = 1 + (int)(rng() % maxRows);
+			Scroll((rng() & 1) ? rows : -rows);
+		}
+
+		const unsigned int mismatches = CompareWithReference();
+		if (mismatches != 0 && ++failedSteps <= 10)
+		{
+			printf("Step %u (action %u, scroll area %u+%u, offset %u): %u pixels differ\n", step, action, scrollTop, scrollHeight, scrollOffset, mismatches);
+		}
+	}
+
+	SSD1963::FlushStats stats;
+	SSD1963::GetFlushStats(stats);
+	printf("%u steps, %u failed, %u scrolls, %u flushes split at scroll boundaries\n", steps, failedSteps, (unsigned int)stats.scrolls, (unsigned int)stats.splitFlushes);
+	printf("Scrolling sent %llu pixels, against %llu to redraw the scroll area each time\n", (unsigned long long)scrollPixelsSent, (unsigned long long)softwareScrollPixels);
+	return (failedSteps == 0) ? 0 : 1;
+}
+
+// End
@@ -0,0 +1,223 @@
+/*
+ * SettingsStoreCheck.cpp
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  Host program that exercises the settings store against the simulated flash, cutting the power at random points during writes.
+ *  After each power cut the store is reinitialised as it would be at boot, and every setting must read back as the last value
+ *  successfully written, except that the setting being written when the power failed may have either its old or its new value.
+ *  It prints the number of failures and how evenly the sector erases were spread.
+ *  Then it sends settings frames through the telemetry frame parser and stores them as the display task does, checking that the valid ones
+ *  read back as the firmware reads them and that the invalid ones are rejected.
+ *
+ *  Usage: settings-store-check [iterations]
+ */
+
+#include <SettingsStore.h>
+#include <SettingsFlash.h>
+#include "../SettingsFlashSim.h"
+#include <Telemetry/FrameParser.h>
+#include <Crc16.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using SettingsStore::Key;
+using SettingsStore::NumKeys;
+using SettingsStore::MaxValueLength;
+
+struct Value
+{
+	size_t length;								// 0 if there is no value
+	uint8_t data[MaxValueLength];
+
+	bool operator==(const Value& other) const noexcept
+	{
+		return length == other.length && memcmp(data, other.data, length) == 0;
+	}
+};
+
+static Value expected[NumKeys];
+
+static Value ReadBack(unsigned int key) noexcept
+{
+	Value v;
+	v.length = 0;
+	for (size_t length = 1; length <= MaxValueLength; ++length)
+	{
+		if (SettingsStore::Read((Key)key, v.data, length))
+		{
+			v.length = length;
+			break;
+		}
+	}
+	return v;
+}
+
+// Check every key except 'skip' against the expected values, returning the number of mismatches
+static unsigned int CheckAll(unsigned int skip, unsigned int iteration) noexcept
+{
+	unsigned int failures = 0;
+	for (unsigned int key = 1; key < NumKeys; ++key)
+	{
+		if (key != skip && !(ReadBack(key) == expected[key]))
+		{
+			printf("iteration %u: key %u has the wrong value\n", iteration, key);
+			++failures;
+		}
+	}
+	return failures;
+}
+
+static unsigned int settingsStored = 0, settingsRejected = 0;
+
+// Store a settings frame as the CDC receive task and the display task do between them
+static void HandleFrame(uint8_t type, uint8_t, const uint8_t *payload, size_t length) noexcept
+{
+	SettingsStore::Update update;
+	if (type == FrameFormat::SettingsFrame && SettingsStore::DecodeUpdate(payload, length, update) && SettingsStore::Write(update.key, update.value, update.length))
+	{
+		++settingsStored;
+	}
+	else
+	{
+		++settingsRejected;
+	}
+}
+
+static void AppendFrame(std::vector<uint8_t>& stream, uint8_t sequence, const std::vector<uint8_t>& payload) noexcept
+{
+	const size_t start = stream.size();
+	const uint8_t header[FrameFormat::HeaderSize] =
+		{ FrameFormat::Sync1, FrameFormat::Sync2, (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8), FrameFormat::SettingsFrame, sequence };
+	stream.insert(stream.end(), header, header + sizeof(header));
+	stream.insert(stream.end(), payload.begin(), payload.end());
+	const uint16_t crc = Crc16(stream.data() + start + 2, stream.size() - start - 2);
+	stream.push_back((uint8_t)crc);
+	stream.push_back((uint8_t)(crc >> 8));
+}
+
+// Send one frame for each setting the firmware uses and some invalid ones, then check what was stored after a restart. Returns the number of failures.
+static unsigned int CheckSettingsFrames() noexcept
+{
+	const SettingsStore::TouchCalibration cal = { 3200, 900, 3400, 700, 20 };
+	const uint8_t *const calBytes = reinterpret_cast<const uint8_t*>(&cal);
+	std::vector<uint8_t> stream;
+	uint8_t sequence = 0;
+	std::vector<uint8_t> calPayload = { (uint8_t)Key::touchCalibration };
+	calPayload.insert(calPayload.end(), calBytes, calBytes + sizeof(cal));
+	AppendFrame(stream, sequence++, calPayload);
+	AppendFrame(stream, sequence++, { (uint8_t)Key::displayOrientation, 5 });
+	AppendFrame(stream, sequence++, { (uint8_t)Key::backlightLevel, 200 });
+	AppendFrame(stream, sequence++, { (uint8_t)Key::buzzerVolume, 3 });
+	AppendFrame(stream, sequence++, { (uint8_t)Key::backlightLevel, 10, 0 });		// wrong length
+	AppendFrame(stream, sequence++, { 9, 1 });										// unused key
+	AppendFrame(stream, sequence++, { (uint8_t)Key::buzzerVolume });				// no value
+
+	FrameParser parser(HandleFrame);
+	parser.Process(stream.data(), stream.size());
+	SettingsStore::Init();
+
+	unsigned int failures = 0;
+	SettingsStore::TouchCalibration calRead;
+	uint8_t orientation = 0, backlight = 0, volume = 0;
+	if (!SettingsStore::Read(Key::touchCalibration, calRead) || memcmp(&calRead, &cal, sizeof(cal)) != 0)
+	{
+		printf("settings frames: touch calibration not stored\n");
+		++failures;
+	}
+	if (!SettingsStore::Read(Key::displayOrientation, orientation) || orientation != 5
+		|| !SettingsStore::Read(Key::backlightLevel, backlight) || backlight != 200
+		|| !SettingsStore::Read(Key::buzzerVolume, volume) || volume != 3)
+	{
+		printf("settings frames: orientation %u, backlight %u, volume %u\n", orientation, backlight, volume);
+		++failures;
+	}
+	if (settingsStored != 4 || settingsRejected != 3)
+	{
+		printf("settings frames: %u stored and %u rejected, expected 4 and 3\n", settingsStored, settingsRejected);
+		++failures;
+	}
+	printf("settings frames: %u stored, %u rejected, %u failures\n", settingsStored, settingsRejected, failures);
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	const unsigned int iterations = (argc > 1) ? (unsigned int)atoi(argv[1]) : 100000;
+	std::mt19937 rng(1);
+
+	SettingsFlashSim::EraseAll();
+	SettingsStore::Init();
+
+	unsigned int failures = 0, powerCuts = 0;
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		const unsigned int key = 1 + rng() % (NumKeys - 1);
+		Value v;
+		v.length = 1 + rng() % MaxValueLength;
+		for (size_t j = 0; j < v.length; ++j)
+		{
+			v.data[j] = (uint8_t)rng();
+		}
+
+		const bool cutPower = (rng() % 8) == 0;
+		if (cutPower)
+		{
+			// Usually cut the power during the append, sometimes later on when the store may be moving to a new sector
+			SettingsFlashSim::FailAfter(rng() % (((rng() % 4) == 0) ? 600 : 40));
+		}
+		const bool ok = SettingsStore::Write((Key)key, v.data, v.length);
+
+		if (SettingsFlashSim::HasFailed())
+		{
+			++powerCuts;
+			SettingsFlashSim::PowerRestored();
+			SettingsStore::Init();
+			const Value actual = ReadBack(key);
+			if (actual == v)
+			{
+				expected[key] = v;
+			}
+			else if (!(actual == expected[key]))
+			{
+				printf("iteration %u: key %u has neither its old nor its new value after power failure\n", i, key);
+				++failures;
+				expected[key] = actual;
+			}
+			failures += CheckAll(key, i);
+		}
+		else
+		{
+			SettingsFlashSim::PowerRestored();
+			if (!ok)
+			{
+				printf("iteration %u: write failed\n", i);
+				++failures;
+			}
+			expected[key] = v;
+			if (i % 1000 == 0)
+			{
+				SettingsStore::Init();
+				failures += CheckAll(0, i);
+			}
+		}
+	}
+
+	SettingsStore::Init();
+	failures += CheckAll(0, iterations);
+
+	printf("%u iterations, %u power cuts, %u failures\nsector erases:", iterations, powerCuts, failures);
+	for (unsigned int s = 0; s < SettingsFlash::NumSectors; ++s)
+	{
+		printf(" %u", (unsigned int)SettingsFlashSim::GetEraseCount(s));
+	}
+	printf("\n");
+	failures += CheckSettingsFrames();
+	return (failures == 0) ? 0 : 1;
+}
+
+// End
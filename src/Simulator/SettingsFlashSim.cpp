@@ -0,0 +1,141 @@
+/*
+ * SettingsFlashSim.cpp
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for RP2040/SettingsFlash.cpp.
+ *  When power fails part way through an erase, the bytes not yet erased keep their old values; part way through programming, the bytes not yet programmed are left unchanged.
+ */
+
+#include "SettingsFlashSim.h"
+#include <SettingsFlash.h>
+#include <cstdio>
+#include <cstring>
+
+using namespace SettingsFlash;
+
+constexpr size_t FlashSize = SectorSize * NumSectors;
+constexpr size_t Unlimited = (size_t)-1;
+
+static uint8_t flash[FlashSize];
+static uint32_t eraseCounts[NumSectors];
+static const char *backingFile = nullptr;
+static size_t bytesUntilFailure = Unlimited;
+static bool failed = false;
+static bool initialised = false;
+
+static void CheckInitialised() noexcept
+{
+	if (!initialised)
+	{
+		memset(flash, 0xFF, sizeof(flash));
+		initialised = true;
+	}
+}
+
+static void Save() noexcept
+{
+	if (backingFile != nullptr)
+	{
+		FILE * const f = fopen(backingFile, "wb");
+		if (f != nullptr)
+		{
+			fwrite(flash, 1, sizeof(flash), f);
+			fclose(f);
+		}
+	}
+}
+
+// Return how many of the next 'length' bytes can be changed before the power fails
+static size_t BytesBeforeFailure(size_t length) noexcept
+{
+	if (failed)
+	{
+		return 0;
+	}
+	if (bytesUntilFailure != Unlimited)
+	{
+		if (length >= bytesUntilFailure)
+		{
+			length = bytesUntilFailure;
+			failed = true;
+		}
+		bytesUntilFailure -= length;
+	}
+	return length;
+}
+
+void SettingsFlashSim::UseFile(const char *filename) noexcept
+{
+	CheckInitialised();
+	backingFile = filename;
+	FILE * const f = fopen(filename, "rb");
+	if (f != nullptr)
+	{
+		(void)fread(flash, 1, sizeof(flash), f);
+		fclose(f);
+	}
+}
+
+void SettingsFlashSim::EraseAll() noexcept
+{
+	CheckInitialised();
+	memset(flash, 0xFF, sizeof(flash));
+	memset(eraseCounts, 0, sizeof(eraseCounts));
+	Save();
+}
+
+void SettingsFlashSim::FailAfter(size_t bytes) noexcept
+{
+	bytesUntilFailure = bytes;
+	failed = false;
+}
+
+void SettingsFlashSim::PowerRestored() noexcept
+{
+	bytesUntilFailure = Unlimited;
+	failed = false;
+}
+
+bool SettingsFlashSim::HasFailed() noexcept
+{
+	return failed;
+}
+
+uint32_t SettingsFlashSim::GetEraseCount(unsigned int sector) noexcept
+{
+	return (sector < NumSectors) ? eraseCounts[sector] : 0;
+}
+
+const uint8_t *SettingsFlash::GetSector(unsigned int sector) noexcept
+{
+	CheckInitialised();
+	return flash + sector * SectorSize;
+}
+
+void SettingsFlash::EraseSector(unsigned int sector) noexcept
+{
+	CheckInitialised();
+	const size_t n = BytesBeforeFailure(SectorSize);
+	memset(flash + sector * SectorSize, 0xFF, n);
+	if (n == SectorSize)
+	{
+		++eraseCounts[sector];
+	}
+	Save();
+}
+
+void SettingsFlash::Program(unsigned int sector, size_t offset, const uint8_t *data, size_t length) noexcept
+{
+	CheckInitialised();
+	uint8_t * const dest = flash + sector * SectorSize + offset;
+	const size_t n = BytesBeforeFailure(length);
+	for (size_t i = 0; i < n; ++i)
+	{
+		dest[i] &= data[i];						// programming can only clear bits
+	}
+	Save();
+}
+
+// End
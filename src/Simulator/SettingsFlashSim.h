@@ -0,0 +1,30 @@
+/*
+ * SettingsFlashSim.h
+ *
+ *  Created on: 4 Feb 2023
+ *      Author: David
+ *
+ *  Host simulator model of the settings flash sectors. The contents can be kept in a file so that settings persist between runs,
+ *  and a power failure can be simulated part way through an erase or program operation.
+ */
+
+#ifndef SRC_SIMULATOR_SETTINGSFLASHSIM_H_
+#define SRC_SIMULATOR_SETTINGSFLASHSIM_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace SettingsFlashSim
+{
+	void UseFile(const char *filename) noexcept;		// load the flash contents from the file if it exists, and save them there after every change
+	void EraseAll() noexcept;
+
+	// Simulate power failing after another 'bytes' bytes have been erased or programmed. After that, erase and program do nothing until PowerRestored is called.
+	void FailAfter(size_t bytes) noexcept;
+	void PowerRestored() noexcept;
+	bool HasFailed() noexcept;
+
+	uint32_t GetEraseCount(unsigned int sector) noexcept;
+}
+
+#endif /* SRC_SIMULATOR_SETTINGSFLASHSIM_H_ */
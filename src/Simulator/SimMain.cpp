@@ -0,0 +1,147 @@
+/*
+ * SimMain.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Entry point for the host simulator build. It runs the display code against the virtual SSD1963 and touch panel,
+ *  prints the bus counters for each frame in CSV format and writes the final screen contents to a PPM file.
+ *  Given a trace file, it also records the areas LVGL renders in each frame, after they have been joined, for BandBench to replay.
+ *
+ *  Usage: ems-display-sim [output.ppm [milliseconds [trace-file]]]
+ */
+
+#include <Display.h>
+#include <SettingsStore.h>
+#include <MemoryArena.h>
+#include <Telemetry/Telemetry.h>
+#include <UI/DeferredFill.h>
+#include <DisplayWake.h>
+#include <Drivers/PioBus.h>
+#include "SimPins.h"
+#include "VirtualSSD1963.h"
+#include "VirtualTouchPanel.h"
+#include <hardware/timer.h>
+#include <lvgl.h>
+#include <cstdio>
+#include <cstdlib>
+
+static FILE *areaTrace = nullptr;
+static void (*joinAreas)(lv_disp_drv_t *disp_drv) = nullptr;
+
+// Called by LVGL in place of the display's render_start_cb. Write the time and the areas about to be rendered as one line of the trace.
+static void RecordAreas(lv_disp_drv_t *disp_drv) noexcept
+{
+	joinAreas(disp_drv);
+	const lv_disp_t * const disp = _lv_refr_get_disp_refreshing();
+	fprintf(areaTrace, "%u", (unsigned int)(time_us_32()/1000));
+	for (uint32_t i = 0; i < disp->inv_p; ++i)
+	{
+		if (disp->inv_area_joined[i] == 0)
+		{
+			const lv_area_t& a = disp->inv_areas[i];
+			fprintf(areaTrace, " %d,%d,%d,%d", (int)a.x1, (int)a.y1, (int)a.x2, (int)a.y2);
+		}
+	}
+	fputc('\n', areaTrace);
+}
+
+// Convert a screen position to raw touch panel readings, allowing for the orientation that Display::Init passes to TouchPanel::Init
+static void TouchAt(unsigned int x, unsigned int y) noexcept
+{
+	const uint16_t rawY = (uint16_t)((x * 4095u)/(VirtualSSD1963::Width - 1));
+	const uint16_t rawX = (uint16_t)(4095u - (y * 4095u)/(VirtualSSD1963::Height - 1));
+	VirtualTouchPanel::Touch(rawX, rawY, 10);
+}
+
+int main(int argc, char *argv[])
+{
+	const char * const outputFile = (argc > 1) ? argv[1] : "display.ppm";
+	const unsigned int milliseconds = (argc > 2) ? (unsigned int)atoi(argv[2]) : 2000;
+	if (argc > 3)
+	{
+		areaTrace = fopen(argv[3], "w");
+		if (areaTrace == nullptr)
+		{
+			fprintf(stderr, "Failed to create %s\n", argv[3]);
+			return 1;
+		}
+	}
+
+	VirtualSSD1963::Reset();
+	SettingsStore::Init();
+	Display::Init();
+	if (areaTrace != nullptr)
+	{
+		lv_disp_drv_t * const driver = lv_disp_get_default()->driver;
+		joinAreas = driver->render_start_cb;
+		driver->render_start_cb = RecordAreas;
+	}
+	Display::Start();
+	Telemetry::Start();
+	MemoryArena::EndStartup();
+
+	// LVGL takes its time from time_us_32(), so the simulation runs in real time. Display::Spin sleeps for up to a millisecond each time.
+	printf("time,strobes,commands,parameters,pixels,column_addr,page_addr,gpio_writes,pio_clocks\n");
+	const uint32_t startTime = time_us_32();
+	bool touched = false, released = false;
+	for (unsigned int ms = 0; ms < milliseconds; ms = (time_us_32() - startTime)/1000)
+	{
+		// Press the first tile for a while half way through, and signal motion near the end
+		if (!touched && ms >= milliseconds/2)
+		{
+			TouchAt(VirtualSSD1963::Width/6, VirtualSSD1963::Height/4);
+			touched = true;
+		}
+		else if (touched && !released && ms >= milliseconds/2 + 100)
+		{
+			VirtualTouchPanel::Release();
+			released = true;
+		}
+		SimPins::SetMotionDetected(ms >= (milliseconds * 3)/4);
+
+		Display::Spin();
+		VirtualSSD1963::EndFrame();
+
+		const VirtualSSD1963::BusCounters& c = VirtualSSD1963::GetLastFrameCounters();
+		if (c.writeStrobes != 0)
+		{
+			printf("%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu\n", ms,
+					(unsigned long long)c.writeStrobes, (unsigned long long)c.commands, (unsigned long long)c.parameters, (unsigned long long)c.pixels,
+					(unsigned long long)c.columnAddressCommands, (unsigned long long)c.pageAddressCommands,
+					(unsigned long long)c.gpioWrites, (unsigned long long)c.pioClocks);
+		}
+	}
+
+	const VirtualSSD1963::BusCounters& t = VirtualSSD1963::GetTotalCounters();
+	fprintf(stderr, "Total: %llu strobes, %llu pixels, %llu GPIO writes, %llu PIO clocks, %u touch conversions\n",
+			(unsigned long long)t.writeStrobes, (unsigned long long)t.pixels, (unsigned long long)t.gpioWrites, (unsigned long long)t.pioClocks,
+			(unsigned int)VirtualTouchPanel::GetConversions());
+
+	const DeferredFill::Stats& df = DeferredFill::GetStats();
+	SSD1963::FlushStats fs;
+	SSD1963::GetFlushStats(fs);
+	fprintf(stderr, "Fills: %u kept solid, %u pixels not drawn, %u pixels drawn later, %u solid pixels sent, %u fallbacks, %llu bus clocks saved\n",
+			(unsigned int)df.fills, (unsigned int)df.pixelsDeferred, (unsigned int)df.pixelsWritten, (unsigned int)fs.solidPixels, (unsigned int)fs.solidFallbacks,
+			(unsigned long long)fs.busClocksSaved);
+	PioBus::InterruptStats bus;
+	PioBus::GetInterruptStats(bus);
+	fprintf(stderr, "Bus interrupts: %u, %u us in total, %u us at most\n", (unsigned int)bus.interrupts, (unsigned int)bus.totalTime, (unsigned int)bus.maxTime);
+
+	const DisplayWake::Stats& wake = DisplayWake::GetStats();
+	fprintf(stderr, "Display loop: %u wakeups, %u%% of the time sleeping\n", (unsigned int)wake.wakeups,
+			(unsigned int)((wake.blockedTime * 100)/(wake.blockedTime + wake.awakeTime + 1)));
+
+	if (areaTrace != nullptr)
+	{
+		fclose(areaTrace);
+	}
+	if (!VirtualSSD1963::WritePpm(outputFile))
+	{
+		fprintf(stderr, "Failed to write %s\n", outputFile);
+		return 1;
+	}
+	return 0;
+}
+
+// End
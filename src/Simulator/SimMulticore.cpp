@@ -0,0 +1,117 @@
+/*
+ * SimMulticore.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  The core that a thread is simulating is kept in a thread-local variable. The core 0 FIFO interrupt handler is called in the core 1 thread
+ *  after each push, with the thread marked as core 0 while it runs, and the PIO bus simulator does the same with the PIO interrupt handler.
+ */
+
+#include "pico/multicore.h"
+#include "hardware/irq.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+// These are never destroyed, because the core 1 thread may still be waiting on them when the program exits
+static std::mutex& fifoMutex = *new std::mutex;
+static std::condition_variable& fifoNotEmpty = *new std::condition_variable;
+static std::deque<uint32_t>& core0Fifo = *new std::deque<uint32_t>;		// read by core 0
+static std::deque<uint32_t>& core1Fifo = *new std::deque<uint32_t>;		// read by core 1
+
+static thread_local unsigned int currentCore = 0;
+static irq_handler_t core0FifoHandler = nullptr;
+static bool core0FifoIrqEnabled = false;
+
+static std::deque<uint32_t>& ReadFifo() noexcept
+{
+	return (currentCore == 0) ? core0Fifo : core1Fifo;
+}
+
+static void CallCore0FifoHandler() noexcept
+{
+	bool pending;
+	{
+		std::lock_guard<std::mutex> lock(fifoMutex);
+		pending = core0FifoIrqEnabled && core0FifoHandler != nullptr && !core0Fifo.empty();
+	}
+	if (pending)
+	{
+		SimCallOnCore0(core0FifoHandler);
+	}
+}
+
+void SimCallOnCore0(void (*handler)() noexcept) noexcept
+{
+	const unsigned int savedCore = currentCore;
+	currentCore = 0;
+	handler();
+	currentCore = savedCore;
+}
+
+void multicore_launch_core1_with_stack(void (*entry)(), uint32_t *stack_bottom, size_t stack_size_bytes) noexcept
+{
+	std::thread([entry]() { currentCore = 1; entry(); }).detach();
+}
+
+void multicore_fifo_push_blocking(uint32_t data) noexcept
+{
+	{
+		std::lock_guard<std::mutex> lock(fifoMutex);
+		((currentCore == 0) ? core1Fifo : core0Fifo).push_back(data);
+	}
+	if (currentCore == 0)
+	{
+		fifoNotEmpty.notify_all();
+	}
+	else
+	{
+		CallCore0FifoHandler();
+	}
+}
+
+bool multicore_fifo_rvalid() noexcept
+{
+	std::lock_guard<std::mutex> lock(fifoMutex);
+	return !ReadFifo().empty();
+}
+
+uint32_t multicore_fifo_pop_blocking() noexcept
+{
+	std::unique_lock<std::mutex> lock(fifoMutex);
+	std::deque<uint32_t>& fifo = ReadFifo();
+	fifoNotEmpty.wait(lock, [&fifo] { return !fifo.empty(); });
+	const uint32_t data = fifo.front();
+	fifo.pop_front();
+	return data;
+}
+
+void multicore_fifo_drain() noexcept
+{
+	std::lock_guard<std::mutex> lock(fifoMutex);
+	ReadFifo().clear();
+}
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler) noexcept
+{
+	if (num == SIO_IRQ_PROC0)
+	{
+		core0FifoHandler = handler;
+	}
+}
+
+void irq_set_enabled(unsigned int num, bool enabled) noexcept
+{
+	if (num == SIO_IRQ_PROC0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(fifoMutex);
+			core0FifoIrqEnabled = enabled;
+		}
+		CallCore0FifoHandler();				// the interrupt is raised at once if the FIFO already holds something
+	}
+}
+
+// End
@@ -0,0 +1,62 @@
+/*
+ * SimPins.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ */
+
+#include "SimPins.h"
+#include "VirtualSSD1963.h"
+#include "VirtualTouchPanel.h"
+#include <Pins.h>
+
+static uint32_t outputs = 0;
+static bool motionDetected = false;
+
+static void SetOutputs(uint32_t mask, uint32_t values, bool byCpu) noexcept
+{
+	const uint32_t oldOutputs = outputs;
+	outputs = (outputs & ~mask) | (values & mask);
+	VirtualSSD1963::PinsChanged(oldOutputs, outputs, byCpu);
+	VirtualTouchPanel::PinsChanged(oldOutputs, outputs);
+}
+
+void SimPins::WriteMasked(uint32_t mask, uint32_t values) noexcept
+{
+	SetOutputs(mask, values, true);
+}
+
+void SimPins::PioWriteMasked(uint32_t mask, uint32_t values) noexcept
+{
+	SetOutputs(mask, values, false);
+}
+
+uint32_t SimPins::GetOutputs() noexcept
+{
+	return outputs;
+}
+
+bool SimPins::Read(unsigned int pin) noexcept
+{
+	switch (pin)
+	{
+	case TouchDoutPin:
+		return VirtualTouchPanel::GetDout();
+
+	case TouchIrqPin:
+		return VirtualTouchPanel::GetIrq();
+
+	case MotionSensorPin:
+		return motionDetected;
+
+	default:
+		return ((outputs >> pin) & 1) != 0;
+	}
+}
+
+void SimPins::SetMotionDetected(bool detected) noexcept
+{
+	motionDetected = detected;
+}
+
+// End
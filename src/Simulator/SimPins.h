@@ -0,0 +1,25 @@
+/*
+ * SimPins.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  GPIO state for the host simulator build. Output changes are passed to the virtual devices, which also supply the input pin levels.
+ */
+
+#ifndef SRC_SIMULATOR_SIMPINS_H_
+#define SRC_SIMULATOR_SIMPINS_H_
+
+#include <cstdint>
+
+namespace SimPins
+{
+	void WriteMasked(uint32_t mask, uint32_t values) noexcept;
+	void PioWriteMasked(uint32_t mask, uint32_t values) noexcept;		// pin changes made by a PIO state machine rather than the CPU
+	uint32_t GetOutputs() noexcept;
+	bool Read(unsigned int pin) noexcept;
+
+	void SetMotionDetected(bool detected) noexcept;
+}
+
+#endif /* SRC_SIMULATOR_SIMPINS_H_ */
@@ -0,0 +1,207 @@
+/*
+ * TelemetryBench.cpp
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ *
+ *  Host program that measures the throughput of the telemetry frame parser and fuzzes it.
+ *  - Throughput: a stream of readings frames is fed to the parser in 64-byte blocks, as they arrive from USB.
+ *  - Fuzzing: streams are corrupted by flipping bits, inserting and deleting bytes and truncating frames, then fed in blocks of random size.
+ *    After each corrupted stream a few good frames are sent, and the parser must receive them and leave the data model holding their readings.
+ *    The last of them is a command frame, which must be the only command received: nothing in a corrupted stream may be taken for a command.
+ *  If a recorded stream file is given, it is fed to the parser and the statistics are printed instead.
+ *
+ *  Usage: telemetry-bench [recorded-stream.bin]
+ *  Building with -fsanitize=address,undefined is recommended when fuzzing.
+ */
+
+#include <Telemetry/FrameParser.h>
+#include <Telemetry/EmsData.h>
+#include <Crc16.h>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+
+static Ems::Data data;
+static std::vector<uint8_t> commands;
+
+static void HandleFrame(uint8_t type, uint8_t, const uint8_t *payload, size_t length) noexcept
+{
+	if (type == FrameFormat::ReadingsFrame)
+	{
+		(void)Ems::ApplyReadings(data, payload, length);
+	}
+	else if (type == FrameFormat::CommandFrame)
+	{
+		commands.insert(commands.end(), payload, payload + length);
+	}
+}
+
+static void AppendFrame(std::vector<uint8_t>& stream, uint8_t type, uint8_t sequence, const std::vector<uint8_t>& payload) noexcept
+{
+	const size_t start = stream.size();
+	const uint8_t header[FrameFormat::HeaderSize] =
+		{ FrameFormat::Sync1, FrameFormat::Sync2, (uint8_t)payload.size(), (uint8_t)(payload.size() >> 8), type, sequence };
+	stream.insert(stream.end(), header, header + sizeof(header));
+	stream.insert(stream.end(), payload.begin(), payload.end());
+	const uint16_t crc = Crc16(stream.data() + start + 2, stream.size() - start - 2);
+	stream.push_back((uint8_t)crc);
+	stream.push_back((uint8_t)(crc >> 8));
+}
+
+static void AppendReading(std::vector<uint8_t>& payload, unsigned int source, unsigned int quantity, int32_t value) noexcept
+{
+	const uint8_t reading[Ems::ReadingSize] =
+		{ (uint8_t)source, (uint8_t)quantity, (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+	payload.insert(payload.end(), reading, reading + sizeof(reading));
+}
+
+// Make a stream of readings frames with random values for random sources and quantities
+static std::vector<uint8_t> MakeStream(std::mt19937& rng, unsigned int numFrames, unsigned int readingsPerFrame, uint8_t& sequence) noexcept
+{
+	std::vector<uint8_t> stream;
+	for (unsigned int i = 0; i < numFrames; ++i)
+	{
+		std::vector<uint8_t> payload;
+		for (unsigned int j = 0; j < readingsPerFrame; ++j)
+		{
+			AppendReading(payload, rng() % Ems::NumSources, rng() % Ems::NumQuantities, (int32_t)rng());
+		}
+		AppendFrame(stream, FrameFormat::ReadingsFrame, sequence++, payload);
+	}
+	return stream;
+}
+
+static void Feed(FrameParser& parser, const std::vector<uint8_t>& stream, size_t blockSize) noexcept
+{
+	for (size_t i = 0; i < stream.size(); i += blockSize)
+	{
+		parser.Process(stream.data() + i, (stream.size() - i < blockSize) ? stream.size() - i : blockSize);
+	}
+}
+
+static void PrintStats(const FrameParser::Stats& s) noexcept
+{
+	printf("%u bytes, %u frames, %u CRC errors, %u length errors, %u sequence gaps, %u frames reassembled, %u bytes skipped\n",
+			(unsigned int)s.bytesReceived, (unsigned int)s.framesReceived, (unsigned int)s.crcErrors, (unsigned int)s.lengthErrors,
+			(unsigned int)s.sequenceGaps, (unsigned int)s.framesCopied, (unsigned int)s.bytesSkipped);
+}
+
+// Measure throughput with the data arriving one USB packet at a time, and in large blocks as it might be read from a ring buffer
+static void Throughput() noexcept
+{
+	std::mt19937 rng(1);
+	uint8_t sequence = 0;
+	constexpr unsigned int NumFrames = 20000;
+	const std::vector<uint8_t> stream = MakeStream(rng, NumFrames, 40, sequence);
+	constexpr unsigned int Repeats = 20;
+
+	for (const size_t blockSize : { 64, 4096 })
+	{
+		FrameParser parser(HandleFrame);
+		const auto start = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < Repeats; ++i)
+		{
+			Feed(parser, stream, blockSize);
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("Throughput with %u byte blocks: %.1f MB/s, %.0f frames/s\n",
+				(unsigned int)blockSize, (stream.size() * (double)Repeats)/(seconds * 1.0e6), ((double)NumFrames * Repeats)/seconds);
+		PrintStats(parser.GetStats());
+	}
+}
+
+static unsigned int Fuzz(unsigned int iterations) noexcept
+{
+	std::mt19937 rng(2);
+	unsigned int failures = 0;
+	FrameParser parser(HandleFrame);
+	uint8_t sequence = 0;
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		std::vector<uint8_t> stream = MakeStream(rng, 1 + rng() % 8, rng() % 60, sequence);
+		const unsigned int numMutations = 1 + rng() % 8;
+		for (unsigned int m = 0; m < numMutations && !stream.empty(); ++m)
+		{
+			const size_t pos = rng() % stream.size();
+			switch (rng() % 5)
+			{
+			case 0:		stream[pos] ^= (uint8_t)(1u << (rng() % 8)); break;
+			case 1:		stream.insert(stream.begin() + pos, (uint8_t)rng()); break;
+			case 2:		stream.erase(stream.begin() + pos); break;
+			case 3:		stream.resize(pos); break;
+			default:	stream.insert(stream.begin() + pos, FrameFormat::Sync1); break;
+			}
+		}
+
+		// Follow the corrupted stream by enough good frames to flush out any partial frame the parser is holding, then ones with known values
+		std::vector<uint8_t> payload;
+		for (unsigned int j = 0; j < FrameFormat::MaxPayloadLength/Ems::ReadingSize; ++j)
+		{
+			AppendReading(payload, Ems::NumSources - 1, 0, 0);
+		}
+		AppendFrame(stream, FrameFormat::ReadingsFrame, sequence++, payload);
+		payload.clear();
+		const int32_t check = (int32_t)rng();
+		AppendReading(payload, (unsigned int)Ems::Source::grid, (unsigned int)Ems::Quantity::power, check);
+		AppendFrame(stream, FrameFormat::ReadingsFrame, sequence++, payload);
+		const uint8_t command = (uint8_t)('a' + rng() % 26);
+		AppendFrame(stream, FrameFormat::CommandFrame, sequence++, std::vector<uint8_t>{ command });
+
+		commands.clear();
+		size_t offset = 0;
+		while (offset < stream.size())
+		{
+			const size_t blockSize = 1 + rng() % 200;
+			const size_t n = (stream.size() - offset < blockSize) ? stream.size() - offset : blockSize;
+			parser.Process(stream.data() + offset, n);
+			offset += n;
+		}
+
+		if (data.Get(Ems::Source::grid, Ems::Quantity::power) != check)
+		{
+			printf("Fuzz iteration %u: parser did not resynchronise\n", i);
+			++failures;
+		}
+		else if (commands.size() != 1 || commands[0] != command)
+		{
+			printf("Fuzz iteration %u: %u commands received from a stream holding one\n", i, (unsigned int)commands.size());
+			++failures;
+		}
+	}
+	printf("Fuzzing: %u iterations, %u failures\n", iterations, failures);
+	PrintStats(parser.GetStats());
+	return failures;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)
+	{
+		FILE * const f = fopen(argv[1], "rb");
+		if (f == nullptr)
+		{
+			fprintf(stderr, "Failed to read %s\n", argv[1]);
+			return 1;
+		}
+		std::vector<uint8_t> stream;
+		uint8_t buffer[4096];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) != 0)
+		{
+			stream.insert(stream.end(), buffer, buffer + n);
+		}
+		fclose(f);
+		FrameParser parser(HandleFrame);
+		Feed(parser, stream, 64);
+		PrintStats(parser.GetStats());
+		return 0;
+	}
+
+	Throughput();
+	return (Fuzz(200000) == 0) ? 0 : 1;
+}
+
+// End
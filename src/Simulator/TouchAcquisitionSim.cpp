@@ -0,0 +1,44 @@
+/*
+ * TouchAcquisitionSim.cpp
+ *
+ *  Created on: 31 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for TouchAcquisition.cpp. There is no RTOS in the simulator, so the touch panel is read when a sample is requested.
+ */
+
+#include <Drivers/TouchAcquisition.h>
+#include <Drivers/TouchPanel.h>
+#include <hardware/timer.h>
+
+static TouchSample sample = {};
+
+void TouchAcquisition::Start() noexcept
+{
+}
+
+bool TouchAcquisition::GetLatest(TouchSample& s) noexcept
+{
+	const uint32_t now = time_us_32();
+	uint16_t x, y, rawX, rawY;
+	bool repeat;
+	const bool pressed = TouchPanel::Read(x, y, repeat, &rawX, &rawY);
+	if (pressed)
+	{
+		if (!sample.pressed)
+		{
+			sample.touchTime = now;
+			++sample.touchNumber;
+		}
+		sample.x = x;
+		sample.y = y;
+		sample.rawX = rawX;
+		sample.rawY = rawY;
+	}
+	sample.pressed = pressed;
+	sample.sampleTime = now;
+	s = sample;
+	return true;
+}
+
+// End
@@ -0,0 +1,160 @@
+/*
+ * TouchFilterBench.cpp
+ *
+ *  Created on: 2 Feb 2023
+ *      Author: David
+ *
+ *  Host program that replays a touch panel trace through each of the touch filters and compares them.
+ *  The trace is a text file of "rawX,rawY" lines, one ADC conversion per axis per line, as recorded using the profiler's 't' command.
+ *  Lines that don't start with a digit are ignored. If no file is given, a synthetic trace of a stationary touch with noise and spikes is used.
+ *
+ *  For each filter it reports the conversions needed per good reading, the proportion of readings rejected as unstable,
+ *  and the jitter (RMS difference between successive good readings). Differences bigger than MaxJitterStep are treated as
+ *  the touch moving or a new touch starting and are left out of the jitter.
+ *
+ *  Usage: touch-filter-bench [trace.csv]
+ */
+
+#include <Drivers/TouchFilter.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <random>
+#include <vector>
+
+constexpr int MaxJitterStep = 200;
+
+struct AxisResults
+{
+	unsigned int readings = 0;
+	unsigned int stableReadings = 0;
+	unsigned int conversions = 0;
+	unsigned int jitterSamples = 0;
+	double jitterSquares = 0.0;
+};
+
+static bool LoadTrace(const char *filename, std::vector<uint16_t>& xs, std::vector<uint16_t>& ys) noexcept
+{
+	FILE * const f = fopen(filename, "r");
+	if (f == nullptr)
+	{
+		return false;
+	}
+	char line[100];
+	while (fgets(line, sizeof(line), f) != nullptr)
+	{
+		unsigned int x, y;
+		if (isdigit((unsigned char)line[0]) && sscanf(line, "%u,%u", &x, &y) == 2)
+		{
+			xs.push_back((uint16_t)x);
+			ys.push_back((uint16_t)y);
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+// Make a trace of a touch held at one place with Gaussian noise and occasional large spikes, as seen on the 7" panels
+static void MakeSyntheticTrace(std::vector<uint16_t>& xs, std::vector<uint16_t>& ys) noexcept
+{
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0.0, 12.0);
+	std::uniform_int_distribution<int> spike(-400, 400);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	auto sample = [&](double centre) -> uint16_t
+	{
+		const double v = centre + noise(rng) + ((chance(rng) < 0.03) ? spike(rng) : 0);
+		return (uint16_t)((v < 0.0) ? 0.0 : (v > 4095.0) ? 4095.0 : v);
+	};
+	for (unsigned int i = 0; i < 20000; ++i)
+	{
+		xs.push_back(sample(1500.0));
+		ys.push_back(sample(2600.0));
+	}
+}
+
+// Feed one axis of the trace through the filter, starting a new reading each time the filter finishes the previous one
+static AxisResults RunAxis(TouchFilter& f, const std::vector<uint16_t>& conversions) noexcept
+{
+	AxisResults r;
+	bool havePrevious = false;
+	uint16_t previous = 0;
+	size_t i = 0;
+	while (i < conversions.size())
+	{
+		f.Start();
+		TouchFilterResult res = TouchFilterResult::needMore;
+		unsigned int used = 0;
+		while (res == TouchFilterResult::needMore && i < conversions.size())
+		{
+			res = f.Add(conversions[i++]);
+			++used;
+		}
+		if (res == TouchFilterResult::needMore)
+		{
+			break;									// ran out of trace part way through a reading
+		}
+
+		++r.readings;
+		r.conversions += used;
+		if (res == TouchFilterResult::stable)
+		{
+			++r.stableReadings;
+			const uint16_t val = f.GetResult();
+			if (havePrevious)
+			{
+				const int step = (int)val - (int)previous;
+				if (abs(step) <= MaxJitterStep)
+				{
+					++r.jitterSamples;
+					r.jitterSquares += (double)step * step;
+				}
+			}
+			previous = val;
+			havePrevious = true;
+		}
+	}
+	return r;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<uint16_t> xs, ys;
+	if (argc > 1)
+	{
+		if (!LoadTrace(argv[1], xs, ys))
+		{
+			fprintf(stderr, "Failed to read %s\n", argv[1]);
+			return 1;
+		}
+	}
+	else
+	{
+		MakeSyntheticTrace(xs, ys);
+	}
+	printf("%zu conversions per axis\n", xs.size());
+
+	AveragingTouchFilter averaging;
+	MedianTouchFilter median;
+	IirTouchFilter iir;
+	AdaptiveTouchFilter adaptive;
+	TouchFilter * const filters[] = { &averaging, &median, &iir, &adaptive };
+
+	printf("filter,conversions_per_good_reading,rejected_percent,jitter_rms\n");
+	for (TouchFilter *f : filters)
+	{
+		const AxisResults x = RunAxis(*f, xs);
+		const AxisResults y = RunAxis(*f, ys);
+		const unsigned int stable = x.stableReadings + y.stableReadings;
+		const unsigned int readings = x.readings + y.readings;
+		const unsigned int jitterSamples = x.jitterSamples + y.jitterSamples;
+		printf("%s,%.2f,%.1f,%.2f\n", f->GetName(),
+				(stable == 0) ? 0.0 : (double)(x.conversions + y.conversions)/stable,
+				(readings == 0) ? 0.0 : (100.0 * (readings - stable))/readings,
+				(jitterSamples == 0) ? 0.0 : sqrt((x.jitterSquares + y.jitterSquares)/jitterSamples));
+	}
+	return 0;
+}
+
+// End
@@ -0,0 +1,314 @@
+/*
+ * VirtualSSD1963.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ */
+
+#include "VirtualSSD1963.h"
+#include <Pins.h>
+#include <cstdio>
+
+using namespace VirtualSSD1963;
+
+constexpr uint32_t CsBit = 1u << DisplayCsPin;
+constexpr uint32_t DcBit = 1u << DisplayDataNotCommandPin;
+constexpr uint32_t WrBit = 1u << DisplayWritePin;
+constexpr uint32_t LatchBit = 1u << DisplayLatchLowDataPin;
+constexpr uint32_t ResetBit = 1u << DisplayNotResetPin;
+constexpr size_t MaxParameters = 16;
+
+static uint16_t framebuffer[Width * Height];
+
+static BusCounters totalCounters, frameStartCounters, lastFrameCounters;
+static unsigned int frameCount = 0;
+
+static uint8_t latchQ = 0;						// outputs of the 74AHC573, connected to D0-D7 of the SSD1963
+static uint8_t currentCommand = 0;
+static uint8_t parameters[MaxParameters];
+static size_t numParameters = 0;
+static bool writingMemory = false;
+static bool displayOn = false;
+static uint16_t startColumn, endColumn, startPage, endPage;
+static uint16_t column, page;
+static uint16_t scrollTop, scrollHeight, scrollStart;		// set by 0x33 and 0x37
+static uint16_t partialStart, partialEnd;					// set by 0x30
+static bool partialMode = false;
+
+static BusCounters Difference(const BusCounters& a, const BusCounters& b) noexcept
+{
+	BusCounters ret;
+	ret.writeStrobes = a.writeStrobes - b.writeStrobes;
+	ret.commands = a.commands - b.commands;
+	ret.parameters = a.parameters - b.parameters;
+	ret.pixels = a.pixels - b.pixels;
+	ret.columnAddressCommands = a.columnAddressCommands - b.columnAddressCommands;
+	ret.pageAddressCommands = a.pageAddressCommands - b.pageAddressCommands;
+	ret.gpioWrites = a.gpioWrites - b.gpioWrites;
+	ret.pioClocks = a.pioClocks - b.pioClocks;
+	return ret;
+}
+
+// Reset the controller state, as done by the ~RESET pin or the software reset command. The framebuffer contents are undefined after reset, so we leave them alone.
+static void ResetController() noexcept
+{
+	currentCommand = 0;
+	numParameters = 0;
+	writingMemory = false;
+	displayOn = false;
+	startColumn = 0;
+	endColumn = Width - 1;
+	startPage = 0;
+	endPage = Height - 1;
+	column = page = 0;
+	scrollTop = 0;
+	scrollHeight = Height;
+	scrollStart = 0;
+	partialStart = 0;
+	partialEnd = Height - 1;
+	partialMode = false;
+}
+
+static void Command(uint8_t cmd) noexcept
+{
+	++totalCounters.commands;
+	currentCommand = cmd;
+	numParameters = 0;
+	writingMemory = false;
+	switch (cmd)
+	{
+	case 0x01:					// soft reset
+		ResetController();
+		break;
+
+	case 0x28:					// display off
+		displayOn = false;
+		break;
+
+	case 0x29:					// display on
+		displayOn = true;
+		break;
+
+	case 0x2A:					// set column address
+		++totalCounters.columnAddressCommands;
+		break;
+
+	case 0x2B:					// set page address
+		++totalCounters.pageAddressCommands;
+		break;
+
+	case 0x2C:					// write memory start
+		column = startColumn;
+		page = startPage;
+		writingMemory = true;
+		break;
+
+	case 0x3C:					// write memory continue
+		writingMemory = true;
+		break;
+
+	case 0x12:					// enter partial mode
+		partialMode = true;
+		break;
+
+	case 0x13:					// enter normal mode
+		partialMode = false;
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void Parameter(uint8_t val) noexcept
+{
+	++totalCounters.parameters;
+	if (numParameters < MaxParameters)
+	{
+		parameters[numParameters++] = val;
+	}
+
+	if (numParameters == 4)
+	{
+		const uint16_t first = ((uint16_t)parameters[0] << 8) | parameters[1];
+		const uint16_t last = ((uint16_t)parameters[2] << 8) | parameters[3];
+		if (currentCommand == 0x2A)
+		{
+			startColumn = first;
+			endColumn = last;
+		}
+		else if (currentCommand == 0x2B)
+		{
+			startPage = first;
+			endPage = last;
+		}
+		else if (currentCommand == 0x30)
+		{
+			partialStart = first;
+			partialEnd = last;
+		}
+	}
+	else if (numParameters == 2 && currentCommand == 0x37)
+	{
+		scrollStart = ((uint16_t)parameters[0] << 8) | parameters[1];
+	}
+	else if (numParameters == 6 && currentCommand == 0x33)
+	{
+		// The bottom fixed area is whatever is left, so we don't need the third parameter
+		scrollTop = ((uint16_t)parameters[0] << 8) | parameters[1];
+		scrollHeight = ((uint16_t)parameters[2] << 8) | parameters[3];
+	}
+}
+
+static void Pixel(uint16_t val) noexcept
+{
+	++totalCounters.pixels;
+	if (column < Width && page < Height)
+	{
+		framebuffer[page * Width + column] = val;
+	}
+	if (column >= endColumn)
+	{
+		column = startColumn;
+		page = (page >= endPage) ? startPage : page + 1;
+	}
+	else
+	{
+		++column;
+	}
+}
+
+void VirtualSSD1963::Reset() noexcept
+{
+	ResetController();
+	totalCounters = frameStartCounters = lastFrameCounters = BusCounters();
+	frameCount = 0;
+	for (uint16_t& px : framebuffer)
+	{
+		px = 0;
+	}
+}
+
+// Called on every GPIO register write with the old and new output levels
+void VirtualSSD1963::PinsChanged(uint32_t oldPins, uint32_t newPins, bool byCpu) noexcept
+{
+	if (byCpu)
+	{
+		++totalCounters.gpioWrites;
+	}
+
+	if ((oldPins & ResetBit) != 0 && (newPins & ResetBit) == 0)
+	{
+		ResetController();
+	}
+
+	// The latch is transparent while LE is high and holds the data that was present when LE went low
+	if ((newPins & LatchBit) != 0)
+	{
+		latchQ = (uint8_t)(newPins >> DisplayLowestDataPin);
+	}
+	else if ((oldPins & LatchBit) != 0)
+	{
+		latchQ = (uint8_t)(oldPins >> DisplayLowestDataPin);
+	}
+
+	// The SSD1963 samples the bus on the rising edge of ~WR. D0-D7 come from the latch and D8-D15 come directly from the data pins.
+	if ((newPins & CsBit) == 0 && (oldPins & WrBit) == 0 && (newPins & WrBit) != 0)
+	{
+		++totalCounters.writeStrobes;
+		if ((newPins & DcBit) == 0)
+		{
+			Command(latchQ);
+		}
+		else if (writingMemory)
+		{
+			Pixel((uint16_t)((((newPins >> DisplayLowestDataPin) & 0xFF) << 8) | latchQ));
+		}
+		else
+		{
+			Parameter(latchQ);
+		}
+	}
+}
+
+void VirtualSSD1963::AddPioClocks(uint64_t clocks) noexcept
+{
+	totalCounters.pioClocks += clocks;
+}
+
+void VirtualSSD1963::EndFrame() noexcept
+{
+	lastFrameCounters = Difference(totalCounters, frameStartCounters);
+	frameStartCounters = totalCounters;
+	++frameCount;
+}
+
+const BusCounters& VirtualSSD1963::GetTotalCounters() noexcept
+{
+	return totalCounters;
+}
+
+const BusCounters& VirtualSSD1963::GetLastFrameCounters() noexcept
+{
+	return lastFrameCounters;
+}
+
+unsigned int VirtualSSD1963::GetFrameCount() noexcept
+{
+	return frameCount;
+}
+
+uint16_t VirtualSSD1963::GetPixel(unsigned int x, unsigned int y) noexcept
+{
+	return (x < Width && y < Height) ? framebuffer[y * Width + x] : 0;
+}
+
+// Get a pixel as the panel shows it, allowing for the scroll area and partial mode
+uint16_t VirtualSSD1963::GetVisiblePixel(unsigned int x, unsigned int y) noexcept
+{
+	if (x >= Width || y >= Height || (partialMode && (y < partialStart || y > partialEnd)))
+	{
+		return 0;
+	}
+	if (y >= scrollTop && y < (unsigned int)scrollTop + scrollHeight && scrollHeight != 0)
+	{
+		y = scrollTop + (y - scrollTop + (scrollStart - scrollTop)) % scrollHeight;
+	}
+	return framebuffer[y * Width + x];
+}
+
+const uint16_t *VirtualSSD1963::GetFramebuffer() noexcept
+{
+	return framebuffer;
+}
+
+bool VirtualSSD1963::IsDisplayOn() noexcept
+{
+	return displayOn;
+}
+
+// Write what the panel shows to a binary PPM file, expanding RGB565 to 8 bits per colour
+bool VirtualSSD1963::WritePpm(const char *filename) noexcept
+{
+	FILE * const f = fopen(filename, "wb");
+	if (f == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(f, "P6\n%u %u\n255\n", Width, Height);
+	for (unsigned int i = 0; i < Width * Height; ++i)
+	{
+		const uint16_t px = GetVisiblePixel(i % Width, i / Width);
+		const uint8_t rgb[3] =
+		{
+			(uint8_t)((((px >> 11) & 0x1F) * 255)/31),
+			(uint8_t)((((px >> 5) & 0x3F) * 255)/63),
+			(uint8_t)(((px & 0x1F) * 255)/31)
+		};
+		fwrite(rgb, 1, sizeof(rgb), f);
+	}
+	return fclose(f) == 0;
+}
+
+// End
@@ -0,0 +1,49 @@
+/*
+ * VirtualSSD1963.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Pin-level model of the SSD1963 and the 74AHC573 that latches the low byte of each 16-bit pixel.
+ *  It decodes the command stream written by the driver into a framebuffer and counts bus transactions per frame.
+ */
+
+#ifndef SRC_SIMULATOR_VIRTUALSSD1963_H_
+#define SRC_SIMULATOR_VIRTUALSSD1963_H_
+
+#include <cstdint>
+
+namespace VirtualSSD1963
+{
+	constexpr unsigned int Width = 800;
+	constexpr unsigned int Height = 480;
+
+	struct BusCounters
+	{
+		uint64_t writeStrobes;				// number of rising edges on ~WR with ~CS low
+		uint64_t commands;
+		uint64_t parameters;
+		uint64_t pixels;
+		uint64_t columnAddressCommands;		// number of 0x2A commands
+		uint64_t pageAddressCommands;		// number of 0x2B commands
+		uint64_t gpioWrites;				// GPIO register writes by the CPU
+		uint64_t pioClocks;					// PIO clocks taken by pixel data sent using the PIO
+	};
+
+	void Reset() noexcept;
+	void PinsChanged(uint32_t oldPins, uint32_t newPins, bool byCpu) noexcept;
+	void AddPioClocks(uint64_t clocks) noexcept;
+
+	void EndFrame() noexcept;
+	const BusCounters& GetTotalCounters() noexcept;
+	const BusCounters& GetLastFrameCounters() noexcept;
+	unsigned int GetFrameCount() noexcept;
+
+	uint16_t GetPixel(unsigned int x, unsigned int y) noexcept;			// pixel in the controller's memory
+	uint16_t GetVisiblePixel(unsigned int x, unsigned int y) noexcept;	// pixel shown on the panel, after scrolling
+	const uint16_t *GetFramebuffer() noexcept;
+	bool IsDisplayOn() noexcept;
+	bool WritePpm(const char *filename) noexcept;
+}
+
+#endif /* SRC_SIMULATOR_VIRTUALSSD1963_H_ */
@@ -0,0 +1,103 @@
+/*
+ * VirtualTouchPanel.cpp
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  The XPT2046 samples DIN on the rising edge of DCLK. A command starts with a 1 bit and is 8 bits long.
+ *  The 12-bit result is shifted out MSB first on the falling edges of DCLK, starting with the second falling edge after the command.
+ */
+
+#include "VirtualTouchPanel.h"
+#include <Pins.h>
+#include <cstdlib>
+
+constexpr uint32_t CsBit = 1u << TouchCsPin;
+constexpr uint32_t ClkBit = 1u << TouchClkPin;
+constexpr uint32_t DinBit = 1u << TouchDinPin;
+
+static bool touched = false;
+static uint16_t touchX, touchY, touchNoise;
+
+static uint8_t commandBits = 0;			// number of command bits received so far, 0 if waiting for a start bit
+static uint8_t command = 0;
+static uint16_t result = 0;
+static uint8_t resultBitsLeft = 0;
+static bool dout = false;
+static uint32_t conversions = 0;
+
+static uint16_t Sample(uint16_t val) noexcept
+{
+	if (touchNoise != 0)
+	{
+		const int sample = (int)val + (rand() % (2 * touchNoise + 1)) - (int)touchNoise;
+		return (uint16_t)((sample < 0) ? 0 : (sample > 4095) ? 4095 : sample);
+	}
+	return val;
+}
+
+void VirtualTouchPanel::Touch(uint16_t rawX, uint16_t rawY, uint16_t noise) noexcept
+{
+	touched = true;
+	touchX = rawX;
+	touchY = rawY;
+	touchNoise = noise;
+}
+
+void VirtualTouchPanel::Release() noexcept
+{
+	touched = false;
+}
+
+void VirtualTouchPanel::PinsChanged(uint32_t oldPins, uint32_t newPins) noexcept
+{
+	if ((newPins & CsBit) != 0)
+	{
+		commandBits = 0;
+		resultBitsLeft = 0;
+		return;
+	}
+
+	if ((oldPins & ClkBit) == 0 && (newPins & ClkBit) != 0)
+	{
+		// Rising edge, sample DIN
+		const bool bit = (newPins & DinBit) != 0;
+		if (commandBits != 0 || bit)
+		{
+			command = (command << 1) | (bit ? 1 : 0);
+			if (++commandBits == 8)
+			{
+				// Channel 1 (A2-A0 = 001) is X and channel 5 (101) is Y in differential mode
+				const uint8_t channel = (command >> 4) & 0x07;
+				result = (!touched) ? 0 : (channel == 1) ? Sample(touchX) : (channel == 5) ? Sample(touchY) : 0;
+				resultBitsLeft = 13;						// the falling edge that ends the command outputs the BUSY bit, which is always 0
+				commandBits = 0;
+				++conversions;
+			}
+		}
+	}
+	else if ((oldPins & ClkBit) != 0 && (newPins & ClkBit) == 0 && resultBitsLeft != 0)
+	{
+		// Falling edge, shift out the next result bit
+		--resultBitsLeft;
+		dout = resultBitsLeft < 12 && ((result >> resultBitsLeft) & 1) != 0;
+	}
+}
+
+bool VirtualTouchPanel::GetDout() noexcept
+{
+	return dout;
+}
+
+// The PENIRQ output is pulled low while the panel is touched
+bool VirtualTouchPanel::GetIrq() noexcept
+{
+	return !touched;
+}
+
+uint32_t VirtualTouchPanel::GetConversions() noexcept
+{
+	return conversions;
+}
+
+// End
@@ -0,0 +1,27 @@
+/*
+ * VirtualTouchPanel.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Pin-level model of the XPT2046 resistive touch controller, as driven by TouchPanel.cpp
+ */
+
+#ifndef SRC_SIMULATOR_VIRTUALTOUCHPANEL_H_
+#define SRC_SIMULATOR_VIRTUALTOUCHPANEL_H_
+
+#include <cstdint>
+
+namespace VirtualTouchPanel
+{
+	void Touch(uint16_t rawX, uint16_t rawY, uint16_t noise = 0) noexcept;		// raw values are 12-bit ADC readings
+	void Release() noexcept;
+
+	void PinsChanged(uint32_t oldPins, uint32_t newPins) noexcept;
+	bool GetDout() noexcept;
+	bool GetIrq() noexcept;
+
+	uint32_t GetConversions() noexcept;
+}
+
+#endif /* SRC_SIMULATOR_VIRTUALTOUCHPANEL_H_ */
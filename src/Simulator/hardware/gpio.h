@@ -0,0 +1,20 @@
+/*
+ * gpio.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the pico-sdk gpio functions used by the drivers
+ */
+
+#ifndef SRC_SIMULATOR_HARDWARE_GPIO_H_
+#define SRC_SIMULATOR_HARDWARE_GPIO_H_
+
+#include "../SimPins.h"
+
+inline void gpio_put_masked(uint32_t mask, uint32_t value) noexcept
+{
+	SimPins::WriteMasked(mask, value);
+}
+
+#endif /* SRC_SIMULATOR_HARDWARE_GPIO_H_ */
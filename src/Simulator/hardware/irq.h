@@ -0,0 +1,25 @@
+/*
+ * irq.h
+ *
+ *  Created on: 28 Feb 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the pico-sdk interrupt functions. Only the core 0 inter-core FIFO interrupt is simulated (see SimMulticore.cpp);
+ *  its handler is called in the core 1 thread straight after core 1 pushes to the FIFO, as if core 0 had been interrupted at once.
+ */
+
+#ifndef SRC_SIMULATOR_HARDWARE_IRQ_H_
+#define SRC_SIMULATOR_HARDWARE_IRQ_H_
+
+#include <cstdint>
+
+typedef void (*irq_handler_t)() noexcept;
+
+constexpr unsigned int SIO_IRQ_PROC0 = 15;
+constexpr int SIO_IRQ_PROC0_IRQn = 15;
+
+void irq_set_exclusive_handler(unsigned int num, irq_handler_t handler) noexcept;
+void irq_set_enabled(unsigned int num, bool enabled) noexcept;
+inline void NVIC_SetPriority(int, uint32_t) noexcept { }
+
+#endif /* SRC_SIMULATOR_HARDWARE_IRQ_H_ */
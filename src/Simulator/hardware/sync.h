@@ -0,0 +1,35 @@
+/*
+ * sync.h
+ *
+ *  Created on: 18 Mar 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the pico-sdk interrupt masking and event functions. No interrupts are simulated on core 1, so there is nothing to mask.
+ *  Waiting for an event just yields, because nothing raises one.
+ */
+
+#ifndef SRC_SIMULATOR_HARDWARE_SYNC_H_
+#define SRC_SIMULATOR_HARDWARE_SYNC_H_
+
+#include <cstdint>
+#include <thread>
+
+inline uint32_t save_and_disable_interrupts() noexcept
+{
+	return 0;
+}
+
+inline void restore_interrupts(uint32_t) noexcept
+{
+}
+
+inline void __wfe() noexcept
+{
+	std::this_thread::yield();
+}
+
+inline void __sev() noexcept
+{
+}
+
+#endif /* SRC_SIMULATOR_HARDWARE_SYNC_H_ */
@@ -0,0 +1,50 @@
+/*
+ * timer.h
+ *
+ *  Created on: 28 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the pico-sdk timer functions. Alarms can be claimed and set, but they never fire;
+ *  the display driver polls the time while it waits for one, so the simulation runs the same either way.
+ */
+
+#ifndef SRC_SIMULATOR_HARDWARE_TIMER_H_
+#define SRC_SIMULATOR_HARDWARE_TIMER_H_
+
+#include <cstdint>
+#include <chrono>
+
+typedef uint64_t absolute_time_t;
+typedef void (*hardware_alarm_callback_t)(unsigned int alarm_num);
+
+inline uint64_t time_us_64() noexcept
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t time_us_32() noexcept
+{
+	return (uint32_t)time_us_64();
+}
+
+inline absolute_time_t from_us_since_boot(uint64_t us) noexcept
+{
+	return us;
+}
+
+inline int hardware_alarm_claim_unused(bool) noexcept
+{
+	return 0;
+}
+
+inline void hardware_alarm_set_callback(unsigned int, hardware_alarm_callback_t) noexcept
+{
+}
+
+// Returns true if the target time has already passed, as the pico-sdk function does
+inline bool hardware_alarm_set_target(unsigned int, absolute_time_t target) noexcept
+{
+	return (int64_t)(target - time_us_64()) <= 0;
+}
+
+#endif /* SRC_SIMULATOR_HARDWARE_TIMER_H_ */
@@ -0,0 +1,26 @@
+/*
+ * multicore.h
+ *
+ *  Created on: 21 Jan 2023
+ *      Author: David
+ *
+ *  Host simulator replacement for the pico-sdk multicore functions. Core 1 is a thread, and each direction of the inter-core FIFO is a queue protected by a mutex.
+ */
+
+#ifndef SRC_SIMULATOR_PICO_MULTICORE_H_
+#define SRC_SIMULATOR_PICO_MULTICORE_H_
+
+#include <cstdint>
+#include <cstddef>
+
+void multicore_launch_core1_with_stack(void (*entry)(), uint32_t *stack_bottom, size_t stack_size_bytes) noexcept;
+void multicore_fifo_push_blocking(uint32_t data) noexcept;
+bool multicore_fifo_rvalid() noexcept;
+uint32_t multicore_fifo_pop_blocking() noexcept;
+void multicore_fifo_drain() noexcept;
+inline void multicore_fifo_clear_irq() noexcept { }
+
+// Simulator only: call a handler for an interrupt that the firmware takes on core 0, with the calling thread marked as core 0 while it runs
+void SimCallOnCore0(void (*handler)() noexcept) noexcept;
+
+#endif /* SRC_SIMULATOR_PICO_MULTICORE_H_ */
@@ -0,0 +1,67 @@
+/*
+ * SpscQueue.h
+ *
+ *  Created on: 14 Jan 2023
+ *      Author: David
+ *
+ *  Lock-free queue for passing items from one producer to one consumer, which may be running on different cores.
+ *  Only the producer may call Put and only the consumer may call Get. It uses nothing but std::atomic, so it can also be built on a host.
+ */
+
+#ifndef SRC_SPSCQUEUE_H_
+#define SRC_SPSCQUEUE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+
+template<class T, size_t N> class SpscQueue
+{
+public:
+	static_assert(N != 0 && (N & (N - 1)) == 0, "queue size must be a power of 2");
+
+	SpscQueue() noexcept : putIndex(0), getIndex(0) { }
+
+	// Add an item to the queue, returning false if it is full. Call only from the producer.
+	bool Put(const T& item) noexcept
+	{
+		const uint32_t put = putIndex.load(std::memory_order_relaxed);
+		if (put - getIndex.load(std::memory_order_acquire) == N)
+		{
+			return false;
+		}
+		items[put & (N - 1)] = item;
+		putIndex.store(put + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Remove an item from the queue, returning false if it is empty. Call only from the consumer.
+	bool Get(T& item) noexcept
+	{
+		const uint32_t get = getIndex.load(std::memory_order_relaxed);
+		if (putIndex.load(std::memory_order_acquire) == get)
+		{
+			return false;
+		}
+		item = items[get & (N - 1)];
+		getIndex.store(get + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool IsEmpty() const noexcept
+	{
+		return putIndex.load(std::memory_order_acquire) == getIndex.load(std::memory_order_acquire);
+	}
+
+	size_t Count() const noexcept
+	{
+		return putIndex.load(std::memory_order_acquire) - getIndex.load(std::memory_order_acquire);
+	}
+
+private:
+	T items[N];
+	std::atomic<uint32_t> putIndex;				// free-running, written only by the producer
+	std::atomic<uint32_t> getIndex;				// free-running, written only by the consumer
+};
+
+#endif /* SRC_SPSCQUEUE_H_ */
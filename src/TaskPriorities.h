@@ -11,9 +11,11 @@
 // Task priorities
 namespace TaskPriority
 {
-	static constexpr unsigned int SpinPriority = 1;							// priority for tasks that rarely block
+	static constexpr unsigned int TouchPriority = 1;						// below the display and telemetry, it only needs to keep up with a finger
+	static constexpr unsigned int DisplayPriority = 2;						// the display task blocks between LVGL timer deadlines and while flushes complete
 	static constexpr unsigned int UsbPriority = 2;
 	static constexpr unsigned int AinPriority = 2;
+	static constexpr unsigned int CdcReceivePriority = 3;					// above the display task, so that USB data is read promptly while it redraws
 }
 
 #endif /* SRC_TASKPRIORITIES_H_ */
@@ -0,0 +1,152 @@
+/*
+ * CdcReceiver.cpp
+ *
+ *  Created on: 8 Feb 2023
+ *      Author: David
+ */
+
+#include "CdcReceiver.h"
+#include <SpscQueue.h>
+#include <DisplayWake.h>
+#include <TaskPriorities.h>
+#include <RP2040/Devices.h>
+#include <RTOSIface/RTOSIface.h>
+#include <hardware/timer.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+constexpr unsigned int CdcReceiveTaskStackWords = 200;
+constexpr size_t ReceiveChunkSize = 64;				// one full-speed USB packet
+constexpr uint32_t MinIdlePollMillis = 1;			// how long we wait before looking for more data when the port has just emptied
+constexpr uint32_t MaxIdlePollMillis = 16;			// the wait doubles each time the port is still empty, up to this
+constexpr uint32_t DisconnectedPollMillis = 100;	// how often we look for a connection
+
+static Task<CdcReceiveTaskStackWords> cdcReceiveTask;
+static SpscQueue<TelemetryUpdate, CdcReceiver::UpdateQueueLength> updateQueue;
+static SpscQueue<SettingsStore::Update, CdcReceiver::SettingsQueueLength> settingsQueue;
+static uint32_t chunkReceiveTime = 0;
+static uint32_t overruns = 0;
+static uint32_t maxQueued = 0;
+static uint32_t settingsRejected = 0;
+
+// Queue an update for the display task. If the display task has fallen behind then we drop the update rather than stop reading the port.
+static void QueueUpdate(const TelemetryUpdate& update) noexcept
+{
+	if (updateQueue.Put(update))
+	{
+		maxQueued = max<uint32_t>(maxQueued, updateQueue.Count());
+	}
+	else
+	{
+		++overruns;
+	}
+}
+
+static void HandleFrame(uint8_t type, uint8_t sequence, const uint8_t *payload, size_t length) noexcept
+{
+	if (type == FrameFormat::ReadingsFrame)
+	{
+		for (const uint8_t * const end = payload + length - (length % Ems::ReadingSize); payload < end; payload += Ems::ReadingSize)
+		{
+			QueueUpdate(TelemetryUpdate{ chunkReceiveTime, Ems::DecodeReading(payload), false });
+		}
+	}
+	else if (type == FrameFormat::SettingsFrame)
+	{
+		SettingsStore::Update update;
+		if (!SettingsStore::DecodeUpdate(payload, length, update) || !settingsQueue.Put(update))
+		{
+			++settingsRejected;
+		}
+	}
+	else if (type == FrameFormat::CommandFrame)
+	{
+		// Profiler commands are passed to the display task so that the profiler is only ever used from one task
+		for (size_t i = 0; i < length; ++i)
+		{
+			QueueUpdate(TelemetryUpdate{ chunkReceiveTime, Ems::Reading{ payload[i], 0, 0 }, true });
+		}
+	}
+}
+
+static FrameParser parser(HandleFrame);
+
+// The CDC driver doesn't tell us when data arrives, so we poll it while it is empty and read it without pausing while it isn't.
+// The poll backs off while the port stays empty, so that an idle or disconnected port costs little; the USB driver's FIFO holds what
+// arrives meanwhile, and the host is NAKed rather than data lost if it fills. Each byte is copied out of that FIFO into our buffer, where
+// the parser works on it; the parser copies it again only if it is part of a frame that is split between blocks (counted in framesCopied).
+[[noreturn]] static void CdcReceiveTask(void *) noexcept
+{
+	uint8_t buffer[ReceiveChunkSize];
+	uint32_t idlePollMillis = MinIdlePollMillis;
+	for (;;)
+	{
+		if (!serialUSB.IsConnected())
+		{
+			vTaskDelay(pdMS_TO_TICKS(DisconnectedPollMillis));
+			idlePollMillis = MinIdlePollMillis;
+			continue;
+		}
+		const int available = serialUSB.available();
+		if (available <= 0)
+		{
+			vTaskDelay(pdMS_TO_TICKS(idlePollMillis));
+			idlePollMillis = min<uint32_t>(idlePollMillis * 2, MaxIdlePollMillis);
+			continue;
+		}
+		idlePollMillis = MinIdlePollMillis;
+		const size_t numRead = serialUSB.readBytes(reinterpret_cast<char*>(buffer), min<size_t>((size_t)available, sizeof(buffer)));
+		if (numRead != 0)
+		{
+			chunkReceiveTime = time_us_32();
+			parser.Process(buffer, numRead);
+			if (!updateQueue.IsEmpty() || !settingsQueue.IsEmpty())
+			{
+				DisplayWake::Notify(DisplayWake::Event::data);
+			}
+		}
+	}
+}
+
+void CdcReceiver::Start() noexcept
+{
+	cdcReceiveTask.Create(CdcReceiveTask, "CDCRX", nullptr, TaskPriority::CdcReceivePriority);
+}
+
+// Get the next decoded update, returning false if there are none. Call only from the display task.
+bool CdcReceiver::GetUpdate(TelemetryUpdate& update) noexcept
+{
+	return updateQueue.Get(update);
+}
+
+// Get the next setting to be stored, returning false if there are none. Call only from the display task.
+bool CdcReceiver::GetSettingsUpdate(SettingsStore::Update& update) noexcept
+{
+	return settingsQueue.Get(update);
+}
+
+// Return the number of settings frames that were invalid or arrived faster than the display task could store them
+uint32_t CdcReceiver::GetSettingsRejected() noexcept
+{
+	return settingsRejected;
+}
+
+// Return the number of updates dropped because the queue was full
+uint32_t CdcReceiver::GetOverruns() noexcept
+{
+	return overruns;
+}
+
+// Return the largest number of updates that have been waiting for the display task
+uint32_t CdcReceiver::GetMaxQueued() noexcept
+{
+	return maxQueued;
+}
+
+const FrameParser::Stats& CdcReceiver::GetParserStats() noexcept
+{
+	return parser.GetStats();
+}
+
+// End
@@ -0,0 +1,41 @@
+/*
+ * CdcReceiver.h
+ *
+ *  Created on: 8 Feb 2023
+ *      Author: David
+ *
+ *  Task that drains the USB CDC port, decodes the telemetry frames in it and queues the decoded updates for the display task.
+ *  Settings frames are queued separately, because the display task must store each one in flash and apply it.
+ *  Because it runs independently of the display task, a burst from the EMS controller doesn't hold up rendering
+ *  and a slow redraw doesn't leave the USB endpoint full so that the host is NAKed.
+ */
+
+#ifndef SRC_TELEMETRY_CDCRECEIVER_H_
+#define SRC_TELEMETRY_CDCRECEIVER_H_
+
+#include "EmsData.h"
+#include "FrameParser.h"
+#include <SettingsStore.h>
+
+struct TelemetryUpdate
+{
+	uint32_t receiveTime;					// value of time_us_32() when the bytes were read from the USB port
+	Ems::Reading reading;					// if isCommand is true then reading.value holds the command character
+	bool isCommand;
+};
+
+namespace CdcReceiver
+{
+	constexpr size_t UpdateQueueLength = 256;		// must be a power of 2, and enough to hold a few full readings frames
+	constexpr size_t SettingsQueueLength = 4;		// must be a power of 2; settings are changed by hand, so they arrive rarely
+
+	void Start() noexcept;
+	bool GetUpdate(TelemetryUpdate& update) noexcept;
+	bool GetSettingsUpdate(SettingsStore::Update& update) noexcept;
+	uint32_t GetSettingsRejected() noexcept;
+	uint32_t GetOverruns() noexcept;
+	uint32_t GetMaxQueued() noexcept;
+	const FrameParser::Stats& GetParserStats() noexcept;
+}
+
+#endif /* SRC_TELEMETRY_CDCRECEIVER_H_ */
@@ -0,0 +1,47 @@
+/*
+ * EmsData.cpp
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ */
+
+#include "EmsData.h"
+
+// Decode the reading that starts at p. There must be at least ReadingSize bytes.
+Ems::Reading Ems::DecodeReading(const uint8_t *p) noexcept
+{
+	Reading r;
+	r.source = p[0];
+	r.quantity = p[1];
+	r.value = (int32_t)((uint32_t)p[2] | ((uint32_t)p[3] << 8) | ((uint32_t)p[4] << 16) | ((uint32_t)p[5] << 24));
+	return r;
+}
+
+// Store a reading, returning false if it is for an unknown source or quantity. These are skipped so that a newer controller can send
+// readings that this firmware doesn't know about.
+bool Ems::ApplyReading(Data& data, const Reading& r) noexcept
+{
+	if (r.source < NumSources && r.quantity < NumQuantities)
+	{
+		data.values[r.source][r.quantity] = r.value;
+		data.valid[r.source] |= (uint8_t)(1u << r.quantity);
+		return true;
+	}
+	return false;
+}
+
+// Store the readings in a readings frame payload, returning the number stored
+size_t Ems::ApplyReadings(Data& data, const uint8_t *payload, size_t length) noexcept
+{
+	size_t numApplied = 0;
+	for (const uint8_t * const end = payload + length - (length % ReadingSize); payload < end; payload += ReadingSize)
+	{
+		if (ApplyReading(data, DecodeReading(payload)))
+		{
+			++numApplied;
+		}
+	}
+	return numApplied;
+}
+
+// End
@@ -0,0 +1,71 @@
+/*
+ * EmsData.h
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ *
+ *  Fixed-layout model of the energy data received from the EMS controller.
+ *  Every reading is a 32-bit signed integer in the units given for its quantity, so a reading can be stored without knowing what it means.
+ */
+
+#ifndef SRC_TELEMETRY_EMSDATA_H_
+#define SRC_TELEMETRY_EMSDATA_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace Ems
+{
+	// Where a reading comes from. The values are the source numbers used in the telemetry frames.
+	enum class Source : uint8_t
+	{
+		meter0 = 0,							// meters 0 to MaxMeters-1
+		battery = 8,
+		solar = 9,
+		grid = 10,
+	};
+
+	constexpr unsigned int MaxMeters = 6;
+	constexpr unsigned int NumSources = 11;
+
+	// What a reading measures, and its units
+	enum class Quantity : uint8_t
+	{
+		power = 0,							// watts, positive for import or discharge
+		energy = 1,							// watt-hours
+		stateOfCharge = 2,					// tenths of a percent
+		voltage = 3,						// tenths of a volt
+		current = 4,						// hundredths of an amp
+		temperature = 5,					// tenths of a degree C
+	};
+
+	constexpr unsigned int NumQuantities = 6;
+
+	struct Data
+	{
+		int32_t values[NumSources][NumQuantities];
+		uint8_t valid[NumSources];			// bitmap of the quantities that have been received for each source
+		uint32_t lastUpdateTime;			// value of time_us_32() when the last batch of readings was applied
+
+		bool IsValid(Source s, Quantity q) const noexcept { return (valid[(unsigned int)s] & (1u << (unsigned int)q)) != 0; }
+		int32_t Get(Source s, Quantity q) const noexcept { return values[(unsigned int)s][(unsigned int)q]; }
+	};
+
+	inline constexpr Source Meter(unsigned int n) noexcept { return (Source)((unsigned int)Source::meter0 + n); }
+
+	// Each reading in a readings frame is a source number, a quantity number and a little-endian 32-bit value
+	constexpr size_t ReadingSize = 6;
+
+	struct Reading
+	{
+		int32_t value;
+		uint8_t source;
+		uint8_t quantity;
+	};
+
+	Reading DecodeReading(const uint8_t *p) noexcept;
+	bool ApplyReading(Data& data, const Reading& r) noexcept;
+	size_t ApplyReadings(Data& data, const uint8_t *payload, size_t length) noexcept;
+}
+
+#endif /* SRC_TELEMETRY_EMSDATA_H_ */
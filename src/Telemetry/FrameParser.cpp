@@ -0,0 +1,160 @@
+/*
+ * FrameParser.cpp
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ */
+
+#include "FrameParser.h"
+#include <Crc16.h>
+#include <cstring>
+
+using namespace FrameFormat;
+
+static inline uint16_t GetPayloadLength(const uint8_t *frame) noexcept
+{
+	return (uint16_t)(frame[2] | (frame[3] << 8));
+}
+
+FrameParser::FrameParser(FrameHandler fh) noexcept
+	: frameHandler(fh), stats(), partialLength(0), haveSequence(false), expectedSequence(0)
+{
+}
+
+// Check the CRC of a complete frame and pass it to the handler if it is good
+bool FrameParser::CheckAndDispatch(const uint8_t *frame, size_t payloadLength) noexcept
+{
+	const uint8_t * const crcBytes = frame + HeaderSize + payloadLength;
+	const uint16_t receivedCrc = (uint16_t)(crcBytes[0] | (crcBytes[1] << 8));
+	if (Crc16(frame + 2, HeaderSize - 2 + payloadLength) != receivedCrc)
+	{
+		++stats.crcErrors;
+		return false;
+	}
+
+	++stats.framesReceived;
+	const uint8_t sequence = frame[5];
+	if (haveSequence && sequence != expectedSequence)
+	{
+		++stats.sequenceGaps;
+	}
+	haveSequence = true;
+	expectedSequence = sequence + 1;
+	frameHandler(frame[4], sequence, frame + HeaderSize, payloadLength);
+	return true;
+}
+
+// Return how many bytes of a possible frame starting with the first sync byte we need before we can decide whether it is a good frame
+static size_t BytesNeeded(const uint8_t *data, size_t length) noexcept
+{
+	if (length < 2 || data[1] != Sync2)
+	{
+		return 2;
+	}
+	if (length < HeaderSize)
+	{
+		return HeaderSize;
+	}
+	const size_t payloadLength = GetPayloadLength(data);
+	return (payloadLength <= MaxPayloadLength) ? HeaderSize + payloadLength + CrcSize : HeaderSize;
+}
+
+// Look for a frame at the start of 'data', which starts with the first sync byte.
+// Return the number of bytes consumed: the frame length if there is a good frame, 1 if this isn't the start of a good frame, or 0 if we need more data to tell.
+size_t FrameParser::TryFrame(const uint8_t *data, size_t length) noexcept
+{
+	const size_t needed = BytesNeeded(data, length);
+	if (length < needed)
+	{
+		return 0;
+	}
+	if (data[1] != Sync2)
+	{
+		return 1;
+	}
+	const size_t payloadLength = GetPayloadLength(data);
+	if (payloadLength > MaxPayloadLength)
+	{
+		++stats.lengthErrors;
+		return 1;
+	}
+	return (CheckAndDispatch(data, payloadLength)) ? needed : 1;
+}
+
+// Remove bytes from the start of the partial frame buffer, then skip any bytes before the next sync byte because they can't be part of a frame
+void FrameParser::DropPartial(size_t count) noexcept
+{
+	while (count < partialLength && partial[count] != Sync1)
+	{
+		++stats.bytesSkipped;
+		++count;
+	}
+	partialLength -= count;
+	memmove(partial, partial + count, partialLength);
+}
+
+// Process a block of received data. After a bad frame we carry on looking for sync bytes from the byte after the one we thought started the frame,
+// so that we resynchronise on the next frame even if it started inside the bad one.
+void FrameParser::Process(const uint8_t *data, size_t length) noexcept
+{
+	stats.bytesReceived += length;
+	while (length != 0 || partialLength != 0)
+	{
+		if (partialLength != 0)
+		{
+			// We have the start of a frame that was split at the end of a previous block, so add as much of this block as it needs
+			const size_t needed = BytesNeeded(partial, partialLength);
+			if (needed > partialLength)
+			{
+				if (length == 0)
+				{
+					return;
+				}
+				const size_t toCopy = (needed - partialLength < length) ? needed - partialLength : length;
+				memcpy(partial + partialLength, data, toCopy);
+				partialLength += toCopy;
+				data += toCopy;
+				length -= toCopy;
+				continue;
+			}
+
+			const size_t consumed = TryFrame(partial, partialLength);
+			if (consumed > 1)
+			{
+				++stats.framesCopied;
+				DropPartial(consumed);
+			}
+			else
+			{
+				// Not a good frame. Drop the first byte and keep whatever follows from the next sync byte, which may start another frame.
+				++stats.bytesSkipped;
+				DropPartial(1);
+			}
+		}
+		else if (*data != Sync1)
+		{
+			++stats.bytesSkipped;
+			++data;
+			--length;
+		}
+		else
+		{
+			const size_t consumed = TryFrame(data, length);
+			if (consumed == 0)
+			{
+				// This may be the start of a frame that continues in the next block
+				memcpy(partial, data, length);
+				partialLength = length;
+				return;
+			}
+			if (consumed == 1)
+			{
+				++stats.bytesSkipped;
+			}
+			data += consumed;
+			length -= consumed;
+		}
+	}
+}
+
+// End
@@ -0,0 +1,76 @@
+/*
+ * FrameParser.h
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ *
+ *  Parser for the binary frames sent by the EMS controller over USB. A frame is:
+ *    2 bytes	sync, 0xA5 then 0x5A
+ *    2 bytes	payload length, little-endian, at most MaxPayloadLength
+ *    1 byte	frame type
+ *    1 byte	sequence number, incremented by the sender for each frame
+ *    n bytes	payload
+ *    2 bytes	CRC-16-CCITT of everything from the length to the end of the payload, little-endian
+ *
+ *  The parser is given the received data in whatever blocks it arrives in. A frame that lies entirely within one block is checked and
+ *  passed to the handler directly from that block; only a frame split between blocks is copied, into the parser's own buffer.
+ *  Bytes that aren't part of a good frame are counted and dropped. Nothing outside a frame is acted on, so a corrupted frame or joining
+ *  the stream part way through a frame can't be taken for a command; commands have a frame type of their own.
+ */
+
+#ifndef SRC_TELEMETRY_FRAMEPARSER_H_
+#define SRC_TELEMETRY_FRAMEPARSER_H_
+
+#include <cstdint>
+#include <cstddef>
+
+namespace FrameFormat
+{
+	constexpr uint8_t Sync1 = 0xA5;
+	constexpr uint8_t Sync2 = 0x5A;
+	constexpr size_t HeaderSize = 6;
+	constexpr size_t CrcSize = 2;
+	constexpr size_t MaxPayloadLength = 504;
+	constexpr size_t MaxFrameSize = HeaderSize + MaxPayloadLength + CrcSize;
+
+	// Frame types
+	constexpr uint8_t ReadingsFrame = 1;				// payload is a batch of readings, see EmsData.h
+	constexpr uint8_t SettingsFrame = 2;				// payload is a settings key and the new value, see SettingsStore.h
+	constexpr uint8_t CommandFrame = 3;					// payload is one or more profiler command characters, see Profiler.cpp
+}
+
+class FrameParser
+{
+public:
+	typedef void (*FrameHandler)(uint8_t type, uint8_t sequence, const uint8_t *payload, size_t length) noexcept;
+
+	struct Stats
+	{
+		uint32_t bytesReceived;
+		uint32_t framesReceived;
+		uint32_t crcErrors;
+		uint32_t lengthErrors;
+		uint32_t sequenceGaps;						// number of times the sequence number was not one more than in the previous frame
+		uint32_t framesCopied;						// frames that were split between blocks and had to be reassembled
+		uint32_t bytesSkipped;						// bytes that weren't part of a good frame
+	};
+
+	explicit FrameParser(FrameHandler fh) noexcept;
+
+	void Process(const uint8_t *data, size_t length) noexcept;
+	const Stats& GetStats() const noexcept { return stats; }
+
+private:
+	size_t TryFrame(const uint8_t *data, size_t length) noexcept;
+	bool CheckAndDispatch(const uint8_t *frame, size_t payloadLength) noexcept;
+	void DropPartial(size_t count) noexcept;
+
+	FrameHandler frameHandler;
+	Stats stats;
+	size_t partialLength;							// number of bytes of a split frame held in 'partial'
+	bool haveSequence;
+	uint8_t expectedSequence;
+	uint8_t partial[FrameFormat::MaxFrameSize];
+};
+
+#endif /* SRC_TELEMETRY_FRAMEPARSER_H_ */
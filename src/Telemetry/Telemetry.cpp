@@ -0,0 +1,145 @@
+/*
+ * Telemetry.cpp
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ */
+
+#include <Core.h>
+#include "Telemetry.h"
+#include "CdcReceiver.h"
+#include <Profiler.h>
+#include <hardware/timer.h>
+
+constexpr unsigned int MaxUpdatesPerSpin = 128;		// limit the time we spend on updates before getting back to rendering
+constexpr int32_t HistoryWattsPerCount = 10;		// power history is stored to 10W, so it can go up to 327kW
+
+static Ems::Data emsData;
+static uint32_t updatesApplied = 0;
+static uint32_t maxLatency = 0;
+static uint32_t totalLatency = 0;
+static uint32_t settingsStored = 0;
+static uint32_t settingsFailed = 0;
+
+// Power history of the main sources, about 9.6K bytes each
+static constexpr Ems::Source HistorySources[] = { Ems::Source::grid, Ems::Source::solar, Ems::Source::battery };
+static TimeSeries histories[ARRAY_SIZE(HistorySources)] = { TimeSeries(HistoryWattsPerCount), TimeSeries(HistoryWattsPerCount), TimeSeries(HistoryWattsPerCount) };
+static uint32_t historySeconds = 0;							// seconds since we started, used to timestamp the history
+static uint32_t historyMicroseconds = 0;					// value of time_us_32() at the start of the current second
+
+// Record the latest power readings once a second. If we were held up for more than a second then the seconds we missed are left as gaps.
+static void RecordHistory() noexcept
+{
+	const uint32_t elapsed = (time_us_32() - historyMicroseconds)/1000000;
+	if (elapsed != 0)
+	{
+		historySeconds += elapsed;
+		historyMicroseconds += elapsed * 1000000;
+		for (size_t i = 0; i < ARRAY_SIZE(HistorySources); ++i)
+		{
+			if (emsData.IsValid(HistorySources[i], Ems::Quantity::power))
+			{
+				histories[i].Add(historySeconds, emsData.Get(HistorySources[i], Ems::Quantity::power));
+			}
+		}
+	}
+}
+
+// Start receiving telemetry
+void Telemetry::Start() noexcept
+{
+	historyMicroseconds = time_us_32();
+	CdcReceiver::Start();
+}
+
+// Apply the updates that the CDC receive task has decoded since we were last called. Call only from the display task.
+// Returns true if we stopped because we had applied MaxUpdatesPerSpin of them, so there may be more waiting.
+bool Telemetry::ApplyUpdates() noexcept
+{
+	TelemetryUpdate update;
+	unsigned int i = 0;
+	for (; i < MaxUpdatesPerSpin && CdcReceiver::GetUpdate(update); ++i)
+	{
+		if (update.isCommand)
+		{
+			Profiler::Command((uint8_t)update.reading.value);
+			continue;
+		}
+
+		(void)Ems::ApplyReading(emsData, update.reading);
+		const uint32_t now = time_us_32();
+		emsData.lastUpdateTime = now;
+		const uint32_t latency = now - update.receiveTime;
+		++updatesApplied;
+		totalLatency += latency;
+		if (latency > maxLatency)
+		{
+			maxLatency = latency;
+		}
+	}
+	RecordHistory();
+	return i == MaxUpdatesPerSpin;
+}
+
+// Store the next setting received over USB in flash, returning false if there are none. Call only from the display task, which must then apply the setting.
+// Writing to flash stops the display flushes and this core for up to a sector erase (about 45ms), but settings are only sent when the user changes one.
+bool Telemetry::StoreNextSetting(SettingsStore::Update& update) noexcept
+{
+	if (!CdcReceiver::GetSettingsUpdate(update))
+	{
+		return false;
+	}
+	if (SettingsStore::Write(update.key, update.value, update.length))
+	{
+		++settingsStored;
+	}
+	else
+	{
+		++settingsFailed;
+	}
+	return true;
+}
+
+const Ems::Data& Telemetry::GetData() noexcept
+{
+	return emsData;
+}
+
+// Get the power history for a source, or nullptr if we don't keep one for it
+const TimeSeries *Telemetry::GetHistory(Ems::Source source) noexcept
+{
+	for (size_t i = 0; i < ARRAY_SIZE(HistorySources); ++i)
+	{
+		if (HistorySources[i] == source)
+		{
+			return &histories[i];
+		}
+	}
+	return nullptr;
+}
+
+// Get the time in seconds that the history has reached
+uint32_t Telemetry::GetHistoryTime() noexcept
+{
+	return historySeconds;
+}
+
+Telemetry::Stats Telemetry::GetStats() noexcept
+{
+	Stats stats;
+	stats.updatesApplied = updatesApplied;
+	stats.overruns = CdcReceiver::GetOverruns();
+	stats.maxQueued = CdcReceiver::GetMaxQueued();
+	stats.maxLatency = maxLatency;
+	stats.totalLatency = totalLatency;
+	stats.settingsStored = settingsStored;
+	stats.settingsRejected = CdcReceiver::GetSettingsRejected() + settingsFailed;
+	return stats;
+}
+
+const FrameParser::Stats& Telemetry::GetParserStats() noexcept
+{
+	return CdcReceiver::GetParserStats();
+}
+
+// End
@@ -0,0 +1,43 @@
+/*
+ * Telemetry.h
+ *
+ *  Created on: 6 Feb 2023
+ *      Author: David
+ *
+ *  Display task side of the telemetry from the EMS controller. The updates decoded by the CDC receive task are applied to the latest readings here,
+ *  and the power readings of the main sources are recorded once a second for the trend charts. Settings received over USB are stored here too;
+ *  the display task applies them.
+ */
+
+#ifndef SRC_TELEMETRY_TELEMETRY_H_
+#define SRC_TELEMETRY_TELEMETRY_H_
+
+#include "EmsData.h"
+#include "FrameParser.h"
+#include "TimeSeries.h"
+#include <SettingsStore.h>
+
+namespace Telemetry
+{
+	struct Stats
+	{
+		uint32_t updatesApplied;
+		uint32_t overruns;						// updates dropped because the display task didn't collect them in time
+		uint32_t maxQueued;						// most updates ever waiting for the display task
+		uint32_t maxLatency;					// longest time in microseconds from reading an update from USB to applying it
+		uint32_t totalLatency;					// sum of the latencies, for calculating the average
+		uint32_t settingsStored;				// settings frames whose values were written to flash
+		uint32_t settingsRejected;				// settings frames that were invalid, arrived too fast, or couldn't be written
+	};
+
+	void Start() noexcept;
+	bool ApplyUpdates() noexcept;
+	bool StoreNextSetting(SettingsStore::Update& update) noexcept;
+	const Ems::Data& GetData() noexcept;
+	const TimeSeries *GetHistory(Ems::Source source) noexcept;
+	uint32_t GetHistoryTime() noexcept;
+	Stats GetStats() noexcept;
+	const FrameParser::Stats& GetParserStats() noexcept;
+}
+
+#endif /* SRC_TELEMETRY_TELEMETRY_H_ */
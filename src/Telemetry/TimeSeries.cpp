@@ -0,0 +1,273 @@
+/*
+ * TimeSeries.cpp
+ *
+ *  Created on: 12 Feb 2023
+ *      Author: David
+ */
+
+#include "TimeSeries.h"
+
+TimeSeries::TimeSeries(int32_t p_unitsPerCount) noexcept
+	: unitsPerCount(p_unitsPerCount), latestTime(0), hasData(false), buckets{ nullptr, minutes, quarterHours, hours }
+{
+	for (int16_t& r : raw)
+	{
+		r = NoData;
+	}
+	for (size_t level = 1; level < NumLevels; ++level)
+	{
+		for (size_t i = 0; i < LevelLengths[level]; ++i)
+		{
+			buckets[level][i] = Bucket{ 0, 0, 0, 0 };
+		}
+		pending[level] = Accumulator{ 0, 0, 0, 0, 0 };
+	}
+	for (uint32_t& s : newestSlot)
+	{
+		s = 0;
+	}
+}
+
+// Convert a value to a 16-bit sample, rounding to the nearest step and limiting it to the range we can store
+int16_t TimeSeries::Quantise(int32_t value) const noexcept
+{
+	const int32_t half = unitsPerCount/2;
+	const int32_t q = (value >= 0) ? (value + half)/unitsPerCount : -((half - value)/unitsPerCount);
+	return (q > INT16_MAX) ? INT16_MAX : (q <= NoData) ? NoData + 1 : (int16_t)q;
+}
+
+// Add the sample for 'time', which is in seconds and must be later than the previous sample. Seconds without samples are recorded as gaps.
+void TimeSeries::Add(uint32_t time, int32_t value) noexcept
+{
+	if (hasData && time <= latestTime)
+	{
+		return;
+	}
+
+	const int16_t q = Quantise(value);
+
+	// Store the raw sample, marking any seconds we missed as having no data
+	if (hasData)
+	{
+		const uint32_t firstMissing = (time - latestTime > LevelLengths[0]) ? time - LevelLengths[0] + 1 : latestTime + 1;
+		for (uint32_t t = firstMissing; t < time; ++t)
+		{
+			raw[t % LevelLengths[0]] = NoData;
+		}
+	}
+	raw[time % LevelLengths[0]] = q;
+	newestSlot[0] = time;
+
+	// Add it to the buckets being built for the other resolutions, first storing any that it doesn't belong in
+	for (size_t level = 1; level < NumLevels; ++level)
+	{
+		Accumulator& acc = pending[level];
+		const uint32_t slot = time/LevelPeriods[level];
+		if (acc.count != 0 && acc.slot != slot)
+		{
+			Emit(level, acc);
+			acc.count = 0;
+		}
+		if (acc.count == 0)
+		{
+			acc.slot = slot;
+			acc.sum = 0;
+			acc.min = acc.max = q;
+		}
+		acc.sum += q;
+		if (q < acc.min)
+		{
+			acc.min = q;
+		}
+		else if (q > acc.max)
+		{
+			acc.max = q;
+		}
+		++acc.count;
+	}
+
+	latestTime = time;
+	hasData = true;
+}
+
+// Store a completed bucket, marking any slots we skipped as empty
+void TimeSeries::Emit(size_t level, const Accumulator& acc) noexcept
+{
+	const size_t length = LevelLengths[level];
+	Bucket * const ring = buckets[level];
+	const uint32_t firstMissing = (acc.slot - newestSlot[level] > length) ? acc.slot - length + 1 : newestSlot[level] + 1;
+	for (uint32_t s = firstMissing; s < acc.slot; ++s)
+	{
+		ring[s % length].count = 0;
+	}
+
+	const int32_t half = acc.count/2;
+	Bucket& b = ring[acc.slot % length];
+	b.min = acc.min;
+	b.max = acc.max;
+	b.avg = (int16_t)((acc.sum >= 0) ? (acc.sum + half)/(int32_t)acc.count : -((half - acc.sum)/(int32_t)acc.count));
+	b.count = acc.count;
+	newestSlot[level] = acc.slot;
+}
+
+// Get the bucket for a slot at one of the resolutions, returning false if we have no samples for it
+bool TimeSeries::GetBucket(size_t level, uint32_t slot, Bucket& b) const noexcept
+{
+	if (!hasData)
+	{
+		return false;
+	}
+
+	const size_t length = LevelLengths[level];
+	if (level == 0)
+	{
+		if (slot > latestTime || slot + length <= latestTime)
+		{
+			return false;
+		}
+		const int16_t v = raw[slot % length];
+		b = Bucket{ v, v, v, 1 };
+		return v != NoData;
+	}
+
+	const Accumulator& acc = pending[level];
+	if (acc.count != 0 && slot == acc.slot)
+	{
+		const int32_t half = acc.count/2;
+		b.min = acc.min;
+		b.max = acc.max;
+		b.avg = (int16_t)((acc.sum >= 0) ? (acc.sum + half)/(int32_t)acc.count : -((half - acc.sum)/(int32_t)acc.count));
+		b.count = acc.count;
+		return true;
+	}
+	if (slot > newestSlot[level] || slot + length <= newestSlot[level])
+	{
+		return false;
+	}
+	b = buckets[level][slot % length];
+	return b.count != 0;
+}
+
+// Return true if a resolution still holds the entry for a time, or would if we had a sample for it
+bool TimeSeries::Covers(size_t level, uint32_t time) const noexcept
+{
+	const uint32_t newest = (level == 0 || pending[level].count == 0) ? newestSlot[level] : pending[level].slot;
+	return time/LevelPeriods[level] + LevelLengths[level] > newest;
+}
+
+void TimeSeries::Totals::Clear() noexcept
+{
+	sum = 0;
+	count = 0;
+	min = INT16_MAX;
+	max = INT16_MIN;
+}
+
+void TimeSeries::Totals::Add(const Bucket& b) noexcept
+{
+	sum += (int64_t)b.avg * b.count;
+	count += b.count;
+	if (b.min < min)
+	{
+		min = b.min;
+	}
+	if (b.max > max)
+	{
+		max = b.max;
+	}
+}
+
+void TimeSeries::ToSummary(const Totals& t, Summary& s) const noexcept
+{
+	s.count = t.count;
+	if (t.count == 0)
+	{
+		s.min = s.max = s.avg = 0;
+	}
+	else
+	{
+		s.min = (int32_t)t.min * unitsPerCount;
+		s.max = (int32_t)t.max * unitsPerCount;
+		s.avg = (int32_t)((t.sum * unitsPerCount)/(int64_t)t.count);
+	}
+}
+
+// Get the minimum, maximum and average of the samples from 'start' up to but not including 'end', returning false if there are none.
+// We use the finest resolution that still covers 'start' without scanning more than MaxBucketsScanned entries. So at coarser resolutions,
+// samples in the same entry as 'start' or 'end' but outside the range are included.
+bool TimeSeries::Query(uint32_t start, uint32_t end, Summary& result) const noexcept
+{
+	Totals totals;
+	totals.Clear();
+	if (end > start)
+	{
+		size_t level = 0;
+		while (level + 1 < NumLevels
+				&& (!Covers(level, start) || (end - 1)/LevelPeriods[level] - start/LevelPeriods[level] >= MaxBucketsScanned))
+		{
+			++level;
+		}
+
+		Bucket b;
+		for (uint32_t slot = start/LevelPeriods[level]; slot <= (end - 1)/LevelPeriods[level]; ++slot)
+		{
+			if (GetBucket(level, slot, b))
+			{
+				totals.Add(b);
+			}
+		}
+	}
+	ToSummary(totals, result);
+	return result.count != 0;
+}
+
+// Divide the time from 'start' up to but not including 'end' into equal intervals, one per chart point, and summarise the samples in each.
+// We use the coarsest resolution that is no coarser than the intervals and still covers 'start'. Returns the number of intervals,
+// which is fewer than numResults if the range is less than numResults seconds long.
+size_t TimeSeries::QueryBuckets(uint32_t start, uint32_t end, Summary *results, size_t numResults) const noexcept
+{
+	if (end <= start || numResults == 0)
+	{
+		return 0;
+	}
+	if (end - start < numResults)
+	{
+		numResults = end - start;
+	}
+	const uint32_t width = (end - start)/numResults;
+
+	size_t level = NumLevels;
+	do
+	{
+		--level;
+	} while (level != 0 && (LevelPeriods[level] > width || !Covers(level, start)));
+	if (level == 0 && !Covers(0, start))
+	{
+		// The range starts before the raw samples, so use the finest resolution that goes back far enough
+		while (level + 1 < NumLevels && !Covers(level, start))
+		{
+			++level;
+		}
+	}
+
+	const uint32_t period = LevelPeriods[level];
+	Bucket b;
+	for (size_t i = 0; i < numResults; ++i)
+	{
+		const uint32_t intervalStart = start + i * width;
+		const uint32_t intervalEnd = (i + 1 == numResults) ? end : intervalStart + width;
+		Totals totals;
+		totals.Clear();
+		for (uint32_t slot = intervalStart/period; slot <= (intervalEnd - 1)/period; ++slot)
+		{
+			if (GetBucket(level, slot, b))
+			{
+				totals.Add(b);
+			}
+		}
+		ToSummary(totals, results[i]);
+	}
+	return numResults;
+}
+
+// End
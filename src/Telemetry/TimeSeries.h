@@ -0,0 +1,93 @@
+/*
+ * TimeSeries.h
+ *
+ *  Created on: 12 Feb 2023
+ *      Author: David
+ *
+ *  Fixed-size history of one value sampled once per second, for trend charts.
+ *  Samples are quantised to 16 bits and kept at four resolutions: the raw samples, and the minimum, maximum and average over each minute,
+ *  15 minutes and hour. Each resolution is a ring that overwrites its oldest entries, so the memory used is fixed and the coarser
+ *  resolutions go back further. A range query scans whichever resolution gives enough detail, so its cost depends on how many
+ *  chart points are wanted rather than on how long the range is.
+ *  There is nothing hardware-specific in here, so it can be tested and benchmarked on a host.
+ */
+
+#ifndef SRC_TELEMETRY_TIMESERIES_H_
+#define SRC_TELEMETRY_TIMESERIES_H_
+
+#include <cstdint>
+#include <cstddef>
+
+class TimeSeries
+{
+public:
+	static constexpr size_t NumLevels = 4;
+	static constexpr uint32_t LevelPeriods[NumLevels] = { 1, 60, 15 * 60, 60 * 60 };		// seconds per entry at each resolution
+	static constexpr size_t LevelLengths[NumLevels] = { 15 * 60, 4 * 60, 4 * 96, 14 * 24 };	// 15 minutes, 4 hours, 4 days, 14 days
+	static constexpr size_t MaxBucketsScanned = 1024;					// Query uses a coarser resolution rather than scan more than this
+
+	// Summary of the samples in a time range, in the units of the values passed to Add
+	struct Summary
+	{
+		int32_t min, max, avg;
+		uint32_t count;						// number of samples, zero if there were none in the range
+	};
+
+	explicit TimeSeries(int32_t unitsPerCount) noexcept;
+
+	void Add(uint32_t time, int32_t value) noexcept;
+	bool Query(uint32_t start, uint32_t end, Summary& result) const noexcept;
+	size_t QueryBuckets(uint32_t start, uint32_t end, Summary *results, size_t numResults) const noexcept;
+	uint32_t GetLatestTime() const noexcept { return latestTime; }
+	bool IsEmpty() const noexcept { return !hasData; }
+
+private:
+	static constexpr int16_t NoData = INT16_MIN;
+
+	// Minimum, maximum and average of the samples in one entry of a downsampled resolution, quantised like the samples
+	struct Bucket
+	{
+		int16_t min, max, avg;
+		uint16_t count;
+	};
+
+	// A bucket in the making
+	struct Accumulator
+	{
+		int32_t sum;
+		uint32_t slot;
+		int16_t min, max;
+		uint16_t count;
+	};
+
+	// Totals used while answering a query
+	struct Totals
+	{
+		int64_t sum;
+		uint32_t count;
+		int16_t min, max;
+
+		void Clear() noexcept;
+		void Add(const Bucket& b) noexcept;
+	};
+
+	int16_t Quantise(int32_t value) const noexcept;
+	void Emit(size_t level, const Accumulator& acc) noexcept;
+	bool GetBucket(size_t level, uint32_t slot, Bucket& b) const noexcept;
+	bool Covers(size_t level, uint32_t time) const noexcept;
+	void ToSummary(const Totals& t, Summary& s) const noexcept;
+
+	int32_t unitsPerCount;					// value units per quantisation step
+	uint32_t latestTime;
+	bool hasData;
+
+	int16_t raw[LevelLengths[0]];
+	Bucket minutes[LevelLengths[1]];
+	Bucket quarterHours[LevelLengths[2]];
+	Bucket hours[LevelLengths[3]];
+	Bucket * const buckets[NumLevels];		// the downsampled rings, indexed by level; buckets[0] is not used
+	uint32_t newestSlot[NumLevels];			// newest slot stored in each ring
+	Accumulator pending[NumLevels];			// the bucket being built for each downsampled resolution; pending[0] is not used
+};
+
+#endif /* SRC_TELEMETRY_TIMESERIES_H_ */
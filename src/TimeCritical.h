@@ -0,0 +1,21 @@
+/*
+ * TimeCritical.h
+ *
+ *  Created on: 21 Feb 2023
+ *      Author: David
+ *
+ *  Functions marked TIME_CRITICAL are linked into the .time_critical section, which the startup code copies from flash to RAM,
+ *  so they never wait for an XIP cache miss. Use it only for code whose loops run once per pixel or once per run of pixels: a cache miss
+ *  costs far more than the few instructions of each loop iteration, and the flush code on core 1 competes with core 0 for the cache.
+ *  Code that runs a few times per frame gains too little to be worth the RAM.
+ *  The name gives each function its own input section, so the linker map shows how much RAM each one uses. Run map-report
+ *  (see src/Simulator/MapReport) on the map file to list them. Anything a marked function calls that isn't inlined or marked
+ *  itself still runs from flash.
+ */
+
+#ifndef SRC_TIMECRITICAL_H_
+#define SRC_TIMECRITICAL_H_
+
+#define TIME_CRITICAL(name)		__attribute__((section(".time_critical." #name)))
+
+#endif /* SRC_TIMECRITICAL_H_ */
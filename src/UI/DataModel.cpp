@@ -0,0 +1,161 @@
+/*
+ * DataModel.cpp
+ *
+ *  Created on: 10 Feb 2023
+ *      Author: David
+ */
+
+#include "DataModel.h"
+#include <General/SafeVsnprintf.h>
+#include <cstring>
+#include <cinttypes>
+
+// A label bound to a field. The label displays our copy of the text, so LVGL doesn't have to allocate memory for a copy of its own.
+struct Binding
+{
+	const ModelField *field;
+	lv_obj_t *label;
+	uint32_t shownVersion;
+	char text[ModelField::MaxTextLength];
+};
+
+static Binding bindings[DataModel::MaxBindings];
+static size_t numBindings = 0;
+static DataModel::Stats stats = {};
+
+// Round a value to a whole number of steps
+static int32_t ToSteps(int32_t value, int32_t unitsPerStep) noexcept
+{
+	const int32_t half = unitsPerStep/2;
+	return (value >= 0) ? (value + half)/unitsPerStep : -((half - value)/unitsPerStep);
+}
+
+// Set a new value, returning true if the displayed text changes. A value within the deadband of the displayed one is ignored, so that noise
+// doesn't make the last digit flicker, and so is one that rounds to the same displayed value.
+bool NumberField::Set(int32_t value) noexcept
+{
+	if (valid)
+	{
+		const int32_t diff = value - displayedValue;
+		if (diff <= format.deadband && diff >= -format.deadband)
+		{
+			return false;
+		}
+	}
+
+	const int32_t steps = ToSteps(value, format.unitsPerStep);
+	if (valid && steps == displayedSteps)
+	{
+		return false;
+	}
+	displayedValue = value;
+	displayedSteps = steps;
+	valid = true;
+	++version;
+	return true;
+}
+
+// Mark the value as unknown
+void NumberField::Clear() noexcept
+{
+	if (valid)
+	{
+		valid = false;
+		++version;
+	}
+}
+
+void NumberField::Format(char *buffer, size_t length) const noexcept
+{
+	if (!valid)
+	{
+		SafeSnprintf(buffer, length, "--%s", format.suffix);
+		return;
+	}
+
+	const uint32_t magnitude = (displayedSteps < 0) ? -(uint32_t)displayedSteps : (uint32_t)displayedSteps;
+	const char * const sign = (displayedSteps < 0) ? "-" : "";
+	if (format.decimals == 0)
+	{
+		SafeSnprintf(buffer, length, "%s%" PRIu32 "%s", sign, magnitude, format.suffix);
+	}
+	else
+	{
+		// Write the fraction digits ourselves so that we get the leading zeros
+		const unsigned int decimals = (format.decimals < MaxDecimals) ? format.decimals : MaxDecimals;
+		char fraction[MaxDecimals + 1];
+		uint32_t whole = magnitude;
+		for (unsigned int i = decimals; i != 0; --i)
+		{
+			fraction[i - 1] = (char)('0' + whole % 10);
+			whole /= 10;
+		}
+		fraction[decimals] = 0;
+		SafeSnprintf(buffer, length, "%s%" PRIu32 ".%s%s", sign, whole, fraction, format.suffix);
+	}
+}
+
+// Select one of the strings, returning true if it is a different one
+bool StateField::Set(size_t newState) noexcept
+{
+	if (newState == state || newState >= numStrings)
+	{
+		return false;
+	}
+	state = newState;
+	++version;
+	return true;
+}
+
+void StateField::Format(char *buffer, size_t length) const noexcept
+{
+	SafeSnprintf(buffer, length, "%s", strings[state]);
+}
+
+// Bind a label to a field, so that the label shows the field's value from the next call to Refresh. Returns false if there are too many bindings.
+bool DataModel::Bind(const ModelField& field, lv_obj_t *label) noexcept
+{
+	if (numBindings == MaxBindings)
+	{
+		return false;
+	}
+	Binding& b = bindings[numBindings++];
+	b.field = &field;
+	b.label = label;
+	b.shownVersion = field.GetVersion() - 1;				// make sure that the label gets its first value
+	b.text[0] = 0;
+	return true;
+}
+
+// Update the labels whose fields have changed. Call once per frame before lv_timer_handler.
+void DataModel::Refresh() noexcept
+{
+	for (size_t i = 0; i < numBindings; ++i)
+	{
+		Binding& b = bindings[i];
+		const uint32_t version = b.field->GetVersion();
+		if (version != b.shownVersion)
+		{
+			b.shownVersion = version;
+			char newText[ModelField::MaxTextLength];
+			b.field->Format(newText, sizeof(newText));
+			if (strcmp(newText, b.text) == 0)
+			{
+				++stats.unchangedTexts;
+			}
+			else
+			{
+				strcpy(b.text, newText);
+				lv_label_set_text_static(b.label, b.text);		// this makes LVGL invalidate the label
+				++stats.labelsUpdated;
+			}
+		}
+	}
+}
+
+const DataModel::Stats& DataModel::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
@@ -0,0 +1,90 @@
+/*
+ * DataModel.h
+ *
+ *  Created on: 10 Feb 2023
+ *      Author: David
+ *
+ *  Values shown on the screen, each with a version number that changes only when its displayed text would change.
+ *  Fields are bound to LVGL labels once, and Refresh pushes the changed fields to their labels once per frame,
+ *  so values that change too little to show don't cost any formatting or redrawing.
+ */
+
+#ifndef SRC_UI_DATAMODEL_H_
+#define SRC_UI_DATAMODEL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <lvgl.h>
+
+class ModelField
+{
+public:
+	static constexpr size_t MaxTextLength = 24;				// including the null terminator
+
+	uint32_t GetVersion() const noexcept { return version; }
+	virtual void Format(char *buffer, size_t length) const noexcept = 0;
+
+protected:
+	uint32_t version = 0;									// incremented whenever the displayed text changes
+};
+
+// How a fixed-point value is displayed
+struct NumberFormat
+{
+	int32_t unitsPerStep;			// value units per step of the last digit displayed, e.g. 10 for watts shown as kW to 2 decimal places
+	uint8_t decimals;				// number of digits after the decimal point, up to MaxDecimals
+	int32_t deadband;				// changes of this many value units or fewer from the displayed value are ignored
+	const char *suffix;				// units to append, e.g. " kW"
+};
+
+// A number, displayed with a fixed number of decimal places
+class NumberField : public ModelField
+{
+public:
+	static constexpr unsigned int MaxDecimals = 6;
+
+	explicit constexpr NumberField(const NumberFormat& f) noexcept : format(f) { }
+
+	bool Set(int32_t value) noexcept;
+	void Clear() noexcept;
+	void Format(char *buffer, size_t length) const noexcept override;
+
+private:
+	const NumberFormat& format;
+	int32_t displayedValue = 0;		// the value we last accepted
+	int32_t displayedSteps = 0;		// displayedValue rounded to the displayed resolution
+	bool valid = false;
+};
+
+// One of a fixed set of strings
+class StateField : public ModelField
+{
+public:
+	constexpr StateField(const char * const *s, size_t n) noexcept : strings(s), numStrings(n) { }
+
+	bool Set(size_t state) noexcept;
+	size_t Get() const noexcept { return state; }
+	void Format(char *buffer, size_t length) const noexcept override;
+
+private:
+	const char * const *strings;
+	size_t numStrings;
+	size_t state = 0;
+};
+
+namespace DataModel
+{
+	constexpr size_t MaxBindings = 32;
+
+	struct Stats
+	{
+		uint32_t labelsUpdated;				// number of times a label's text was changed
+		uint32_t unchangedTexts;			// number of times a field changed version but formatted to the same text
+	};
+
+	bool Bind(const ModelField& field, lv_obj_t *label) noexcept;
+	void Refresh() noexcept;
+	const Stats& GetStats() noexcept;
+}
+
+#endif /* SRC_UI_DATAMODEL_H_ */
@@ -0,0 +1,211 @@
+/*
+ * DeferredFill.cpp
+ *
+ *  Created on: 22 Feb 2023
+ *      Author: David
+ *
+ *  Each draw buffer has its own list of solid areas, which belongs to the flush from when TakeSolidAreas is called until LVGL next draws
+ *  into that buffer; LVGL doesn't do that until the flush is complete. Only drawing into the draw buffer itself is affected. Drawing into
+ *  a layer buffer is left alone, and when the layer is blended into the draw buffer the solid areas it covers are written first.
+ *  The solid areas in a list never overlap, because any fill drawn over one is treated like any other drawing.
+ */
+
+#include "DeferredFill.h"
+
+using namespace DeferredFill;
+
+struct SolidList
+{
+	const void *buf;									// the draw buffer this list is for, or nullptr if the list is unused
+	size_t count;
+	bool flushed;										// the list has been taken by the flush, so it is out of date when LVGL draws into the buffer again
+	SSD1963::SolidArea areas[SSD1963::MaxSolidAreas];
+};
+
+static SolidList lists[2];								// one for each draw buffer
+static Stats stats = {};
+static decltype(lv_draw_sw_ctx_t::blend) lvglBlend = nullptr;
+
+// Return the list for the draw buffer that LVGL is drawing into, or nullptr if it is drawing into something else
+static SolidList *GetList(const lv_draw_ctx_t *drawCtx) noexcept
+{
+	const lv_disp_t * const disp = _lv_refr_get_disp_refreshing();
+	if (disp == nullptr || drawCtx->buf != disp->driver->draw_buf->buf_act)
+	{
+		return nullptr;
+	}
+
+	SolidList *unused = nullptr;
+	for (SolidList& list : lists)
+	{
+		if (list.buf == drawCtx->buf)
+		{
+			if (list.flushed)
+			{
+				list.count = 0;
+				list.flushed = false;
+			}
+			return &list;
+		}
+		if (list.buf == nullptr && unused == nullptr)
+		{
+			unused = &list;
+		}
+	}
+	if (unused != nullptr)
+	{
+		unused->buf = drawCtx->buf;
+		unused->count = 0;
+		unused->flushed = false;
+	}
+	return unused;
+}
+
+// Write rows y1 to y2 of a solid area to the draw buffer
+static void WriteRows(const lv_draw_ctx_t *drawCtx, const SSD1963::SolidArea& s, lv_coord_t y1, lv_coord_t y2) noexcept
+{
+	const lv_coord_t stride = lv_area_get_width(drawCtx->buf_area);
+	const uint32_t width = lv_area_get_width(&s.area);
+	lv_color_t *row = static_cast<lv_color_t*>(drawCtx->buf) + (y1 - drawCtx->buf_area->y1) * stride + (s.area.x1 - drawCtx->buf_area->x1);
+	for (lv_coord_t y = y1; y <= y2; ++y)
+	{
+		lv_color_fill(row, s.colour, width);
+		row += stride;
+	}
+	stats.pixelsWritten += width * (y2 - y1 + 1);
+}
+
+// Write the rows of the solid areas that overlap an area to the draw buffer, because something is about to be drawn there.
+// A solid area keeps the rows above and below the overlap, so it may be split in two; if the list is full, all of it is written instead.
+static void WriteOverlappingRows(const lv_draw_ctx_t *drawCtx, SolidList& list, const lv_area_t& area) noexcept
+{
+	size_t i = 0;
+	while (i < list.count)
+	{
+		SSD1963::SolidArea& s = list.areas[i];
+		lv_area_t overlap;
+		if (!_lv_area_intersect(&overlap, &s.area, &area))
+		{
+			++i;
+			continue;
+		}
+
+		const bool keepAbove = overlap.y1 > s.area.y1;
+		const bool keepBelow = overlap.y2 < s.area.y2;
+		if (keepAbove && keepBelow && list.count < SSD1963::MaxSolidAreas)
+		{
+			WriteRows(drawCtx, s, overlap.y1, overlap.y2);
+			SSD1963::SolidArea& below = list.areas[list.count++];
+			below = s;
+			below.area.y1 = overlap.y2 + 1;
+			s.area.y2 = overlap.y1 - 1;
+			++i;
+		}
+		else if (keepAbove && !keepBelow)
+		{
+			WriteRows(drawCtx, s, overlap.y1, overlap.y2);
+			s.area.y2 = overlap.y1 - 1;
+			++i;
+		}
+		else if (keepBelow && !keepAbove)
+		{
+			WriteRows(drawCtx, s, overlap.y1, overlap.y2);
+			s.area.y1 = overlap.y2 + 1;
+			++i;
+		}
+		else
+		{
+			WriteRows(drawCtx, s, s.area.y1, s.area.y2);
+			s = list.areas[--list.count];
+		}
+	}
+}
+
+// Drop the solid areas that an area covers completely, because an opaque fill is about to be drawn over them
+static void DropCoveredAreas(SolidList& list, const lv_area_t& area) noexcept
+{
+	size_t i = 0;
+	while (i < list.count)
+	{
+		if (_lv_area_is_in(&list.areas[i].area, &area, 0))
+		{
+			list.areas[i] = list.areas[--list.count];
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+static void Blend(lv_draw_ctx_t *drawCtx, const lv_draw_sw_blend_dsc_t *dsc) noexcept
+{
+	lv_area_t area;
+	SolidList * const list = (dsc->mask_buf != nullptr && dsc->mask_res == LV_DRAW_MASK_RES_TRANSP) ? nullptr : GetList(drawCtx);
+	if (list == nullptr || !_lv_area_intersect(&area, dsc->blend_area, drawCtx->clip_area))
+	{
+		lvglBlend(drawCtx, dsc);
+		return;
+	}
+
+	const bool opaqueFill =    dsc->src_buf == nullptr
+							&& (dsc->mask_buf == nullptr || dsc->mask_res == LV_DRAW_MASK_RES_FULL_COVER)
+							&& dsc->opa >= LV_OPA_MAX
+							&& dsc->blend_mode == LV_BLEND_MODE_NORMAL;
+	if (opaqueFill)
+	{
+		DropCoveredAreas(*list, area);
+	}
+	WriteOverlappingRows(drawCtx, *list, area);
+
+	const uint32_t pixels = lv_area_get_size(&area);
+	if (opaqueFill && pixels >= MinPixels && list->count < SSD1963::MaxSolidAreas)
+	{
+		list->areas[list->count++] = SSD1963::SolidArea{ area, dsc->color };
+		++stats.fills;
+		stats.pixelsDeferred += pixels;
+		return;
+	}
+	lvglBlend(drawCtx, dsc);
+}
+
+// Hook the blend function of a software draw context. Call this from the draw_ctx_init function of the display driver, after lv_draw_sw_init_ctx.
+void DeferredFill::Install(lv_draw_ctx_t *drawCtx) noexcept
+{
+	lv_draw_sw_ctx_t * const swCtx = reinterpret_cast<lv_draw_sw_ctx_t*>(drawCtx);
+	lvglBlend = swCtx->blend;
+	swCtx->blend = Blend;
+}
+
+// Write the parts of the solid areas that overlap an area to the draw buffer. Call this before writing to the draw buffer other than through LVGL.
+void DeferredFill::WriteSolidAreas(lv_draw_ctx_t *drawCtx, const lv_area_t& area) noexcept
+{
+	SolidList * const list = GetList(drawCtx);
+	if (list != nullptr)
+	{
+		WriteOverlappingRows(drawCtx, *list, area);
+	}
+}
+
+// Get the solid areas of a draw buffer that is about to be flushed. They remain valid until the flush is complete.
+const SSD1963::SolidArea *DeferredFill::TakeSolidAreas(const void *buf, size_t& count) noexcept
+{
+	for (SolidList& list : lists)
+	{
+		if (list.buf == buf && !list.flushed)
+		{
+			list.flushed = true;
+			count = list.count;
+			return list.areas;
+		}
+	}
+	count = 0;
+	return nullptr;
+}
+
+const Stats& DeferredFill::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
@@ -0,0 +1,38 @@
+/*
+ * DeferredFill.h
+ *
+ *  Created on: 22 Feb 2023
+ *      Author: David
+ *
+ *  Most of the screen is solid rectangles: the backgrounds of the screen, the grid and the tiles. This replaces the blend function of
+ *  the software draw context so that an opaque fill of a large enough area is not written to the draw buffer but kept as a solid area,
+ *  which the flush sends as one pixel followed by a write strobe for each of the others. When something is drawn over part of a solid area,
+ *  the rows of it that are affected are written to the draw buffer first, and the rows above and below stay solid.
+ */
+
+#ifndef SRC_UI_DEFERREDFILL_H_
+#define SRC_UI_DEFERREDFILL_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <lvgl.h>
+#include <Drivers/SSD1963.h>
+
+namespace DeferredFill
+{
+	constexpr uint32_t MinPixels = 256;						// smaller fills are drawn as usual
+
+	struct Stats
+	{
+		uint32_t fills;										// fills kept as solid areas
+		uint32_t pixelsDeferred;							// pixels of those fills not written to the draw buffer when they were drawn
+		uint32_t pixelsWritten;								// pixels of solid areas written to the draw buffer later because something was drawn over them
+	};
+
+	void Install(lv_draw_ctx_t *drawCtx) noexcept;
+	void WriteSolidAreas(lv_draw_ctx_t *drawCtx, const lv_area_t& area) noexcept;
+	const SSD1963::SolidArea *TakeSolidAreas(const void *buf, size_t& count) noexcept;
+	const Stats& GetStats() noexcept;
+}
+
+#endif /* SRC_UI_DEFERREDFILL_H_ */
@@ -0,0 +1,202 @@
+/*
+ * GlyphCache.cpp
+ *
+ *  Created on: 20 Feb 2023
+ *      Author: David
+ *
+ *  The cache replaces the draw_letter function of the software draw context and passes to the original function any glyph it
+ *  can't handle: other fonts, partly transparent text, glyphs with active masks, glyphs that aren't in the font itself, and
+ *  glyphs over a background that isn't a single colour. Tiles are blended as LVGL's software renderer blends a glyph,
+ *  using the same opacity for each level of the glyph bitmap and the same colour mixing.
+ */
+
+#include "GlyphCache.h"
+#include "DeferredFill.h"
+#include <TimeCritical.h>
+#include <cstring>
+
+using namespace GlyphCache;
+
+struct Entry
+{
+	const lv_font_t *font;								// nullptr if the entry is free
+	uint32_t letter;
+	lv_color_t colour;
+	lv_color_t background;
+	uint32_t lastUsed;
+	lv_coord_t width;
+	lv_coord_t height;
+	lv_color_t pixels[MaxTilePixels];
+};
+
+static Entry entries[MaxEntries];
+static const lv_font_t *fonts[MaxFonts];
+static size_t numFonts = 0;
+static uint32_t useCount = 0;
+static Stats stats = {};
+static decltype(lv_draw_ctx_t::draw_letter) lvglDrawLetter = nullptr;
+
+static bool IsCachedFont(const lv_font_t *font) noexcept
+{
+	for (size_t i = 0; i < numFonts; ++i)
+	{
+		if (fonts[i] == font)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Return the colour of the draw buffer pixels in an area if they are all the same
+TIME_CRITICAL(GetBackground) static bool GetBackground(const lv_draw_ctx_t *drawCtx, const lv_area_t& area, lv_color_t& background) noexcept
+{
+	const lv_coord_t stride = lv_area_get_width(drawCtx->buf_area);
+	const lv_color_t *row = static_cast<const lv_color_t*>(drawCtx->buf) + (area.y1 - drawCtx->buf_area->y1) * stride + (area.x1 - drawCtx->buf_area->x1);
+	background = row[0];
+	for (lv_coord_t y = area.y1; y <= area.y2; ++y)
+	{
+		for (lv_coord_t x = 0; x <= area.x2 - area.x1; ++x)
+		{
+			if (row[x].full != background.full)
+			{
+				return false;
+			}
+		}
+		row += stride;
+	}
+	return true;
+}
+
+// Blend a glyph bitmap into a tile
+static void Render(Entry& e, const lv_font_glyph_dsc_t& g, const uint8_t *bitmap) noexcept
+{
+	const uint32_t levelMask = (1u << g.bpp) - 1;
+	const uint32_t opaPerLevel = LV_OPA_COVER/levelMask;				// 255, 85, 17 or 1 for 1, 2, 4 or 8 bits per pixel
+	uint32_t bitPos = 0;
+	for (size_t i = 0; i < (size_t)g.box_w * g.box_h; ++i)
+	{
+		const uint32_t level = (bitmap[bitPos >> 3] >> (8 - g.bpp - (bitPos & 7))) & levelMask;
+		const lv_opa_t opa = (lv_opa_t)(level * opaPerLevel);
+		e.pixels[i] = (opa == LV_OPA_COVER) ? e.colour : lv_color_mix(e.colour, e.background, opa);
+		bitPos += g.bpp;
+	}
+	e.width = (lv_coord_t)g.box_w;
+	e.height = (lv_coord_t)g.box_h;
+}
+
+// Find the tile for a glyph, rendering it in place of the least recently used one if it isn't in the cache
+static const Entry& GetTile(const lv_font_t *font, uint32_t letter, lv_color_t colour, lv_color_t background, const lv_font_glyph_dsc_t& g) noexcept
+{
+	Entry *lru = &entries[0];
+	for (Entry& e : entries)
+	{
+		if (e.font == font && e.letter == letter && e.colour.full == colour.full && e.background.full == background.full)
+		{
+			++stats.hits;
+			e.lastUsed = ++useCount;
+			return e;
+		}
+		if (e.font == nullptr || (lru->font != nullptr && e.lastUsed < lru->lastUsed))
+		{
+			lru = &e;
+		}
+	}
+
+	++stats.misses;
+	if (lru->font != nullptr)
+	{
+		++stats.evictions;
+	}
+	lru->font = font;
+	lru->letter = letter;
+	lru->colour = colour;
+	lru->background = background;
+	lru->lastUsed = ++useCount;
+	Render(*lru, g, font->get_glyph_bitmap(font, letter));
+	return *lru;
+}
+
+TIME_CRITICAL(DrawLetter) static void DrawLetter(lv_draw_ctx_t *drawCtx, const lv_draw_label_dsc_t *dsc, const lv_point_t *pos, uint32_t letter) noexcept
+{
+	const lv_font_t * const font = dsc->font;
+	lv_font_glyph_dsc_t g;
+	if (   !IsCachedFont(font)
+		|| dsc->opa < LV_OPA_MAX
+		|| dsc->blend_mode != LV_BLEND_MODE_NORMAL
+		|| !font->get_glyph_dsc(font, &g, letter, 0)					// call the font directly so that we don't get a fallback font or placeholder
+		|| g.box_w == 0 || g.box_h == 0
+	   )
+	{
+		lvglDrawLetter(drawCtx, dsc, pos, letter);
+		return;
+	}
+
+	lv_area_t area;
+	area.x1 = pos->x + g.ofs_x;
+	area.y1 = pos->y + (font->line_height - font->base_line) - g.box_h - g.ofs_y;
+	area.x2 = area.x1 + g.box_w - 1;
+	area.y2 = area.y1 + g.box_h - 1;
+	lv_area_t clipped;
+	if (!_lv_area_intersect(&clipped, &area, drawCtx->clip_area))
+	{
+		return;
+	}
+
+	DeferredFill::WriteSolidAreas(drawCtx, clipped);
+	lv_color_t background;
+	if (   (size_t)g.box_w * g.box_h > MaxTilePixels
+		|| (g.bpp != 1 && g.bpp != 2 && g.bpp != 4 && g.bpp != 8)
+		|| font->subpx != LV_FONT_SUBPX_NONE
+		|| lv_draw_mask_is_any(&clipped)
+		|| !GetBackground(drawCtx, clipped, background)
+	   )
+	{
+		++stats.bypassed;
+		lvglDrawLetter(drawCtx, dsc, pos, letter);
+		return;
+	}
+
+	// Copy the visible part of the tile into the draw buffer
+	const Entry& tile = GetTile(font, letter, dsc->color, background, g);
+	const lv_coord_t stride = lv_area_get_width(drawCtx->buf_area);
+	lv_color_t *dest = static_cast<lv_color_t*>(drawCtx->buf) + (clipped.y1 - drawCtx->buf_area->y1) * stride + (clipped.x1 - drawCtx->buf_area->x1);
+	const lv_color_t *src = tile.pixels + (clipped.y1 - area.y1) * tile.width + (clipped.x1 - area.x1);
+	const size_t bytesPerRow = lv_area_get_width(&clipped) * sizeof(lv_color_t);
+	for (lv_coord_t y = clipped.y1; y <= clipped.y2; ++y)
+	{
+		memcpy(dest, src, bytesPerRow);
+		dest += stride;
+		src += tile.width;
+	}
+}
+
+// Initialise the software draw context and hook its glyph drawing. Call this from the draw_ctx_init function of the display driver.
+void GlyphCache::Install(lv_disp_drv_t *drv, lv_draw_ctx_t *drawCtx) noexcept
+{
+	lv_draw_sw_init_ctx(drv, drawCtx);
+	lvglDrawLetter = drawCtx->draw_letter;
+	drawCtx->draw_letter = DrawLetter;
+}
+
+// Cache the glyphs of a font, returning false if too many fonts have been added
+bool GlyphCache::AddFont(const lv_font_t *font) noexcept
+{
+	if (IsCachedFont(font))
+	{
+		return true;
+	}
+	if (numFonts == MaxFonts)
+	{
+		return false;
+	}
+	fonts[numFonts++] = font;
+	return true;
+}
+
+const Stats& GlyphCache::GetStats() noexcept
+{
+	return stats;
+}
+
+// End
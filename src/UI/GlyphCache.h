@@ -0,0 +1,40 @@
+/*
+ * GlyphCache.h
+ *
+ *  Created on: 20 Feb 2023
+ *      Author: David
+ *
+ *  Cache of rendered glyphs for the fonts of the readouts that change while the display is running. Each entry is an RGB565 tile
+ *  of one glyph already blended in one colour against one background colour, so when a digit changes it is copied into the draw
+ *  buffer instead of being anti-aliased again. A glyph is taken from the cache only when the pixels it covers are all the same
+ *  colour, which is true for the value labels on the plain tile backgrounds; otherwise LVGL draws it as usual.
+ *  The cache has a fixed number of entries and the least recently used one is replaced when it is full.
+ */
+
+#ifndef SRC_UI_GLYPHCACHE_H_
+#define SRC_UI_GLYPHCACHE_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <lvgl.h>
+
+namespace GlyphCache
+{
+	constexpr size_t MaxEntries = 24;
+	constexpr size_t MaxTilePixels = 384;					// larger glyphs are not cached
+	constexpr size_t MaxFonts = 2;
+
+	struct Stats
+	{
+		uint32_t hits;
+		uint32_t misses;
+		uint32_t evictions;
+		uint32_t bypassed;									// glyphs of a cached font that LVGL drew because the cache couldn't be used
+	};
+
+	void Install(lv_disp_drv_t *drv, lv_draw_ctx_t *drawCtx) noexcept;
+	bool AddFont(const lv_font_t *font) noexcept;
+	const Stats& GetStats() noexcept;
+}
+
+#endif /* SRC_UI_GLYPHCACHE_H_ */
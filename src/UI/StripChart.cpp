@@ -0,0 +1,228 @@
+/*
+ * StripChart.cpp
+ *
+ *  Created on: 14 Feb 2023
+ *      Author: David
+ */
+
+#include "StripChart.h"
+
+// Create the chart object. Its size is set by the caller or the parent's layout, and it is cleared whenever the size changes.
+void StripChart::Create(lv_obj_t *parent) noexcept
+{
+	obj = lv_obj_create(parent);
+	lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+	lv_obj_add_event_cb(obj, EventHandler, LV_EVENT_DRAW_MAIN, this);
+	lv_obj_add_event_cb(obj, EventHandler, LV_EVENT_SIZE_CHANGED, this);
+	Clear();
+}
+
+bool StripChart::AddSeries(lv_color_t colour) noexcept
+{
+	if (numSeries == MaxSeries)
+	{
+		return false;
+	}
+	colours[numSeries++] = colour;
+	Clear();
+	return true;
+}
+
+// Set the values at the bottom and top of the chart. The rows we have stored are no longer valid, so this clears the chart.
+void StripChart::SetRange(int32_t p_minValue, int32_t p_maxValue) noexcept
+{
+	if (p_maxValue > p_minValue && (p_minValue != minValue || p_maxValue != maxValue))
+	{
+		minValue = p_minValue;
+		maxValue = p_maxValue;
+		Clear();
+	}
+}
+
+// Remove all the columns and start again at the left
+void StripChart::Clear() noexcept
+{
+	for (auto& column : columns)
+	{
+		for (Column& c : column)
+		{
+			c.top = c.bottom = c.average = NoData;
+		}
+	}
+	cursor = 0;
+	if (obj != nullptr)
+	{
+		const lv_coord_t h = lv_obj_get_content_height(obj);
+		height = (h > MaxHeight) ? MaxHeight : (h < 1) ? 1 : h;
+		lv_obj_invalidate(obj);
+		++stats.fullRedraws;
+	}
+}
+
+size_t StripChart::GetNumColumns() const noexcept
+{
+	const lv_coord_t w = lv_obj_get_content_width(obj);
+	return (w <= 0) ? 0 : ((size_t)w > MaxColumns) ? MaxColumns : (size_t)w;
+}
+
+uint8_t StripChart::ValueToRow(int32_t value) const noexcept
+{
+	const int32_t v = (value < minValue) ? minValue : (value > maxValue) ? maxValue : value;
+	return (uint8_t)(((int64_t)(maxValue - v) * (height - 1))/(maxValue - minValue));
+}
+
+// Add a column at the cursor, with one summary per series, and blank the column that is now the far edge of the gap ahead of the cursor.
+// The column after that is invalidated too, because it no longer has a line joining it to the column before.
+void StripChart::AddColumn(const TimeSeries::Summary *values) noexcept
+{
+	const size_t numColumns = GetNumColumns();
+	if (numColumns <= GapColumns + 1)
+	{
+		return;
+	}
+	if (cursor >= numColumns)
+	{
+		cursor = 0;
+	}
+
+	for (size_t i = 0; i < numSeries; ++i)
+	{
+		Column& c = columns[cursor][i];
+		if (values[i].count == 0)
+		{
+			c.top = c.bottom = c.average = NoData;
+		}
+		else
+		{
+			c.top = ValueToRow(values[i].max);
+			c.bottom = ValueToRow(values[i].min);
+			c.average = ValueToRow(values[i].avg);
+		}
+	}
+	InvalidateColumns(cursor, 1);
+
+	const size_t gapEdge = (cursor + GapColumns) % numColumns;
+	for (Column& c : columns[gapEdge])
+	{
+		c.top = c.bottom = c.average = NoData;
+	}
+	// The column after the gap edge joins its average line to the gap edge, so it has to be redrawn too, unless it is column 0, which isn't joined
+	InvalidateColumns(gapEdge, (gapEdge + 1 < numColumns) ? 2 : 1);
+
+	cursor = (cursor + 1) % numColumns;
+	++stats.columnsAdded;
+}
+
+void StripChart::InvalidateColumns(size_t firstColumn, size_t count) noexcept
+{
+	lv_area_t content;
+	lv_obj_get_content_coords(obj, &content);
+	lv_area_t area;
+	area.x1 = content.x1 + (lv_coord_t)firstColumn;
+	area.x2 = area.x1 + (lv_coord_t)count - 1;
+	area.y1 = content.y1;
+	area.y2 = content.y1 + height - 1;
+	lv_obj_invalidate_area(obj, &area);
+}
+
+void StripChart::EventHandler(lv_event_t *e) noexcept
+{
+	StripChart * const chart = static_cast<StripChart*>(lv_event_get_user_data(e));
+	switch (lv_event_get_code(e))
+	{
+	case LV_EVENT_DRAW_MAIN:
+		chart->Draw(lv_event_get_draw_ctx(e));
+		break;
+
+	case LV_EVENT_SIZE_CHANGED:
+		chart->Clear();
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Draw the columns that fall within the clip area. This is called after the object's background has been drawn.
+void StripChart::Draw(lv_draw_ctx_t *drawCtx) noexcept
+{
+	lv_area_t content;
+	lv_obj_get_content_coords(obj, &content);
+	const lv_area_t& clip = *drawCtx->clip_area;
+	const lv_coord_t firstX = (clip.x1 > content.x1) ? clip.x1 : content.x1;
+	const lv_coord_t lastX = ((clip.x2 - content.x1) < (lv_coord_t)GetNumColumns()) ? clip.x2 : content.x1 + (lv_coord_t)GetNumColumns() - 1;
+	if (firstX > lastX)
+	{
+		return;
+	}
+
+	lv_draw_rect_dsc_t dsc;
+	lv_draw_rect_dsc_init(&dsc);
+	lv_area_t area;
+
+	// Draw the zero line under the data
+	if (minValue < 0 && maxValue > 0)
+	{
+		area.x1 = firstX;
+		area.x2 = lastX;
+		area.y1 = area.y2 = content.y1 + ValueToRow(0);
+		if (area.y1 >= clip.y1 && area.y1 <= clip.y2)
+		{
+			dsc.bg_color = lv_palette_main(LV_PALETTE_GREY);
+			dsc.bg_opa = LV_OPA_50;
+			lv_draw_rect(drawCtx, &dsc, &area);
+		}
+	}
+
+	for (lv_coord_t x = firstX; x <= lastX; ++x)
+	{
+		const size_t column = (size_t)(x - content.x1);
+		area.x1 = area.x2 = x;
+		for (size_t i = 0; i < numSeries; ++i)
+		{
+			const Column& c = columns[column][i];
+			if (c.average == NoData)
+			{
+				continue;
+			}
+
+			// Minimum to maximum band
+			area.y1 = content.y1 + c.top;
+			area.y2 = content.y1 + c.bottom;
+			if (area.y1 <= clip.y2 && area.y2 >= clip.y1)
+			{
+				dsc.bg_color = colours[i];
+				dsc.bg_opa = LV_OPA_30;
+				lv_draw_rect(drawCtx, &dsc, &area);
+			}
+
+			// Average line, joined to the average in the previous column. We don't join the first column to the last one.
+			uint8_t from = c.average, to = c.average;
+			if (column != 0)
+			{
+				const uint8_t previous = columns[column - 1][i].average;
+				if (previous != NoData)
+				{
+					if (previous < from)
+					{
+						from = previous;
+					}
+					else
+					{
+						to = previous;
+					}
+				}
+			}
+			area.y1 = content.y1 + from;
+			area.y2 = content.y1 + to;
+			if (area.y1 <= clip.y2 && area.y2 >= clip.y1)
+			{
+				dsc.bg_color = colours[i];
+				dsc.bg_opa = LV_OPA_COVER;
+				lv_draw_rect(drawCtx, &dsc, &area);
+			}
+		}
+	}
+}
+
+// End
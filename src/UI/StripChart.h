@@ -0,0 +1,69 @@
+/*
+ * StripChart.h
+ *
+ *  Created on: 14 Feb 2023
+ *      Author: David
+ *
+ *  Sweep-mode chart of the power history. New columns are written at a cursor that moves from left to right and wraps around,
+ *  with a blank gap ahead of it, instead of the whole chart scrolling left. So adding a column invalidates just two narrow areas:
+ *  the new column, and the column that becomes the leading edge of the gap together with the one after it, whose average line
+ *  joins the cleared column. The flush sends O(height) pixels instead of the whole chart.
+ *  Each column shows the minimum to maximum range of each series as a faint band and the average as a line.
+ */
+
+#ifndef SRC_UI_STRIPCHART_H_
+#define SRC_UI_STRIPCHART_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <lvgl.h>
+#include <Telemetry/TimeSeries.h>
+
+class StripChart
+{
+public:
+	static constexpr size_t MaxSeries = 3;
+	static constexpr size_t MaxColumns = 800;
+	static constexpr lv_coord_t MaxHeight = 254;			// rows are stored in a byte, and NoData is reserved
+	static constexpr size_t GapColumns = 8;					// blank columns ahead of the cursor
+
+	struct Stats
+	{
+		uint32_t columnsAdded;
+		uint32_t fullRedraws;
+	};
+
+	void Create(lv_obj_t *parent) noexcept;
+	lv_obj_t *GetObject() const noexcept { return obj; }
+	bool AddSeries(lv_color_t colour) noexcept;
+	void SetRange(int32_t p_minValue, int32_t p_maxValue) noexcept;
+	void AddColumn(const TimeSeries::Summary *values) noexcept;
+	void Clear() noexcept;
+	size_t GetNumColumns() const noexcept;
+	const Stats& GetStats() const noexcept { return stats; }
+
+private:
+	static constexpr uint8_t NoData = 0xFF;
+
+	// Pixel rows of one series in one column, counted from the top of the chart's content area
+	struct Column
+	{
+		uint8_t top, bottom, average;
+	};
+
+	static void EventHandler(lv_event_t *e) noexcept;
+	void Draw(lv_draw_ctx_t *drawCtx) noexcept;
+	void InvalidateColumns(size_t firstColumn, size_t count) noexcept;
+	uint8_t ValueToRow(int32_t value) const noexcept;
+
+	lv_obj_t *obj = nullptr;
+	lv_color_t colours[MaxSeries];
+	size_t numSeries = 0;
+	int32_t minValue = 0, maxValue = 1;
+	lv_coord_t height = 0;								// content height when the rows were calculated
+	size_t cursor = 0;									// the column that the next value goes in
+	Stats stats = {};
+	Column columns[MaxColumns][MaxSeries];
+};
+
+#endif /* SRC_UI_STRIPCHART_H_ */